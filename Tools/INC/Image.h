@@ -61,6 +61,9 @@ struct IMG_MODULE_HEADER
 
 #define IMAGE_SECTION_CODE		0x00000001	/*< The section has code*/
 #define IMAGE_SECTION_DATA		0x00000002	/*< The section has data*/
+#define IMAGE_SECTION_PAGED		0x00000004	/*< The reloc section is sorted and followed by a IMG_RELOCATION_PAGES index*/
+#define IMAGE_SECTION_PRELINK	0x00000008	/*< The reloc section ends with a IMG_PRELINK record (after the page index)*/
+#define IMAGE_SECTION_COMPRESSED	0x00000010	/*< The section is stored in the XLZ stream (dword size + data) found in the file where the first section starts*/
 #define IMAGE_MODE_USER			0x00000001	/*< The image is for user-land*/
 #define IMAGE_MODE_SYSTEM		0x00000000	/*< The image is for kernel-land*/
 #define IMAGE_KIND_CLASS		0x00000001	/*< The image is a class-based module (unsupported)*/
@@ -82,6 +85,32 @@ struct IMG_RELOCATION
 	dword relocations[];
 };
 
+/**
+* @brief	XkyOS image per-page relocation index.
+* Present right after the IMG_RELOCATION array when the reloc section has IMAGE_SECTION_PAGED. Relocations are
+* then sorted by offset and first_relocation[i] is the first one touching file page i, so a loader can bring in
+* and relocate a single page without walking the whole table.
+*/
+struct IMG_RELOCATION_PAGES
+{
+	dword number_of_pages;
+	dword first_relocation[];
+};
+
+/**
+* @brief	XkyOS image prelink record.
+* Written by PE2X at the end of the reloc section. An image prelinked at "base" has its relocations already
+* applied for that base, and if "imports_base" is not zero its imports are already bound to the export module
+* with "imports_checksum" loaded at "imports_base". The loader only relocates or binds when these don't match.
+*/
+struct IMG_PRELINK
+{
+	dword base;
+	dword checksum;
+	dword imports_base;
+	dword imports_checksum;
+};
+
 /**
 * @brief	Maximum size for bounded string used in exports. Allows extern's to be 64 bytes.
 */
@@ -11,6 +11,7 @@
 #ifndef __TYPES_H__
 #define __TYPES_H__
 
+#if defined(_MSC_VER)
 #pragma warning(disable:4200)
 #pragma warning(disable:4201)
 #pragma warning(disable:4100)
@@ -41,6 +42,16 @@ typedef unsigned __int64	qword;
 * @brief For alignment issues in the image
 */
 #define ALIGN(X)	__declspec(align(X))
+#else
+//The same types for the host tests built with GCC (XMEMTEST, XHEAPTEST)
+typedef unsigned char		byte;
+typedef unsigned short		word;
+typedef unsigned int		dword;
+typedef unsigned long long	qword;
+
+#define NAKED		__attribute__((naked))
+#define ALIGN(X)	__attribute__((aligned(X)))
+#endif
 
 
 /**
@@ -0,0 +1,381 @@
+/******************************************************************************/
+/**
+* @file		XHEAP.h
+* @brief	XkyOS boundary tag heap
+* Heap of the user RTL, built on the host too so XHEAPTEST can stress it.
+* Blocks follow each other from the start of the heap to a fence at its end, each with its size and the
+* size of the block before, so a freed block merges with the free ones around. Free blocks wait in bins
+* by a power of two of sizes, and freed small ones in a quick list per size, not merged until no free
+* block is large enough. The heap grows after its end through the map function it is given: XKY_PAGE_Alloc
+* in the RTL, mmap on the host. Locking is left to the caller.
+*
+* @date		20/03/2008
+* @author	Pablo Bravo
+*/
+/******************************************************************************/
+#ifndef __XHEAP_H__
+#define __XHEAP_H__
+
+#include "Types.h"
+
+/**
+* @brief Header of a heap block.
+*/
+struct XHEAP_BLOCK
+{
+	dword	size;		/*< Bytes of the block, header included, and the XHEAP_USED and XHEAP_QUICK flags*/
+	dword	previous;	/*< Bytes of the block before, zero for the first*/
+};
+
+/**
+* @brief A free block, linked in its bin, or a freed small one in its quick list.
+*/
+struct XHEAP_FREE_BLOCK
+{
+	XHEAP_BLOCK			header;
+	XHEAP_FREE_BLOCK*	next;
+	XHEAP_FREE_BLOCK*	back;	/*< Not used in the quick lists*/
+};
+
+#define XHEAP_PAGE_SIZE		4096
+#define XHEAP_GROW_PAGES	16			/*< Fewest pages the heap grows by*/
+#define XHEAP_GRANULARITY	8			/*< Blocks are multiples of it, so allocations are aligned to it*/
+#define XHEAP_MIN_BLOCK		((dword)sizeof(XHEAP_FREE_BLOCK))
+#define XHEAP_USED			1			/*< The block is allocated, or waiting in a quick list*/
+#define XHEAP_QUICK			2			/*< The block is waiting in a quick list*/
+#define XHEAP_QUICK_MAX		256			/*< Freed blocks up to this size wait in the quick list of their size*/
+#define XHEAP_QUICK_LISTS	(XHEAP_QUICK_MAX/XHEAP_GRANULARITY - 1)
+#define XHEAP_BINS			16			/*< Free blocks lists, a power of two of sizes each*/
+#define XHEAP_SIZE(X)		((X)->size & ~(XHEAP_GRANULARITY - 1))
+#define XHEAP_NEXT(X)		((XHEAP_BLOCK*)((byte*)(X) + XHEAP_SIZE(X)))
+
+/**
+* @brief Maps pages at an address.
+* @return True if they are mapped there.
+*/
+typedef bool (*fXHEAP_Map)(byte* _address, dword _pages);
+
+/**
+* @brief Heap counters, as HEAP_STATISTICS in the RTL.
+*/
+struct XHEAP_STATISTICS
+{
+	dword	pages;			/*< Pages the heap has taken*/
+	dword	used;			/*< Bytes of the blocks allocated, headers included*/
+	dword	cached;			/*< Bytes of the freed blocks waiting in the quick lists*/
+	dword	free;			/*< Bytes of the free blocks*/
+	dword	allocations;	/*< Calls to XHEAP_Alloc that got memory*/
+	dword	quick;			/*< Of them, served from a quick list*/
+	dword	frees;			/*< Calls to XHEAP_Free*/
+	dword	failures;		/*< Calls to XHEAP_Alloc that got nothing*/
+};
+
+/**
+* @brief Heap definition.
+*/
+struct XHEAP
+{
+	byte*				start;						/*< Address of the heap*/
+	dword				pages;						/*< Pages from start*/
+	dword				max_pages;					/*< Pages the heap can grow to*/
+	fXHEAP_Map			map;						/*< Maps the pages the heap grows by*/
+	XHEAP_FREE_BLOCK*	bins[XHEAP_BINS];			/*< Free blocks, merged with the free ones around*/
+	XHEAP_FREE_BLOCK*	quick[XHEAP_QUICK_LISTS];	/*< Freed small blocks, by size, not merged until needed*/
+	XHEAP_STATISTICS	statistics;
+};
+
+/**
+* @brief Tells the bin of a free block.
+* @param _size [in] Bytes of the block.
+* @return The bin, the smallest blocks go in the first one and each one after takes twice larger blocks.
+*/
+inline dword XHEAP_Bin(dword _size)
+{
+	dword bin = 0;
+	for(_size /= 2*XHEAP_MIN_BLOCK; _size && bin < XHEAP_BINS - 1; _size /= 2)
+		bin++;
+	return bin;
+}
+
+/**
+* @brief Puts a free block in its bin.
+*/
+inline void XHEAP_Insert(XHEAP* _heap, XHEAP_FREE_BLOCK* _block)
+{
+	dword bin = XHEAP_Bin(_block->header.size);
+	_block->next = _heap->bins[bin];
+	_block->back = 0;
+	if(_block->next)
+		_block->next->back = _block;
+	_heap->bins[bin] = _block;
+	_heap->statistics.free += _block->header.size;
+}
+
+/**
+* @brief Takes a free block out of its bin.
+*/
+inline void XHEAP_Unlink(XHEAP* _heap, XHEAP_FREE_BLOCK* _block)
+{
+	if(_block->back)
+		_block->back->next = _block->next;
+	else
+		_heap->bins[XHEAP_Bin(_block->header.size)] = _block->next;
+	if(_block->next)
+		_block->next->back = _block->back;
+	_heap->statistics.free -= _block->header.size;
+}
+
+/**
+* @brief Frees a block, merged with the blocks around if they are free.
+* @param _block [in] The block, allocated or out of a quick list.
+*/
+inline void XHEAP_Release(XHEAP* _heap, XHEAP_BLOCK* _block)
+{
+	dword size = XHEAP_SIZE(_block);
+
+	XHEAP_BLOCK* next = XHEAP_NEXT(_block);
+	if(!(next->size & XHEAP_USED))
+	{
+		XHEAP_Unlink(_heap, (XHEAP_FREE_BLOCK*)next);
+		size += next->size;
+	}
+
+	if(_block->previous)
+	{
+		XHEAP_BLOCK* previous = (XHEAP_BLOCK*)((byte*)_block - _block->previous);
+		if(!(previous->size & XHEAP_USED))
+		{
+			XHEAP_Unlink(_heap, (XHEAP_FREE_BLOCK*)previous);
+			size += previous->size;
+
+			//Its header is now inside a free block, it must not pass for a used one if freed again
+			_block->size &= ~XHEAP_USED;
+			_block = previous;
+		}
+	}
+
+	_block->size = size;
+	XHEAP_NEXT(_block)->previous = size;
+	XHEAP_Insert(_heap, (XHEAP_FREE_BLOCK*)_block);
+}
+
+/**
+* @brief Frees the blocks waiting in the quick lists, so they can merge.
+*/
+inline void XHEAP_Consolidate(XHEAP* _heap)
+{
+	for(dword i = 0; i < XHEAP_QUICK_LISTS; i++)
+	{
+		while(_heap->quick[i])
+		{
+			XHEAP_FREE_BLOCK* block = _heap->quick[i];
+			_heap->quick[i] = block->next;
+			_heap->statistics.cached -= XHEAP_SIZE(&block->header);
+			XHEAP_Release(_heap, &block->header);
+		}
+	}
+}
+
+/**
+* @brief Finds a free block, the first large enough in the smallest bin that has one.
+* @return The block, zero if there is none.
+*/
+inline XHEAP_FREE_BLOCK* XHEAP_Find(XHEAP* _heap, dword _size)
+{
+	for(dword bin = XHEAP_Bin(_size); bin < XHEAP_BINS; bin++)
+	{
+		for(XHEAP_FREE_BLOCK* block = _heap->bins[bin]; block; block = block->next)
+		{
+			if(block->header.size >= _size)
+				return block;
+		}
+	}
+	return 0;
+}
+
+/**
+* @brief Allocates a free block, and gives back to its bin what it has left.
+* @return The allocated block.
+*/
+inline XHEAP_BLOCK* XHEAP_Take(XHEAP* _heap, XHEAP_FREE_BLOCK* _block, dword _size)
+{
+	XHEAP_Unlink(_heap, _block);
+
+	XHEAP_BLOCK* block = &_block->header;
+	dword rest = block->size - _size;
+	if(rest >= XHEAP_MIN_BLOCK)
+	{
+		block->size = _size;
+
+		XHEAP_BLOCK* left = XHEAP_NEXT(block);
+		left->size = rest;
+		left->previous = _size;
+		XHEAP_NEXT(left)->previous = rest;
+		XHEAP_Insert(_heap, (XHEAP_FREE_BLOCK*)left);
+	}
+
+	block->size |= XHEAP_USED;
+	_heap->statistics.used += XHEAP_SIZE(block);
+	return block;
+}
+
+/**
+* @brief Grows the heap with pages after its end, for a free block of at least a size.
+* @return True if the heap has grown.
+*/
+inline bool XHEAP_Grow(XHEAP* _heap, dword _size)
+{
+	dword needed = (_size + XHEAP_PAGE_SIZE - 1)/XHEAP_PAGE_SIZE;
+	dword pages = needed;
+	if(pages < XHEAP_GROW_PAGES)
+		pages = XHEAP_GROW_PAGES;
+	if(pages > _heap->max_pages - _heap->pages)
+		pages = _heap->max_pages - _heap->pages;
+	if(pages < needed)
+		return false;
+
+	byte* end = _heap->start + _heap->pages*XHEAP_PAGE_SIZE;
+	if(!_heap->map(end, pages))
+		return false;
+	_heap->pages += pages;
+	_heap->statistics.pages = _heap->pages;
+
+	//The old fence starts the new block, and a new one ends it
+	XHEAP_BLOCK* block = (XHEAP_BLOCK*)(end - sizeof(XHEAP_BLOCK));
+	block->size = pages*XHEAP_PAGE_SIZE | XHEAP_USED;
+
+	XHEAP_BLOCK* fence = XHEAP_NEXT(block);
+	fence->size = XHEAP_USED;
+	fence->previous = pages*XHEAP_PAGE_SIZE;
+
+	XHEAP_Release(_heap, block);
+	return true;
+}
+
+/**
+* @brief Initializes a heap, mapping its first pages.
+* @param _heap [out] The heap.
+* @param _start [in] Address of the heap, page aligned.
+* @param _max_pages [in] Pages the heap can grow to, XHEAP_GROW_PAGES at least.
+* @param _map [in] Maps the pages of the heap.
+* @return True if the first pages could be mapped.
+*/
+inline bool XHEAP_Init(XHEAP* _heap, byte* _start, dword _max_pages, fXHEAP_Map _map)
+{
+	_heap->start = _start;
+	_heap->pages = 0;
+	_heap->max_pages = _max_pages;
+	_heap->map = _map;
+	for(dword i = 0; i < XHEAP_BINS; i++)
+		_heap->bins[i] = 0;
+	for(dword i = 0; i < XHEAP_QUICK_LISTS; i++)
+		_heap->quick[i] = 0;
+	XHEAP_STATISTICS empty = {0, 0, 0, 0, 0, 0, 0, 0};
+	_heap->statistics = empty;
+
+	if(!_map(_start, XHEAP_GROW_PAGES))
+		return false;
+	_heap->pages = XHEAP_GROW_PAGES;
+	_heap->statistics.pages = _heap->pages;
+
+	//A free block to the fence
+	XHEAP_BLOCK* block = (XHEAP_BLOCK*)_start;
+	block->size = XHEAP_GROW_PAGES*XHEAP_PAGE_SIZE - sizeof(XHEAP_BLOCK);
+	block->previous = 0;
+
+	XHEAP_BLOCK* fence = XHEAP_NEXT(block);
+	fence->size = XHEAP_USED;
+	fence->previous = block->size;
+
+	XHEAP_Insert(_heap, (XHEAP_FREE_BLOCK*)block);
+	return true;
+}
+
+/**
+* @brief Allocates memory from a heap. Small blocks come from the quick list of their size if it has
+* any; the rest from the free blocks, merging the quick lists first if none is large enough, and growing
+* the heap if still none is.
+* @param _heap [in out] The heap.
+* @param _size [in] Number of bytes to be allocated.
+* @return Address to be used, aligned to XHEAP_GRANULARITY, or zero if there was an error.
+*/
+inline void* XHEAP_Alloc(XHEAP* _heap, dword _size)
+{
+	if(!_size || _size > _heap->max_pages*XHEAP_PAGE_SIZE)
+		return 0;
+
+	dword size = (_size + sizeof(XHEAP_BLOCK) + XHEAP_GRANULARITY - 1) & ~(XHEAP_GRANULARITY - 1);
+	if(size < XHEAP_MIN_BLOCK)
+		size = XHEAP_MIN_BLOCK;
+
+	XHEAP_BLOCK* block = 0;
+	dword quick = size/XHEAP_GRANULARITY - 2;
+	if(size <= XHEAP_QUICK_MAX && _heap->quick[quick])
+	{
+		XHEAP_FREE_BLOCK* cached = _heap->quick[quick];
+		_heap->quick[quick] = cached->next;
+
+		block = &cached->header;
+		block->size &= ~XHEAP_QUICK;
+		_heap->statistics.cached -= size;
+		_heap->statistics.used += size;
+		_heap->statistics.quick++;
+	}
+	else
+	{
+		XHEAP_FREE_BLOCK* found = XHEAP_Find(_heap, size);
+		if(!found)
+		{
+			XHEAP_Consolidate(_heap);
+			found = XHEAP_Find(_heap, size);
+		}
+		if(!found && XHEAP_Grow(_heap, size))
+			found = XHEAP_Find(_heap, size);
+		if(found)
+			block = XHEAP_Take(_heap, found, size);
+	}
+
+	if(block)
+		_heap->statistics.allocations++;
+	else
+		_heap->statistics.failures++;
+
+	return block ? (void*)(block + 1) : 0;
+}
+
+/**
+* @brief Frees heap memory. Small blocks wait in the quick list of their size, the rest are merged with
+* the free blocks around. Addresses out of the heap and blocks already freed are ignored.
+* @param _heap [in out] The heap.
+* @param _address [in] Address given by XHEAP_Alloc.
+*/
+inline void XHEAP_Free(XHEAP* _heap, void* _address)
+{
+	byte* address = (byte*)_address;
+	if(address <= _heap->start || address >= _heap->start + _heap->pages*XHEAP_PAGE_SIZE)
+		return;
+
+	XHEAP_BLOCK* block = (XHEAP_BLOCK*)address - 1;
+	if((block->size & (XHEAP_USED | XHEAP_QUICK)) != XHEAP_USED)
+		return;
+
+	dword size = XHEAP_SIZE(block);
+	_heap->statistics.used -= size;
+	_heap->statistics.frees++;
+
+	if(size <= XHEAP_QUICK_MAX)
+	{
+		dword quick = size/XHEAP_GRANULARITY - 2;
+		XHEAP_FREE_BLOCK* cached = (XHEAP_FREE_BLOCK*)block;
+		cached->next = _heap->quick[quick];
+		_heap->quick[quick] = cached;
+		block->size |= XHEAP_QUICK;
+		_heap->statistics.cached += size;
+	}
+	else
+	{
+		XHEAP_Release(_heap, block);
+	}
+}
+
+#endif //__XHEAP_H__
@@ -0,0 +1,177 @@
+/******************************************************************************/
+/**
+* @file		XLZ.h
+* @brief	XkyOS image compression
+* LZ77 byte oriented codec used for compressed X image sections. A stream is a list of sequences:
+* a token (high nibble literals, low nibble match length - 4, 15 means more length bytes follow, each
+* added until one is not 255), the literals, and unless the stream ends there, a little endian 16 bit
+* backwards offset and the match length extension.
+* The kernel decoder (RTL_Decompress) follows exactly this format.
+*
+* @date		20/03/2008
+* @author	Pablo Bravo
+*/
+/******************************************************************************/
+#ifndef __XLZ_H__
+#define __XLZ_H__
+
+#include <string.h>
+#include "Types.h"
+
+#define XLZ_MIN_MATCH		4
+#define XLZ_MAX_OFFSET		0xFFFF
+#define XLZ_HASH_BITS		14
+#define XLZ_BOUND(_size)	((_size) + (_size)/255 + 16)	/*< Worst case compressed size*/
+
+/**
+* @brief Writes an extended length (15 already in the token).
+*/
+inline byte* XLZ_WriteLength(byte* _out, dword _length)
+{
+	for(_length -= 15; _length >= 255; _length -= 255)
+		*_out++ = 255;
+	*_out++ = (byte)_length;
+	return _out;
+}
+
+/**
+* @brief Writes a sequence: literals and, if _match_length is not zero, a match.
+*/
+inline byte* XLZ_WriteSequence(byte* _out, const byte* _literals, dword _literal_length, dword _offset, dword _match_length)
+{
+	byte* token = _out++;
+	dword match_code = _match_length?(_match_length - XLZ_MIN_MATCH):0;
+
+	*token = (byte)(((_literal_length < 15)?_literal_length:15)<<4);
+	if(_literal_length >= 15)
+		_out = XLZ_WriteLength(_out, _literal_length);
+	memcpy(_out, _literals, _literal_length);
+	_out += _literal_length;
+
+	if(_match_length)
+	{
+		*token |= (byte)((match_code < 15)?match_code:15);
+		*_out++ = (byte)_offset;
+		*_out++ = (byte)(_offset>>8);
+		if(match_code >= 15)
+			_out = XLZ_WriteLength(_out, match_code);
+	}
+	return _out;
+}
+
+/**
+* @brief Compresses a buffer.
+* @param _in [in] Data to compress.
+* @param _in_size [in] Size of the data.
+* @param _out [out] Buffer of at least XLZ_BOUND(_in_size) bytes.
+* @return Compressed size.
+*/
+inline dword XLZ_Compress(const byte* _in, dword _in_size, byte* _out)
+{
+	static dword table[1<<XLZ_HASH_BITS];
+	for(dword i = 0; i < (1<<XLZ_HASH_BITS); i++)
+		table[i] = 0xFFFFFFFF;
+
+	byte* out = _out;
+	dword anchor = 0;
+	dword position = 0;
+
+	while(position + XLZ_MIN_MATCH <= _in_size)
+	{
+		dword sequence;
+		memcpy(&sequence, _in + position, 4);
+		dword hash = (sequence * 2654435761U) >> (32 - XLZ_HASH_BITS);
+		dword candidate = table[hash];
+		table[hash] = position;
+
+		if(candidate != 0xFFFFFFFF && position - candidate <= XLZ_MAX_OFFSET && !memcmp(_in + candidate, _in + position, XLZ_MIN_MATCH))
+		{
+			dword length = XLZ_MIN_MATCH;
+			while(position + length < _in_size && _in[candidate + length] == _in[position + length])
+				length++;
+
+			out = XLZ_WriteSequence(out, _in + anchor, position - anchor, position - candidate, length);
+			position += length;
+			anchor = position;
+		}
+		else
+		{
+			position++;
+		}
+	}
+
+	//Last literals
+	out = XLZ_WriteSequence(out, _in + anchor, _in_size - anchor, 0, 0);
+	return (dword)(out - _out);
+}
+
+/**
+* @brief Reads an extended length.
+*/
+inline bool XLZ_ReadLength(const byte*& _in, const byte* _end, dword& _length)
+{
+	byte value;
+	do
+	{
+		if(_in >= _end)
+			return false;
+		value = *_in++;
+		_length += value;
+	}
+	while(value == 255);
+	return true;
+}
+
+/**
+* @brief Decompresses a buffer.
+* @param _in [in] Compressed data.
+* @param _in_size [in] Size of the compressed data.
+* @param _out [out] Where to leave the data.
+* @param _out_size [in] Size of the output buffer.
+* @return Decompressed size, zero if the stream is corrupt.
+*/
+inline dword XLZ_Decompress(const byte* _in, dword _in_size, byte* _out, dword _out_size)
+{
+	const byte* in = _in;
+	const byte* in_end = _in + _in_size;
+	byte* out = _out;
+	byte* out_end = _out + _out_size;
+
+	while(in < in_end)
+	{
+		byte token = *in++;
+
+		dword literals = token>>4;
+		if(literals == 15 && !XLZ_ReadLength(in, in_end, literals))
+			return 0;
+		if(literals > (dword)(in_end - in) || literals > (dword)(out_end - out))
+			return 0;
+		memcpy(out, in, literals);
+		in += literals;
+		out += literals;
+
+		if(in >= in_end)
+			break;
+
+		if(in_end - in < 2)
+			return 0;
+		dword offset = in[0] | (in[1]<<8);
+		in += 2;
+
+		dword length = token & 0x0F;
+		if(length == 15 && !XLZ_ReadLength(in, in_end, length))
+			return 0;
+		length += XLZ_MIN_MATCH;
+
+		if(!offset || offset > (dword)(out - _out) || length > (dword)(out_end - out))
+			return 0;
+
+		//Byte by byte, matches may overlap
+		const byte* match = out - offset;
+		while(length--)
+			*out++ = *match++;
+	}
+	return (dword)(out - _out);
+}
+
+#endif //__XLZ_H__
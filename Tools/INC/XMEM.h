@@ -0,0 +1,276 @@
+/******************************************************************************/
+/**
+* @file		XMEM.h
+* @brief	XkyOS memory primitives
+* Copy and fill of the kernel and user RTLs, built on the host too so XMEMTEST can check them.
+* Every implementation splits a block the same way: bytes until the destiny is dword aligned (the
+* head), the body, and the dwords and bytes left (the tail). The string implementation moves the body
+* with rep movsd/stosd. The SSE2 one moves it 32 bytes per iteration with non temporal stores from
+* general registers (movnti), prefetching the source, and ends with sfence. No FPU or XMM state is
+* touched, it is not saved per environment.
+* Blocks are moved front to back, so they may overlap only if the destiny is below the origin.
+*
+* @date		20/03/2008
+* @author	Pablo Bravo
+*/
+/******************************************************************************/
+#ifndef __XMEM_H__
+#define __XMEM_H__
+
+#include <stddef.h>
+#include <emmintrin.h>
+#include "Types.h"
+
+#define XMEM_SMALL			16		/*< Shorter blocks go byte by byte*/
+#define XMEM_NONTEMPORAL	65536	/*< Longer blocks skip the cache, which they would push out whole*/
+#define XMEM_PREFETCH		256		/*< Bytes ahead to prefetch when copying*/
+#define XMEM_RUN			32		/*< Bytes per iteration of the SSE2 body*/
+
+/**
+* @brief A dword read from any address, GCC must not assume it does not alias the bytes around.
+*/
+#if defined(__GNUC__)
+typedef int __attribute__((__may_alias__, __aligned__(1))) XMEM_DWORD;
+#else
+typedef int XMEM_DWORD;
+#endif
+
+typedef void (*fXMEM_Copy)	(byte* _destiny, const byte* _origin, dword _size);
+typedef void (*fXMEM_Fill)	(byte* _destiny, byte _value, dword _size);
+
+/**
+* @brief Moves bytes with rep movsb.
+*/
+inline void XMEM_MoveBytes(byte* _destiny, const byte* _origin, dword _count)
+{
+#if defined(_MSC_VER)
+	__asm
+	{
+		cld
+		mov esi, _origin
+		mov edi, _destiny
+		mov ecx, _count
+		rep movsb
+	}
+#else
+	size_t count = _count;
+	__asm__ __volatile__("rep movsb" : "+D"(_destiny), "+S"(_origin), "+c"(count) : : "memory");
+#endif
+}
+
+/**
+* @brief Moves dwords with rep movsd.
+*/
+inline void XMEM_MoveDwords(byte* _destiny, const byte* _origin, dword _count)
+{
+#if defined(_MSC_VER)
+	__asm
+	{
+		cld
+		mov esi, _origin
+		mov edi, _destiny
+		mov ecx, _count
+		rep movsd
+	}
+#else
+	size_t count = _count;
+	__asm__ __volatile__("rep movsl" : "+D"(_destiny), "+S"(_origin), "+c"(count) : : "memory");
+#endif
+}
+
+/**
+* @brief Stores a byte with rep stosb.
+*/
+inline void XMEM_StoreBytes(byte* _destiny, byte _value, dword _count)
+{
+#if defined(_MSC_VER)
+	__asm
+	{
+		cld
+		mov edi, _destiny
+		mov al, _value
+		mov ecx, _count
+		rep stosb
+	}
+#else
+	size_t count = _count;
+	__asm__ __volatile__("rep stosb" : "+D"(_destiny), "+c"(count) : "a"(_value) : "memory");
+#endif
+}
+
+/**
+* @brief Stores a dword with rep stosd.
+*/
+inline void XMEM_StoreDwords(byte* _destiny, dword _value, dword _count)
+{
+#if defined(_MSC_VER)
+	__asm
+	{
+		cld
+		mov edi, _destiny
+		mov eax, _value
+		mov ecx, _count
+		rep stosd
+	}
+#else
+	size_t count = _count;
+	__asm__ __volatile__("rep stosl" : "+D"(_destiny), "+c"(count) : "a"(_value) : "memory");
+#endif
+}
+
+/**
+* @brief Bytes before the destiny is dword aligned, no more than the block.
+*/
+inline dword XMEM_Head(const byte* _destiny, dword _size)
+{
+	dword head = (dword)(0 - (size_t)_destiny) & 3;
+	return (head < _size)?head:_size;
+}
+
+/**
+* @brief Copies bytes a dword at a time: the head, dwords, and the bytes left.
+* @param _destiny [out] Destiny address.
+* @param _origin [in] Source address.
+* @param _size [in] Bytes to copy.
+*/
+inline void XMEM_CopyString(byte* _destiny, const byte* _origin, dword _size)
+{
+	dword head = XMEM_Head(_destiny, _size);
+	XMEM_MoveBytes(_destiny, _origin, head);
+	_destiny += head;
+	_origin += head;
+	_size -= head;
+
+	XMEM_MoveDwords(_destiny, _origin, _size >> 2);
+	XMEM_MoveBytes(_destiny + (_size & ~3), _origin + (_size & ~3), _size & 3);
+}
+
+/**
+* @brief Fills bytes a dword at a time: the head, dwords, and the bytes left.
+* @param _destiny [out] Destiny address.
+* @param _value [in] The byte.
+* @param _size [in] Bytes to fill.
+*/
+inline void XMEM_FillString(byte* _destiny, byte _value, dword _size)
+{
+	dword head = XMEM_Head(_destiny, _size);
+	XMEM_StoreBytes(_destiny, _value, head);
+	_destiny += head;
+	_size -= head;
+
+	XMEM_StoreDwords(_destiny, _value*0x01010101U, _size >> 2);
+	XMEM_StoreBytes(_destiny + (_size & ~3), _value, _size & 3);
+}
+
+/**
+* @brief Copies bytes prefetching the source and with non temporal stores: the head, runs of 32 bytes,
+* and the dwords and bytes left.
+* @param _destiny [out] Destiny address.
+* @param _origin [in] Source address.
+* @param _size [in] Bytes to copy.
+*/
+inline void XMEM_CopySSE2(byte* _destiny, const byte* _origin, dword _size)
+{
+	dword head = XMEM_Head(_destiny, _size);
+	XMEM_MoveBytes(_destiny, _origin, head);
+	_destiny += head;
+	_origin += head;
+	_size -= head;
+
+	dword runs = _size/XMEM_RUN;
+	for(dword i = 0; i < runs; i++)
+	{
+		_mm_prefetch((const char*)_origin + XMEM_PREFETCH, _MM_HINT_NTA);
+		for(dword j = 0; j < XMEM_RUN; j += 4)
+			_mm_stream_si32((int*)(_destiny + j), *(const XMEM_DWORD*)(_origin + j));
+		_destiny += XMEM_RUN;
+		_origin += XMEM_RUN;
+	}
+	if(runs)
+		_mm_sfence();
+
+	dword tail = _size%XMEM_RUN;
+	XMEM_MoveDwords(_destiny, _origin, tail >> 2);
+	XMEM_MoveBytes(_destiny + (tail & ~3), _origin + (tail & ~3), tail & 3);
+}
+
+/**
+* @brief Fills bytes with non temporal stores: the head, runs of 32 bytes, and the dwords and bytes left.
+* @param _destiny [out] Destiny address.
+* @param _value [in] The byte.
+* @param _size [in] Bytes to fill.
+*/
+inline void XMEM_FillSSE2(byte* _destiny, byte _value, dword _size)
+{
+	dword head = XMEM_Head(_destiny, _size);
+	XMEM_StoreBytes(_destiny, _value, head);
+	_destiny += head;
+	_size -= head;
+
+	int value = (int)(_value*0x01010101U);
+	dword runs = _size/XMEM_RUN;
+	for(dword i = 0; i < runs; i++)
+	{
+		for(dword j = 0; j < XMEM_RUN; j += 4)
+			_mm_stream_si32((int*)(_destiny + j), value);
+		_destiny += XMEM_RUN;
+	}
+	if(runs)
+		_mm_sfence();
+
+	dword tail = _size%XMEM_RUN;
+	XMEM_StoreDwords(_destiny, _value*0x01010101U, tail >> 2);
+	XMEM_StoreBytes(_destiny + (tail & ~3), _value, tail & 3);
+}
+
+/**
+* @brief Copies a block: small ones byte by byte, up to XMEM_NONTEMPORAL with the string implementation,
+* longer ones with the given one.
+* @param _destiny [out] Destiny address.
+* @param _origin [in] Source address.
+* @param _size [in] Bytes to copy.
+* @param _large [in] Implementation for large blocks.
+*/
+inline void XMEM_Copy(byte* _destiny, const byte* _origin, dword _size, fXMEM_Copy _large)
+{
+	if(_size < XMEM_SMALL)
+	{
+		for(dword i = 0; i < _size; i++)
+			_destiny[i] = _origin[i];
+	}
+	else if(_size < XMEM_NONTEMPORAL)
+	{
+		XMEM_CopyString(_destiny, _origin, _size);
+	}
+	else
+	{
+		_large(_destiny, _origin, _size);
+	}
+}
+
+/**
+* @brief Fills a block: small ones byte by byte, up to XMEM_NONTEMPORAL with the string implementation,
+* longer ones with the given one.
+* @param _destiny [out] Destiny address.
+* @param _value [in] The byte.
+* @param _size [in] Bytes to fill.
+* @param _large [in] Implementation for large blocks.
+*/
+inline void XMEM_Fill(byte* _destiny, byte _value, dword _size, fXMEM_Fill _large)
+{
+	if(_size < XMEM_SMALL)
+	{
+		for(dword i = 0; i < _size; i++)
+			_destiny[i] = _value;
+	}
+	else if(_size < XMEM_NONTEMPORAL)
+	{
+		XMEM_FillString(_destiny, _value, _size);
+	}
+	else
+	{
+		_large(_destiny, _value, _size);
+	}
+}
+
+#endif //__XMEM_H__
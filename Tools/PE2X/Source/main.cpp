@@ -1,26 +1,38 @@
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
 #include <string>
+#include <vector>
+#include <algorithm>
 
 #include "PE.h"
 #include "X.h"
+#include "XLZ.h"
 
-void Convert(std::string pe_file_name, std::string xky_file_name);
+void Convert(std::string pe_file_name, std::string xky_file_name, std::string map_file_name, bool compress);
 
 int main(int argc, char* argv[])
 {
 	try
 	{
 		//Testear entrada
-		if(argc!=3)
+		bool compress = (argc>1) && !strcmp(argv[1], "-z");
+		if(compress)
 		{
-			std::cout<<"PE2X <fichero.pe> <fichero.x>"<<std::endl;
+			argc--;
+			argv++;
+		}
+		if(argc!=3 && argc!=4)
+		{
+			std::cout<<"PE2X [-z] <fichero.pe> <fichero.x> [<prelink.map>]"<<std::endl;
 			return 0;
 		}
 
 		//Ejecutar el "linker"
-		Convert(argv[1], argv[2]);
+		Convert(argv[1], argv[2], (argc==4)?argv[3]:"", compress);
 	}
 	catch(std::string error)
 	{
@@ -36,6 +48,8 @@ int main(int argc, char* argv[])
 
 #include "SectionNames.h"
 
+#define XKY_PAGE_SIZE	4096
+
 dword AlignTo(dword value, dword alignment)
 {
 	if(value%alignment) value += (alignment - (value%alignment));
@@ -85,7 +99,19 @@ dword CalculateXkyFileSize(PEFile* pe_file, dword desired_section_alignment, dwo
 	dword relocations[];
 	}
 	*/
-	relocs_size++;
+	relocs_size += sizeof(dword);
+
+	/*
+	struct IMG_RELOCATION_PAGES
+	{
+	dword number_of_pages;
+	dword first_relocation[];
+	}
+	*/
+	relocs_size += sizeof(dword) + (AlignTo(size, XKY_PAGE_SIZE)/XKY_PAGE_SIZE)*sizeof(dword);
+
+	//Registro de prelink
+	relocs_size += sizeof(IMG_PRELINK);
 	relocs_size=AlignTo(relocs_size, desired_section_alignment);
 
 	//Devolvemos
@@ -143,6 +169,7 @@ void DumpRelocs(XFile* xky_file, PEFile* pe_file, dword alignment)
 		xky_file->SequentialWrite(&null_dword, 4);
 
 		DWORD pe_total_relocs = 0;
+		std::vector<dword> xky_relocations;
 
 		BYTE* pe_raw_file=pe_file->Raw();
 		byte* xky_raw_file = xky_file->Raw();
@@ -175,12 +202,12 @@ void DumpRelocs(XFile* xky_file, PEFile* pe_file, dword alignment)
 					{
 						//Puede ser en la cabecera (no verifico, asumo salida del compilador correcta y ficheros de entrada al compilador correctos)
 						xky_relocation = section_offset;
-						xky_file->SequentialWrite(&xky_relocation, 4);
+						xky_relocations.push_back(xky_relocation);
 					}
 					else
 					{
 						xky_relocation = xky_section->offset + section_offset;
-						xky_file->SequentialWrite(&xky_relocation, 4);
+						xky_relocations.push_back(xky_relocation);
 					}
 
 					//Ahora reajustar el valor apuntado por la reubicacion en el fichero de xky
@@ -211,16 +238,197 @@ void DumpRelocs(XFile* xky_file, PEFile* pe_file, dword alignment)
 			pe_reloc_block = (IMAGE_BASE_RELOCATION*)(((BYTE*)pe_reloc_block) + pe_reloc_block->SizeOfBlock);
 		}
 
-		//Guardamos el numero total de reubicaciones
+		//Escribimos las reubicaciones ordenadas por offset para poder indexarlas por pagina
+		std::sort(xky_relocations.begin(), xky_relocations.end());
+		for(dword i=0; i<xky_relocations.size(); i++)
+			xky_file->SequentialWrite(&xky_relocations[i], 4);
+
+		//Indice por pagina: primera reubicacion que toca cada pagina del fichero (una reubicacion
+		//puede cruzar el limite de pagina y entonces aparece en las dos)
+		dword number_of_pages = AlignTo(xky_relocs_section_header->offset, XKY_PAGE_SIZE)/XKY_PAGE_SIZE;
+		xky_file->SequentialWrite(&number_of_pages, 4);
+		dword index = 0;
+		for(dword page=0; page<number_of_pages; page++)
+		{
+			while(index<xky_relocations.size() && xky_relocations[index] + sizeof(dword) <= page*XKY_PAGE_SIZE)
+				index++;
+			xky_file->SequentialWrite(&index, 4);
+		}
+		xky_relocs_section_header->flags |= IMAGE_SECTION_PAGED;
+
+		//Registro de prelink vacio (se rellena en Prelink)
+		IMG_PRELINK prelink = {0, 0, 0, 0};
+		xky_file->SequentialWrite(&prelink, sizeof(IMG_PRELINK));
+		xky_relocs_section_header->flags |= IMAGE_SECTION_PRELINK;
+
+		//Guardamos el numero total de reubicaciones (el resto ya esta a cero)
 		IMG_RELOCATION* xky_reloc_section = (IMG_RELOCATION*)xky_file->GetSectionByName(RELOC_SECTION_NAME);
 		xky_reloc_section->number_of_relocations = pe_total_relocs;
-		//Rellenamos a cero las que sobran
-		for(dword i=pe_total_relocs; i<(xky_relocs_section_header->size/4 - 1); i++)
-			xky_reloc_section->relocations[i] = 0;
 	}
 }
 
-void Convert(std::string pe_file_name, std::string xky_file_name)
+IMG_PRELINK* GetPrelink(byte* raw_file)
+{
+	IMG_MODULE_HEADER* header = (IMG_MODULE_HEADER*)raw_file;
+	if(!(header->relocs_section.flags & IMAGE_SECTION_PRELINK) || !(header->relocs_section.flags & IMAGE_SECTION_PAGED))
+		return 0;
+
+	IMG_RELOCATION* relocs = (IMG_RELOCATION*)(raw_file + header->relocs_section.offset);
+	IMG_RELOCATION_PAGES* pages = (IMG_RELOCATION_PAGES*)&relocs->relocations[relocs->number_of_relocations];
+	return (IMG_PRELINK*)&pages->first_relocation[pages->number_of_pages];
+}
+
+dword ExportsChecksum(byte* raw_file)
+{
+	//FNV-1a de la seccion de exportaciones (nombres y offsets sin reubicar)
+	IMG_MODULE_HEADER* header = (IMG_MODULE_HEADER*)raw_file;
+	dword checksum = 2166136261;
+	for(dword i=0; i<header->exports_section.size; i++)
+	{
+		checksum ^= raw_file[header->exports_section.offset + i];
+		checksum *= 16777619;
+	}
+	//Nunca cero, cero significa "sin enlazar"
+	return checksum?checksum:1;
+}
+
+std::string FileName(std::string path)
+{
+	std::string::size_type slash = path.find_last_of("\\/");
+	return (slash==std::string::npos)?path:path.substr(slash+1);
+}
+
+std::string Directory(std::string path)
+{
+	std::string::size_type slash = path.find_last_of("\\/");
+	return (slash==std::string::npos)?"":path.substr(0, slash+1);
+}
+
+bool SameName(std::string a, std::string b)
+{
+	return a.size()==b.size() && !_strnicmp(a.c_str(), b.c_str(), a.size());
+}
+
+/*
+Mapa de prelink, una linea por modulo:
+	; comentario
+	<modulo.x> <base> [<modulo_exportador.x>]
+La ruta del exportador es relativa al directorio del mapa. El exportador tiene que estar ya prelinkado.
+*/
+bool FindInPrelinkMap(std::string map_file_name, std::string module_name, dword& base, std::string& export_file_name)
+{
+	std::ifstream map(map_file_name.c_str());
+	if(!map)
+		throw std::string("Cant open prelink map: ") + map_file_name;
+
+	std::string line;
+	while(std::getline(map, line))
+	{
+		std::istringstream fields(line);
+		std::string name, base_text, exporter;
+		if(!(fields>>name) || name[0]==';')
+			continue;
+		if(!SameName(name, module_name))
+			continue;
+		if(!(fields>>base_text))
+			throw std::string("Prelink map: no base for ") + name;
+
+		base = strtoul(base_text.c_str(), 0, 0);
+		export_file_name = (fields>>exporter)?(Directory(map_file_name) + exporter):"";
+		return true;
+	}
+	return false;
+}
+
+void Prelink(XFile* xky_file, std::string map_file_name, std::string xky_file_name)
+{
+	byte* raw_file = xky_file->Raw();
+	IMG_PRELINK* prelink = GetPrelink(raw_file);
+	if(!prelink)
+		return;
+
+	prelink->checksum = ExportsChecksum(raw_file);
+
+	dword base = 0;
+	std::string export_file_name;
+	if(map_file_name.empty() || !FindInPrelinkMap(map_file_name, FileName(xky_file_name), base, export_file_name))
+		return;
+
+	//Enlazar importaciones contra el exportador (sus exportaciones ya estan en direcciones finales)
+	if(!export_file_name.empty())
+	{
+		std::ifstream export_file(export_file_name.c_str(), std::ios::binary);
+		if(!export_file)
+			throw std::string("Cant open prelink export module: ") + export_file_name;
+		std::vector<char> export_raw((std::istreambuf_iterator<char>(export_file)), std::istreambuf_iterator<char>());
+
+		IMG_MODULE_HEADER* export_header = (IMG_MODULE_HEADER*)&export_raw[0];
+		IMG_PRELINK* export_prelink = GetPrelink((byte*)&export_raw[0]);
+		if(export_header->signature != IMAGE_SIGNATURE || !export_prelink || !export_prelink->base)
+			throw std::string("Export module is not prelinked: ") + export_file_name;
+
+		IMG_IMPORT* imports = (IMG_IMPORT*)(raw_file + xky_file->Header()->imports_section.offset);
+		dword imports_number = xky_file->Header()->imports_section.size/sizeof(IMG_IMPORT);
+		IMG_EXPORT* exports = (IMG_EXPORT*)(&export_raw[0] + export_header->exports_section.offset);
+		dword exports_number = export_header->exports_section.size/sizeof(IMG_EXPORT);
+
+		for(dword i=0; i<imports_number; i++)
+		{
+			if(!imports[i].name_size)
+				continue;
+
+			dword j;
+			for(j=0; j<exports_number; j++)
+			{
+				if(imports[i].name_size == exports[j].name_size && !memcmp(imports[i].name_text, exports[j].name_text, imports[i].name_size))
+					break;
+			}
+			if(j==exports_number)
+				throw std::string("Prelink: unresolved import ") + std::string((char*)imports[i].name_text, imports[i].name_size);
+
+			imports[i].function = exports[j].function;
+		}
+
+		prelink->imports_base = export_prelink->base;
+		prelink->imports_checksum = export_prelink->checksum;
+	}
+
+	//Aplicar las reubicaciones para la base fija
+	IMG_RELOCATION* relocs = (IMG_RELOCATION*)xky_file->GetSectionByName(RELOC_SECTION_NAME);
+	for(dword i=0; i<relocs->number_of_relocations; i++)
+		*(dword*)(raw_file + relocs->relocations[i]) += base;
+
+	prelink->base = base;
+}
+
+bool FlushCompressed(XFile* xky_file, std::string xky_file_name)
+{
+	//La cabecera queda tal cual, todas las secciones van en un unico stream XLZ que empieza donde la primera
+	IMG_MODULE_HEADER* header = xky_file->Header();
+	IMG_SECTION_HEADER* sections[] = {&header->imports_section, &header->data_section, &header->code_section, &header->exports_section, &header->relocs_section};
+	for(dword i=0; i<sizeof(sections)/sizeof(sections[0]); i++)
+	{
+		if(sections[i]->size)
+			sections[i]->flags |= IMAGE_SECTION_COMPRESSED;
+	}
+
+	dword start = XKY_HEADER_ALIGNMENT;
+	std::vector<byte> compressed(sizeof(dword) + XLZ_BOUND(xky_file->Size() - start));
+	dword compressed_size = XLZ_Compress(xky_file->Raw() + start, xky_file->Size() - start, &compressed[sizeof(dword)]);
+	memcpy(&compressed[0], &compressed_size, sizeof(dword));
+
+	FILE* out=fopen(xky_file_name.c_str(), "wb");
+	if(!out)
+		return false;
+	fwrite(xky_file->Raw(), 1, start, out);
+	fwrite(&compressed[0], 1, sizeof(dword) + compressed_size, out);
+	fclose(out);
+
+	std::cout<<xky_file_name.c_str()<<": "<<xky_file->Size()<<" -> "<<(start + sizeof(dword) + compressed_size)<<" bytes"<<std::endl;
+	return true;
+}
+
+void Convert(std::string pe_file_name, std::string xky_file_name, std::string map_file_name, bool compress)
 {
 	//Creamos el fichero PE
 	PEFile pe_file(pe_file_name);
@@ -250,7 +458,10 @@ void Convert(std::string pe_file_name, std::string xky_file_name)
 //	xky_module_header->relocs_section.size = xky_file_size - xky_file_write_pointer;
 	DumpRelocs(&xky_file, &pe_file, XKY_SECTION_ALIGNMENT);
 
+	//Prelink opcional: base fija e importaciones resueltas
+	Prelink(&xky_file, map_file_name, xky_file_name);
+
 	//Volcamos a disco
-	if(!xky_file.FlushToDisk(xky_file_name))
+	if(!(compress?FlushCompressed(&xky_file, xky_file_name):xky_file.FlushToDisk(xky_file_name)))
 		throw std::string("Cant open dump disk file: ") + xky_file_name;
 }
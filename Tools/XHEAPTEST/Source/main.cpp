@@ -0,0 +1,293 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "Types.h"
+#include "XHEAP.h"
+
+//Paginas del monton, como HEAP_MAX_PAGES del RTL (64MB)
+#define MAX_PAGES		16384
+//Paginas del monton pequeno que se agota a proposito
+#define SMALL_PAGES		64
+//Operaciones al azar de la prueba de carga
+#define OPERATIONS		2000000
+//Bloques vivos a la vez como mucho
+#define LIVE			4096
+//Cada cuantas operaciones se recorre el monton entero
+#define WALK_EVERY		20000
+
+dword failures = 0;
+
+//Zona reservada sin acceso; el monton la va mapeando al crecer, como XKY_PAGE_Alloc
+byte* reserved = 0;
+dword reserved_pages = 0;
+
+bool Map(byte* _address, dword _pages)
+{
+	if(_address < reserved || _address + _pages*XHEAP_PAGE_SIZE > reserved + reserved_pages*XHEAP_PAGE_SIZE)
+		return false;
+#if defined(_WIN32)
+	return VirtualAlloc(_address, _pages*XHEAP_PAGE_SIZE, MEM_COMMIT, PAGE_READWRITE) == _address;
+#else
+	return !mprotect(_address, _pages*XHEAP_PAGE_SIZE, PROT_READ | PROT_WRITE);
+#endif
+}
+
+byte* Reserve(dword _pages)
+{
+	reserved_pages = _pages;
+#if defined(_WIN32)
+	reserved = (byte*)VirtualAlloc(0, _pages*XHEAP_PAGE_SIZE, MEM_RESERVE, PAGE_NOACCESS);
+#else
+	void* address = mmap(0, (size_t)_pages*XHEAP_PAGE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	reserved = (address == MAP_FAILED)?0:(byte*)address;
+#endif
+	return reserved;
+}
+
+void Release()
+{
+#if defined(_WIN32)
+	VirtualFree(reserved, 0, MEM_RELEASE);
+#else
+	munmap(reserved, (size_t)reserved_pages*XHEAP_PAGE_SIZE);
+#endif
+	reserved = 0;
+}
+
+void Fail(const char* _what, dword _operation)
+{
+	if(failures < 20)
+		printf("FALLO %s (operacion %u)\n", _what, _operation);
+	failures++;
+}
+
+//Recorre los bloques hasta la valla y comprueba tamanos, enlaces, listas y contadores
+void Walk(XHEAP* _heap, dword _operation)
+{
+	byte* end = _heap->start + _heap->pages*XHEAP_PAGE_SIZE;
+	dword used = 0, cached = 0, free = 0, free_blocks = 0, previous = 0;
+	bool previous_free = false;
+
+	XHEAP_BLOCK* block = (XHEAP_BLOCK*)_heap->start;
+	while(XHEAP_SIZE(block))
+	{
+		dword size = XHEAP_SIZE(block);
+		if(block->previous != previous || size < XHEAP_MIN_BLOCK || (byte*)XHEAP_NEXT(block) > end - sizeof(XHEAP_BLOCK))
+		{
+			Fail("cadena de bloques", _operation);
+			return;
+		}
+		if(block->size & XHEAP_QUICK)
+			cached += size;
+		else if(block->size & XHEAP_USED)
+			used += size;
+		else
+		{
+			if(previous_free)
+				Fail("dos bloques libres seguidos", _operation);
+			free += size;
+			free_blocks++;
+		}
+		previous_free = !(block->size & XHEAP_USED);
+		previous = size;
+		block = XHEAP_NEXT(block);
+	}
+	if((byte*)block != end - sizeof(XHEAP_BLOCK) || block->size != XHEAP_USED || block->previous != previous)
+		Fail("valla", _operation);
+
+	dword listed = 0;
+	for(dword bin = 0; bin < XHEAP_BINS; bin++)
+	{
+		XHEAP_FREE_BLOCK* back = 0;
+		for(XHEAP_FREE_BLOCK* free_block = _heap->bins[bin]; free_block; free_block = free_block->next)
+		{
+			if(free_block->back != back || XHEAP_Bin(free_block->header.size) != bin || (free_block->header.size & XHEAP_USED))
+				Fail("lista de libres", _operation);
+			back = free_block;
+			listed++;
+		}
+	}
+	dword quick = 0;
+	for(dword i = 0; i < XHEAP_QUICK_LISTS; i++)
+	{
+		for(XHEAP_FREE_BLOCK* cached_block = _heap->quick[i]; cached_block; cached_block = cached_block->next)
+		{
+			if(cached_block->header.size != ((i + 2)*XHEAP_GRANULARITY | XHEAP_USED | XHEAP_QUICK))
+				Fail("lista rapida", _operation);
+			quick += XHEAP_SIZE(&cached_block->header);
+		}
+	}
+
+	if(listed != free_blocks || quick != cached)
+		Fail("bloques fuera de las listas", _operation);
+	if(used != _heap->statistics.used || cached != _heap->statistics.cached || free != _heap->statistics.free || _heap->pages != _heap->statistics.pages)
+		Fail("estadisticas", _operation);
+}
+
+struct LIVE_BLOCK
+{
+	byte*	address;
+	dword	size;
+	byte	value;
+};
+
+bool Intact(LIVE_BLOCK& _block)
+{
+	for(dword i = 0; i < _block.size; i++)
+	{
+		if(_block.address[i] != (byte)(_block.value + i))
+			return false;
+	}
+	return true;
+}
+
+//Tamanos como los de un programa: muchos pequenos, algunos medianos y pocos grandes
+dword RandomSize()
+{
+	dword kind = rand()%100;
+	if(kind < 70)
+		return 1 + rand()%XHEAP_QUICK_MAX;
+	if(kind < 95)
+		return 1 + rand()%8192;
+	return 1 + (rand()*(RAND_MAX + 1u) + rand())%(256*1024);
+}
+
+void Stress()
+{
+	XHEAP heap;
+	if(!Reserve(MAX_PAGES) || !XHEAP_Init(&heap, reserved, MAX_PAGES, Map))
+	{
+		Fail("no se puede crear el monton", 0);
+		return;
+	}
+
+	std::vector<LIVE_BLOCK> live;
+	dword allocations = 0, frees = 0, exhausted = 0;
+	for(dword operation = 0; operation < OPERATIONS; operation++)
+	{
+		if(live.size() < LIVE && (live.empty() || rand()%100 < 55))
+		{
+			LIVE_BLOCK block;
+			block.size = RandomSize();
+			block.value = (byte)rand();
+			block.address = (byte*)XHEAP_Alloc(&heap, block.size);
+			if(!block.address)
+			{
+				//Solo puede fallar si ningun bloque libre basta y el monton no puede crecer lo necesario
+				dword size = (block.size + sizeof(XHEAP_BLOCK) + XHEAP_GRANULARITY - 1) & ~(XHEAP_GRANULARITY - 1);
+				if(XHEAP_Find(&heap, size) || heap.statistics.cached || heap.pages + (size + XHEAP_PAGE_SIZE - 1)/XHEAP_PAGE_SIZE <= MAX_PAGES)
+					Fail("sin memoria", operation);
+				exhausted++;
+				continue;
+			}
+			if((size_t)block.address%XHEAP_GRANULARITY || block.address < heap.start || block.address + block.size > heap.start + heap.pages*XHEAP_PAGE_SIZE)
+				Fail("direccion", operation);
+			for(dword i = 0; i < block.size; i++)
+				block.address[i] = (byte)(block.value + i);
+			live.push_back(block);
+			allocations++;
+		}
+		else
+		{
+			size_t chosen = rand()%live.size();
+			if(!Intact(live[chosen]))
+				Fail("bloque pisado", operation);
+			XHEAP_Free(&heap, live[chosen].address);
+			frees++;
+
+			//Liberarlo otra vez no hace nada
+			if(rand()%16 == 0)
+				XHEAP_Free(&heap, live[chosen].address);
+
+			live[chosen] = live.back();
+			live.pop_back();
+		}
+
+		if(operation%WALK_EVERY == 0)
+			Walk(&heap, operation);
+	}
+
+	for(size_t i = 0; i < live.size(); i++)
+	{
+		if(!Intact(live[i]))
+			Fail("bloque pisado", OPERATIONS);
+		XHEAP_Free(&heap, live[i].address);
+		frees++;
+	}
+	XHEAP_Consolidate(&heap);
+	Walk(&heap, OPERATIONS);
+
+	//Todo libre y fusionado: un unico bloque hasta la valla
+	dword whole = heap.pages*XHEAP_PAGE_SIZE - sizeof(XHEAP_BLOCK);
+	if(heap.statistics.used || heap.statistics.cached || heap.statistics.free != whole)
+		Fail("memoria perdida", OPERATIONS);
+	if(heap.statistics.allocations != allocations || heap.statistics.frees != frees || heap.statistics.failures != exhausted)
+		Fail("contadores", OPERATIONS);
+
+	printf("Carga: %u reservas (%u de listas rapidas), %u sin memoria, %u liberaciones, %u paginas\n", heap.statistics.allocations, heap.statistics.quick, heap.statistics.failures, heap.statistics.frees, heap.pages);
+	Release();
+}
+
+//Un monton pequeno se agota, falla sin romperse y se recupera al liberarlo todo
+void Exhaust()
+{
+	XHEAP heap;
+	if(!Reserve(SMALL_PAGES) || !XHEAP_Init(&heap, reserved, SMALL_PAGES, Map))
+	{
+		Fail("no se puede crear el monton", 0);
+		return;
+	}
+
+	std::vector<void*> blocks;
+	for(dword size = 24; ; size = (size*5)%3000 + 1)
+	{
+		void* block = XHEAP_Alloc(&heap, size);
+		if(!block)
+			break;
+		blocks.push_back(block);
+	}
+	Walk(&heap, 0);
+	if(heap.pages != SMALL_PAGES || heap.statistics.failures != 1)
+		Fail("agotar el monton", 0);
+
+	//Fuera del monton y a medio bloque se ignoran
+	XHEAP_Free(&heap, heap.start + heap.pages*XHEAP_PAGE_SIZE);
+	XHEAP_Free(&heap, heap.start);
+	Walk(&heap, 0);
+
+	for(size_t i = 0; i < blocks.size(); i += 2)
+		XHEAP_Free(&heap, blocks[i]);
+	for(size_t i = 1; i < blocks.size(); i += 2)
+		XHEAP_Free(&heap, blocks[i]);
+
+	//Lo mas grande que cabe sale tras fusionar las listas rapidas
+	dword whole = SMALL_PAGES*XHEAP_PAGE_SIZE - 2*sizeof(XHEAP_BLOCK);
+	void* block = XHEAP_Alloc(&heap, whole);
+	if(!block || XHEAP_Alloc(&heap, 1))
+		Fail("recuperar el monton", 1);
+	Walk(&heap, 1);
+	XHEAP_Free(&heap, block);
+	Walk(&heap, 2);
+
+	printf("Agotado: %u bloques en %u paginas\n", (dword)blocks.size(), heap.pages);
+	Release();
+}
+
+int main(int argc, char* argv[])
+{
+	srand(argc > 1 ? atoi(argv[1]) : 1);
+
+	Exhaust();
+	Stress();
+
+	printf("%u fallos\n", failures);
+	return failures?1:0;
+}
@@ -0,0 +1,3 @@
+@echo off
+rem Prueba de carga del monton del RTL: reservas y liberaciones al azar comprobando bloques y listas
+Bin\Release\XHEAPTEST.exe %1
@@ -0,0 +1,4 @@
+#!/bin/sh
+# Prueba de carga del monton del RTL, compilada en Linux con GCC; crece con mmap
+mkdir -p Bin
+g++ -O2 -Wall -I../INC Source/main.cpp -o Bin/xheaptest && Bin/xheaptest "$@"
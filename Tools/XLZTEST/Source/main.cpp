@@ -0,0 +1,80 @@
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include <string>
+
+#include "Types.h"
+#include "Image.h"
+#include "XLZ.h"
+
+//Veces que se descomprime cada modulo para medir
+#define DECODE_ROUNDS	50
+
+//Como PE2X -z: la cabecera (alineada a esto) va sin comprimir
+#define XKY_HEADER_ALIGNMENT	256
+
+bool ReadFile(const char* file_name, std::vector<byte>& data)
+{
+	FILE* in = fopen(file_name, "rb");
+	if(!in)
+		return false;
+	fseek(in, 0, SEEK_END);
+	data.resize(ftell(in));
+	fseek(in, 0, SEEK_SET);
+	bool ok = data.empty() || fread(&data[0], 1, data.size(), in) == data.size();
+	fclose(in);
+	return ok;
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		printf("XLZTEST <fichero.x> [<fichero.x> ...]\n");
+		return 0;
+	}
+
+	dword failures = 0;
+	double total_plain = 0, total_compressed = 0, total_seconds = 0;
+
+	for(int i = 1; i < argc; i++)
+	{
+		std::vector<byte> file;
+		if(!ReadFile(argv[i], file) || file.size() < sizeof(IMG_MODULE_HEADER))
+		{
+			printf("%-40s no se puede leer\n", argv[i]);
+			failures++;
+			continue;
+		}
+
+		//Como PE2X -z: la cabecera va sin comprimir
+		IMG_MODULE_HEADER* header = (IMG_MODULE_HEADER*)&file[0];
+		dword start = (header->signature == IMAGE_SIGNATURE && file.size() > XKY_HEADER_ALIGNMENT)?XKY_HEADER_ALIGNMENT:0;
+		dword plain_size = (dword)file.size() - start;
+
+		std::vector<byte> compressed(XLZ_BOUND(plain_size));
+		std::vector<byte> expanded(plain_size + 1);
+		dword compressed_size = XLZ_Compress(&file[start], plain_size, &compressed[0]);
+
+		clock_t begin = clock();
+		dword expanded_size = 0;
+		for(dword round = 0; round < DECODE_ROUNDS; round++)
+			expanded_size = XLZ_Decompress(&compressed[0], compressed_size, &expanded[0], plain_size);
+		double seconds = (double)(clock() - begin)/CLOCKS_PER_SEC;
+
+		bool ok = expanded_size == plain_size && (!plain_size || !memcmp(&file[start], &expanded[0], plain_size));
+		if(!ok)
+			failures++;
+
+		double mbs = (seconds > 0)?(((double)plain_size*DECODE_ROUNDS)/(1024*1024))/seconds:0;
+		printf("%-40s %8u -> %8u (%5.1f%%) %8.1f MB/s %s\n", argv[i], plain_size, compressed_size, plain_size?(100.0*compressed_size/plain_size):0, mbs, ok?"OK":"FALLO");
+
+		total_plain += plain_size;
+		total_compressed += compressed_size;
+		total_seconds += seconds;
+	}
+
+	printf("TOTAL %.0f -> %.0f bytes (%.1f%%), %.1f MB/s, %u fallos\n", total_plain, total_compressed, total_plain?(100.0*total_compressed/total_plain):0, total_seconds?((total_plain*DECODE_ROUNDS)/(1024*1024))/total_seconds:0, failures);
+	return failures?1:0;
+}
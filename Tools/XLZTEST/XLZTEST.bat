@@ -0,0 +1,7 @@
+@echo off
+rem Round-trip XLZ de todos los modulos .x construidos en el arbol
+setlocal enabledelayedexpansion
+set MODULES=
+for /r ..\..\XkyOS\Source %%f in (*.x) do set MODULES=!MODULES! "%%f"
+Bin\Release\XLZTEST.exe %MODULES%
+endlocal
@@ -0,0 +1,127 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "Types.h"
+#include "XMEM.h"
+
+//Bytes de guarda a cada lado del bloque, que no se deben tocar
+#define GUARD			64
+//Alineaciones del origen y del destino que se prueban
+#define ALIGNMENTS		32
+//Todos los tamanos hasta aqui: cabeza, bucle de 32 bytes y cola
+#define SIZES			320
+#define GUARD_BYTE		0xE5
+
+dword failures = 0;
+
+void Pattern(std::vector<byte>& data, dword seed)
+{
+	for(size_t i = 0; i < data.size(); i++)
+		data[i] = (byte)((i*31 + seed*7) ^ (i >> 8));
+}
+
+void Report(const char* what, dword size, dword destiny, dword origin)
+{
+	if(failures < 20)
+		printf("FALLO %-12s tamano %6u destino +%2u origen +%2u\n", what, size, destiny, origin);
+	failures++;
+}
+
+void CheckCopy(const char* what, fXMEM_Copy _copy, fXMEM_Copy _large, dword _size, dword _destiny, dword _origin)
+{
+	std::vector<byte> origin(_size + ALIGNMENTS + 2*GUARD);
+	std::vector<byte> got(_size + ALIGNMENTS + 2*GUARD, GUARD_BYTE);
+	Pattern(origin, _size);
+	std::vector<byte> expected(got);
+	memcpy(&expected[GUARD + _destiny], &origin[GUARD + _origin], _size);
+
+	if(_copy)
+		_copy(&got[GUARD + _destiny], &origin[GUARD + _origin], _size);
+	else
+		XMEM_Copy(&got[GUARD + _destiny], &origin[GUARD + _origin], _size, _large);
+	if(got != expected)
+		Report(what, _size, _destiny, _origin);
+}
+
+void CheckFill(const char* what, fXMEM_Fill _fill, fXMEM_Fill _large, dword _size, dword _destiny)
+{
+	byte value = (byte)(0x80 + _size);
+	std::vector<byte> got(_size + ALIGNMENTS + 2*GUARD, GUARD_BYTE);
+	std::vector<byte> expected(got);
+	memset(&expected[GUARD + _destiny], value, _size);
+
+	if(_fill)
+		_fill(&got[GUARD + _destiny], value, _size);
+	else
+		XMEM_Fill(&got[GUARD + _destiny], value, _size, _large);
+	if(got != expected)
+		Report(what, _size, _destiny, 0);
+}
+
+//Solapados con el destino por debajo del origen, como los usa el RTL al desplazar
+void CheckOverlap(const char* what, fXMEM_Copy _large, dword _size, dword _distance)
+{
+	std::vector<byte> got(_size + _distance + 2*GUARD);
+	Pattern(got, _size);
+	std::vector<byte> expected(got);
+	memmove(&expected[GUARD], &expected[GUARD + _distance], _size);
+
+	XMEM_Copy(&got[GUARD], &got[GUARD + _distance], _size, _large);
+	if(got != expected)
+		Report(what, _size, 0, _distance);
+}
+
+void CheckAll(dword _size, bool _alignments)
+{
+	dword alignments = _alignments?ALIGNMENTS:1;
+	for(dword destiny = 0; destiny < alignments; destiny++)
+	{
+		for(dword origin = 0; origin < alignments; origin++)
+		{
+			CheckCopy("CopyString", XMEM_CopyString, 0, _size, destiny, origin);
+			CheckCopy("CopySSE2", XMEM_CopySSE2, 0, _size, destiny, origin);
+			CheckCopy("Copy", 0, XMEM_CopyString, _size, destiny, origin);
+			CheckCopy("Copy+SSE2", 0, XMEM_CopySSE2, _size, destiny, origin);
+		}
+		CheckFill("FillString", XMEM_FillString, 0, _size, destiny);
+		CheckFill("FillSSE2", XMEM_FillSSE2, 0, _size, destiny);
+		CheckFill("Fill", 0, XMEM_FillString, _size, destiny);
+		CheckFill("Fill+SSE2", 0, XMEM_FillSSE2, _size, destiny);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	dword checked = 0;
+
+	//Cada tamano pequeno en cada alineacion
+	for(dword size = 0; size <= SIZES; size++, checked++)
+		CheckAll(size, true);
+
+	//Alrededor de los umbrales XMEM_SMALL y XMEM_NONTEMPORAL
+	const dword edges[] = {XMEM_SMALL, XMEM_NONTEMPORAL};
+	for(dword e = 0; e < sizeof(edges)/sizeof(edges[0]); e++)
+	{
+		for(int delta = -3; delta <= XMEM_RUN + 3; delta++, checked++)
+			CheckAll(edges[e] + delta, edges[e] == XMEM_SMALL || delta < 5 || delta > XMEM_RUN - 5);
+	}
+
+	//Bloques grandes y solapados
+	const dword large[] = {XMEM_NONTEMPORAL*4 + 17, 1024*1024 + 3};
+	for(dword l = 0; l < sizeof(large)/sizeof(large[0]); l++, checked++)
+		CheckAll(large[l], false);
+	for(dword size = 0; size <= SIZES; size += 7)
+	{
+		for(dword distance = 1; distance <= 40; distance++, checked++)
+		{
+			CheckOverlap("Overlap", XMEM_CopyString, size, distance);
+			CheckOverlap("Overlap+SSE2", XMEM_CopySSE2, size, distance);
+		}
+	}
+	for(dword distance = 1; distance <= 40; distance += 13, checked++)
+		CheckOverlap("Overlap+SSE2", XMEM_CopySSE2, XMEM_NONTEMPORAL + 100, distance);
+
+	printf("%u tamanos, %u fallos\n", checked, failures);
+	return failures?1:0;
+}
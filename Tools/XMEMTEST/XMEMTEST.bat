@@ -0,0 +1,3 @@
+@echo off
+rem Copia y relleno del RTL contra memcpy/memset en todos los tamanos y alineaciones
+Bin\Release\XMEMTEST.exe
@@ -0,0 +1,4 @@
+#!/bin/sh
+# Copia y relleno del RTL contra memcpy/memset, compilado en Linux con GCC
+mkdir -p Bin
+g++ -O2 -Wall -I../INC Source/main.cpp -o Bin/xmemtest && Bin/xmemtest
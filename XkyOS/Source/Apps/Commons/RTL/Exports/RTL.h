@@ -14,7 +14,16 @@
 typedef bool (*fRTL_Init)();
 
 //Byte Copy
-typedef void	(*fRTL_Copy)(IN VIRTUAL _destiny, IN VIRTUAL _origin, IN dword _size);
+typedef void	(*fRTL_Copy)		(OUT VIRTUAL _destiny, IN VIRTUAL _origin, IN dword _size);
+typedef void	(*fRTL_Fill)		(OUT VIRTUAL _destiny, IN byte _value, IN dword _size);
+typedef bool	(*fRTL_Benchmark)	(IN dword _primitive, IN dword _implementation, OUT VIRTUAL _destiny, IN VIRTUAL _origin, IN dword _size);
+
+#define RTL_COPY		0	/**< RTL_Copy*/
+#define RTL_FILL		1	/**< RTL_Fill*/
+
+#define RTL_STRING				0	/**< Memory primitives with rep movsd and rep stosd*/
+#define RTL_SSE2				1	/**< Non temporal stores for large blocks*/
+#define MAX_RTL_IMPLEMENTATIONS	2
 
 //Byte Translation
 typedef dword	(*fRTL_BytesToUnit)				(IN dword _bytes, IN dword _unit_size);
@@ -30,8 +39,21 @@ typedef bool (*fSTRING_Copy)	(OUT string* _s1, IN string* _s2);
 typedef void (*fSTRING_ToString)(IN string* _buffer, IN dword _data, IN byte _size);
 
 //Heap operations
-typedef VIRTUAL	(*fHEAP_Alloc)	(IN dword _size);
-typedef void	(*fHEAP_Free)	(IN VIRTUAL& _address);
+struct HEAP_STATISTICS
+{
+	dword	pages;			/*< Pages the heap has taken*/
+	dword	used;			/*< Bytes of the blocks allocated, headers included*/
+	dword	cached;			/*< Bytes of the freed blocks waiting in the quick lists*/
+	dword	free;			/*< Bytes of the free blocks*/
+	dword	allocations;	/*< Calls to HEAP_Alloc that got memory*/
+	dword	quick;			/*< Of them, served from a quick list*/
+	dword	frees;			/*< Calls to HEAP_Free*/
+	dword	failures;		/*< Calls to HEAP_Alloc that got nothing*/
+};
+
+typedef VIRTUAL	(*fHEAP_Alloc)			(IN dword _size);
+typedef void	(*fHEAP_Free)			(IN VIRTUAL& _address);
+typedef void	(*fHEAP_GetStatistics)	(OUT HEAP_STATISTICS* _statistics);
 
 //List operations
 struct LIST_ENTRY
@@ -60,4 +82,7 @@ typedef void	(*fCONSOLE_NewLine)		();
 typedef void	(*fCONSOLE_WriteLn)		(IN string* _text, IN ARGB _color);
 typedef void	(*fCONSOLE_WriteNumber)	(IN dword _data, IN byte _size, IN ARGB _color);
 
+//Input events
+typedef dword	(*fEVENTS_Read)	(IN WINDOW_EVENT_RING* _ring, OUT WINDOW_EVENT* _events, IN dword _max);
+
 #endif //__RTL_H__
@@ -19,49 +19,21 @@
 #pragma data_seg(".data")
 //============================================================================//
 #include "RTL.h"
-/**
-* @brief Heap Node definition for kernel Heap.
-*/
-union HEAP_NODE
-{
-	/**
-	* @brief Heap Node definition when the node is free.
-	*/
-	struct
-	{
-		dword		magic;
-		HEAP_NODE*	next;
-		HEAP_NODE*	back;
-	} freed;
-	/**
-	* @brief Heap Node definition when the node is allocated.
-	*/
-	struct
-	{
-		dword	blocks;
-		byte	empty[60];
-	} allocated;
-};
+#define HEAP_START			0x30000000	/**< Address of the heap*/
+#define HEAP_MAX_PAGES		16384		/**< Pages the heap can grow to (64MB)*/
 
 /**
-* @brief Heap definition for kernel Heap.
+* @brief Lock of the heap, for the threads of the execution.
 */
-struct HEAP
-{
-	HEAP_NODE*	ptr;
-	dword		size;
-	dword		number;
-};
+PRIVATE volatile dword heap_lock = 0;
+
+#define RTL_FEATURE_SSE		0x02000000	/**< SSE instructions*/
+#define RTL_FEATURE_SSE2	0x04000000	/**< SSE2 instructions*/
 
 /**
-* @brief Runtime heap.
+* @brief CPU features, read once.
 */
-HEAP rtl_heap = {0, 0, 0};
-
-#define HEAP_MAGIC			'HEAP'
-#define HEAP_SIZE_IN_BYTES	(1024*1024)
-#define HEAP_SIZE_IN_PAGES	(HEAP_SIZE_IN_BYTES/PAGE_SIZE)
-#define HEAP_NODES_NUMBER	(HEAP_SIZE_IN_BYTES/sizeof(HEAP_NODE))
+PRIVATE dword rtl_cpu_features = 0;
 
 //CONSOLE constants
 #define CHARACTER_HEIGHT	8
@@ -74,11 +46,21 @@ dword height;
 dword width;
 dword x;
 dword y;
+ARGB background;
 
 //==================================CODE======================================//
 #pragma code_seg(".code")
 //============================================================================//
+#include "XMEM.h"
+#include "XHEAP.h"
+
+/**
+* @brief Runtime heap.
+*/
+PRIVATE XHEAP rtl_heap;
+
 PRIVATE bool HEAP_Init();
+PRIVATE void RTL_InitMemory();
 
 /**
 * @brief Initialization of runtime systems.
@@ -86,6 +68,9 @@ PRIVATE bool HEAP_Init();
 */
 PUBLIC bool RTL_Init()
 {
+	//Best memory primitives the CPU can run
+	RTL_InitMemory();
+
 	//Inicialize heap support.
 	if(!HEAP_Init())
 		return false;
@@ -95,30 +80,147 @@ PUBLIC bool RTL_Init()
 }
 
 /**
-* @brief Copies _size bytes from _origin to _destiny.
+* @brief Reads the processor feature flags.
+* @return The CPUID function 1 flags (RTL_FEATURE_*), zero if the processor has no CPUID.
+*/
+PRIVATE NAKED dword RTL_GetFeatures()
+{
+	__asm
+	{
+		//CPUID is there if the ID flag can be changed
+		pushfd
+		pop eax
+		mov ecx, eax
+		xor eax, 0x00200000
+		push eax
+		popfd
+		pushfd
+		pop eax
+		push ecx
+		popfd
+		xor eax, ecx
+		jz _NoCPUID
+
+		push ebx
+		mov eax, 1
+		cpuid
+		mov eax, edx
+		pop ebx
+		ret
+
+	_NoCPUID:
+		xor eax, eax
+		ret
+	}
+}
+
+/**
+* @brief One implementation of the memory primitives.
+*/
+struct RTL_MEMORY_IMPLEMENTATION
+{
+	dword		features;	/*< RTL_FEATURE_* needed*/
+	fXMEM_Copy	copy;		/*< Copy of large blocks*/
+	fXMEM_Fill	fill;		/*< Fill of large blocks*/
+};
+
+#define RTL_STRING_IMPLEMENTATION	{0,										XMEM_CopyString,	XMEM_FillString}
+#define RTL_SSE2_IMPLEMENTATION		{RTL_FEATURE_SSE | RTL_FEATURE_SSE2,	XMEM_CopySSE2,		XMEM_FillSSE2}
+
+/**
+* @brief Memory primitives implementations, indexed by RTL_STRING and RTL_SSE2.
+*/
+PRIVATE RTL_MEMORY_IMPLEMENTATION rtl_memory_implementations[MAX_RTL_IMPLEMENTATIONS] = {
+	RTL_STRING_IMPLEMENTATION,
+	RTL_SSE2_IMPLEMENTATION};
+
+/**
+* @brief The implementation large blocks use, the best one the CPU has.
+*/
+PRIVATE RTL_MEMORY_IMPLEMENTATION* rtl_memory = &rtl_memory_implementations[RTL_STRING];
+
+/**
+* @brief Tells if the CPU can run an implementation of the memory primitives.
+* @param _implementation [in] RTL_STRING or RTL_SSE2.
+* @return True if it can.
+*/
+PRIVATE bool RTL_IsSupported(IN dword _implementation)
+{
+	if(_implementation >= MAX_RTL_IMPLEMENTATIONS)
+		return false;
+
+	dword features = rtl_memory_implementations[_implementation].features;
+	return (rtl_cpu_features & features) == features;
+}
+
+/**
+* @brief Chooses the implementation of the memory primitives for large blocks.
+*/
+PRIVATE void RTL_InitMemory()
+{
+	rtl_cpu_features = RTL_GetFeatures();
+	for(dword i = 0; i < MAX_RTL_IMPLEMENTATIONS; i++)
+	{
+		if(RTL_IsSupported(i))
+			rtl_memory = &rtl_memory_implementations[i];
+	}
+}
+
+/**
+* @brief Copies _size bytes from _origin to _destiny, front to back, so blocks may overlap only if the
+* destiny is below the origin. Small blocks go byte by byte, the rest a dword at a time, and large ones
+* skip the cache if the CPU can.
 * @param _destiny [in] Destiny address.
 * @param _origin [in] Source addres.
 * @param _size [in] Bytes to copy.
 */
-PUBLIC NAKED void RTL_Copy(IN VIRTUAL _destiny, IN VIRTUAL _origin, IN dword _size)
+PUBLIC void RTL_Copy(OUT VIRTUAL _destiny, IN VIRTUAL _origin, IN dword _size)
 {
-	__asm
+	XMEM_Copy((byte*)_destiny, (const byte*)_origin, _size, rtl_memory->copy);
+}
+
+/**
+* @brief Sets _size bytes at _destiny to a value. Small blocks go byte by byte, the rest a dword at a
+* time, and large ones skip the cache if the CPU can.
+* @param _destiny [out] Destiny address.
+* @param _value [in] The byte.
+* @param _size [in] Bytes to fill.
+*/
+PUBLIC void RTL_Fill(OUT VIRTUAL _destiny, IN byte _value, IN dword _size)
+{
+	XMEM_Fill((byte*)_destiny, _value, _size, rtl_memory->fill);
+}
+
+/**
+* @brief Runs once one of the memory primitives with a given implementation, whatever the size, to
+* measure it or check it.
+* @param _primitive [in] RTL_COPY or RTL_FILL.
+* @param _implementation [in] RTL_STRING or RTL_SSE2.
+* @param _destiny [out] Destiny address.
+* @param _origin [in] Source address when copying, the byte in the low bits when filling.
+* @param _size [in] Bytes.
+* @return False if the CPU has not the implementation or the primitive is unknown.
+*/
+PUBLIC bool RTL_Benchmark(IN dword _primitive, IN dword _implementation, OUT VIRTUAL _destiny, IN VIRTUAL _origin, IN dword _size)
+{
+	if(!RTL_IsSupported(_implementation))
+		return false;
+
+	RTL_MEMORY_IMPLEMENTATION* implementation = &rtl_memory_implementations[_implementation];
+	switch(_primitive)
 	{
-		push ebp
-		mov ebp, esp
-		push ecx
-		push esi
-		push edi
-		mov ecx, dword ptr [ebp + 16] //_size
-		mov esi, dword ptr [ebp + 12] //_origin
-		mov edi, dword ptr [ebp + 8]  //_destiny
-		rep movsb
-		pop edi
-		pop esi
-		pop ecx
-		pop ebp
-		ret 12
+		case RTL_COPY:
+		{
+			implementation->copy((byte*)_destiny, (const byte*)_origin, _size);
+			return true;
+		}
+		case RTL_FILL:
+		{
+			implementation->fill((byte*)_destiny, (byte)_origin, _size);
+			return true;
+		}
 	}
+	return false;
 }
 
 /**
@@ -163,16 +265,6 @@ PUBLIC dword RTL_BytesToPages(IN dword _bytes)
 	return RTL_BytesToUnit(_bytes, PAGE_SIZE);
 }
 
-/**
-* @brief Translates a given number _bytes into a number of heap nodes.
-* @param _bytes [in] Number of bytes.
-* @return Number of heap nodes.
-*/
-PRIVATE dword RTL_BytesToHeapNodes(IN dword _bytes)
-{
-	return RTL_BytesToUnit(_bytes, sizeof(HEAP_NODE));
-}
-
 /**
 * @brief Translates a given offset in _bytes into a LBA offset.
 * @param _offset [in] Offset in bytes.
@@ -212,8 +304,8 @@ PUBLIC bool STRING_Compare(IN string* _s1, IN string* _s2)
 PUBLIC bool STRING_Append(IN OUT string* _s1, IN string* _s2)
 {
 	//Assumming enough space in s1
-	for(byte i = 0; i < _s2->size; i++)
-		_s1->text[_s1->size++] = _s2->text[i];
+	RTL_Copy((VIRTUAL)&_s1->text[_s1->size], (VIRTUAL)_s2->text, _s2->size);
+	_s1->size = (byte)(_s1->size + _s2->size);
 
 	return true;
 }
@@ -227,8 +319,7 @@ PUBLIC bool STRING_Append(IN OUT string* _s1, IN string* _s2)
 PUBLIC bool STRING_Copy(OUT string* _s1, IN string* _s2)
 {
 	//Assumming enough space in s1
-	for(byte i = 0; i < _s2->size; i++)
-		_s1->text[i] = _s2->text[i];
+	RTL_Copy((VIRTUAL)_s1->text, (VIRTUAL)_s2->text, _s2->size);
 
 	_s1->size = _s2->size;
 	return true;
@@ -325,200 +416,102 @@ PUBLIC void STRING_ToString(IN string* _buffer, IN dword _data, IN byte _size)
 }
 
 /**
-* @brief Initializes the heap.
-* @return True if initilization was successful, false otherwise.
+* @brief Takes the heap lock, waiting while another thread has it.
 */
-PRIVATE bool HEAP_Init()
+PRIVATE void HEAP_Lock()
 {
-	//Ask for memory for heap
-	rtl_heap.ptr = (HEAP_NODE*)XKY_PAGE_Alloc(XKY_ADDRESS_SPACE_GetCurrent(), 0x30000000, HEAP_SIZE_IN_PAGES);
-	if(rtl_heap.ptr)
+	dword busy;
+	do
 	{
-		//Memory allocated
-		rtl_heap.size = HEAP_SIZE_IN_PAGES;
-		rtl_heap.number = HEAP_NODES_NUMBER;
-
-		//Partitionate Heap
-		for(dword i = 1; i < HEAP_NODES_NUMBER - 1; i++)
+		//Wait reading, so the bus is not locked while the lock is taken
+		while(heap_lock);
+		__asm
 		{
-			rtl_heap.ptr[i].freed.magic = HEAP_MAGIC;
-			rtl_heap.ptr[i].freed.next = &rtl_heap.ptr[i + 1];
-			rtl_heap.ptr[i].freed.back = &rtl_heap.ptr[i - 1];
+			mov eax, 1
+			lock xchg eax, heap_lock
+			mov busy, eax
 		}
-
-		//Fix first and last node
-		rtl_heap.ptr[0].freed.magic = HEAP_MAGIC;
-		rtl_heap.ptr[0].freed.next = &rtl_heap.ptr[1];
-		rtl_heap.ptr[0].freed.back = 0;
-
-		rtl_heap.ptr[HEAP_NODES_NUMBER-1].freed.magic = HEAP_MAGIC;
-		rtl_heap.ptr[HEAP_NODES_NUMBER-1].freed.next = 0;
-		rtl_heap.ptr[HEAP_NODES_NUMBER-1].freed.back = &rtl_heap.ptr[HEAP_NODES_NUMBER-2];
-
-		//Ok
-		return true;
 	}
-	//Not enough memory...
-	return false;
+	while(busy);
 }
 
 /**
-* @brief Initializes the heap.
-* @param _node [in out] First node in a heap allocation.
-* @param _number of nodes [in] Number of nodes to be allocated.
-* @return Address of usable heap memory.
+* @brief Gives the heap lock back.
 */
-PRIVATE VIRTUAL HEAP_AllocNodes(IN OUT HEAP_NODE* _node, IN dword _number_of_nodes)
+PRIVATE void HEAP_Unlock()
 {
-	HEAP_NODE* previous = _node->freed.back;
-	HEAP_NODE* last = _node + _number_of_nodes;
-
-	//Relink
-	if(previous)
-		previous->freed.next = last;
-	if(last)
-		last->freed.back = previous;
-
-	//Reserve
-	for(dword i = 0; i < _number_of_nodes; i++)
-	{
-		_node[i].freed.magic = 0;
-	}
+	heap_lock = 0;
+}
 
-	_node->allocated.blocks = _number_of_nodes;
-	return (VIRTUAL)&_node->allocated.empty;
+/**
+* @brief Maps pages the heap grows by in the current address space.
+* @param _address [in] Where.
+* @param _pages [in] Number of pages.
+* @return True if they are mapped there.
+*/
+PRIVATE bool HEAP_Map(IN byte* _address, IN dword _pages)
+{
+	VIRTUAL address = (VIRTUAL)_address;
+	return XKY_PAGE_Alloc(XKY_ADDRESS_SPACE_GetCurrent(), address, _pages) == address;
 }
 
 /**
-* @brief Finds empty space in the heap for a number of nodes.
-* @param _number_of_nodes [in] Number of nodes to be allocated.
-* @return First node that satisfies that is empty, and _number_of_nodes - 1 next nodes are also free.
+* @brief Initializes the heap.
+* @return True if initilization was successful, false otherwise.
 */
-PRIVATE HEAP_NODE* HEAP_FindEmptySpace(IN dword _number_of_nodes)
+PRIVATE bool HEAP_Init()
 {
-	for(dword i = 0; i < HEAP_NODES_NUMBER - _number_of_nodes; i++)
-	{
-		dword j;
-		for(j = i; j < i + _number_of_nodes; j++)
-		{
-			if(rtl_heap.ptr[j].freed.magic != HEAP_MAGIC)
-				break;
-		}
-		if(j == i + _number_of_nodes)
-			return &rtl_heap.ptr[i];
-	}
-	return 0;
+	heap_lock = 0;
+	return XHEAP_Init(&rtl_heap, (byte*)HEAP_START, HEAP_MAX_PAGES, HEAP_Map);
 }
 
 /**
-* @brief Allocates empty space in the heap.
+* @brief Allocates memory from the heap. Small blocks come from the quick list of their size if it has
+* any; the rest from the free blocks, merging the quick lists first if none is large enough, and growing
+* the heap if still none is.
 * @param _size [in] Number of bytes to be allocated.
-* @return Address to be used, or zero if there was an error.
+* @return Address to be used, aligned to XHEAP_GRANULARITY, or zero if there was an error.
 */
 PUBLIC VIRTUAL HEAP_Alloc(IN dword _size)
 {
-	dword number_of_nodes = RTL_BytesToHeapNodes(_size);
-	if(number_of_nodes)
-	{
-		HEAP_NODE* nodes = HEAP_FindEmptySpace(number_of_nodes);
-		if(nodes)
-		{
-			return HEAP_AllocNodes(nodes, number_of_nodes);
-		}
-	}
-	return 0;
+	HEAP_Lock();
+	VIRTUAL address = (VIRTUAL)XHEAP_Alloc(&rtl_heap, _size);
+	HEAP_Unlock();
+	return address;
 }
 
 /**
-* @brief Frees heap memory.
-* @param _address [in] Address given in a previous call to HEAP_Alloc.
+* @brief Frees heap memory. Small blocks wait in the quick list of their size, the rest are merged with
+* the free blocks around. Addresses out of the heap and blocks already freed are ignored.
+* @param _address [in] Address given in a previous call to HEAP_Alloc, zero after the call.
 */
 PUBLIC void HEAP_Free(IN VIRTUAL& _address)
 {
-	_address = 0;
-	return;
-
-	/*
 	if(!_address)
 		return;
 
-	HEAP_NODE* node_start = (HEAP_NODE*)(_address - 4);
-	dword number = node_start->allocated.blocks;
-
-	for(dword i = 1; i < number - 1; i++)
-	{
-		node_start[i].freed.magic = HEAP_MAGIC;
-		node_start[i].freed.next = &node_start[i + 1];
-		node_start[i].freed.back = &node_start[i - 1];
-	}
-
-	//First element must find first free back form him
-	if(rtl_heap.ptr == node_start)
-	{
-		node_start[0].freed.back = 0;
-	}
-	else
-	{
-		HEAP_NODE* previous = node_start - 1;
-		while(previous != rtl_heap.ptr)
-		{
-			if(previous->freed.magic == HEAP_MAGIC)
-			{
-				node_start[0].freed.back = previous;
-				break;
-			}
-			else
-				previous--;
-		}
-
-		if(rtl_heap.ptr == previous)
-		{
-			if(previous->freed.magic == HEAP_MAGIC)
-			{
-				node_start[0].freed.back = previous;
-			}
-			else
-			{
-				node_start[0].freed.back = 0;
-			}
-		}
-	}
-
-
-	//Last element must find first free next form him
-	if(&rtl_heap.ptr[HEAP_NODES_NUMBER-1] == node_start + number)
-	{
-		node_start[number].freed.next = 0;
-	}
-	else
-	{
-		HEAP_NODE* next = node_start + number;
-		while(next != &rtl_heap.ptr[HEAP_NODES_NUMBER-1])
-		{
-			if(next->freed.magic == HEAP_MAGIC)
-			{
-				node_start[number].freed.next = next;
-				break;
-			}
-			else
-				next++;
-		}
-
-		if(&rtl_heap.ptr[HEAP_NODES_NUMBER-1] == next)
-		{
-			if(next->freed.magic == HEAP_MAGIC)
-			{
-				node_start[number].freed.back = next;
-			}
-			else
-			{
-				node_start[number].freed.next = 0;
-			}
-		}
-	}
-
+	HEAP_Lock();
+	XHEAP_Free(&rtl_heap, (void*)_address);
+	HEAP_Unlock();
 	_address = 0;
-	*/
+}
+
+/**
+* @brief Copies the heap counters.
+* @param _statistics [out] Where to leave them.
+*/
+PUBLIC void HEAP_GetStatistics(OUT HEAP_STATISTICS* _statistics)
+{
+	HEAP_Lock();
+	_statistics->pages = rtl_heap.statistics.pages;
+	_statistics->used = rtl_heap.statistics.used;
+	_statistics->cached = rtl_heap.statistics.cached;
+	_statistics->free = rtl_heap.statistics.free;
+	_statistics->allocations = rtl_heap.statistics.allocations;
+	_statistics->quick = rtl_heap.statistics.quick;
+	_statistics->frees = rtl_heap.statistics.frees;
+	_statistics->failures = rtl_heap.statistics.failures;
+	HEAP_Unlock();
 }
 
 /**
@@ -624,6 +617,8 @@ PUBLIC LIST_ITERATOR LIST_Next(IN LIST_ENTRY* _head, IN LIST_ITERATOR _iterator)
 */
 PUBLIC void CONSOLE_Clear(IN ARGB _color)
 {
+	background = _color;
+
 	//Rellenar el rectangulo
 	for(dword x = WIDTH_MARGIN; x <= (width - WIDTH_MARGIN); x++)
 	{
@@ -643,7 +638,11 @@ PUBLIC void CONSOLE_Write(IN string* _text, IN ARGB _color)
 {
 	if(_text->size && (x + _text->size * CHARACTER_WIDTH < width - WIDTH_MARGIN))
 	{
-		XKY_WINDOW_PrintText(window, x, y, _color, _text);
+		//Solid backgrounds are drawn with the text, from the glyph atlas
+		if(COLOR_IsSolid(background))
+			XKY_WINDOW_PrintTextOpaque(window, x, y, _color, background, _text);
+		else
+			XKY_WINDOW_PrintText(window, x, y, _color, _text);
 		x += _text->size * CHARACTER_WIDTH;
 	}
 }
@@ -671,9 +670,22 @@ PUBLIC void CONSOLE_NewLine()
 {
 	x = WIDTH_MARGIN;
 
-	y -= CHARACTER_HEIGHT;
-	if(y <= HEIGHT_MARGIN)
-		y = height - HEIGHT_MARGIN;
+	//The window manager may have changed the window size, it keeps the top rows
+	dword new_height = XKY_WINDOW_GetHeight(window);
+	dword new_width = XKY_WINDOW_GetWidth(window);
+	if(new_height != height || new_width != width)
+	{
+		dword from_top = height - y;
+		height = new_height;
+		width = new_width;
+		y = (from_top + HEIGHT_MARGIN + CHARACTER_HEIGHT < height)?(height - from_top):(HEIGHT_MARGIN + CHARACTER_HEIGHT);
+	}
+
+	//Last line, move the text up
+	if(y - CHARACTER_HEIGHT <= HEIGHT_MARGIN)
+		XKY_WINDOW_Scroll(window, HEIGHT_MARGIN + 1, height - HEIGHT_MARGIN, CHARACTER_HEIGHT, background);
+	else
+		y -= CHARACTER_HEIGHT;
 }
 
 /**
@@ -746,12 +758,43 @@ PUBLIC void CONSOLE_Init(IN WINDOW _window, IN ARGB _color, IN string* _title, I
 	CONSOLE_Write(_prompt, SRGB(0, 255, 0));
 }
 
+/**
+* @brief Takes the pending events of a ring mapped with XKY_WINDOW_MapEvents.
+* @param _ring [in] The mapped ring.
+* @param _events [out] Where to leave the events.
+* @param _max [in] Room in _events.
+* @return Number of events read.
+*/
+PUBLIC dword EVENTS_Read(IN WINDOW_EVENT_RING* _ring, OUT WINDOW_EVENT* _events, IN dword _max)
+{
+	//No pointer move is folded into a pending event until tail is published
+	_ring->reading = 1;
+
+	dword tail = _ring->tail;
+	dword pending = _ring->head - tail;
+	if(pending > _max)
+		pending = _max;
+
+	//At most two runs, before and after the end of the ring
+	dword first = tail & (WINDOW_EVENTS - 1);
+	dword run = (pending < WINDOW_EVENTS - first)?pending:(WINDOW_EVENTS - first);
+	RTL_Copy((VIRTUAL)_events, (VIRTUAL)&_ring->events[first], run*sizeof(WINDOW_EVENT));
+	RTL_Copy((VIRTUAL)(_events + run), (VIRTUAL)&_ring->events[0], (pending - run)*sizeof(WINDOW_EVENT));
+
+	//The slots can be reused once tail moves
+	_ring->tail = tail + pending;
+	_ring->reading = 0;
+	return pending;
+}
+
 //=================================EXPORTS====================================//
 #pragma data_seg(".exports")
 //============================================================================//
 EXPORT(RTL_Init);
 
 EXPORT(RTL_Copy);
+EXPORT(RTL_Fill);
+EXPORT(RTL_Benchmark);
 
 EXPORT(RTL_BytesToUnit);
 EXPORT(RTL_ByteOffsetToUnitOffset);
@@ -766,6 +809,7 @@ EXPORT(STRING_ToString);
 
 EXPORT(HEAP_Alloc);
 EXPORT(HEAP_Free);
+EXPORT(HEAP_GetStatistics);
 
 EXPORT(LIST_Init);
 EXPORT(LIST_IsEmpty);
@@ -785,6 +829,8 @@ EXPORT(CONSOLE_NewLine);
 EXPORT(CONSOLE_WriteLn);
 EXPORT(CONSOLE_WriteNumber);
 
+EXPORT(EVENTS_Read);
+
 //=================================MODULE=====================================//
 #pragma data_seg(".module")
 //============================================================================//
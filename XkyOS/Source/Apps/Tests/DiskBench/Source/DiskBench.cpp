@@ -0,0 +1,228 @@
+/******************************************************************************/
+/**
+* @file		DiskBench.cpp
+* @brief	XkyOS Disk scheduler benchmark
+* Several executions read the disk at once, some sequentially and some at random places, keeping a
+* few requests each in the disk queue. The same load runs under every disk scheduler and the debug
+* output gets the throughput, the transfers, the requests merged, the seeks and the reads of each reader.
+*
+* @date		20/03/2008
+* @author	Pablo Bravo
+*/
+/******************************************************************************/
+#include "Types.h"
+#include "Executable.h"
+
+//=================================IMPORTS====================================//
+#pragma data_seg(".imports")
+//============================================================================//
+#include "API.h"
+
+//==================================DATA======================================//
+#pragma data_seg(".data")
+//============================================================================//
+#define BENCH_READERS		4			/*< The first half read sequentially, the rest at random*/
+#define BENCH_DEPTH			4			/*< Requests each reader keeps submitted*/
+#define BENCH_SECTORS		8			/*< Sectors per request (a page)*/
+#define BENCH_AREA			16384		/*< Sectors of the disk the readers share (8MB)*/
+#define BENCH_TICKS			36			/*< About two seconds per scheduler (18.2 ticks per second)*/
+
+#define BENCH_BUFFERS		0x10000000	/*< A page per request of each reader*/
+#define BENCH_STACKS		0x10100000	/*< A stack page per reader*/
+
+/**
+* @brief A reader.
+*/
+struct BENCH_READER
+{
+	volatile dword	reads;		/*< Requests done*/
+	volatile bool	done;		/*< Gone, its buffers can be freed*/
+	dword			next;		/*< Sequential: next sector within the area. Random: the generator*/
+};
+
+PRIVATE BENCH_READER	bench_readers[BENCH_READERS];
+PRIVATE LBA				bench_area = 0;
+PRIVATE VIRTUAL			bench_buffers = 0;
+PRIVATE volatile dword	bench_started = 0;	/*< Readers that know which they are*/
+PRIVATE volatile bool	bench_stop = false;
+
+//==================================CODE======================================//
+#pragma code_seg(".code")
+//============================================================================//
+/**
+* @brief Tells a reader where to read next.
+* @param _reader [in] The reader.
+* @return Sector within the area.
+*/
+PRIVATE dword NextSector(IN dword _reader)
+{
+	BENCH_READER* reader = &bench_readers[_reader];
+	if(_reader < BENCH_READERS/2)
+	{
+		//Each sequential reader sweeps its own part of the first half of the area
+		dword part = (BENCH_AREA/2)/(BENCH_READERS/2);
+		dword sector = _reader*part + reader->next;
+		reader->next = (reader->next + BENCH_SECTORS) % part;
+		return sector;
+	}
+
+	reader->next = reader->next*1103515245 + 12345;
+	return ((reader->next >> 8) % (BENCH_AREA/BENCH_SECTORS))*BENCH_SECTORS;
+}
+
+/**
+* @brief A reader. Waits for its oldest request and submits another in its place until told to stop,
+* then gives its xid back.
+*/
+PRIVATE void Reader()
+{
+	dword index = bench_started;
+	bench_started++;
+
+	VIRTUAL buffers = bench_buffers + index*BENCH_DEPTH*PAGE_SIZE;
+	DISK_REQUEST requests[BENCH_DEPTH];
+	for(dword i = 0; i < BENCH_DEPTH; i++)
+		requests[i] = XKY_DISK_Submit(bench_area + NextSector(index), buffers + i*PAGE_SIZE, BENCH_SECTORS, false);
+
+	dword oldest = 0;
+	while(!bench_stop)
+	{
+		if(XKY_DISK_Wait(requests[oldest]))
+			bench_readers[index].reads++;
+		requests[oldest] = XKY_DISK_Submit(bench_area + NextSector(index), buffers + oldest*PAGE_SIZE, BENCH_SECTORS, false);
+		oldest = (oldest + 1) % BENCH_DEPTH;
+	}
+
+	for(dword i = 0; i < BENCH_DEPTH; i++)
+		XKY_DISK_Wait(requests[i]);
+	bench_readers[index].done = true;
+
+	XKY_CPU_Free(XKY_CPU_GetCurrent());
+	for(;;);
+}
+
+/**
+* @brief Runs the readers under a disk scheduler and sends the results to the debug output.
+* @param _scheduler [in] The scheduler.
+* @param _name [in] Its name.
+* @param _stacks [in] Stack pages of the readers.
+*/
+PRIVATE void Run(IN dword _scheduler, IN string* _name, IN VIRTUAL _stacks)
+{
+	string failed = STRING("  Scheduler not available");
+	XKY_DEBUG_Message(_name, SRGB(255, 0, 0));
+	if(!XKY_DISK_SetScheduler(_scheduler))
+	{
+		XKY_DEBUG_Message(&failed, SRGB(0, 0, 255));
+		return;
+	}
+
+	DISK_STATISTICS before;
+	XKY_DISK_GetStatistics(&before);
+
+	bench_stop = false;
+	bench_started = 0;
+	XID readers[BENCH_READERS];
+	for(dword i = 0; i < BENCH_READERS; i++)
+	{
+		bench_readers[i].reads = 0;
+		bench_readers[i].done = false;
+		bench_readers[i].next = (i < BENCH_READERS/2) ? 0 : 0x1234 + i;
+
+		//One at a time, so each takes its own index
+		readers[i] = XKY_CPU_AllocCode(XID_ANY, XKY_ADDRESS_SPACE_GetCurrent(), (VIRTUAL)Reader, _stacks + (i + 1)*PAGE_SIZE);
+		while(readers[i] && bench_started == i);
+		if(!readers[i])
+			bench_readers[i].done = true;
+	}
+
+	dword start = XKY_TMR_GetTicks();
+	while(XKY_TMR_GetTicks() - start < BENCH_TICKS);
+	dword ticks = XKY_TMR_GetTicks() - start;
+
+	//Let the readers go before their buffers do
+	bench_stop = true;
+	for(dword i = 0; i < BENCH_READERS; i++)
+		while(!bench_readers[i].done);
+
+	DISK_STATISTICS after;
+	XKY_DISK_GetStatistics(&after);
+
+	dword reads = 0;
+	dword fewest = 0xFFFFFFFF;
+	dword most = 0;
+	for(dword i = 0; i < BENCH_READERS; i++)
+	{
+		reads += bench_readers[i].reads;
+		if(bench_readers[i].reads < fewest)
+			fewest = bench_readers[i].reads;
+		if(bench_readers[i].reads > most)
+			most = bench_readers[i].reads;
+	}
+
+	string kbs = STRING("  KB/s");
+	string transfers = STRING("  Transfers");
+	string merged = STRING("  Requests merged");
+	string seeks = STRING("  Seeks");
+	string distance = STRING("  Sectors sought");
+	string sequential = STRING("  Reads of a sequential reader");
+	string random = STRING("  Reads of a random reader");
+	string fewest_reads = STRING("  Fewest reads of a reader");
+	string most_reads = STRING("  Most reads of a reader");
+
+	XKY_DEBUG_Data(&kbs, (reads*((BENCH_SECTORS*SECTOR_SIZE)/1024)*182)/(10*ticks), SRGB(0, 0, 255));
+	XKY_DEBUG_Data(&transfers, after.transfers - before.transfers, SRGB(0, 0, 255));
+	XKY_DEBUG_Data(&merged, after.merged - before.merged, SRGB(0, 0, 255));
+	XKY_DEBUG_Data(&seeks, after.seeks - before.seeks, SRGB(0, 0, 255));
+	XKY_DEBUG_Data(&distance, (dword)(after.distance - before.distance), SRGB(0, 0, 255));
+	XKY_DEBUG_Data(&sequential, bench_readers[0].reads, SRGB(0, 0, 255));
+	XKY_DEBUG_Data(&random, bench_readers[BENCH_READERS - 1].reads, SRGB(0, 0, 255));
+	XKY_DEBUG_Data(&fewest_reads, fewest, SRGB(0, 0, 255));
+	XKY_DEBUG_Data(&most_reads, most, SRGB(0, 0, 255));
+}
+
+PUBLIC void Main()
+{
+	string header = STRING("Disk scheduler benchmark");
+	string failed = STRING("  No room for the benchmark");
+	string fifo = STRING("FIFO");
+	string clook = STRING("C-LOOK");
+	XKY_DEBUG_Message(&header, SRGB(255, 0, 0));
+
+	DISK_STATISTICS statistics;
+	XKY_DISK_GetStatistics(&statistics);
+
+	bench_area = XKY_DISK_Alloc(65536, BENCH_AREA);
+	bench_buffers = XKY_PAGE_Alloc(XKY_ADDRESS_SPACE_GetCurrent(), BENCH_BUFFERS, BENCH_READERS*BENCH_DEPTH);
+	VIRTUAL stacks = XKY_PAGE_Alloc(XKY_ADDRESS_SPACE_GetCurrent(), BENCH_STACKS, BENCH_READERS);
+	if(bench_area && bench_buffers && stacks)
+	{
+		Run(DISK_SCHEDULER_FIFO, &fifo, stacks);
+		Run(DISK_SCHEDULER_CLOOK, &clook, stacks);
+	}
+	else
+	{
+		XKY_DEBUG_Message(&failed, SRGB(0, 0, 255));
+	}
+
+	//Leave the scheduler as it was
+	XKY_DISK_SetScheduler(statistics.scheduler);
+
+	if(stacks)
+		XKY_PAGE_Free(XKY_ADDRESS_SPACE_GetCurrent(), stacks, BENCH_READERS);
+	if(bench_buffers)
+		XKY_PAGE_Free(XKY_ADDRESS_SPACE_GetCurrent(), bench_buffers, BENCH_READERS*BENCH_DEPTH);
+	if(bench_area)
+		XKY_DISK_Free(bench_area, BENCH_AREA);
+
+	XKY_OS_Finish();
+}
+
+//=================================EXPORTS====================================//
+#pragma data_seg(".exports")
+//============================================================================//
+
+//=================================MODULE=====================================//
+#pragma data_seg(".module")
+//============================================================================//
+	MODULE(IMAGE_MODE_USER, IMAGE_KIND_MODULE, IMAGE_VERSION(1,0,0,0), 0, Main, 0);
@@ -0,0 +1,70 @@
+/******************************************************************************/
+/**
+* @file		DiskStream.cpp
+* @brief	XkyOS Disk streaming load
+* Reads the disk 64KB at a time for a while and leaves. The test application starts it as an
+* environment of its own and measures how much of the CPU it keeps meanwhile.
+*
+* @date		20/03/2008
+* @author	Pablo Bravo
+*/
+/******************************************************************************/
+#include "Types.h"
+#include "Executable.h"
+
+//=================================IMPORTS====================================//
+#pragma data_seg(".imports")
+//============================================================================//
+#include "API.h"
+
+//==================================DATA======================================//
+#pragma data_seg(".data")
+//============================================================================//
+#define STREAM_SECTORS		128			/*< Sectors per read (64KB)*/
+#define STREAM_PAGES		((STREAM_SECTORS*SECTOR_SIZE)/PAGE_SIZE)
+#define STREAM_TICKS		36			/*< About two seconds (18.2 ticks per second)*/
+
+#define STREAM_BUFFER		0x10000000
+
+//==================================CODE======================================//
+#pragma code_seg(".code")
+//============================================================================//
+PUBLIC void Main()
+{
+	string header = STRING("Disk stream reads");
+	string failed = STRING("  No room for the stream");
+
+	LBA sector = XKY_DISK_Alloc(16384, STREAM_SECTORS);
+	VIRTUAL buffer = XKY_PAGE_Alloc(XKY_ADDRESS_SPACE_GetCurrent(), STREAM_BUFFER, STREAM_PAGES);
+	if(sector && buffer)
+	{
+		dword reads = 0;
+		dword start = XKY_TMR_GetTicks();
+		while(XKY_TMR_GetTicks() - start < STREAM_TICKS)
+		{
+			if(XKY_DISK_Read(sector, buffer, STREAM_SECTORS))
+				reads++;
+		}
+		XKY_DEBUG_Data(&header, reads, SRGB(0, 0, 255));
+	}
+	else
+	{
+		XKY_DEBUG_Message(&failed, SRGB(0, 0, 255));
+	}
+
+	if(buffer)
+		XKY_PAGE_Free(XKY_ADDRESS_SPACE_GetCurrent(), buffer, STREAM_PAGES);
+	if(sector)
+		XKY_DISK_Free(sector, STREAM_SECTORS);
+
+	XKY_OS_Finish();
+}
+
+//=================================EXPORTS====================================//
+#pragma data_seg(".exports")
+//============================================================================//
+
+//=================================MODULE=====================================//
+#pragma data_seg(".module")
+//============================================================================//
+	MODULE(IMAGE_MODE_USER, IMAGE_KIND_MODULE, IMAGE_VERSION(1,0,0,0), 0, Main, 0);
@@ -0,0 +1,300 @@
+/******************************************************************************/
+/**
+* @file		HeapTest.cpp
+* @brief	XkyOS User heap stress test
+* Allocates and frees blocks of random sizes, most small and some large, filling each with a pattern
+* that is checked before it is freed. It runs first alone and then in several executions of the same
+* address space at once, to test the heap lock. After each run every block must be back in the heap and
+* the heap statistics must add up to its pages. Then a block of all the free memory must fit without
+* the heap growing, as the quick lists merge, and a block freed again after merging with the one before
+* it must be ignored. The errors and the counters go to the debug output.
+*
+* @date		20/03/2008
+* @author	Pablo Bravo
+*/
+/******************************************************************************/
+#include "Types.h"
+#include "Executable.h"
+
+//=================================IMPORTS====================================//
+#pragma data_seg(".imports")
+//============================================================================//
+#include "API.h"
+
+//==================================DATA======================================//
+#pragma data_seg(".data")
+//============================================================================//
+#include "RTLStub.h"
+
+#define TEST_WORKERS		4			/*< Executions allocating at once*/
+#define TEST_SLOTS			256			/*< Blocks each one can hold*/
+#define TEST_ROUNDS			20000		/*< Allocations or frees each one does*/
+#define TEST_STACKS			0x10100000	/*< A stack page per worker*/
+
+/**
+* @brief A worker.
+*/
+struct TEST_WORKER
+{
+	VIRTUAL			blocks[TEST_SLOTS];	/*< Its blocks, zero where it has none*/
+	dword			sizes[TEST_SLOTS];
+	dword			random;				/*< The generator*/
+	volatile dword	errors;				/*< Blocks that lost their pattern, and allocations that failed*/
+	volatile bool	done;				/*< Gone*/
+};
+
+PRIVATE TEST_WORKER		test_workers[TEST_WORKERS];
+PRIVATE volatile dword	test_started = 0;	/*< Workers that know which they are*/
+
+//==================================CODE======================================//
+#pragma code_seg(".code")
+//============================================================================//
+/**
+* @brief Next random number of a worker.
+* @param _worker [in out] The worker.
+* @return The number.
+*/
+PRIVATE dword Random(IN OUT TEST_WORKER* _worker)
+{
+	_worker->random = _worker->random*1103515245 + 12345;
+	return _worker->random >> 8;
+}
+
+/**
+* @brief Tells if a block keeps the pattern of its slot.
+* @param _worker [in] The worker.
+* @param _slot [in] The slot.
+* @return True if it does.
+*/
+PRIVATE bool CheckBlock(IN TEST_WORKER* _worker, IN dword _slot)
+{
+	byte* block = (byte*)_worker->blocks[_slot];
+	for(dword i = 0; i < _worker->sizes[_slot]; i++)
+	{
+		if(block[i] != (byte)(_slot + i))
+			return false;
+	}
+	return true;
+}
+
+/**
+* @brief Allocates or frees a random slot of a worker each round, and frees what is left at the end.
+* @param _index [in] The worker.
+*/
+PRIVATE void Stress(IN dword _index)
+{
+	TEST_WORKER* worker = &test_workers[_index];
+	for(dword round = 0; round < TEST_ROUNDS; round++)
+	{
+		dword slot = Random(worker) % TEST_SLOTS;
+		if(worker->blocks[slot])
+		{
+			if(!CheckBlock(worker, slot))
+				worker->errors++;
+			HEAP_Free(worker->blocks[slot]);
+			continue;
+		}
+
+		//Seven of ten small, two up to a few pages, one up to a hundred KB
+		dword random = Random(worker);
+		dword kind = random % 10;
+		if(kind < 7)
+			worker->sizes[slot] = random % 200 + 1;
+		else if(kind < 9)
+			worker->sizes[slot] = random % 5000 + 1;
+		else
+			worker->sizes[slot] = random % 100000 + 1;
+
+		worker->blocks[slot] = HEAP_Alloc(worker->sizes[slot]);
+		if(!worker->blocks[slot])
+		{
+			worker->errors++;
+			continue;
+		}
+
+		byte* block = (byte*)worker->blocks[slot];
+		for(dword i = 0; i < worker->sizes[slot]; i++)
+			block[i] = (byte)(slot + i);
+	}
+
+	for(dword slot = 0; slot < TEST_SLOTS; slot++)
+	{
+		if(worker->blocks[slot])
+		{
+			if(!CheckBlock(worker, slot))
+				worker->errors++;
+			HEAP_Free(worker->blocks[slot]);
+		}
+	}
+}
+
+/**
+* @brief A worker in its own execution. Gives its xid back when done.
+*/
+PRIVATE void Worker()
+{
+	dword index = test_started;
+	test_started++;
+
+	Stress(index);
+	test_workers[index].done = true;
+
+	XKY_CPU_Free(XKY_CPU_GetCurrent());
+	for(;;);
+}
+
+/**
+* @brief Sends the results of a run to the debug output.
+* @param _name [in] Name of the run.
+* @param _before [in] Heap counters before it.
+* @param _workers [in] Workers that ran.
+*/
+PRIVATE void Report(IN string* _name, IN HEAP_STATISTICS* _before, IN dword _workers)
+{
+	HEAP_STATISTICS after;
+	HEAP_GetStatistics(&after);
+
+	dword errors = 0;
+	for(dword i = 0; i < _workers; i++)
+		errors += test_workers[i].errors;
+
+	//Everything back, and every byte of the heap in a block or the fence
+	if(after.used != _before->used)
+		errors++;
+	if(after.used + after.cached + after.free + 8 != after.pages*PAGE_SIZE)
+		errors++;
+
+	string errors_name = STRING("  Errors");
+	string allocations = STRING("  Allocations");
+	string quick = STRING("  From the quick lists");
+	string pages = STRING("  Heap pages");
+	string failures = STRING("  Failed allocations");
+
+	XKY_DEBUG_Message(_name, SRGB(255, 0, 0));
+	XKY_DEBUG_Data(&errors_name, errors, errors ? SRGB(0, 0, 255) : SRGB(0, 255, 0));
+	XKY_DEBUG_Data(&allocations, after.allocations - _before->allocations, SRGB(0, 0, 255));
+	XKY_DEBUG_Data(&quick, after.quick - _before->quick, SRGB(0, 0, 255));
+	XKY_DEBUG_Data(&pages, after.pages, SRGB(0, 0, 255));
+	XKY_DEBUG_Data(&failures, after.failures - _before->failures, SRGB(0, 0, 255));
+}
+
+/**
+* @brief Frees again a block that merged with the free one before it. The heap must ignore it.
+* @param _name [in] Name of the run.
+*/
+PRIVATE void DoubleFree(IN string* _name)
+{
+	//Too large for the quick lists, so they merge at once. The third keeps the second from the free space after
+	VIRTUAL first = HEAP_Alloc(1000);
+	VIRTUAL second = HEAP_Alloc(1000);
+	VIRTUAL third = HEAP_Alloc(1000);
+	VIRTUAL stale = second;
+
+	dword errors = (!first || !second || !third) ? 1 : 0;
+	HEAP_Free(first);
+	HEAP_Free(second);
+
+	HEAP_STATISTICS before;
+	HEAP_GetStatistics(&before);
+	HEAP_Free(stale);
+	HEAP_STATISTICS after;
+	HEAP_GetStatistics(&after);
+	HEAP_Free(third);
+
+	if(after.used != before.used || after.free != before.free || after.frees != before.frees)
+		errors++;
+	if(after.used + after.cached + after.free + 8 != after.pages*PAGE_SIZE)
+		errors++;
+
+	string errors_name = STRING("  Errors");
+	XKY_DEBUG_Message(_name, SRGB(255, 0, 0));
+	XKY_DEBUG_Data(&errors_name, errors, errors ? SRGB(0, 0, 255) : SRGB(0, 255, 0));
+}
+
+/**
+* @brief Resets the workers.
+*/
+PRIVATE void Reset()
+{
+	for(dword i = 0; i < TEST_WORKERS; i++)
+	{
+		for(dword slot = 0; slot < TEST_SLOTS; slot++)
+			test_workers[i].blocks[slot] = 0;
+		test_workers[i].random = 0x1234 + i;
+		test_workers[i].errors = 0;
+		test_workers[i].done = false;
+	}
+	test_started = 0;
+}
+
+PUBLIC void Main()
+{
+	string header = STRING("User heap stress test");
+	string no_rtl = STRING("  RTL not loaded");
+	string alone = STRING("One execution");
+	string together = STRING("Several executions");
+	string merged = STRING("All the free memory in a block");
+	string grown = STRING("  Pages grown");
+	string double_free = STRING("Freed again after merging");
+	XKY_DEBUG_Message(&header, SRGB(255, 0, 0));
+
+	if(!LoadRTL(0x40000000))
+	{
+		XKY_DEBUG_Message(&no_rtl, SRGB(0, 0, 255));
+		XKY_OS_Finish();
+		return;
+	}
+
+	HEAP_STATISTICS before;
+	HEAP_GetStatistics(&before);
+	Reset();
+	Stress(0);
+	Report(&alone, &before, 1);
+
+	HEAP_GetStatistics(&before);
+	Reset();
+	VIRTUAL stacks = XKY_PAGE_Alloc(XKY_ADDRESS_SPACE_GetCurrent(), TEST_STACKS, TEST_WORKERS);
+	if(stacks)
+	{
+		XID workers[TEST_WORKERS];
+		for(dword i = 0; i < TEST_WORKERS; i++)
+		{
+			//One at a time, so each takes its own index
+			workers[i] = XKY_CPU_AllocCode(XID_ANY, XKY_ADDRESS_SPACE_GetCurrent(), (VIRTUAL)Worker, stacks + (i + 1)*PAGE_SIZE);
+			while(workers[i] && test_started == i);
+			if(!workers[i])
+			{
+				test_workers[i].errors++;
+				test_workers[i].done = true;
+				test_started++;
+			}
+		}
+		for(dword i = 0; i < TEST_WORKERS; i++)
+			while(!test_workers[i].done);
+		Report(&together, &before, TEST_WORKERS);
+
+		XKY_PAGE_Free(XKY_ADDRESS_SPACE_GetCurrent(), stacks, TEST_WORKERS);
+	}
+
+	//The freed small blocks merge when nothing else fits
+	HEAP_GetStatistics(&before);
+	VIRTUAL block = HEAP_Alloc(before.free + before.cached - 64);
+	HEAP_STATISTICS after;
+	HEAP_GetStatistics(&after);
+	XKY_DEBUG_Message(&merged, SRGB(255, 0, 0));
+	XKY_DEBUG_Data(&grown, after.pages - before.pages, (block && after.pages == before.pages) ? SRGB(0, 255, 0) : SRGB(0, 0, 255));
+	HEAP_Free(block);
+
+	DoubleFree(&double_free);
+
+	XKY_OS_Finish();
+}
+
+//=================================EXPORTS====================================//
+#pragma data_seg(".exports")
+//============================================================================//
+
+//=================================MODULE=====================================//
+#pragma data_seg(".module")
+//============================================================================//
+	MODULE(IMAGE_MODE_USER, IMAGE_KIND_MODULE, IMAGE_VERSION(1,0,0,0), 0, Main, 0);
@@ -0,0 +1,244 @@
+/******************************************************************************/
+/**
+* @file		MemBench.cpp
+* @brief	XkyOS Memory primitives benchmark
+* Checks RTL_Copy and RTL_Fill, and each of their implementations the CPU has, against byte loops for
+* every size up to a few hundred bytes at every alignment and for sizes around the non temporal
+* threshold, guard bytes around the destiny catching writes out of place. Then measures the throughput
+* of each implementation for blocks that fit in the cache and blocks that do not, and sends the
+* errors and the MB/s to the debug output.
+*
+* @date		20/03/2008
+* @author	Pablo Bravo
+*/
+/******************************************************************************/
+#include "Types.h"
+#include "Executable.h"
+
+//=================================IMPORTS====================================//
+#pragma data_seg(".imports")
+//============================================================================//
+#include "API.h"
+
+//==================================DATA======================================//
+#pragma data_seg(".data")
+//============================================================================//
+#include "RTLStub.h"
+
+#define BENCH_PAGES			512			/*< Pages of the source and of the destiny (2MB)*/
+#define BENCH_SOURCE		0x10000000
+#define BENCH_DESTINY		0x10400000
+#define BENCH_GUARD			16			/*< Bytes checked at each side of the destiny*/
+#define BENCH_GUARD_BYTE	0xAA
+#define BENCH_SMALL			320			/*< Every size below is checked at every alignment*/
+#define BENCH_ALIGNMENTS	8
+#define BENCH_TICKS			18			/*< About a second per measure (18.2 ticks per second)*/
+#define BENCH_DISPATCH		MAX_RTL_IMPLEMENTATIONS	/*< RTL_Copy and RTL_Fill as they choose*/
+
+/**
+* @brief Large sizes checked, around the threshold where the non temporal stores start.
+*/
+PRIVATE dword bench_large_sizes[] = {65535, 65536, 65537, 3*65536 + 31};
+
+/**
+* @brief Block sizes measured: a page, the threshold and a block larger than the caches.
+*/
+PRIVATE dword bench_sizes[] = {4096, 65536, BENCH_PAGES*PAGE_SIZE - PAGE_SIZE};
+
+//==================================CODE======================================//
+#pragma code_seg(".code")
+//============================================================================//
+/**
+* @brief Runs a primitive with an implementation, or as RTL_Copy and RTL_Fill choose it.
+* @param _primitive [in] RTL_COPY or RTL_FILL.
+* @param _implementation [in] RTL_STRING, RTL_SSE2 or BENCH_DISPATCH.
+* @param _destiny [out] Destiny address.
+* @param _origin [in] Source address, or the byte to fill with.
+* @param _size [in] Bytes.
+* @return False if the CPU has not the implementation.
+*/
+PRIVATE bool Run(IN dword _primitive, IN dword _implementation, OUT VIRTUAL _destiny, IN VIRTUAL _origin, IN dword _size)
+{
+	if(_implementation != BENCH_DISPATCH)
+		return RTL_Benchmark(_primitive, _implementation, _destiny, _origin, _size);
+
+	if(_primitive == RTL_COPY)
+		RTL_Copy(_destiny, _origin, _size);
+	else
+		RTL_Fill(_destiny, (byte)_origin, _size);
+	return true;
+}
+
+/**
+* @brief Runs a primitive once and compares the destiny and its guard bytes with what a byte loop leaves.
+* @param _primitive [in] RTL_COPY or RTL_FILL.
+* @param _implementation [in] RTL_STRING, RTL_SSE2 or BENCH_DISPATCH.
+* @param _size [in] Bytes.
+* @param _destiny_offset [in] Offset of the destiny from a page.
+* @param _origin_offset [in] Offset of the source from a page.
+* @return True if the destiny is right.
+*/
+PRIVATE bool Check(IN dword _primitive, IN dword _implementation, IN dword _size, IN dword _destiny_offset, IN dword _origin_offset)
+{
+	byte* guarded = (byte*)(BENCH_DESTINY + _destiny_offset);
+	byte* destiny = guarded + BENCH_GUARD;
+	byte* origin = (byte*)(BENCH_SOURCE + _origin_offset);
+	byte value = (byte)(_size + _destiny_offset);
+
+	for(dword i = 0; i < _size + 2*BENCH_GUARD; i++)
+		guarded[i] = BENCH_GUARD_BYTE;
+
+	Run(_primitive, _implementation, (VIRTUAL)destiny, (_primitive == RTL_COPY) ? (VIRTUAL)origin : (VIRTUAL)value, _size);
+
+	for(dword i = 0; i < BENCH_GUARD; i++)
+	{
+		if(guarded[i] != BENCH_GUARD_BYTE || destiny[_size + i] != BENCH_GUARD_BYTE)
+			return false;
+	}
+	for(dword i = 0; i < _size; i++)
+	{
+		if(destiny[i] != ((_primitive == RTL_COPY) ? origin[i] : value))
+			return false;
+	}
+	return true;
+}
+
+/**
+* @brief Checks a primitive with an implementation and sends the errors to the debug output.
+* @param _primitive [in] RTL_COPY or RTL_FILL.
+* @param _implementation [in] RTL_STRING, RTL_SSE2 or BENCH_DISPATCH.
+* @param _name [in] Name of the primitive.
+*/
+PRIVATE void CheckAll(IN dword _primitive, IN dword _implementation, IN string* _name)
+{
+	dword errors = 0;
+	for(dword size = 0; size < BENCH_SMALL; size++)
+	{
+		for(dword destiny = 0; destiny < BENCH_ALIGNMENTS; destiny++)
+		{
+			for(dword origin = 0; origin < BENCH_ALIGNMENTS; origin++)
+			{
+				if(!Check(_primitive, _implementation, size, destiny, origin))
+					errors++;
+			}
+		}
+	}
+	for(dword i = 0; i < sizeof(bench_large_sizes)/sizeof(dword); i++)
+	{
+		for(dword destiny = 0; destiny < 4; destiny++)
+		{
+			if(!Check(_primitive, _implementation, bench_large_sizes[i], destiny, 3 - destiny))
+				errors++;
+		}
+	}
+
+	XKY_DEBUG_Data(_name, errors, errors ? SRGB(0, 0, 255) : SRGB(0, 255, 0));
+}
+
+/**
+* @brief Runs a primitive with an implementation over and over for a while and sends the MB/s to the
+* debug output.
+* @param _primitive [in] RTL_COPY or RTL_FILL.
+* @param _implementation [in] RTL_STRING or RTL_SSE2.
+* @param _size [in] Bytes per run.
+* @param _name [in] Name of the measure.
+*/
+PRIVATE void Measure(IN dword _primitive, IN dword _implementation, IN dword _size, IN string* _name)
+{
+	//Start with a tick
+	dword start = XKY_TMR_GetTicks();
+	while(XKY_TMR_GetTicks() == start);
+	start++;
+
+	dword kb = 0;
+	while(XKY_TMR_GetTicks() - start < BENCH_TICKS)
+	{
+		Run(_primitive, _implementation, BENCH_DESTINY, (_primitive == RTL_COPY) ? BENCH_SOURCE : 0x5A, _size);
+		kb += _size/1024;
+	}
+	dword ticks = XKY_TMR_GetTicks() - start;
+
+	XKY_DEBUG_Data(_name, (kb*182)/(10*1024*ticks), SRGB(0, 0, 255));
+}
+
+/**
+* @brief Checks and measures an implementation.
+* @param _implementation [in] RTL_STRING, RTL_SSE2 or BENCH_DISPATCH.
+* @param _name [in] Its name.
+*/
+PRIVATE void Bench(IN dword _implementation, IN string* _name)
+{
+	string failed = STRING("  Implementation not available");
+	string copy_errors = STRING("  Copy errors");
+	string fill_errors = STRING("  Fill errors");
+	string copy_speed[] = {STRING("  Copy 4KB MB/s"), STRING("  Copy 64KB MB/s"), STRING("  Copy 2MB MB/s")};
+	string fill_speed[] = {STRING("  Fill 4KB MB/s"), STRING("  Fill 64KB MB/s"), STRING("  Fill 2MB MB/s")};
+
+	XKY_DEBUG_Message(_name, SRGB(255, 0, 0));
+	if(!Run(RTL_COPY, _implementation, BENCH_DESTINY, BENCH_SOURCE, 0))
+	{
+		XKY_DEBUG_Message(&failed, SRGB(0, 0, 255));
+		return;
+	}
+
+	CheckAll(RTL_COPY, _implementation, &copy_errors);
+	CheckAll(RTL_FILL, _implementation, &fill_errors);
+
+	//The way they choose is measured through the others
+	if(_implementation == BENCH_DISPATCH)
+		return;
+
+	for(dword i = 0; i < sizeof(bench_sizes)/sizeof(dword); i++)
+		Measure(RTL_COPY, _implementation, bench_sizes[i], &copy_speed[i]);
+	for(dword i = 0; i < sizeof(bench_sizes)/sizeof(dword); i++)
+		Measure(RTL_FILL, _implementation, bench_sizes[i], &fill_speed[i]);
+}
+
+PUBLIC void Main()
+{
+	string header = STRING("Memory primitives benchmark");
+	string failed = STRING("  No room for the benchmark");
+	string no_rtl = STRING("  RTL not loaded");
+	string dispatch = STRING("RTL_Copy and RTL_Fill");
+	string rep = STRING("REP MOVSD/STOSD");
+	string sse2 = STRING("SSE2 non temporal");
+	XKY_DEBUG_Message(&header, SRGB(255, 0, 0));
+
+	bool loaded = LoadRTL(0x40000000);
+	VIRTUAL source = XKY_PAGE_Alloc(XKY_ADDRESS_SPACE_GetCurrent(), BENCH_SOURCE, BENCH_PAGES);
+	VIRTUAL destiny = XKY_PAGE_Alloc(XKY_ADDRESS_SPACE_GetCurrent(), BENCH_DESTINY, BENCH_PAGES);
+	if(!loaded)
+	{
+		XKY_DEBUG_Message(&no_rtl, SRGB(0, 0, 255));
+	}
+	else if(source && destiny)
+	{
+		//A pattern that does not repeat every dword
+		for(dword i = 0; i < BENCH_PAGES*PAGE_SIZE; i++)
+			((byte*)source)[i] = (byte)(i*7 + i/251);
+
+		Bench(BENCH_DISPATCH, &dispatch);
+		Bench(RTL_STRING, &rep);
+		Bench(RTL_SSE2, &sse2);
+	}
+	else
+	{
+		XKY_DEBUG_Message(&failed, SRGB(0, 0, 255));
+	}
+
+	if(destiny)
+		XKY_PAGE_Free(XKY_ADDRESS_SPACE_GetCurrent(), destiny, BENCH_PAGES);
+	if(source)
+		XKY_PAGE_Free(XKY_ADDRESS_SPACE_GetCurrent(), source, BENCH_PAGES);
+
+	XKY_OS_Finish();
+}
+
+//=================================EXPORTS====================================//
+#pragma data_seg(".exports")
+//============================================================================//
+
+//=================================MODULE=====================================//
+#pragma data_seg(".module")
+//============================================================================//
+	MODULE(IMAGE_MODE_USER, IMAGE_KIND_MODULE, IMAGE_VERSION(1,0,0,0), 0, Main, 0);
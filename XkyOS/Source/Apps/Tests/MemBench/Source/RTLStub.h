@@ -0,0 +1,47 @@
+#ifndef __RTL_STUB_H__
+#define __RTL_STUB_H__
+
+#include "RTL.h"
+
+//==================================DATA======================================//
+#pragma data_seg(".data")
+//============================================================================//
+#define FUNCTION_POINTER(X) f##X X = 0
+
+//Init
+FUNCTION_POINTER(RTL_Init);
+
+//Byte Copy
+FUNCTION_POINTER(RTL_Copy);
+FUNCTION_POINTER(RTL_Fill);
+FUNCTION_POINTER(RTL_Benchmark);
+
+//==================================CODE======================================//
+#pragma code_seg(".code")
+//============================================================================//
+
+#define LoadExportedFunction(Y, X)	string X##_name = STRING(#X); \
+					X = (f##X) XKY_LDR_GetProcedureAddress((Y), &X##_name); \
+					if(!X) return false
+
+PUBLIC bool LoadRTL(VIRTUAL _load_address)
+{
+	string RTL_module = STRING("COMMONS\\RTL.x");
+
+	if(XKY_LDR_LoadUserModule(&RTL_module, XKY_ADDRESS_SPACE_GetCurrent(), _load_address))
+	{
+		//Init
+		LoadExportedFunction(_load_address, RTL_Init);
+
+		//Byte Copy
+		LoadExportedFunction(_load_address, RTL_Copy);
+		LoadExportedFunction(_load_address, RTL_Fill);
+		LoadExportedFunction(_load_address, RTL_Benchmark);
+
+		return RTL_Init();
+	}
+
+	return false;
+}
+
+#endif //__RTL_STUB_H__
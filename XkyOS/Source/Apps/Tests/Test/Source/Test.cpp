@@ -25,6 +25,20 @@ string console = STRING("CONSOLE");
 #define HEIGHT_MARGIN		8
 #define WIDTH_MARGIN		8
 
+#define BENCHMARK_PIXELS	32768	/*< Pixels per run (copy reads as many more)*/
+#define BENCHMARK_PAGES		((2*BENCHMARK_PIXELS*sizeof(ARGB))/PAGE_SIZE)
+#define BENCHMARK_TICKS		9		/*< About half a second (18.2 ticks per second)*/
+
+#define DISK_BENCHMARK_SECTORS	128	/*< Sectors per read (64KB)*/
+#define DISK_BENCHMARK_PAGES	((DISK_BENCHMARK_SECTORS*SECTOR_SIZE)/PAGE_SIZE)
+
+#define STREAM_WAIT_TICKS	18		/*< How long the disk stream has to show up (a second)*/
+
+string stream_module = STRING("TESTS\\DiskStream.x");
+
+#define SHARE_TICKS			55		/*< About three seconds*/
+#define SHARE_XIDS			4		/*< Xids added to the one of the test*/
+
 //==================================CODE======================================//
 #pragma code_seg(".code")
 //============================================================================//
@@ -239,6 +253,98 @@ public:
 	}
 };
 
+/**
+* @brief Measures a pixel row primitive.
+* @param _primitive [in] PIXELS_FILL, PIXELS_COPY or PIXELS_BLEND.
+* @param _implementation [in] PIXELS_STRING, PIXELS_MMX or PIXELS_SSE.
+* @param _buffer [in] Memory for BENCHMARK_PAGES pages.
+* @return MB/s written, zero if the CPU has not the implementation.
+*/
+PRIVATE dword Benchmark(IN dword _primitive, IN dword _implementation, IN VIRTUAL _buffer)
+{
+	//Start at a tick edge
+	dword start = XKY_TMR_GetTicks();
+	while(XKY_TMR_GetTicks() == start);
+	start = XKY_TMR_GetTicks();
+
+	dword runs = 0;
+	while(XKY_TMR_GetTicks() - start < BENCHMARK_TICKS)
+	{
+		if(!XKY_SVGA_Benchmark(_primitive, _implementation, _buffer, BENCHMARK_PIXELS))
+			return 0;
+		runs++;
+	}
+	dword ticks = XKY_TMR_GetTicks() - start;
+
+	return (runs * ((BENCHMARK_PIXELS*sizeof(ARGB))/1024) * 182) / (1024 * 10 * ticks);
+}
+
+/**
+* @brief Measures disk reads.
+* @param _sector [in] First of DISK_BENCHMARK_SECTORS sectors owned.
+* @param _buffer [in] Memory for DISK_BENCHMARK_PAGES pages.
+* @return KB/s read, zero if a read failed.
+*/
+PRIVATE dword DiskBenchmark(IN LBA _sector, IN VIRTUAL _buffer)
+{
+	//Start at a tick edge
+	dword start = XKY_TMR_GetTicks();
+	while(XKY_TMR_GetTicks() == start);
+	start = XKY_TMR_GetTicks();
+
+	dword runs = 0;
+	while(XKY_TMR_GetTicks() - start < BENCHMARK_TICKS)
+	{
+		if(!XKY_DISK_Read(_sector, _buffer, DISK_BENCHMARK_SECTORS))
+			return 0;
+		runs++;
+	}
+	dword ticks = XKY_TMR_GetTicks() - start;
+
+	return (runs * ((DISK_BENCHMARK_SECTORS*SECTOR_SIZE)/1024) * 182) / (10 * ticks);
+}
+
+/**
+* @brief Measures the CPU the test gets, as the times it looks at the clock for a while.
+* @return Number of times.
+*/
+PRIVATE dword Spin()
+{
+	//Start at a tick edge
+	dword start = XKY_TMR_GetTicks();
+	while(XKY_TMR_GetTicks() == start);
+	start = XKY_TMR_GetTicks();
+
+	dword spins = 0;
+	while(XKY_TMR_GetTicks() - start < BENCHMARK_TICKS)
+		spins++;
+
+	return spins;
+}
+
+/**
+* @brief Measures the CPU the test gets while spinning.
+* @return Percentage of the timer ticks that were scheduled on this environment.
+*/
+PRIVATE dword Share()
+{
+	ENVIRONMENT_USAGE usage;
+	ENVIRONMENT_LIMITS limits;
+
+	//Start at a tick edge
+	dword start = XKY_TMR_GetTicks();
+	while(XKY_TMR_GetTicks() == start);
+	start = XKY_TMR_GetTicks();
+
+	XKY_OS_GetAccount(&usage, &limits);
+	dword ticks = usage.ticks;
+
+	while(XKY_TMR_GetTicks() - start < SHARE_TICKS);
+
+	XKY_OS_GetAccount(&usage, &limits);
+	return ((usage.ticks - ticks) * 100) / (XKY_TMR_GetTicks() - start);
+}
+
 PUBLIC void Main()
 {
 	Console c;
@@ -263,6 +369,7 @@ PUBLIC void Main()
 
 		string sok = STRING("Ok!");
 		string sfail = STRING("Failed!");
+		string gap = STRING(" ");
 
 		
 		//Memory
@@ -318,6 +425,245 @@ PUBLIC void Main()
 		XKY_DISK_Free(disk_sector, 2);
 		
 		XKY_PAGE_Free(XKY_ADDRESS_SPACE_GetCurrent(), (VIRTUAL)pages, 2);
+
+		//Disk throughput, by DMA if the disk controller is bus master
+		string DSK_BENCHMARK_HEADER = STRING("Disk read KB/s");
+		c.WriteLn(&DSK_BENCHMARK_HEADER, red);
+
+		VIRTUAL disk_buffer = XKY_PAGE_Alloc(XKY_ADDRESS_SPACE_GetCurrent(), 0x10000000, DISK_BENCHMARK_PAGES);
+		LBA benchmark_sector = XKY_DISK_Alloc(16384, DISK_BENCHMARK_SECTORS);
+		if(disk_buffer && benchmark_sector)
+		{
+			c.WriteNumber(DiskBenchmark(benchmark_sector, disk_buffer), 8, blue);
+			c.NewLine();
+		}
+		else
+		{
+			c.WriteLn(&sfail, blue);
+		}
+
+		//CPU of the test alone and while another environment streams the disk. Waiting for the disk
+		//blocks the reader, so the test should keep most of its CPU. Without a bus master the reader
+		//moves the sectors itself and there is nothing to wait for
+		string STREAM_HEADER = STRING("Spins idle/streaming, requests");
+		c.WriteLn(&STREAM_HEADER, red);
+		{
+			dword idle = Spin();
+
+			DISK_STATISTICS before;
+			DISK_STATISTICS after;
+			XKY_DISK_GetStatistics(&before);
+			bool started = XKY_OS_Start(&stream_module);
+
+			//Measure once its first read is in
+			dword start = XKY_TMR_GetTicks();
+			after = before;
+			while(started && after.requests == before.requests && XKY_TMR_GetTicks() - start < STREAM_WAIT_TICKS)
+				XKY_DISK_GetStatistics(&after);
+			dword streaming = Spin();
+			XKY_DISK_GetStatistics(&after);
+
+			c.WriteNumber(idle, 8, blue);
+			c.Write(&gap, blue);
+			c.WriteNumber(streaming, 8, blue);
+			c.Write(&gap, blue);
+			c.WriteNumber(after.requests - before.requests, 8, blue);
+			c.NewLine();
+
+			if(started && after.requests != before.requests && streaming*4 >= idle*3)
+			{
+				c.WriteLn(&sok, blue);
+			}
+			else
+			{
+				c.WriteLn(&sfail, blue);
+			}
+		}
+		if(benchmark_sector)
+			XKY_DISK_Free(benchmark_sector, DISK_BENCHMARK_SECTORS);
+		if(disk_buffer)
+			XKY_PAGE_Free(XKY_ADDRESS_SPACE_GetCurrent(), disk_buffer, DISK_BENCHMARK_PAGES);
+
+		//Compositor
+		string WND_HEADER = STRING("Compositor frames/pixels/cycles");
+		c.WriteLn(&WND_HEADER, red);
+
+		WINDOW_STATISTICS statistics;
+		XKY_WINDOW_GetStatistics(&statistics);
+		c.WriteNumber(statistics.frames, 8, blue);
+		c.NewLine();
+		c.WriteNumber(statistics.last_pixels, 8, blue);
+		c.NewLine();
+		c.WriteNumber((dword)statistics.last_cycles, 8, blue);
+		c.NewLine();
+		c.WriteNumber((dword)statistics.max_cycles, 8, blue);
+		c.NewLine();
+
+		//Desktop image decoding and time stamp of the first frame
+		string BOOT_HEADER = STRING("Background/desktop cycles");
+		c.WriteLn(&BOOT_HEADER, red);
+		c.WriteNumber((dword)statistics.background_cycles, 8, blue);
+		c.NewLine();
+		c.WriteNumber((dword)(statistics.desktop_cycles >> 32), 8, blue);
+		c.WriteNumber((dword)statistics.desktop_cycles, 8, blue);
+		c.NewLine();
+
+		//Pixel primitives, a line per implementation (rep, MMX, SSE)
+		string PIX_HEADER = STRING("Fill/Copy/Blend MB/s");
+		c.WriteLn(&PIX_HEADER, red);
+
+		VIRTUAL buffer = XKY_PAGE_Alloc(XKY_ADDRESS_SPACE_GetCurrent(), 0x10000000, BENCHMARK_PAGES);
+		if(buffer)
+		{
+			string space = STRING(" ");
+			for(dword implementation = 0; implementation < MAX_PIXELS_IMPLEMENTATIONS; implementation++)
+			{
+				for(dword primitive = PIXELS_FILL; primitive <= PIXELS_BLEND; primitive++)
+				{
+					c.WriteNumber(Benchmark(primitive, implementation, buffer), 4, blue);
+					c.Write(&space, blue);
+				}
+				c.NewLine();
+			}
+			XKY_PAGE_Free(XKY_ADDRESS_SPACE_GetCurrent(), buffer, BENCHMARK_PAGES);
+		}
+		else
+		{
+			c.WriteLn(&sfail, blue);
+		}
+
+		//Window table and layout, the other windows make room for a new one and get it back
+		string WIN_HEADER = STRING("Window alloc/resize");
+		c.WriteLn(&WIN_HEADER, red);
+
+		WINDOW extra = XKY_WINDOW_Alloc();
+		if(extra && XKY_WINDOW_Resize(extra, 0x40, 0x40) && XKY_WINDOW_GetWidth(extra) == 0x40 && XKY_WINDOW_GetHeight(extra) == 0x40)
+		{
+			XKY_WINDOW_Move(extra, 0, 0);
+			c.WriteLn(&sok, blue);
+		}
+		else
+		{
+			c.WriteLn(&sfail, blue);
+		}
+
+		//Input events ring read in place, freeing the window unmaps it
+		string EVT_HEADER = STRING("Events queued/dropped/coalesced");
+		c.WriteLn(&EVT_HEADER, red);
+
+		WINDOW_EVENT_RING* ring = extra?(WINDOW_EVENT_RING*)XKY_WINDOW_MapEvents(extra, XKY_ADDRESS_SPACE_GetCurrent(), 0x10000000):0;
+		if(ring && ring->head - ring->tail <= WINDOW_EVENTS)
+		{
+			while(ring->tail != ring->head)
+			{
+				ring->tail++;
+			}
+			c.WriteLn(&sok, blue);
+		}
+		else
+		{
+			c.WriteLn(&sfail, blue);
+		}
+		XKY_WINDOW_GetStatistics(&statistics);
+		c.WriteNumber(statistics.events, 8, blue);
+		c.NewLine();
+		c.WriteNumber(statistics.dropped, 8, blue);
+		c.NewLine();
+		c.WriteNumber(statistics.coalesced, 8, blue);
+		c.NewLine();
+
+		if(extra)
+			XKY_WINDOW_Free(extra);
+
+		//Worst interrupt handler (vector and cycles) and deferred work
+		string INT_HEADER = STRING("Interrupt/deferred max cycles");
+		c.WriteLn(&INT_HEADER, red);
+
+		INTERRUPT_STATISTICS interrupts;
+		XKY_INTERRUPT_GetStatistics(&interrupts);
+		c.WriteNumber(interrupts.max_vector, 2, blue);
+		c.Write(&gap, blue);
+		c.WriteNumber((dword)interrupts.max_cycles, 8, blue);
+		c.NewLine();
+		c.WriteNumber((dword)interrupts.max_deferred_cycles, 8, blue);
+		c.Write(&gap, blue);
+		c.WriteNumber((dword)interrupts.max_delay_cycles, 8, blue);
+		c.NewLine();
+		c.WriteNumber(interrupts.deferred, 8, blue);
+		c.Write(&gap, blue);
+		c.WriteNumber(interrupts.dropped, 8, blue);
+		c.NewLine();
+
+		//Accounting, then no room for one more window
+		string QUOTA_HEADER = STRING("Pages/sectors/xids/windows, quota");
+		c.WriteLn(&QUOTA_HEADER, red);
+
+		ENVIRONMENT_USAGE usage;
+		ENVIRONMENT_LIMITS limits;
+		XKY_OS_GetAccount(&usage, &limits);
+		c.WriteNumber(usage.pages, 8, blue);
+		c.Write(&gap, blue);
+		c.WriteNumber(usage.sectors, 8, blue);
+		c.NewLine();
+		c.WriteNumber(usage.executions, 8, blue);
+		c.Write(&gap, blue);
+		c.WriteNumber(usage.windows, 8, blue);
+		c.NewLine();
+
+		limits.windows = usage.windows;
+		XKY_OS_SetLimits(&limits);
+		WINDOW over = XKY_WINDOW_Alloc();
+		if(!over)
+		{
+			c.WriteLn(&sok, blue);
+		}
+		else
+		{
+			XKY_WINDOW_Free(over);
+			c.WriteLn(&sfail, blue);
+		}
+
+		//CPU share with one xid, with more xids (same share) and at half weight (less share, as much
+		//less as the other environments running tell)
+		string CPU_HEADER = STRING("CPU % 1 xid/5 xids/half weight");
+		c.WriteLn(&CPU_HEADER, red);
+
+		dword one = Share();
+
+		dword xids = 0;
+		for(dword i = 0; i < SHARE_XIDS; i++)
+		{
+			if(XKY_CPU_Alloc(XID_ANY, XKY_CPU_GetCurrent()))
+				xids++;
+		}
+		dword five = Share();
+
+		XKY_OS_GetAccount(&usage, &limits);
+		limits.weight /= 2;
+		XKY_OS_SetLimits(&limits);
+		dword half = Share();
+
+		c.WriteNumber(one, 2, blue);
+		c.Write(&gap, blue);
+		c.WriteNumber(five, 2, blue);
+		c.Write(&gap, blue);
+		c.WriteNumber(half, 2, blue);
+		c.NewLine();
+
+		//The others weigh (100 - one)/one environments of default weight
+		dword expected = (one * 100) / (200 - one);
+		bool alone = one >= 90;
+		bool same = five + one/4 + 4 >= one && five <= one + one/4 + 4;
+		bool halved = half + expected/4 + 4 >= expected && half <= expected + expected/4 + 4;
+		if(xids == SHARE_XIDS && (alone || (same && halved)))
+		{
+			c.WriteLn(&sok, blue);
+		}
+		else
+		{
+			c.WriteLn(&sfail, blue);
+		}
+		XKY_DEBUG_Environments();
 	}
 
 	//Done
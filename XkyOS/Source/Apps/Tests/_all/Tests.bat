@@ -8,4 +8,16 @@
 @echo Copiando Aplicacion de prueba Multihilo
 @copy .\MtTest\Bin\%1\MtTest.x ..\..\..\WORK\%2\TESTS >> ..\..\..\noout
 
+@echo Copiando Prueba de rendimiento del disco
+@copy .\DiskBench\Bin\%1\DiskBench.x ..\..\..\WORK\%2\TESTS >> ..\..\..\noout
+
+@echo Copiando Carga de lectura del disco
+@copy .\DiskStream\Bin\%1\DiskStream.x ..\..\..\WORK\%2\TESTS >> ..\..\..\noout
+
+@echo Copiando Prueba de rendimiento de la memoria
+@copy .\MemBench\Bin\%1\MemBench.x ..\..\..\WORK\%2\TESTS >> ..\..\..\noout
+
+@echo Copiando Prueba del heap de usuario
+@copy .\HeapTest\Bin\%1\HeapTest.x ..\..\..\WORK\%2\TESTS >> ..\..\..\noout
+
 @cd .\_all
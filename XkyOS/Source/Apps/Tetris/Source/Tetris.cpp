@@ -38,6 +38,10 @@ dword next = 0;
 dword timer = 0;
 
 WINDOW window;
+ARGB* surface = 0;
+dword surface_width = 0;
+
+#define SURFACE_ADDRESS 0x20000000
 
 //==================================CODE======================================//
 #pragma code_seg(".code")
@@ -92,7 +96,10 @@ void PintaCuadrado(dword x, dword y, ARGB color)
 	{
 		for(dword j=0;j<PIXELS;j++)
 		{
-			XKY_WINDOW_SetPixel(window, START_X + x*PIXELS + i, START_Y + y*PIXELS + j, color);
+			if(surface)
+				surface[(START_Y + y*PIXELS + j)*surface_width + START_X + x*PIXELS + i] = color;
+			else
+				XKY_WINDOW_SetPixel(window, START_X + x*PIXELS + i, START_Y + y*PIXELS + j, color);
 		}
 	}
 }
@@ -106,6 +113,9 @@ PRIVATE void Tablero_Pintar(Tablero* t)
 			PintaCuadrado(i, TAB_ROWS - j, t->grid[i][j]);
 		}
 	}
+
+	if(surface)
+		XKY_WINDOW_Present(window);
 }
 
 PRIVATE bool TimerCallback(IN XID _xid, IN EXECUTION* _execution)
@@ -185,6 +195,10 @@ PUBLIC void Main()
 	window = XKY_WINDOW_Alloc();
 	if(!window)	goto _Finish;
 
+	//Draw in memory if we can, one call per frame
+	surface = (ARGB*)XKY_WINDOW_MapSurface(window, XKY_ADDRESS_SPACE_GetCurrent(), SURFACE_ADDRESS);
+	surface_width = XKY_WINDOW_GetWidth(window) + 1;
+
 	//Set random seed
 	SetSeed(XKY_RTC_Seconds() + XKY_TMR_GetTicks());
 
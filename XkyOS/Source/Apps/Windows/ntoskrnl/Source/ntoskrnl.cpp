@@ -225,31 +225,14 @@ PRIVATE bool DrawDesktop(IN WINDOW _window)
 	if(!XKY_LDR_LoadFile(&desktop_image, XKY_ADDRESS_SPACE_GetCurrent(), DESKTOP_IMAGE_ADDRESS))
 		return false;
 
-	//Get window metrics
-	dword width = XKY_WINDOW_GetWidth(window);
-	dword height = XKY_WINDOW_GetHeight(window);
-
-	//Copy BMP File to Background
-	//Jump over BMP header
-	byte* bmp = ((byte*)DESKTOP_IMAGE_ADDRESS + 0x36);
-	for(dword i = 0; i < height; i++)
-	{
-		for(dword j = 0; j < width; j++)
-		{
-			byte B = *bmp;
-			byte G = *(bmp+1);
-			byte R = *(bmp+2);
-			XKY_WINDOW_SetPixel(window, j, i, SRGB(R,G,B));
-			bmp+=3;
-		}
-	}
+	//Copy BMP File to Background, the kernel decodes it a row at a time
+	dword file_size = XKY_LDR_FileSize(&desktop_image);
+	bool drawn = XKY_WINDOW_DrawBitmap(_window, 0, 0, (byte*)DESKTOP_IMAGE_ADDRESS, file_size);
 
 	//Release memory
-	dword file_size = XKY_LDR_FileSize(&desktop_image);
 	XKY_PAGE_Free(XKY_ADDRESS_SPACE_GetCurrent(), DESKTOP_IMAGE_ADDRESS, RTL_BytesToPages(file_size));
 
-	//Ok
-	return true;
+	return drawn;
 }
 
 PUBLIC bool Main()
@@ -24,6 +24,7 @@
 typedef dword ADDRESS_SPACE;
 typedef dword VIRTUAL;
 typedef dword LBA;
+typedef dword DISK_REQUEST;
 typedef dword WINDOW;
 typedef dword ARGB;
 typedef dword POINTER;
@@ -97,6 +98,11 @@ struct INTERRUPT_FRAME
 	dword ss;
 };
 typedef bool (*fInterruptHandler)(IN INTERRUPT_FRAME* _frame);
+struct DISK_STATISTICS;
+struct WINDOW_STATISTICS;
+struct INTERRUPT_STATISTICS;
+struct ENVIRONMENT_USAGE;
+struct ENVIRONMENT_LIMITS;
 
 //==================================CODE======================================//
 #pragma code_seg(".code")
@@ -106,6 +112,13 @@ PUBLIC bool API_EntryPoint()
 	return true;
 }
 
+/*
+* Services are asked with the index in eax and the arguments pushed right to left just below the return
+* address, through the two byte int OS_API_SERVICES. The kernel may run a service again from the same int:
+* a guest blocked on XKY_DISK_Read or XKY_DISK_Write goes back to it with eax set to XKY_DISK_Wait and the
+* request written over the first argument. So the arguments are pushed here, as copies the stub pops
+* whatever the service, and eax is never taken as the service index after the int.
+*/
 #define CALL0(X)	__asm mov eax, X \
 					__asm int OS_API_SERVICES \
 					__asm ret 
@@ -165,6 +178,20 @@ PUBLIC bool API_EntryPoint()
 					__asm pop ebp \
 					__asm ret 20
 
+#define CALL6(X)	__asm push ebp \
+					__asm mov ebp, esp \
+					__asm push dword ptr [ebp + 28] \
+					__asm push dword ptr [ebp + 24] \
+					__asm push dword ptr [ebp + 20] \
+					__asm push dword ptr [ebp + 16] \
+					__asm push dword ptr [ebp + 12] \
+					__asm push dword ptr [ebp + 8] \
+					__asm mov eax, X \
+					__asm int OS_API_SERVICES \
+					__asm add esp, 24 \
+					__asm pop ebp \
+					__asm ret 24
+
 //Memory
 PUBLIC NAKED ADDRESS_SPACE XKY_ADDRESS_SPACE_Alloc()
 {
@@ -223,6 +250,31 @@ PUBLIC NAKED bool XKY_DISK_Write(IN LBA _sector, IN VIRTUAL _memory, IN dword _n
 	CALL3(IDX_XKY_DISK_Write)
 }
 
+PUBLIC NAKED DISK_REQUEST XKY_DISK_Submit(IN LBA _sector, IN VIRTUAL _memory, IN dword _number_of_sectors, IN bool _write)
+{
+	CALL4(IDX_XKY_DISK_Submit)
+}
+
+PUBLIC NAKED dword XKY_DISK_Poll(IN DISK_REQUEST _request)
+{
+	CALL1(IDX_XKY_DISK_Poll)
+}
+
+PUBLIC NAKED bool XKY_DISK_Wait(IN DISK_REQUEST _request)
+{
+	CALL1(IDX_XKY_DISK_Wait)
+}
+
+PUBLIC NAKED bool XKY_DISK_SetScheduler(IN dword _scheduler)
+{
+	CALL1(IDX_XKY_DISK_SetScheduler)
+}
+
+PUBLIC NAKED void XKY_DISK_GetStatistics(OUT DISK_STATISTICS* _statistics)
+{
+	CALL1(IDX_XKY_DISK_GetStatistics)
+}
+
 //Windows
 PUBLIC NAKED WINDOW XKY_WINDOW_Alloc()
 {
@@ -289,6 +341,56 @@ PUBLIC NAKED void XKY_WINDOW_SetPointerColor(IN WINDOW _window, IN ARGB _color)
 	CALL2(IDX_XKY_WINDOW_SetPointerColor)
 }
 
+PUBLIC NAKED VIRTUAL XKY_WINDOW_MapSurface(IN WINDOW _window, IN ADDRESS_SPACE _pdbr, IN VIRTUAL _address)
+{
+	CALL3(IDX_XKY_WINDOW_MapSurface)
+}
+
+PUBLIC NAKED void XKY_WINDOW_Present(IN WINDOW _window)
+{
+	CALL1(IDX_XKY_WINDOW_Present)
+}
+
+PUBLIC NAKED void XKY_WINDOW_GetStatistics(OUT WINDOW_STATISTICS* _statistics)
+{
+	CALL1(IDX_XKY_WINDOW_GetStatistics)
+}
+
+PUBLIC NAKED void XKY_WINDOW_PrintTextOpaque(IN WINDOW _window, IN dword _x, IN dword _y, IN ARGB _foreground, IN ARGB _background, IN string* _text)
+{
+	CALL6(IDX_XKY_WINDOW_PrintTextOpaque)
+}
+
+PUBLIC NAKED void XKY_WINDOW_Scroll(IN WINDOW _window, IN dword _y_low, IN dword _y_high, IN dword _distance, IN ARGB _color)
+{
+	CALL5(IDX_XKY_WINDOW_Scroll)
+}
+
+PUBLIC NAKED bool XKY_WINDOW_DrawBitmap(IN WINDOW _window, IN dword _x, IN dword _y, IN byte* _file, IN dword _size)
+{
+	CALL5(IDX_XKY_WINDOW_DrawBitmap)
+}
+
+PUBLIC NAKED void XKY_WINDOW_Move(IN WINDOW _window, IN dword _x, IN dword _y)
+{
+	CALL3(IDX_XKY_WINDOW_Move)
+}
+
+PUBLIC NAKED bool XKY_WINDOW_Resize(IN WINDOW _window, IN dword _width, IN dword _height)
+{
+	CALL3(IDX_XKY_WINDOW_Resize)
+}
+
+PUBLIC NAKED void XKY_WINDOW_SetLayout(IN dword _layout)
+{
+	CALL1(IDX_XKY_WINDOW_SetLayout)
+}
+
+PUBLIC NAKED VIRTUAL XKY_WINDOW_MapEvents(IN WINDOW _window, IN ADDRESS_SPACE _pdbr, IN VIRTUAL _address)
+{
+	CALL3(IDX_XKY_WINDOW_MapEvents)
+}
+
 //PCI
 PUBLIC NAKED PCI XKY_PCI_Alloc(IN PCI _device)
 {
@@ -445,6 +547,16 @@ PUBLIC NAKED void XKY_OS_Finish()
 	CALL0(IDX_XKY_OS_Finish)
 }
 
+PUBLIC NAKED void XKY_OS_GetAccount(OUT ENVIRONMENT_USAGE* _usage, OUT ENVIRONMENT_LIMITS* _limits)
+{
+	CALL2(IDX_XKY_OS_GetAccount)
+}
+
+PUBLIC NAKED void XKY_OS_SetLimits(IN ENVIRONMENT_LIMITS* _limits)
+{
+	CALL1(IDX_XKY_OS_SetLimits)
+}
+
 //EXCEPTION
 PUBLIC NAKED bool XKY_EXCEPTION_SetHandler(IN byte _exception, IN ADDRESS_SPACE _pdbr, IN fInterruptHandler _handler)
 {
@@ -456,6 +568,11 @@ PUBLIC NAKED void XKY_EXCEPTION_UnsetHandler(IN byte _exception)
 	CALL1(IDX_XKY_EXCEPTION_UnsetHandler)
 }
 
+PUBLIC NAKED void XKY_INTERRUPT_GetStatistics(OUT INTERRUPT_STATISTICS* _statistics)
+{
+	CALL1(IDX_XKY_INTERRUPT_GetStatistics)
+}
+
 //DEBUG
 PUBLIC NAKED void XKY_DEBUG_Message(IN string* _message, IN dword _color)
 {
@@ -467,6 +584,17 @@ PUBLIC NAKED void XKY_DEBUG_Data(IN string* _message, IN dword _data, IN dword _
 	CALL3(IDX_XKY_DEBUG_Data)
 }
 
+PUBLIC NAKED void XKY_DEBUG_Environments()
+{
+	CALL0(IDX_XKY_DEBUG_Environments)
+}
+
+//SVGA
+PUBLIC NAKED bool XKY_SVGA_Benchmark(IN dword _primitive, IN dword _implementation, IN VIRTUAL _buffer, IN dword _count)
+{
+	CALL4(IDX_XKY_SVGA_Benchmark)
+}
+
 //=================================EXPORTS====================================//
 #pragma data_seg(".exports")
 //============================================================================//
@@ -484,6 +612,11 @@ EXPORT(XKY_DISK_Alloc);
 EXPORT(XKY_DISK_Free);
 EXPORT(XKY_DISK_Read);
 EXPORT(XKY_DISK_Write);
+EXPORT(XKY_DISK_Submit);
+EXPORT(XKY_DISK_Poll);
+EXPORT(XKY_DISK_Wait);
+EXPORT(XKY_DISK_SetScheduler);
+EXPORT(XKY_DISK_GetStatistics);
 
 //Windows
 EXPORT(XKY_WINDOW_Alloc);
@@ -499,6 +632,16 @@ EXPORT(XKY_POINTER_GetArrow);
 EXPORT(XKY_POINTER_GetClock);
 EXPORT(XKY_WINDOW_SetPointer);
 EXPORT(XKY_WINDOW_SetPointerColor);
+EXPORT(XKY_WINDOW_MapSurface);
+EXPORT(XKY_WINDOW_Present);
+EXPORT(XKY_WINDOW_GetStatistics);
+EXPORT(XKY_WINDOW_PrintTextOpaque);
+EXPORT(XKY_WINDOW_Scroll);
+EXPORT(XKY_WINDOW_DrawBitmap);
+EXPORT(XKY_WINDOW_Move);
+EXPORT(XKY_WINDOW_Resize);
+EXPORT(XKY_WINDOW_SetLayout);
+EXPORT(XKY_WINDOW_MapEvents);
 
 //PCI
 EXPORT(XKY_PCI_Alloc);
@@ -541,14 +684,21 @@ EXPORT(XKY_LDR_FileSize);
 //OS
 EXPORT(XKY_OS_Start);
 EXPORT(XKY_OS_Finish);
+EXPORT(XKY_OS_GetAccount);
+EXPORT(XKY_OS_SetLimits);
 
 //EXCEPTION
 EXPORT(XKY_EXCEPTION_SetHandler);
 EXPORT(XKY_EXCEPTION_UnsetHandler);
+EXPORT(XKY_INTERRUPT_GetStatistics);
 
 //DEBUG
 EXPORT(XKY_DEBUG_Message);
 EXPORT(XKY_DEBUG_Data);
+EXPORT(XKY_DEBUG_Environments);
+
+//SVGA
+EXPORT(XKY_SVGA_Benchmark);
 
 
 //=================================MODULE=====================================//
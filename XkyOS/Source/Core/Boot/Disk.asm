@@ -77,46 +77,120 @@ LBA2CHS4FLP: ;dword LBA2CHS4FLP(dword lba)
 
 %ifndef BOOTING
 ;;;;;;;;;;;;;;;;;;;;;ReadFromStorage;;;;;;;;;;;;;;;;;;;;
+;;Comments:
+;;	Lee en las transferencias mas grandes que permite la BIOS: pistas enteras en floppy
+;;	y paquetes de hasta 127 sectores en disco, sin cruzar limites de 64KB (DMA)
+%define HD_MAX_SECTORS		0x0000007F
+%define STORAGE_RETRIES		3
 ReadFromStorage: ;dword ReadFromStorage(word lba, word segment, word offset, word how_many)
 	push bp
 	mov bp, sp
 	
-	push bx
-	push cx
-	push dx
+	push ebx
+	push ecx
+	push edx
+	push esi
+	push edi
 
-	mov cx, word [bp+10]	;HowMany
-	jcxz .end
-	
-	mov bx, word [bp+4]	;LBA
-	mov dx, word [bp+8]	;Offset
+	movzx ebx, word [bp+4]	;LBA
+	movzx esi, word [bp+6]	;Direccion lineal = Segment*16 + Offset
+	shl esi, 4
+	movzx eax, word [bp+8]
+	add esi, eax
+	movzx edi, word [bp+10]	;Sectores que quedan
 		
 .read_bucle:
-	push word 1		;HowMany
-	push dx			;Offset
-	push word [bp+6]	;Segment
+	test edi, edi
+	jz .success
+
+	;Sectores hasta el siguiente limite de 64KB
+	mov ecx, esi
+	and ecx, 0x0000FFFF
+	neg ecx
+	add ecx, 0x00010000
+	shr ecx, 9			;Depende del valor de SECTOR_SIZE
+	jnz .limit_to_remaining
+	mov ecx, 1			;Buffer no alineado a sector, no queda otra
+.limit_to_remaining:
+	cmp ecx, edi
+	jbe .limit_to_device
+	mov ecx, edi
+.limit_to_device:
+	fs cmp byte [LP_DISK + DISK_LOADER_DATA.boot_drive], 0x80
+	jnz .limit_to_track
+	cmp ecx, HD_MAX_SECTORS
+	jbe .read_sectors
+	mov ecx, HD_MAX_SECTORS
+	jmp .read_sectors
+.limit_to_track:
+	;Sectores hasta el final de la pista
+	push ecx
+	mov eax, ebx
+	xor edx, edx
+	mov ecx, FLOPPY_SECTORS_PER_TRACK
+	div ecx
+	pop ecx
+	mov eax, FLOPPY_SECTORS_PER_TRACK
+	sub eax, edx
+	cmp ecx, eax
+	jbe .read_sectors
+	mov ecx, eax
+
+.read_sectors:
+	mov dx, STORAGE_RETRIES
+.retry_read:
+	push cx			;HowMany
+	mov eax, esi
+	and ax, 0x000F
+	push ax			;Offset
+	mov eax, esi
+	shr eax, 4
+	push ax			;Segment
 	push bx			;LBA
-	call ReadFromStorageSector
-	
-	add dx, SECTOR_SIZE
-	inc bx
-	dec cx
-	jnz .read_bucle
-	
-.end:
+	call ReadFromStorageSectors
+	test eax, eax
+	jnz .next_read
+
+	;Reiniciamos la unidad y volvemos a intentarlo
+	dec dx
+	jz .error_reading
+	push dx
+	xor ax, ax
+	fs mov dl, byte [LP_DISK + DISK_LOADER_DATA.boot_drive]
+	int 0x13
 	pop dx
-	pop cx
-	pop bx
+	jmp .retry_read
+
+.next_read:
+	add ebx, ecx
+	sub edi, ecx
+	shl ecx, 9			;Depende del valor de SECTOR_SIZE
+	add esi, ecx
+	jmp .read_bucle
+
+.success:
+	mov eax, 1
+	jmp .end
+
+.error_reading:
+	xor eax, eax
+
+.end:
+	pop edi
+	pop esi
+	pop edx
+	pop ecx
+	pop ebx
 	
 	pop bp
 	ret 8
 %endif
 
-;;;;;;;;;;;;;;;;;;;;;ReadFromStorageSector;;;;;;;;;;;;;;;;;;;;
+;;;;;;;;;;;;;;;;;;;;ReadFromStorageSectors;;;;;;;;;;;;;;;;;;;
 %ifdef BOOTING
 ReadFromStorage:	;dword ReadFromStorage(word lba, word segment, word offset, word how_many)
 %else
-ReadFromStorageSector:	;dword ReadFromStorageSector(word lba, word segment, word offset, word how_many)
+ReadFromStorageSectors:	;dword ReadFromStorageSectors(word lba, word segment, word offset, word how_many)
 %endif
 	fs cmp byte [LP_DISK + DISK_LOADER_DATA.boot_drive], 0x80
 	jz .read_from_hd
@@ -29,6 +29,8 @@ ErrorLoadingKernelModulesMsg:	db '[XKYLDR] Error loading kernel modules',13,10,0
 ErrorEnablingA20Msg:		db '[XKYLDR] Error enabling A20 line',13,10,0
 ErrorNoMemoryFoundMsg:		db '[XKYLDR] Error no memory found',13,10,0
 SVGAEnabled: dd 0
+LoaderStartTime:	dd 0, 0	;Time stamp al empezar a leer del disco
+ModulesLoadedTime:	dd 0, 0	;Time stamp con los modulos del nucleo leidos
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;CODE;;;;;;;;;;;;;;;;;;;;;;;;;;;
 	;Error
@@ -59,6 +61,11 @@ loader:
 	mov ds, ax
 	mov es, ax
 
+	;Medimos lo que tardamos en leer del disco
+	rdtsc
+	mov [LoaderStartTime], eax
+	mov [LoaderStartTime+4], edx
+
 	;Create RAM Disk si arrancamos de floppy
 	call CreateRAMDisk
 	test eax, eax
@@ -69,6 +76,10 @@ loader:
 	test eax, eax
 	jz near error_loading_kernel_modules
 
+	rdtsc
+	mov [ModulesLoadedTime], eax
+	mov [ModulesLoadedTime+4], edx
+
 	;Desactivamos las interrupciones
 	cli
 
@@ -156,6 +167,15 @@ prefetch_queue_clean:
 	mov dword [LP_LOADER + LOADER_DATA.memory], LP_DIRECTION_FLAT+LP_MEMORY
 	mov dword [LP_LOADER + LOADER_DATA.svga], LP_DIRECTION_FLAT+LP_SVGA
 
+	mov eax, [LDR_DIRECTION_FLAT + LoaderStartTime]
+	mov [LP_LOADER + LOADER_DATA.loader_start_low], eax
+	mov eax, [LDR_DIRECTION_FLAT + LoaderStartTime + 4]
+	mov [LP_LOADER + LOADER_DATA.loader_start_high], eax
+	mov eax, [LDR_DIRECTION_FLAT + ModulesLoadedTime]
+	mov [LP_LOADER + LOADER_DATA.modules_loaded_low], eax
+	mov eax, [LDR_DIRECTION_FLAT + ModulesLoadedTime + 4]
+	mov [LP_LOADER + LOADER_DATA.modules_loaded_high], eax
+
 	;Montamos la pila en modo protegido
 	mov esp, KERNEL_STACK
 	
@@ -15,57 +15,87 @@ WalkMemory:
 	mov di, LP_DIRECTION_SEGMENT
 	mov es, di
 	mov di, LP_MEMORY + MEMORY_LOADER_DATA_size	;Direccion del descriptor en es:di
-	mov ebx, 0	;Continuacion
-	jmp .start_walking
+	xor ebx, ebx	;Continuacion
 
 .walk_memory:
-	add di, MEMORY_DESCRIPTOR_size
-	fs inc dword [LP_MEMORY + MEMORY_LOADER_DATA.descriptors_number]
-
-.start_walking:
-	mov ax, 0xE820			;Servicio "Query System Address Map"
-	mov cx, MEMORY_DESCRIPTOR_size	;Tamao del buffer
+	mov eax, 0xE820			;Servicio "Query System Address Map"
+	mov ecx, MEMORY_DESCRIPTOR_size	;Tamanyo del buffer
 	mov edx, 'PAMS'			;Comprobacion
 	int 15h
-	jc .error_walking_memory
+	jc .end_walking_memory		;Algunas BIOS acaban con carry en vez de ebx = 0
 	cmp eax, 'PAMS'
 	jnz .error_walking_memory
-	cmp ebx, 0
+
+	;Los descriptores vacios no se guardan
+	es mov eax, [di + MEMORY_DESCRIPTOR.base_length_low]
+	es or eax, [di + MEMORY_DESCRIPTOR.base_length_high]
+	jz .next_descriptor
+
+	;Guardamos el descriptor, tambien el ultimo (el que devuelve ebx = 0)
+	add di, MEMORY_DESCRIPTOR_size
+	fs inc dword [LP_MEMORY + MEMORY_LOADER_DATA.descriptors_number]
+	fs cmp dword [LP_MEMORY + MEMORY_LOADER_DATA.descriptors_number], MEMORY_MAX_DESCRIPTORS
+	jae .end_walking_memory
+
+.next_descriptor:
+	test ebx, ebx
 	jnz .walk_memory
 	
 .end_walking_memory:
 	pop es
+	;Solo es un error no tener ningun descriptor
+	fs cmp dword [LP_MEMORY + MEMORY_LOADER_DATA.descriptors_number], 0
+	jz .no_memory_map
 	mov eax, 1
 	ret
 	
 .error_walking_memory:
 	pop es
+.no_memory_map:
 	xor eax, eax
 	ret
 
 ;;;;;;;;;;;;;;;;;DetectAvailableMemory;;;;;;;;;;;;;;;;;;
+;;Comments:
+;;	Basta con que funcione uno de los dos servicios, sin mapa (E820) el nucleo usa el
+;;	tamanyo (E801)
 DetectAvailableMemory:
 	pushad
+	fs mov dword [LP_MEMORY + MEMORY_LOADER_DATA.size_in_megas], 0
 
 	;Preguntamos por el tamanyo de la memoria
 	xor eax, eax
 	xor ebx, ebx
+	xor ecx, ecx
+	xor edx, edx
 	mov ax, 0xE801
 	int 15h
-	jc .error_detecting_memory
-	
+	jc .walk_memory_map
+
+	;Algunas BIOS lo devuelven en cx/dx
+	test ax, ax
+	jnz .size_in_ax
+	mov ax, cx
+	mov bx, dx
+
+.size_in_ax:
 	shr ax, 10	;KB to MB
 	shr bx, 4	;64KB to MB
 	add eax, ebx
 	inc eax		;Add first MB
 
-	;En eax el tamao en megas de la memoria
+	;En eax el tamanyo en megas de la memoria
 	fs mov [LP_MEMORY + MEMORY_LOADER_DATA.size_in_megas], eax
 	
+.walk_memory_map:
 	call WalkMemory
 	test ax, ax
+	jnz .success
+
+	fs cmp dword [LP_MEMORY + MEMORY_LOADER_DATA.size_in_megas], 0
 	jz .error_detecting_memory
 
+.success:
 	popad
 	mov eax, 1
 	ret
@@ -150,40 +150,14 @@ LoadKernelModule:
 	call ToFlatPointer
 	fs mov dword [si + XFS_ENTRY.direction], eax
 
-	;Guardamos en edx el numero de sectores para ir decrementando
-	mov edx, ecx	
-	jmp .read_file
-
-.next_reading_iteration:	
-	;Actualizamos el puntero
-	;mov di, gs
-	;add di, PAGE_SIZE
-	;mov gs, di
-	;xor di, di
-	mov di, gs
-	add di, 0x900
-	mov gs, di
-	xor di, di
-	
-	;Hay que leerlo en trozos de 64KB (128 sectores)
-.read_file:
-	;Ajustamos a 64KB (128 sectores)
-	cmp edx, MAX_SECTORS_PER_SEGMENT
-	jle .do_read
-	mov edx, MAX_SECTORS_PER_SEGMENT
-.do_read:	
-	push dx		;Cuantos sectores
+	;Leemos el fichero de una vez, ReadFromStorage lo parte segun la BIOS
+	push cx		;Cuantos sectores
 	push di		;Donde lo dejamos
 	push gs		;Donde lo dejamos
 	push bx		;De donde leemos
 	call ReadFromStorage
 	test ax, ax
 	jz near .error_loading_module
-
-	add ebx, edx
-	sub ecx, edx
-	mov edx, ecx
-	jnz .next_reading_iteration
 	
 	;Todo OK
 	popad
@@ -53,6 +53,9 @@ BOUNDED_STRING(show_key, 1, 1);
 BOUNDED_STRING(command_line, 255, 0);
 string extension = STRING(".x");
 
+//Built in commands
+string account_command = STRING("account");
+
 byte n_row[] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9'};
 byte q_row[] = {'q', 'w', 'e', 'r', 't', 'y', 'u', 'i', 'o', 'p'};
 byte Q_row[] = {'Q', 'W', 'E', 'R', 'T', 'Y', 'U', 'I', 'O', 'P'};
@@ -154,6 +157,46 @@ byte KEY_Translate(IN dword _scan_code)
 	return 0;
 }
 
+void AccountLine(IN string* _name, IN dword _usage, IN dword _limit)
+{
+	string separator = STRING(" / ");
+
+	//Red once the resource is exhausted
+	CONSOLE_Write(_name, SRGB(0, 0, 255));
+	CONSOLE_WriteNumber(_usage, 8, (_usage >= _limit)?SRGB(255, 0, 0):SRGB(0, 0, 255));
+	CONSOLE_Write(&separator, SRGB(0, 0, 255));
+	CONSOLE_WriteNumber(_limit, 8, SRGB(0, 0, 255));
+	CONSOLE_NewLine();
+}
+
+void AccountCommand()
+{
+	ENVIRONMENT_USAGE usage;
+	ENVIRONMENT_LIMITS limits;
+	XKY_OS_GetAccount(&usage, &limits);
+
+	//Own usage and limits
+	string pages = STRING("Pages      ");
+	string sectors = STRING("Sectors    ");
+	string executions = STRING("Executions ");
+	string windows = STRING("Windows    ");
+	string ticks = STRING("Ticks      ");
+	string syscalls = STRING("Syscalls   ");
+	AccountLine(&pages, usage.pages, limits.pages);
+	AccountLine(&sectors, usage.sectors, limits.sectors);
+	AccountLine(&executions, usage.executions, limits.executions);
+	AccountLine(&windows, usage.windows, limits.windows);
+	CONSOLE_Write(&ticks, SRGB(0, 0, 255));
+	CONSOLE_WriteNumber(usage.ticks, 8, SRGB(0, 0, 255));
+	CONSOLE_NewLine();
+	CONSOLE_Write(&syscalls, SRGB(0, 0, 255));
+	CONSOLE_WriteNumber(usage.syscalls, 8, SRGB(0, 0, 255));
+	CONSOLE_NewLine();
+
+	//Every environment goes to the debug output
+	XKY_DEBUG_Environments();
+}
+
 void ConsoleKeyboardCallback(IN dword _scan_code)
 {
 	//Check for ENTER
@@ -162,7 +205,11 @@ void ConsoleKeyboardCallback(IN dword _scan_code)
 		if(!IS_DEPRESSED(_scan_code))
 		{
 			CONSOLE_NewLine();
-			if(command_line->size)
+			if(STRING_Compare(command_line, &account_command))
+			{
+				AccountCommand();
+			}
+			else if(command_line->size)
 			{
 				//Try to execute
 				STRING_Append(command_line, &extension);
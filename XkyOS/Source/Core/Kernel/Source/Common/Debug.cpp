@@ -159,7 +159,11 @@ PRIVATE void DEBUG_Write(IN string* _text, IN ARGB _color)
 {
 	if(_text->size && (debug_x + _text->size * CHARACTER_WIDTH < debug_width - WIDTH_MARGIN))
 	{
-		WINDOW_PrintText(debug_window, debug_x, debug_y, _color, _text);
+		//Solid backgrounds are drawn with the text, from the glyph atlas
+		if(COLOR_IsSolid(debug_color))
+			WINDOW_PrintTextOpaque(debug_window, debug_x, debug_y, _color, debug_color, _text);
+		else
+			WINDOW_PrintText(debug_window, debug_x, debug_y, _color, _text);
 		debug_x += _text->size * CHARACTER_WIDTH;
 	}
 }
@@ -187,9 +191,37 @@ PRIVATE void DEBUG_NewLine()
 {
 	debug_x = WIDTH_MARGIN;
 
-	debug_y -= CHARACTER_HEIGHT;
-	if(debug_y <= HEIGHT_MARGIN)
-		debug_y = debug_height - HEIGHT_MARGIN;
+	//The window may have been tiled again, its top rows are kept
+	dword height = WINDOW_GetHeight(debug_window);
+	dword width = WINDOW_GetWidth(debug_window);
+	if(height != debug_height || width != debug_width)
+	{
+		dword from_top = debug_height - debug_y;
+		debug_height = height;
+		debug_width = width;
+		debug_y = (from_top + HEIGHT_MARGIN + CHARACTER_HEIGHT < debug_height)?(debug_height - from_top):(HEIGHT_MARGIN + CHARACTER_HEIGHT);
+	}
+
+	//Last line, move the text up
+	if(debug_y - CHARACTER_HEIGHT <= HEIGHT_MARGIN)
+		WINDOW_Scroll(debug_window, HEIGHT_MARGIN + 1, debug_height - HEIGHT_MARGIN, CHARACTER_HEIGHT, debug_color);
+	else
+		debug_y -= CHARACTER_HEIGHT;
+}
+
+/**
+* @brief Goes to the next line when writing straight to the screen, moving the screen rows up when
+* the bottom is reached.
+*/
+PRIVATE void DEBUG_ScreenNewLine()
+{
+	if(debug_y < 2*UNINIT_CHARACTER_HEIGHT)
+	{
+		SVGA_ScrollUp(0, 0, SVGA_GetWidth(), UNINIT_HEIGHT_START + 1, UNINIT_CHARACTER_HEIGHT);
+		SVGA_Fill(0, 0, SVGA_GetWidth(), debug_y + 1, SRGB(0, 0, 0));
+	}
+	else
+		debug_y -= UNINIT_CHARACTER_HEIGHT;
 }
 
 /**
@@ -247,7 +279,7 @@ PUBLIC void	DEBUG_Message(IN string* _message, IN ARGB _color)
 	else
 	{
 		SVGA_PrintText(UNINIT_WIDTH_START, debug_y, _color, _message);
-		debug_y -= UNINIT_CHARACTER_HEIGHT;
+		DEBUG_ScreenNewLine();
 	}
 #endif
 }
@@ -273,9 +305,7 @@ PUBLIC void	DEBUG_Data(IN string* _message, IN dword _data, IN ARGB _color)
 		STRING_ToString(&buffer, _data, 8);
 		SVGA_PrintText(UNINIT_WIDTH_START, debug_y, _color, _message);
 		SVGA_PrintText(UNINIT_WIDTH_START + _message->size*CHARACTER_WIDTH + 1, debug_y, _color, &buffer);
-		debug_y -= UNINIT_CHARACTER_HEIGHT;
-		if(debug_y < UNINIT_CHARACTER_HEIGHT)
-			debug_y = UNINIT_HEIGHT_START;
+		DEBUG_ScreenNewLine();
 	}
 #endif
 }
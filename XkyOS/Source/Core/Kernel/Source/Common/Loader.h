@@ -68,6 +68,8 @@
 		DISK_LOADER_DATA*	disk;
 		MEMORY_LOADER_DATA*	memory;
 		SVGA_LOADER_DATA*	svga;
+		qword				loader_start;	/*< Time stamp when the loader started reading the disk*/
+		qword				modules_loaded;	/*< Time stamp when the kernel modules were read*/
 	};
 
 #endif //__LOADER_H__
@@ -0,0 +1,604 @@
+/******************************************************************************/
+/**
+* @file		AHCI.cpp
+* @brief	XkyOS Hardware AHCI Library
+* Implementation of the SATA host bus adapter driver. The first port with a disk attached is used.
+* With native command queuing several transfers are given to the disk at once, each in its own
+* command slot (its tag), and the disk ends them in the order it likes; without it, one at a time.
+*
+* @date		20/03/2008
+* @author	Pablo Bravo
+*/
+/******************************************************************************/
+#include "Types.h"
+#include "System.h"
+#include "Memory.h"
+#include "PCI.h"
+#include "Interrupts.h"
+#include "AHCI.h"
+
+//==================================DATA======================================//
+#pragma data_seg(".data")
+//============================================================================//
+#define AHCI_CAP				0x00		/**< HBA registers*/
+#define AHCI_GHC				0x04
+#define AHCI_IS					0x08
+#define AHCI_PI					0x0C
+#define AHCI_CAP_NCQ			0x40000000
+#define AHCI_GHC_IE				0x00000002
+#define AHCI_GHC_AE				0x80000000
+
+#define AHCI_PORT(X)			(0x100 + ahci.port*0x80 + (X))	/**< Registers of the port in use*/
+#define AHCI_PxCLB				0x00
+#define AHCI_PxCLBU				0x04
+#define AHCI_PxFB				0x08
+#define AHCI_PxFBU				0x0C
+#define AHCI_PxIS				0x10
+#define AHCI_PxIE				0x14
+#define AHCI_PxCMD				0x18
+#define AHCI_PxTFD				0x20
+#define AHCI_PxSIG				0x24
+#define AHCI_PxSSTS				0x28
+#define AHCI_PxSERR				0x30
+#define AHCI_PxSACT				0x34
+#define AHCI_PxCI				0x38
+
+#define AHCI_PxCMD_ST			0x00000001
+#define AHCI_PxCMD_FRE			0x00000010
+#define AHCI_PxCMD_FR			0x00004000
+#define AHCI_PxCMD_CR			0x00008000
+#define AHCI_PxIS_DONE			0x0000000F	/**< Register, PIO setup, DMA setup and set device bits FIS received*/
+#define AHCI_PxIS_ERRORS		0x78000000	/**< Task file, host bus fatal, host bus data and interface fatal errors*/
+#define AHCI_PxTFD_ERR			0x01
+#define AHCI_PxTFD_DRQ			0x08
+#define AHCI_PxTFD_DF			0x20
+#define AHCI_PxTFD_BSY			0x80
+#define AHCI_SIGNATURE_ATA		0x00000101
+#define AHCI_SSTS_ACTIVE		0x00000103	/**< Device present and communicating, interface active*/
+
+#define ATA_IDENTIFY			0xEC
+#define ATA_READ_DMA_EXT		0x25
+#define ATA_WRITE_DMA_EXT		0x35
+#define ATA_READ_FPDMA			0x60
+#define ATA_WRITE_FPDMA			0x61
+
+#define AHCI_FIS_H2D			0x27
+#define AHCI_FIS_COMMAND		0x80
+#define AHCI_PRDT_MAX			56			/**< Regions of a command, so a command table is 1KB*/
+#define AHCI_TIMEOUT			0x04000000	/**< Polls before giving up a command*/
+
+/**
+* @brief Command header, an entry of the command list.
+*/
+struct AHCI_COMMAND_HEADER
+{
+	dword			flags;		/*< FIS length in dwords, write bit (6) and regions in the high word*/
+	volatile dword	bytes;		/*< Transferred*/
+	PHYSICAL		table;
+	dword			table_high;
+	dword			reserved[4];
+};
+
+#define AHCI_HEADER_WRITE		0x00000040
+
+/**
+* @brief Host to device register FIS, how a command goes to the disk.
+*/
+struct AHCI_FIS
+{
+	byte	type;
+	byte	flags;
+	byte	command;
+	byte	feature_low;
+	byte	lba0;
+	byte	lba1;
+	byte	lba2;
+	byte	device;
+	byte	lba3;
+	byte	lba4;
+	byte	lba5;
+	byte	feature_high;
+	word	count;
+	byte	icc;
+	byte	control;
+	dword	reserved;
+};
+
+/**
+* @brief Physical region of a command.
+*/
+struct AHCI_PRDT
+{
+	PHYSICAL	address;
+	dword		address_high;
+	dword		reserved;
+	dword		count;		/*< Bytes minus one*/
+};
+
+/**
+* @brief Command table, a command and its regions.
+*/
+struct AHCI_COMMAND_TABLE
+{
+	byte		fis[64];
+	byte		atapi[16];
+	byte		reserved[48];
+	AHCI_PRDT	prdt[AHCI_PRDT_MAX];
+};
+
+#define AHCI_LIST_OFFSET		0x000		/**< Layout of the first page: command list (1KB aligned)*/
+#define AHCI_FIS_OFFSET			0x400		/**< Received FISes (256 bytes aligned)*/
+#define AHCI_IDENTIFY_OFFSET	0x800		/**< Identify data*/
+#define AHCI_MEMORY_PAGES		(1 + (AHCI_MAX_TAGS*sizeof(AHCI_COMMAND_TABLE))/PAGE_SIZE)
+
+/**
+* @brief The host bus adapter and the port of the disk.
+*/
+struct AHCI
+{
+	PHYSICAL			registers;	/*< ABAR, identity mapped, zero if there is no disk*/
+	dword				port;
+	PHYSICAL			memory;		/*< Command list, received FISes, then a command table per tag*/
+	dword				tags;		/*< Commands in flight at most*/
+	bool				ncq;		/*< Native command queuing, else one command at a time*/
+	dword				sectors;	/*< Size of the disk*/
+	volatile dword		busy;		/*< Tags of AHCI_StartTransfer in flight*/
+	fHDCompletion		completion;	/*< Told when each ends*/
+	volatile bool		executing;	/*< AHCI_Execute is polling slot 0*/
+	volatile bool		failed;		/*< The interrupt took an error of it*/
+};
+
+PRIVATE AHCI ahci = {0, 0, 0, 0, false, 0, 0, 0, false, false};
+
+//==================================CODE======================================//
+#pragma code_seg(".code")
+//============================================================================//
+/**
+* @brief Reads a register of the HBA.
+* @param _offset [in] Offset of the register.
+* @return Its value.
+*/
+PRIVATE dword AHCI_Read(IN dword _offset)
+{
+	return *(volatile dword*)(ahci.registers + _offset);
+}
+
+/**
+* @brief Writes a register of the HBA.
+* @param _offset [in] Offset of the register.
+* @param _value [in] The value.
+*/
+PRIVATE void AHCI_Write(IN dword _offset, IN dword _value)
+{
+	*(volatile dword*)(ahci.registers + _offset) = _value;
+}
+
+/**
+* @brief Waits until some bits of a port register are clear.
+* @param _offset [in] Offset of the register within the port.
+* @param _bits [in] The bits.
+* @return True if they cleared in time.
+*/
+PRIVATE bool AHCI_WaitClear(IN dword _offset, IN dword _bits)
+{
+	for(dword i = 0; i < AHCI_TIMEOUT; i++)
+	{
+		if(!(AHCI_Read(AHCI_PORT(_offset)) & _bits))
+			return true;
+	}
+	return false;
+}
+
+/**
+* @brief Stops the port from processing the command list.
+*/
+PRIVATE void AHCI_StopPort()
+{
+	AHCI_Write(AHCI_PORT(AHCI_PxCMD), AHCI_Read(AHCI_PORT(AHCI_PxCMD)) & ~AHCI_PxCMD_ST);
+	AHCI_WaitClear(AHCI_PxCMD, AHCI_PxCMD_CR);
+	AHCI_Write(AHCI_PORT(AHCI_PxCMD), AHCI_Read(AHCI_PORT(AHCI_PxCMD)) & ~AHCI_PxCMD_FRE);
+	AHCI_WaitClear(AHCI_PxCMD, AHCI_PxCMD_FR);
+}
+
+/**
+* @brief Lets the port process the command list, once errors are cleared and the disk is idle.
+* @return True if the disk is ready.
+*/
+PRIVATE bool AHCI_StartPort()
+{
+	AHCI_Write(AHCI_PORT(AHCI_PxSERR), 0xFFFFFFFF);
+	AHCI_Write(AHCI_PORT(AHCI_PxIS), 0xFFFFFFFF);
+	AHCI_Write(AHCI_PORT(AHCI_PxCMD), AHCI_Read(AHCI_PORT(AHCI_PxCMD)) | AHCI_PxCMD_FRE);
+	if(!AHCI_WaitClear(AHCI_PxTFD, AHCI_PxTFD_BSY | AHCI_PxTFD_DRQ))
+		return false;
+
+	AHCI_Write(AHCI_PORT(AHCI_PxCMD), AHCI_Read(AHCI_PORT(AHCI_PxCMD)) | AHCI_PxCMD_ST);
+	return true;
+}
+
+/**
+* @brief Fills the command slot of a tag.
+* @param _tag [in] The tag.
+* @param _command [in] ATA command.
+* @param _lba [in] First sector.
+* @param _number_of_sectors [in] Sectors.
+* @param _prd [in] Regions of the buffer.
+* @param _entries [in] Number of regions.
+* @param _write [in] True if the data goes to the disk.
+* @return False if the regions don't fit.
+*/
+PRIVATE bool AHCI_Build(IN dword _tag, IN byte _command, IN LBA _lba, IN dword _number_of_sectors, IN HD_PRD* _prd, IN dword _entries, IN bool _write)
+{
+	if(!_entries || _entries > AHCI_PRDT_MAX)
+		return false;
+
+	AHCI_COMMAND_HEADER* header = (AHCI_COMMAND_HEADER*)(ahci.memory + AHCI_LIST_OFFSET) + _tag;
+	AHCI_COMMAND_TABLE* table = (AHCI_COMMAND_TABLE*)(ahci.memory + PAGE_SIZE) + _tag;
+
+	for(dword i = 0; i < sizeof(table->fis)/sizeof(dword); i++)
+		((dword*)table->fis)[i] = 0;
+
+	//Queued commands carry the count in the features and the tag in the count
+	AHCI_FIS* fis = (AHCI_FIS*)table->fis;
+	bool queued = (_command == ATA_READ_FPDMA || _command == ATA_WRITE_FPDMA);
+	fis->type = AHCI_FIS_H2D;
+	fis->flags = AHCI_FIS_COMMAND;
+	fis->command = _command;
+	fis->device = 0x40;
+	fis->lba0 = (byte)_lba;
+	fis->lba1 = (byte)(_lba >> 8);
+	fis->lba2 = (byte)(_lba >> 16);
+	fis->lba3 = (byte)(_lba >> 24);
+	fis->feature_low = queued ? (byte)_number_of_sectors : 0;
+	fis->feature_high = queued ? (byte)(_number_of_sectors >> 8) : 0;
+	fis->count = queued ? (word)(_tag << 3) : (word)_number_of_sectors;
+
+	for(dword i = 0; i < _entries; i++)
+	{
+		dword bytes = _prd[i].count & 0xFFFF;
+		table->prdt[i].address = _prd[i].address;
+		table->prdt[i].address_high = 0;
+		table->prdt[i].reserved = 0;
+		table->prdt[i].count = (bytes ? bytes : HD_PRD_LIMIT) - 1;
+	}
+
+	header->flags = (sizeof(AHCI_FIS)/sizeof(dword)) | (_write ? AHCI_HEADER_WRITE : 0) | (_entries << 16);
+	header->bytes = 0;
+	header->table = (PHYSICAL)table;
+	header->table_high = 0;
+	return true;
+}
+
+/**
+* @brief Runs a command in slot 0 and polls until it ends. No other command may be in flight, nor start
+* until it ends: slot 0 is also tag 0, and the disk can't mix queued commands with others.
+* @return True if the disk did it without errors, false too if some tag is in flight.
+*/
+PRIVATE bool AHCI_Execute()
+{
+	if(ahci.busy)
+		return false;
+
+	ahci.failed = false;
+	ahci.executing = true;
+	AHCI_Write(AHCI_PORT(AHCI_PxCI), 0x01);
+
+	//The interrupt may take the status away, then it says so
+	bool ok = false;
+	for(dword i = 0; i < AHCI_TIMEOUT; i++)
+	{
+		dword tfd = AHCI_Read(AHCI_PORT(AHCI_PxTFD));
+		if(ahci.failed || (AHCI_Read(AHCI_PORT(AHCI_PxIS)) & AHCI_PxIS_ERRORS) || (tfd & (AHCI_PxTFD_ERR | AHCI_PxTFD_DF)))
+			break;
+		if(!(AHCI_Read(AHCI_PORT(AHCI_PxCI)) & 0x01))
+		{
+			ok = true;
+			break;
+		}
+	}
+
+	dword status = AHCI_Read(AHCI_PORT(AHCI_PxIS));
+	AHCI_Write(AHCI_PORT(AHCI_PxIS), status);
+	AHCI_Write(AHCI_IS, 1 << ahci.port);
+
+	if(!ok)
+	{
+		AHCI_StopPort();
+		AHCI_StartPort();
+	}
+	ahci.executing = false;
+	return ok;
+}
+
+/**
+* @brief Ends the commands of the given tags and tells their owner.
+* @param _tags [in] The tags.
+* @param _ok [in] True if they went well.
+*/
+PRIVATE void AHCI_Complete(IN dword _tags, IN bool _ok)
+{
+	for(dword tag = 0; tag < AHCI_MAX_TAGS; tag++)
+	{
+		if(_tags & (1 << tag))
+		{
+			ahci.busy &= ~(1 << tag);
+
+			//May start another command with the same tag
+			if(ahci.completion)
+				ahci.completion(tag, _ok);
+		}
+	}
+}
+
+/**
+* @brief Ends the commands of AHCI_StartTransfer the disk is done with. After an error the port is
+* restarted and all those in flight fail, the disk drops its queue anyway.
+* @return True if none is in flight any more.
+*/
+PRIVATE bool AHCI_Poll()
+{
+	if(!ahci.busy)
+		return true;
+
+	//Acknowledge before looking, so a command that ends meanwhile interrupts again
+	dword status = AHCI_Read(AHCI_PORT(AHCI_PxIS));
+	AHCI_Write(AHCI_PORT(AHCI_PxIS), status);
+	AHCI_Write(AHCI_IS, 1 << ahci.port);
+
+	if(status & AHCI_PxIS_ERRORS)
+	{
+		dword failed = ahci.busy;
+		AHCI_StopPort();
+		AHCI_StartPort();
+		AHCI_Complete(failed, false);
+	}
+	else
+	{
+		AHCI_Complete(ahci.busy & ~(AHCI_Read(AHCI_PORT(AHCI_PxSACT)) | AHCI_Read(AHCI_PORT(AHCI_PxCI))), true);
+	}
+	return !ahci.busy;
+}
+
+/**
+* @brief HBA interrupt. Ends the commands the disk is done with.
+* @param _frame [in] Interrupt frame.
+* @return True if call chain can be continued.
+*/
+PRIVATE bool INTERRUPT AHCI_Interrupt(IN INTERRUPT_FRAME* _frame)
+{
+	if(AHCI_Read(AHCI_IS) & (1 << ahci.port))
+	{
+		if(!AHCI_Poll())
+			return true;
+
+		//Not ours. Errors are acknowledged too or they would interrupt again and again; AHCI_Execute is
+		//told and restarts the port itself, else it is restarted here
+		dword status = AHCI_Read(AHCI_PORT(AHCI_PxIS)) & (AHCI_PxIS_DONE | AHCI_PxIS_ERRORS);
+		AHCI_Write(AHCI_PORT(AHCI_PxIS), status);
+		AHCI_Write(AHCI_IS, 1 << ahci.port);
+		if(status & AHCI_PxIS_ERRORS)
+		{
+			if(ahci.executing)
+			{
+				ahci.failed = true;
+			}
+			else
+			{
+				AHCI_StopPort();
+				AHCI_StartPort();
+			}
+		}
+	}
+	return true;
+}
+
+/**
+* @brief Asks the disk who it is, to learn its size and whether it queues commands.
+* @return True if it answered.
+*/
+PRIVATE bool AHCI_Identify()
+{
+	HD_PRD prd;
+	prd.address = ahci.memory + AHCI_IDENTIFY_OFFSET;
+	prd.count = SECTOR_SIZE;
+	if(!AHCI_Build(0, ATA_IDENTIFY, 0, 0, &prd, 1, false) || !AHCI_Execute())
+		return false;
+
+	word* identify = (word*)(ahci.memory + AHCI_IDENTIFY_OFFSET);
+
+	//LBA48 size (words 100 to 103) if supported (word 83 bit 10), LBA28 size (words 60 and 61) if not
+	ahci.sectors = identify[60] | ((dword)identify[61] << 16);
+	if(identify[83] & 0x0400)
+	{
+		ahci.sectors = identify[100] | ((dword)identify[101] << 16);
+		if(identify[102] || identify[103])
+			ahci.sectors = 0xFFFFFFFF;
+	}
+
+	//Queue depth minus one in word 75, support in word 76 bit 8
+	dword slots = ((AHCI_Read(AHCI_CAP) >> 8) & 0x1F) + 1;
+	ahci.ncq = (AHCI_Read(AHCI_CAP) & AHCI_CAP_NCQ) && (identify[76] & 0x0100);
+	ahci.tags = 1;
+	if(ahci.ncq)
+	{
+		ahci.tags = (identify[75] & 0x1F) + 1;
+		if(ahci.tags > slots)
+			ahci.tags = slots;
+	}
+	return ahci.sectors != 0;
+}
+
+/**
+* @brief Looks for an AHCI host bus adapter with a disk, maps its registers and prepares the port of the disk.
+* @return True if the disk can be used.
+*/
+PUBLIC bool AHCI_Init()
+{
+	for(dword i = 0; i < PCI_GetNumberOfDevices(); i++)
+	{
+		PCI device = PCI_GetDevice(i);
+
+		//Mass storage (0x01), SATA (0x06), AHCI (0x01)
+		if(PCI_ReadByte(device, 0x0B) != 0x01 || PCI_ReadByte(device, 0x0A) != 0x06 || PCI_ReadByte(device, 0x09) != 0x01)
+			continue;
+
+		//BAR5 (ABAR) has the registers in memory space
+		dword abar = PCI_ReadDword(device, 0x24);
+		if((abar & 0x01) || !(abar & 0xFFFFF000))
+			continue;
+
+		//Enable memory decoding and bus mastering, and the interrupt line
+		PCI_WriteWord(device, 0x04, (word)((PCI_ReadWord(device, 0x04) | 0x0006) & ~0x0400));
+
+		ahci.registers = abar & 0xFFFFF000;
+		MEM_MapDevice(ahci.registers, AHCI_REGISTERS_PAGES*PAGE_SIZE);
+		AHCI_Write(AHCI_GHC, AHCI_Read(AHCI_GHC) | AHCI_GHC_AE);
+
+		//First port with a disk
+		dword implemented = AHCI_Read(AHCI_PI);
+		bool found = false;
+		for(ahci.port = 0; ahci.port < 32 && !found; ahci.port++)
+		{
+			found = (implemented & (1 << ahci.port)) && (AHCI_Read(AHCI_PORT(AHCI_PxSSTS)) & 0x0F0F) == AHCI_SSTS_ACTIVE && AHCI_Read(AHCI_PORT(AHCI_PxSIG)) == AHCI_SIGNATURE_ATA;
+		}
+		ahci.port--;
+		if(!found)
+		{
+			ahci.registers = 0;
+			continue;
+		}
+
+		ahci.memory = MEM_AllocPages(AHCI_MEMORY_PAGES, KernelMode);
+		if(!ahci.memory)
+		{
+			ahci.registers = 0;
+			return false;
+		}
+		for(dword j = 0; j < (AHCI_MEMORY_PAGES*PAGE_SIZE)/sizeof(dword); j++)
+			((dword*)ahci.memory)[j] = 0;
+
+		AHCI_StopPort();
+		AHCI_Write(AHCI_PORT(AHCI_PxCLB), ahci.memory + AHCI_LIST_OFFSET);
+		AHCI_Write(AHCI_PORT(AHCI_PxCLBU), 0);
+		AHCI_Write(AHCI_PORT(AHCI_PxFB), ahci.memory + AHCI_FIS_OFFSET);
+		AHCI_Write(AHCI_PORT(AHCI_PxFBU), 0);
+		if(!AHCI_StartPort() || !AHCI_Identify())
+		{
+			AHCI_StopPort();
+			MEM_ReleasePages(ahci.memory, AHCI_MEMORY_PAGES);
+			ahci.registers = 0;
+			return false;
+		}
+
+		//Interrupts when commands end or fail
+		byte line = PCI_ReadByte(device, 0x3C);
+		if(line < 16 && INT_SetHandler(HardwareInterrupt, line, AHCI_Interrupt))
+		{
+			AHCI_Write(AHCI_PORT(AHCI_PxIE), AHCI_PxIS_DONE | AHCI_PxIS_ERRORS);
+			AHCI_Write(AHCI_GHC, AHCI_Read(AHCI_GHC) | AHCI_GHC_IE);
+		}
+		return true;
+	}
+	return false;
+}
+
+/**
+* @brief Tells where the registers of the HBA are.
+* @return Their physical address (identity mapped), zero if there is no AHCI disk.
+*/
+PUBLIC PHYSICAL AHCI_GetRegisters()
+{
+	return ahci.registers;
+}
+
+/**
+* @brief Tells how many transfers the disk takes at once.
+* @return Number of tags.
+*/
+PUBLIC dword AHCI_GetTags()
+{
+	return ahci.tags;
+}
+
+/**
+* @brief Size of the disk.
+* @return Sectors.
+*/
+PUBLIC dword AHCI_GetSize()
+{
+	return ahci.sectors;
+}
+
+/**
+* @brief Sets who is told of the end of the transfers started by AHCI_StartTransfer.
+* @param _completion [in] The callback, called from the interrupt.
+*/
+PUBLIC void AHCI_SetCompletion(IN fHDCompletion _completion)
+{
+	ahci.completion = _completion;
+}
+
+/**
+* @brief Gives a transfer to the disk and returns at once, the completion callback is told when it ends.
+* @param _tag [in] The tag, below AHCI_GetTags and not in flight.
+* @param _lba [in] First sector.
+* @param _number_of_sectors [in] Sectors, up to HD_DMA_MAX_SECTORS.
+* @param _prd [in] Regions of the buffer, physical.
+* @param _entries [in] Number of regions.
+* @param _write [in] True to write to the disk.
+* @return True if started.
+*/
+PUBLIC bool AHCI_StartTransfer(IN dword _tag, IN LBA _lba, IN dword _number_of_sectors, IN HD_PRD* _prd, IN dword _entries, IN bool _write)
+{
+	if(!ahci.registers || _tag >= ahci.tags || (ahci.busy & (1 << _tag)))
+		return false;
+
+	byte command = ahci.ncq ? (_write ? ATA_WRITE_FPDMA : ATA_READ_FPDMA) : (_write ? ATA_WRITE_DMA_EXT : ATA_READ_DMA_EXT);
+	if(!AHCI_Build(_tag, command, _lba, _number_of_sectors, _prd, _entries, _write))
+		return false;
+
+	ahci.busy |= 1 << _tag;
+	if(ahci.ncq)
+		AHCI_Write(AHCI_PORT(AHCI_PxSACT), 1 << _tag);
+	AHCI_Write(AHCI_PORT(AHCI_PxCI), 1 << _tag);
+	return true;
+}
+
+/**
+* @brief Moves sectors between the disk and memory, polling until done. Transfers in flight are waited for first.
+* @param _lba [in] First sector.
+* @param _number_of_sectors [in] Sectors, up to HD_DMA_MAX_SECTORS.
+* @param _prd [in] Regions of the buffer, physical.
+* @param _entries [in] Number of regions.
+* @param _write [in] True to write to the disk.
+* @return True if transferred.
+*/
+PUBLIC bool AHCI_Transfer(IN LBA _lba, IN dword _number_of_sectors, IN HD_PRD* _prd, IN dword _entries, IN bool _write)
+{
+	//With interrupts disabled no completion can start a queued command on slot 0 meanwhile
+	dword state = INT_DisableInterrupts();
+	AHCI_Drain();
+	bool ok = AHCI_Build(0, _write ? ATA_WRITE_DMA_EXT : ATA_READ_DMA_EXT, _lba, _number_of_sectors, _prd, _entries, _write) && AHCI_Execute();
+	INT_EnableInterrupts(state);
+	return ok;
+}
+
+/**
+* @brief Waits until no transfer started by AHCI_StartTransfer is in flight, polling, so it works with
+* interrupts disabled. Completions may start new ones, which are waited for as well; if the disk
+* stops answering the port is restarted and they fail.
+*/
+PUBLIC void AHCI_Drain()
+{
+	for(dword i = 0; !AHCI_Poll(); i++)
+	{
+		if(i == AHCI_TIMEOUT)
+		{
+			dword failed = ahci.busy;
+			AHCI_StopPort();
+			AHCI_StartPort();
+			AHCI_Complete(failed, false);
+			i = 0;
+		}
+	}
+}
@@ -0,0 +1,30 @@
+/******************************************************************************/
+/**
+* @file		AHCI.h
+* @brief	XkyOS Hardware AHCI Library
+* Definitions of the SATA host bus adapter driver
+*
+* @date		20/03/2008
+* @author	Pablo Bravo
+*/
+/******************************************************************************/
+#ifndef __AHCI_H__
+#define __AHCI_H__
+
+	#include "Types.h"
+	#include "HardDisk.h"
+
+	#define AHCI_MAX_TAGS			32		/**< Commands a port takes at once*/
+	#define AHCI_REGISTERS_PAGES	2		/**< Pages of the registers of a HBA with all its ports*/
+
+	bool		AHCI_Init			();
+	PHYSICAL	AHCI_GetRegisters	();
+	dword		AHCI_GetTags		();
+	dword		AHCI_GetSize		();
+
+	void		AHCI_SetCompletion	(IN fHDCompletion _completion);
+	bool		AHCI_StartTransfer	(IN dword _tag, IN LBA _lba, IN dword _number_of_sectors, IN HD_PRD* _prd, IN dword _entries, IN bool _write);
+	bool		AHCI_Transfer		(IN LBA _lba, IN dword _number_of_sectors, IN HD_PRD* _prd, IN dword _entries, IN bool _write);
+	void		AHCI_Drain			();
+
+#endif //__AHCI_H__
@@ -204,3 +204,80 @@ PUBLIC NAKED void CPU_WriteCR3(IN dword _cr3)
 		ret 4
 	}
 }
+
+/**
+* @brief Reads the time stamp counter.
+* @return The number of cycles since the processor was reset.
+*/
+PUBLIC NAKED qword CPU_ReadTimeStamp()
+{
+	__asm
+	{
+		rdtsc
+		ret
+	}
+}
+
+/**
+* @brief Reads the processor feature flags.
+* @return The CPUID function 1 flags (CPU_FEATURE_*), zero if the processor has no CPUID.
+*/
+PUBLIC NAKED dword CPU_GetFeatures()
+{
+	__asm
+	{
+		//CPUID is there if the ID flag can be changed
+		pushfd
+		pop eax
+		mov ecx, eax
+		xor eax, 0x00200000
+		push eax
+		popfd
+		pushfd
+		pop eax
+		push ecx
+		popfd
+		xor eax, ecx
+		jz _NoCPUID
+
+		push ebx
+		mov eax, 1
+		cpuid
+		mov eax, edx
+		pop ebx
+		ret
+
+	_NoCPUID:
+		xor eax, eax
+		ret
+	}
+}
+
+/**
+* @brief Saves the floating point registers, so the kernel can use MMX without breaking the
+* environments (their state is not saved on switches). Leaves the FPU initialized.
+* @param _state [out] Where to save the registers.
+*/
+PUBLIC NAKED void CPU_SaveFPU(OUT FPU_STATE* _state)
+{
+	__asm
+	{
+		mov eax, [esp + 4]
+		fnsave [eax]
+		ret 4
+	}
+}
+
+/**
+* @brief Restores the floating point registers saved by CPU_SaveFPU.
+* @param _state [in] The saved registers.
+*/
+PUBLIC NAKED void CPU_RestoreFPU(IN FPU_STATE* _state)
+{
+	__asm
+	{
+		mov eax, [esp + 4]
+		frstor [eax]
+		ret 4
+	}
+}
@@ -56,5 +56,26 @@
 
 	dword	CPU_ReadCR3();
 	void	CPU_WriteCR3(IN dword _cr3);
+
+	qword	CPU_ReadTimeStamp();
+
+	//Features
+	#define CPU_FEATURE_TSC		0x00000010	/**< Time stamp counter*/
+	#define CPU_FEATURE_MMX		0x00800000	/**< MMX instructions*/
+	#define CPU_FEATURE_SSE		0x02000000	/**< SSE instructions*/
+	#define CPU_FEATURE_SSE2	0x04000000	/**< SSE2 instructions*/
+
+	dword	CPU_GetFeatures();
+
+	/**
+	* @brief Floating point (and MMX) registers as saved by fnsave.
+	*/
+	struct FPU_STATE
+	{
+		byte data[108];
+	};
+
+	void	CPU_SaveFPU		(OUT FPU_STATE* _state);
+	void	CPU_RestoreFPU	(IN FPU_STATE* _state);
 	
 #endif //__CPU_H__
@@ -12,22 +12,61 @@
 #include "System.h"
 #include "Memory.h"
 #include "IO.h"
+#include "CPU.h"
+#include "PCI.h"
+#include "Interrupts.h"
 #include "HardDisk.h"
+#include "AHCI.h"
 
 //==================================DATA======================================//
 #pragma data_seg(".data")
 //============================================================================//
 PRIVATE dword hd_last_sector = 0;
 PRIVATE dword hd_boot_drive = 0;
+PRIVATE bool hd_ahci = false;	/**< The disk is on an AHCI controller*/
 
 #define FLOPPY_RAM_DISK	0x00040000
 #define FLOPPY_SIZE	1474560
 
+#define HD_PRD_MAX			(PAGE_SIZE/sizeof(HD_PRD))
+
+#define BM_COMMAND			0x00	/**< Bus master registers, from BAR4 of the controller*/
+#define BM_STATUS			0x02
+#define BM_PRD				0x04
+#define BM_START			0x01
+#define BM_TO_MEMORY		0x08
+#define BM_STATUS_ACTIVE	0x01
+#define BM_STATUS_ERROR		0x02
+#define BM_STATUS_INTERRUPT	0x04
+
+#define ATA_STATUS_ERROR	0x01
+#define ATA_STATUS_FAULT	0x20
+#define ATA_READ_DMA		0xC8
+#define ATA_WRITE_DMA		0xCA
+
+#define HD_DMA_TIMEOUT		0x04000000	/**< Status polls before giving up a transfer*/
+
+/**
+* @brief Bus master DMA of the primary channel, found on a PCI IDE controller.
+*/
+struct HD_DMA
+{
+	word			bus_master;	/*< I/O base of the bus master registers, zero if none*/
+	HD_PRD*			prd;		/*< Descriptor table (a kernel page, identity mapped), copied by the AHCI driver*/
+	volatile bool	completed;	/*< Set by the interrupt when the transfer ends*/
+	volatile byte	status;		/*< Bus master status at completion*/
+	volatile bool	busy;		/*< A transfer started by HD_StartTransfer is running*/
+	bool			write;		/*< Direction of that transfer*/
+	fHDCompletion	completion;	/*< Told when it ends*/
+};
+
+PRIVATE HD_DMA hd_dma = {0, 0, false, 0, false, false, 0};
+
 //==================================CODE======================================//
 #pragma code_seg(".code")
 //============================================================================//
 /**
-* @brief Copies _size bytes from _origin to _destiny.
+* @brief Copies _size bytes from _origin to _destiny, four at a time and the rest one by one.
 * @param _destiny [in] Destiny address.
 * @param _origin [in] Source addres.
 * @param _size [in] Bytes to copy.
@@ -44,6 +83,10 @@ PRIVATE NAKED void MEM_Copy(IN VIRTUAL _destiny, IN VIRTUAL _origin, IN dword _s
 		mov ecx, dword ptr [ebp + 16] //_size
 		mov esi, dword ptr [ebp + 12] //_origin
 		mov edi, dword ptr [ebp + 8]  //_destiny
+		shr ecx, 2                    //Dobles palabras
+		rep movsd
+		mov ecx, dword ptr [ebp + 16] //Lo que sobra
+		and ecx, 3
 		rep movsb
 		pop edi
 		pop esi
@@ -53,6 +96,88 @@ PRIVATE NAKED void MEM_Copy(IN VIRTUAL _destiny, IN VIRTUAL _origin, IN dword _s
 	}
 }
 
+/**
+* @brief Ends the transfer started by HD_StartTransfer and tells its owner.
+* @param _status [in] Bus master status it ended with.
+*/
+PRIVATE void HD_FinishTransfer(IN byte _status)
+{
+	//Stop the engine, then acknowledge drive and controller
+	word bm = hd_dma.bus_master;
+	IO_OutPortByte(bm + BM_COMMAND, hd_dma.write ? 0 : BM_TO_MEMORY);
+	byte drive = IO_InPortByte(0x1F7);
+	IO_OutPortByte(bm + BM_STATUS, BM_STATUS_ERROR | BM_STATUS_INTERRUPT);
+
+	hd_dma.busy = false;
+	if(hd_dma.completion)
+	{
+		//May start the next transfer
+		hd_dma.completion(0, (_status & BM_STATUS_INTERRUPT) && !(_status & BM_STATUS_ERROR) && !(drive & (ATA_STATUS_ERROR | ATA_STATUS_FAULT)));
+	}
+}
+
+/**
+* @brief Primary channel interrupt (IRQ14). Ends a transfer of HD_StartTransfer, or acknowledges the
+* end of a bus master transfer being polled.
+* @param _frame [in] Interrupt frame.
+* @return True if call chain can be continued.
+*/
+PRIVATE bool INTERRUPT HD_Interrupt(IN INTERRUPT_FRAME* _frame)
+{
+	if(hd_dma.bus_master)
+	{
+		byte status = IO_InPortByte(hd_dma.bus_master + BM_STATUS);
+		if(hd_dma.busy)
+		{
+			if((status & BM_STATUS_INTERRUPT) || ((status & BM_STATUS_ERROR) && !(status & BM_STATUS_ACTIVE)))
+			{
+				HD_FinishTransfer(status);
+			}
+		}
+		else if(status & BM_STATUS_INTERRUPT)
+		{
+			//Reading the drive status releases the interrupt line
+			IO_InPortByte(0x1F7);
+			IO_OutPortByte(hd_dma.bus_master + BM_STATUS, status);
+
+			hd_dma.status = status;
+			hd_dma.completed = true;
+		}
+	}
+	return true;
+}
+
+/**
+* @brief Looks for a PCI IDE controller able to be bus master, and prepares its primary channel.
+* The secondary channel (0x170, IRQ15) is never used, its bus master registers at BAR4 + 8 are left alone.
+* @return True if transfers can be done by DMA.
+*/
+PRIVATE bool HD_InitDMA()
+{
+	for(dword i = 0; i < PCI_GetNumberOfDevices(); i++)
+	{
+		PCI device = PCI_GetDevice(i);
+
+		//Mass storage (0x01), IDE (0x01), with bus master (programming interface bit 7)
+		if(PCI_ReadByte(device, 0x0B) != 0x01 || PCI_ReadByte(device, 0x0A) != 0x01 || !(PCI_ReadByte(device, 0x09) & 0x80))
+			continue;
+
+		//BAR4 has the bus master registers in I/O space
+		dword bar4 = PCI_ReadDword(device, 0x20);
+		if(!(bar4 & 0x01) || !(bar4 & 0xFFFC))
+			continue;
+
+		//Enable I/O decoding and bus mastering
+		PCI_WriteWord(device, 0x04, PCI_ReadWord(device, 0x04) | 0x0005);
+
+		hd_dma.bus_master = (word)(bar4 & 0xFFFC);
+		IO_OutPortByte(hd_dma.bus_master + BM_COMMAND, 0);
+		IO_OutPortByte(hd_dma.bus_master + BM_STATUS, BM_STATUS_ERROR | BM_STATUS_INTERRUPT);
+		return true;
+	}
+	return false;
+}
+
 /**
 * @brief Hard Disk initialization.
 * @param _loader_data [in] Loader data regarding disk.
@@ -72,8 +197,40 @@ PUBLIC bool HD_Init(IN DISK_LOADER_DATA* _loader_data)
 		//FLOPPY
 		hd_last_sector = 512;
 	}
+
+	//The controllers are looked for whatever the boot drive. A disk on an AHCI controller goes first,
+	//else the primary channel, by bus master if there is a controller able to, by the CPU if not.
+	//Booted from anything but 0x80 the loader left the disk in the RAM disk, and they are not used
+	hd_dma.prd = (HD_PRD*)MEM_AllocPages(1, KernelMode);
+	if(hd_dma.prd)
+	{
+		hd_ahci = AHCI_Init();
+		if(!hd_ahci)
+			HD_InitDMA();
+		else if(hd_boot_drive == (dword)0x80)
+			hd_last_sector = AHCI_GetSize();
+	}
 	
-	return true;
+	//Only the primary channel is driven, so only IRQ14
+	return INT_SetHandler(HardwareInterrupt, 14, HD_Interrupt);
+}
+
+/**
+* @brief Tells if hard disk transfers are done by bus master DMA.
+* @return True if a bus master controller was found and the disk is not the RAM disk.
+*/
+PUBLIC bool HD_IsDMA()
+{
+	return hd_boot_drive == (dword)0x80 && (hd_ahci || hd_dma.bus_master != 0);
+}
+
+/**
+* @brief Tells how many transfers of HD_StartTransfer can be in flight at once.
+* @return Number of tags, several if the disk queues commands.
+*/
+PUBLIC dword HD_GetTags()
+{
+	return hd_ahci ? AHCI_GetTags() : 1;
 }
 
 /**
@@ -90,14 +247,15 @@ PRIVATE bool HD_CheckLBA(IN LBA _lba, IN dword _number_of_sectors)
 /**
 * @brief Prepare Hard Disk for action.
 * @param _lba [in] LBA regarding operation.
+* @param _number_of_sectors [in] Sectors of the operation.
 */
-PRIVATE void HD_StartHD(IN byte _drive, IN LBA _lba)
+PRIVATE void HD_StartHD(IN byte _drive, IN LBA _lba, IN dword _number_of_sectors)
 {
 	//Send a NULL byte to port 0x1F1
 	IO_OutPortByte(0x1F1, 0x00);
 
-	//Send a sector count to port 0x1F2
-	IO_OutPortByte(0x1F2, 0x01);
+	//Send a sector count to port 0x1F2 (0 is 256)
+	IO_OutPortByte(0x1F2, (byte)_number_of_sectors);
 
 	//Send the low 8 bits of the block address to port 0x1F3
 	IO_OutPortByte(0x1F3, (byte)_lba);
@@ -120,6 +278,243 @@ PRIVATE void HD_WaitForHD()
 	while(!(IO_InPortByte(0x1F7) & 0x08));
 }
 
+/**
+* @brief Describes a buffer as physical regions for the bus master, after the regions already in the
+* table. Regions are merged while physically contiguous and split at 64KB boundaries.
+* @param _pdbr [in] Address space of the buffer.
+* @param _buffer [in] The buffer, word aligned.
+* @param _size [in] Bytes of the buffer.
+* @param _user [in] True if every page must be a user page.
+* @param _entries [in, out] Regions in the table.
+* @return True if described, false if some page is not mapped or the table would not fit.
+*/
+PRIVATE bool HD_BuildPRD(IN PHYSICAL _pdbr, IN VIRTUAL _buffer, IN dword _size, IN bool _user, IN OUT dword* _entries)
+{
+	if(_buffer & 0x01)
+		return false;
+
+	//Page tables are only reachable from kernel space
+	PHYSICAL pdbr = CPU_ReadCR3();
+	CPU_WriteCR3(KERNEL_PAGE_DIRECTORY);
+
+	dword entries = *_entries;
+	bool ok = true;
+	while(_size && ok)
+	{
+		PTE* pte = VIRTUAL_PTE_Address(_pdbr, _buffer);
+		if(!pte || !pte->present || (_user && !pte->user_supervisor))
+		{
+			ok = false;
+			break;
+		}
+
+		PHYSICAL address = (pte->address << 12) + VIRTUAL_PageOffset(_buffer);
+		dword bytes = PAGE_SIZE - VIRTUAL_PageOffset(_buffer);
+		if(bytes > _size)
+			bytes = _size;
+
+		while(bytes)
+		{
+			dword piece = HD_PRD_LIMIT - (address & (HD_PRD_LIMIT - 1));
+			if(piece > bytes)
+				piece = bytes;
+
+			//Grow the last region if this one follows it without crossing 64KB
+			HD_PRD* last = entries ? &hd_dma.prd[entries - 1] : 0;
+			dword last_size = last ? ((last->count & 0xFFFF) ? (last->count & 0xFFFF) : HD_PRD_LIMIT) : 0;
+			if(last && last->address + last_size == address && (address & (HD_PRD_LIMIT - 1)))
+			{
+				last->count = (last_size + piece) & 0xFFFF;
+			}
+			else
+			{
+				if(entries == HD_PRD_MAX)
+				{
+					ok = false;
+					break;
+				}
+				hd_dma.prd[entries].address = address;
+				hd_dma.prd[entries].count = piece & 0xFFFF;
+				entries++;
+			}
+
+			address += piece;
+			bytes -= piece;
+			_buffer += piece;
+			_size -= piece;
+		}
+	}
+
+	CPU_WriteCR3(pdbr);
+
+	*_entries = entries;
+	return ok;
+}
+
+/**
+* @brief Marks the end of the region table.
+* @param _entries [in] Regions in the table.
+* @return True if there is some region.
+*/
+PRIVATE bool HD_EndPRD(IN dword _entries)
+{
+	if(!_entries)
+		return false;
+
+	hd_dma.prd[_entries - 1].count |= HD_PRD_LAST;
+	return true;
+}
+
+/**
+* @brief Sets who is told of the end of the transfers started by HD_StartTransfer.
+* @param _completion [in] The callback, called from the disk interrupt.
+*/
+PUBLIC void HD_SetCompletion(IN fHDCompletion _completion)
+{
+	hd_dma.completion = _completion;
+	AHCI_SetCompletion(_completion);
+}
+
+/**
+* @brief Starts a bus master transfer and returns at once, the completion callback is told when it ends.
+* As many transfers as HD_GetTags are in flight at a time, each with its own tag. The sectors, consecutive
+* on disk, may go to or come from several buffers, even of different address spaces.
+* @param _tag [in] Tag of the transfer, not in flight.
+* @param _lba [in] First sector.
+* @param _segments [in] The buffers, in disk order.
+* @param _number_of_segments [in] Number of buffers.
+* @param _write [in] True to write to the disk.
+* @return True if started, false if there is no bus master, the tag is busy or some buffer is not valid.
+*/
+PUBLIC bool HD_StartTransfer(IN dword _tag, IN LBA _lba, IN HD_SEGMENT* _segments, IN dword _number_of_segments, IN bool _write)
+{
+	if(!HD_IsDMA() || (!hd_ahci && (hd_dma.busy || _tag)))
+		return false;
+
+	dword number_of_sectors = 0;
+	dword entries = 0;
+	for(dword i = 0; i < _number_of_segments; i++)
+	{
+		number_of_sectors += _segments[i].sectors;
+		if(!HD_BuildPRD(_segments[i].pdbr, _segments[i].buffer, _segments[i].sectors*SECTOR_SIZE, _segments[i].user, &entries))
+			return false;
+	}
+
+	if(!number_of_sectors || number_of_sectors > HD_DMA_MAX_SECTORS || !HD_CheckLBA(_lba, number_of_sectors) || !HD_EndPRD(entries))
+		return false;
+
+	//The controller keeps its own copy of the regions
+	if(hd_ahci)
+		return AHCI_StartTransfer(_tag, _lba, number_of_sectors, hd_dma.prd, entries, _write);
+
+	word bm = hd_dma.bus_master;
+	byte direction = _write ? 0 : BM_TO_MEMORY;
+
+	IO_OutPortByte(bm + BM_COMMAND, direction);
+	IO_OutPortDword(bm + BM_PRD, (dword)hd_dma.prd);
+	IO_OutPortByte(bm + BM_STATUS, BM_STATUS_ERROR | BM_STATUS_INTERRUPT);
+	hd_dma.write = _write;
+	hd_dma.busy = true;
+
+	HD_StartHD(0 /*_disk*/, _lba, number_of_sectors);
+	IO_OutPortByte(0x1F7, _write ? ATA_WRITE_DMA : ATA_READ_DMA);
+	IO_OutPortByte(bm + BM_COMMAND, direction | BM_START);
+	return true;
+}
+
+/**
+* @brief Ends the transfer in flight if the controller is done with it, for code that runs with
+* interrupts disabled and can't wait for HD_Interrupt.
+* @return True if no transfer is in flight any more.
+*/
+PRIVATE bool HD_Poll()
+{
+	if(hd_dma.busy)
+	{
+		byte status = IO_InPortByte(hd_dma.bus_master + BM_STATUS);
+		if((status & BM_STATUS_INTERRUPT) || ((status & BM_STATUS_ERROR) && !(status & BM_STATUS_ACTIVE)))
+		{
+			HD_FinishTransfer(status);
+		}
+	}
+	return !hd_dma.busy;
+}
+
+/**
+* @brief Waits until no transfer started by HD_StartTransfer is in flight, polling, so it works with
+* interrupts disabled. Completions may start new ones, which are waited for as well; a transfer that
+* never ends is ended as failed.
+*/
+PUBLIC void HD_Drain()
+{
+	if(hd_ahci)
+	{
+		AHCI_Drain();
+		return;
+	}
+
+	for(dword i = 0; !HD_Poll(); i++)
+	{
+		if(i == HD_DMA_TIMEOUT)
+		{
+			HD_FinishTransfer(BM_STATUS_ERROR);
+			i = 0;
+		}
+	}
+}
+
+/**
+* @brief Moves sectors between the disk and memory by bus master DMA. System calls run with interrupts
+* disabled, so the end of the transfer is polled; with interrupts enabled HD_Interrupt acknowledges it.
+* @param _disk [in] Disk.
+* @param _lba [in] First sector.
+* @param _number_of_sectors [in] Sectors, up to HD_DMA_MAX_SECTORS.
+* @param _buffer [in] Memory, word aligned.
+* @param _write [in] True to write to the disk.
+* @return True if transferred.
+*/
+PRIVATE bool HD_TransferDMA(IN byte _disk, IN LBA _lba, IN dword _number_of_sectors, IN VIRTUAL _buffer, IN bool _write)
+{
+	//The channel is shared with HD_StartTransfer
+	HD_Drain();
+
+	dword entries = 0;
+	if(!HD_BuildPRD(CPU_ReadCR3(), _buffer, _number_of_sectors*SECTOR_SIZE, false, &entries) || !HD_EndPRD(entries))
+		return false;
+
+	if(hd_ahci)
+		return AHCI_Transfer(_lba, _number_of_sectors, hd_dma.prd, entries, _write);
+
+	word bm = hd_dma.bus_master;
+	byte direction = _write ? 0 : BM_TO_MEMORY;
+
+	IO_OutPortByte(bm + BM_COMMAND, direction);
+	IO_OutPortDword(bm + BM_PRD, (dword)hd_dma.prd);
+	IO_OutPortByte(bm + BM_STATUS, BM_STATUS_ERROR | BM_STATUS_INTERRUPT);
+	hd_dma.completed = false;
+
+	HD_StartHD(_disk, _lba, _number_of_sectors);
+	IO_OutPortByte(0x1F7, _write ? ATA_WRITE_DMA : ATA_READ_DMA);
+	IO_OutPortByte(bm + BM_COMMAND, direction | BM_START);
+
+	byte status = 0;
+	for(dword i = 0; i < HD_DMA_TIMEOUT && !hd_dma.completed; i++)
+	{
+		status = IO_InPortByte(bm + BM_STATUS);
+		if((status & BM_STATUS_INTERRUPT) || ((status & BM_STATUS_ERROR) && !(status & BM_STATUS_ACTIVE)))
+			break;
+	}
+	if(hd_dma.completed)
+		status = hd_dma.status;
+
+	//Stop the engine, then acknowledge drive and controller
+	IO_OutPortByte(bm + BM_COMMAND, direction);
+	byte drive = IO_InPortByte(0x1F7);
+	IO_OutPortByte(bm + BM_STATUS, BM_STATUS_ERROR | BM_STATUS_INTERRUPT);
+
+	return (status & BM_STATUS_INTERRUPT) && !(status & BM_STATUS_ERROR) && !(drive & (ATA_STATUS_ERROR | ATA_STATUS_FAULT));
+}
+
 /**
 * @brief Reads one sector from hard disk.
 * @param _disk [in] Disk to read from.
@@ -130,7 +525,7 @@ PRIVATE void HD_WaitForHD()
 PRIVATE bool HD_ReadSector(IN byte _disk, IN LBA _lba, OUT VIRTUAL _buffer)
 {
 	//Prepare the HD
-	HD_StartHD(_disk, _lba);
+	HD_StartHD(_disk, _lba, 1);
 	
 	//Send the command (0x20) to port 0x1F7
 	IO_OutPortByte(0x1F7, 0x20);
@@ -149,15 +544,16 @@ PRIVATE bool HD_ReadSector(IN byte _disk, IN LBA _lba, OUT VIRTUAL _buffer)
 }
 
 /**
-* @brief Reads one sector from floppy.
+* @brief Reads sectors from the floppy image the loader left in memory, all in one copy.
 * @param _disk [in] Disk to read from.
-* @param _lba [in] LBA to be read.
+* @param _lba [in] First LBA to be read.
+* @param _number_of_sectors [in] Number of sectors to read.
 * @param _buffer [out] Where to leave the data.
-* @return Returns true if sector was read.
+* @return Returns true if sectors were read.
 */
-PRIVATE bool FLOPPY_ReadSector(IN byte _disk, IN LBA _lba, OUT VIRTUAL _buffer)
+PRIVATE bool FLOPPY_ReadSectors(IN byte _disk, IN LBA _lba, IN dword _number_of_sectors, OUT VIRTUAL _buffer)
 {
-	MEM_Copy(_buffer, (VIRTUAL)(FLOPPY_RAM_DISK + _lba*SECTOR_SIZE), SECTOR_SIZE);
+	MEM_Copy(_buffer, (VIRTUAL)(FLOPPY_RAM_DISK + _lba*SECTOR_SIZE), _number_of_sectors*SECTOR_SIZE);
 	return true;
 }
 
@@ -178,19 +574,33 @@ PUBLIC dword HD_ReadSectors(IN byte _disk, IN LBA _lba, IN dword _number_of_sect
 	//Read
 	if(hd_boot_drive == (dword)0x80)
 	{
-		for(dword i = 0; i < _number_of_sectors; i++)
+		for(dword i = 0; i < _number_of_sectors; )
 		{
-			if(!HD_ReadSector(0 /*_disk*/, _lba + i, _buffer + i*SECTOR_SIZE))
+			//Large pieces by DMA, what can't be done that way by the CPU
+			dword sectors = _number_of_sectors - i;
+			if(sectors > HD_DMA_MAX_SECTORS)
+				sectors = HD_DMA_MAX_SECTORS;
+			if(HD_IsDMA() && HD_TransferDMA(0 /*_disk*/, _lba + i, sectors, _buffer + i*SECTOR_SIZE, false))
+			{
+				i += sectors;
+				continue;
+			}
+
+			//The primary channel has no disk behind an AHCI controller
+			if(hd_ahci)
 				return i;
+
+			for(dword j = 0; j < sectors; j++, i++)
+			{
+				if(!HD_ReadSector(0 /*_disk*/, _lba + i, _buffer + i*SECTOR_SIZE))
+					return i;
+			}
 		}
 	}
 	else
 	{
-		for(dword i = 0; i < _number_of_sectors; i++)
-		{
-			if(!FLOPPY_ReadSector(0 /*_disk*/, _lba + i, _buffer + i*SECTOR_SIZE))
-				return i;
-		}
+		if(!FLOPPY_ReadSectors(0 /*_disk*/, _lba, _number_of_sectors, _buffer))
+			return 0;
 	}
 
 	//Ok
@@ -207,7 +617,7 @@ PUBLIC dword HD_ReadSectors(IN byte _disk, IN LBA _lba, IN dword _number_of_sect
 PRIVATE bool HD_WriteSector(IN byte _disk, IN LBA _lba, IN VIRTUAL _buffer)
 {
 	//Preparamos el HD
-	HD_StartHD(_disk, _lba);
+	HD_StartHD(_disk, _lba, 1);
 	
 	//Send the command (0x30) to port 0x1F7
 	IO_OutPortByte(0x1F7, 0x30);
@@ -226,15 +636,16 @@ PRIVATE bool HD_WriteSector(IN byte _disk, IN LBA _lba, IN VIRTUAL _buffer)
 }
 
 /**
-* @brief Writes one sector from floppy.
+* @brief Writes sectors to the floppy image the loader left in memory, all in one copy.
 * @param _disk [in] Disk to write to.
-* @param _lba [in] LBA to be written.
+* @param _lba [in] First LBA to be written.
+* @param _number_of_sectors [in] Number of sectors to write.
 * @param _buffer [in] Where to get the data from.
-* @return Returns true if sector was read.
+* @return Returns true if sectors were written.
 */
-PRIVATE bool FLOPPY_WriteSector(IN byte _disk, IN LBA _lba, IN VIRTUAL _buffer)
+PRIVATE bool FLOPPY_WriteSectors(IN byte _disk, IN LBA _lba, IN dword _number_of_sectors, IN VIRTUAL _buffer)
 {
-	MEM_Copy((VIRTUAL)(FLOPPY_RAM_DISK + _lba*SECTOR_SIZE), _buffer, SECTOR_SIZE);
+	MEM_Copy((VIRTUAL)(FLOPPY_RAM_DISK + _lba*SECTOR_SIZE), _buffer, _number_of_sectors*SECTOR_SIZE);
 	return true;
 }
 
@@ -255,25 +666,54 @@ PUBLIC dword HD_WriteSectors(IN byte _disk, IN LBA _lba, IN dword _number_of_sec
 	//Write
 	if(hd_boot_drive == (dword)0x80)
 	{
-		for(dword i = 0; i < _number_of_sectors; i++)
+		for(dword i = 0; i < _number_of_sectors; )
 		{
-			if(!HD_WriteSector(0 /*_disk*/, _lba + i, _buffer + i*SECTOR_SIZE))
+			dword sectors = _number_of_sectors - i;
+			if(sectors > HD_DMA_MAX_SECTORS)
+				sectors = HD_DMA_MAX_SECTORS;
+			if(HD_IsDMA() && HD_TransferDMA(0 /*_disk*/, _lba + i, sectors, _buffer + i*SECTOR_SIZE, true))
+			{
+				i += sectors;
+				continue;
+			}
+
+			//The primary channel has no disk behind an AHCI controller
+			if(hd_ahci)
 				return i;
+
+			for(dword j = 0; j < sectors; j++, i++)
+			{
+				if(!HD_WriteSector(0 /*_disk*/, _lba + i, _buffer + i*SECTOR_SIZE))
+					return i;
+			}
 		}
 	}
 	else
 	{
-		for(dword i = 0; i < _number_of_sectors; i++)
-		{
-			if(!FLOPPY_WriteSector(0 /*_disk*/, _lba + i, _buffer + i*SECTOR_SIZE))
-				return i;
-		}
+		if(!FLOPPY_WriteSectors(0 /*_disk*/, _lba, _number_of_sectors, _buffer))
+			return 0;
 	}
 
 	//Ok
 	return _number_of_sectors;
 }
 
+/**
+* @brief Tells where some sectors are when the disk is the floppy image held in memory, so they can be
+* read in place instead of copied. The memory is the disk's: it must not be written, and writes to
+* those sectors change it.
+* @param _lba [in] First sector.
+* @param _number_of_sectors [in] Number of sectors.
+* @return Kernel address of the sectors, zero if the disk is not in memory or they are out of it.
+*/
+PUBLIC PHYSICAL HD_MapSectors(IN LBA _lba, IN dword _number_of_sectors)
+{
+	if(hd_boot_drive == (dword)0x80 || !HD_CheckLBA(_lba, _number_of_sectors))
+		return 0;
+
+	return FLOPPY_RAM_DISK + _lba*SECTOR_SIZE;
+}
+
 /**
 * @brief Consults disk size.
 * @return Returns the size IN SECTORS of the disk.
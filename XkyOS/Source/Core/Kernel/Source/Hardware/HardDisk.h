@@ -23,7 +23,46 @@
 
 	dword	HD_ReadSectors	(IN byte _disk, IN LBA _lba, IN dword _sectors, OUT VIRTUAL _buffer);
 	dword	HD_WriteSectors	(IN byte _disk, IN LBA _lba, IN dword _sectors, IN VIRTUAL _buffer);
+	PHYSICAL HD_MapSectors	(IN LBA _lba, IN dword _sectors);
 	dword	HD_Size			();
+	bool	HD_IsDMA		();
+	dword	HD_GetTags		();
+
+	/**
+	* @brief Told from the disk interrupt when a transfer of HD_StartTransfer ends.
+	* @param _tag [in] Tag of the transfer.
+	* @param _ok [in] True if the sectors were transferred.
+	*/
+	typedef void (*fHDCompletion)(IN dword _tag, IN bool _ok);
+
+	#define HD_DMA_MAX_SECTORS	256	/**< Most a LBA28 command moves*/
+
+	/**
+	* @brief Physical Region Descriptor, a piece of memory of a bus master transfer.
+	*/
+	struct HD_PRD
+	{
+		PHYSICAL	address;
+		dword		count;		/*< Bytes in the low word (0 is 64KB), HD_PRD_LAST in the last one*/
+	};
+
+	#define HD_PRD_LAST			0x80000000
+	#define HD_PRD_LIMIT		0x00010000	/**< A region can't cross a 64KB boundary*/
+
+	/**
+	* @brief A buffer of a transfer.
+	*/
+	struct HD_SEGMENT
+	{
+		PHYSICAL	pdbr;		/*< Address space of the buffer, which may not be the current one*/
+		VIRTUAL		buffer;		/*< Word aligned*/
+		dword		sectors;
+		bool		user;		/*< The buffer must be made of user pages*/
+	};
+
+	void	HD_SetCompletion(IN fHDCompletion _completion);
+	bool	HD_StartTransfer(IN dword _tag, IN LBA _lba, IN HD_SEGMENT* _segments, IN dword _number_of_segments, IN bool _write);
+	void	HD_Drain		();
 
 	#define FLOPPY_DRIVE	0
 	#define HD_DRIVE		0x00000080
@@ -8,6 +8,7 @@
 #include "PCI.h"
 #include "CPU.h"
 #include "HardDisk.h"
+#include "AHCI.h"
 #include "Keyboard.h"
 #include "Mouse.h"
 #include "Timer.h"
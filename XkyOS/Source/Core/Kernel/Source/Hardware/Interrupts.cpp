@@ -12,6 +12,7 @@
 #include "System.h"
 #include "IO.h"
 #include "Interrupts.h"
+#include "CPU.h"
 
 //==================================DATA======================================//
 #pragma data_seg(".data")
@@ -26,6 +27,34 @@ ALIGN(4)
 */
 PRIVATE fInterruptHandler int_handlers[IDT_ELEMENTS][MAX_HANDLERS_PER_INTERRUPT];
 
+#define MAX_DEFERRED_WORK 32 /**< Work items that can be pending, a power of two*/
+
+/**
+* @brief Work queued by an interrupt handler.
+*/
+struct INT_WORK
+{
+	fDeferredWork	work;
+	dword			data;
+	qword			queued;	/*< Time stamp when queued*/
+};
+/**
+* @brief Pending work. Handlers write head, the interrupt returning to user mode reads tail; both with
+* interrupts disabled.
+*/
+PRIVATE INT_WORK int_work[MAX_DEFERRED_WORK];
+PRIVATE dword int_work_head = 0;
+PRIVATE dword int_work_tail = 0;
+/**
+* @brief True while deferred work runs, interrupts coming then return to it.
+*/
+PRIVATE bool int_deferring = false;
+
+/**
+* @brief Latency counters.
+*/
+PRIVATE INTERRUPT_STATISTICS int_statistics;
+
 //==================================CODE======================================//
 #pragma code_seg(".code")
 //============================================================================//
@@ -56,12 +85,45 @@ PRIVATE void INT_ReprogramPIC()
 	IO_OutPortByte(0xA1, 0x00);
 }
 
+/**
+* @brief Runs the pending work with interrupts enabled. Interrupts arriving meanwhile may queue more,
+* it is run too before leaving.
+* @param [in] _frame The interrupt frame, returning to user mode.
+*/
+PRIVATE void INT_RunDeferredWork(IN INTERRUPT_FRAME* _frame)
+{
+	int_deferring = true;
+
+	while(int_work_tail != int_work_head)
+	{
+		INT_WORK work = int_work[int_work_tail & (MAX_DEFERRED_WORK - 1)];
+		int_work_tail++;
+
+		qword start = CPU_ReadTimeStamp();
+		if(start - work.queued > int_statistics.max_delay_cycles)
+			int_statistics.max_delay_cycles = start - work.queued;
+
+		__asm sti
+		work.work(_frame, work.data);
+		__asm cli
+
+		qword cycles = CPU_ReadTimeStamp() - start;
+		if(cycles > int_statistics.max_deferred_cycles)
+			int_statistics.max_deferred_cycles = cycles;
+		int_statistics.deferred++;
+	}
+
+	int_deferring = false;
+}
+
 /**
 * @brief Generic interrupt handler hooked in the IDT. Will call the handlers suscripted.
 * @param [in] _frame The interrupt frame.
 */
 PRIVATE void __cdecl INT_InterruptHandler(IN INTERRUPT_FRAME _frame)
 {
+	qword start = CPU_ReadTimeStamp();
+
 	for(dword i = 0; i < MAX_HANDLERS_PER_INTERRUPT; i++)
 	{
 		if(int_handlers[_frame.vector][i])
@@ -83,6 +145,19 @@ PRIVATE void __cdecl INT_InterruptHandler(IN INTERRUPT_FRAME _frame)
 		IO_OutPortByte(0xA0, 0x20);
 		IO_OutPortByte(0x20, 0x20);
 	}
+
+	//Interrupts were disabled all along, that is what any other interrupt may have to wait
+	qword cycles = CPU_ReadTimeStamp() - start;
+	if(cycles > int_statistics.max_cycles)
+	{
+		int_statistics.max_cycles = cycles;
+		int_statistics.max_vector = _frame.vector;
+	}
+	int_statistics.interrupts++;
+
+	//Going back to user mode (the handlers may have switched the frame to a task), a safe point
+	if(!int_deferring && int_work_tail != int_work_head && INT_InterruptFromUserMode(&_frame))
+		INT_RunDeferredWork(&_frame);
 }
 
 /**
@@ -536,3 +611,67 @@ PUBLIC void INT_EnableHardwareInterrupts()
 	for(byte i = 0; i < 15; i++)
 		INT_MaskHardwareInterrupts(i, true);
 }
+
+/**
+* @brief Queues work to be run with interrupts enabled before going back to user mode. Meant for
+* interrupt handlers, that should only capture the data. Work already pending is not queued twice.
+* @param _work [in] The routine.
+* @param _data [in] Value for the routine.
+* @return False if the queue was full.
+*/
+PUBLIC bool INT_QueueWork(IN fDeferredWork _work, IN dword _data)
+{
+	dword state = INT_DisableInterrupts();
+
+	for(dword i = int_work_tail; i != int_work_head; i++)
+	{
+		INT_WORK* pending = &int_work[i & (MAX_DEFERRED_WORK - 1)];
+		if(pending->work == _work && pending->data == _data)
+		{
+			INT_EnableInterrupts(state);
+			return true;
+		}
+	}
+
+	if(int_work_head - int_work_tail == MAX_DEFERRED_WORK)
+	{
+		int_statistics.dropped++;
+		INT_EnableInterrupts(state);
+		return false;
+	}
+
+	INT_WORK* work = &int_work[int_work_head & (MAX_DEFERRED_WORK - 1)];
+	work->work = _work;
+	work->data = _data;
+	work->queued = CPU_ReadTimeStamp();
+	int_work_head++;
+
+	INT_EnableInterrupts(state);
+	return true;
+}
+
+/**
+* @brief Indicates if the interrupted code is deferred work rather than a task.
+*/
+PUBLIC bool INT_IsDeferring()
+{
+	return int_deferring;
+}
+
+/**
+* @brief Forgets the deferred work being run, for when it is abandoned and never returns (an
+* environment killed from its callback). The rest of the queue runs on next return to user mode.
+*/
+PUBLIC void INT_ResetDeferredWork()
+{
+	int_deferring = false;
+}
+
+/**
+* @brief Consults the interrupt latency counters.
+* @param _statistics [out] Where to leave the counters.
+*/
+PUBLIC void INT_GetStatistics(OUT INTERRUPT_STATISTICS* _statistics)
+{
+	*_statistics = int_statistics;
+}
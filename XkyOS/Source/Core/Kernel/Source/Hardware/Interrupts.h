@@ -53,6 +53,28 @@
 	*/
 	typedef bool (INTERRUPT *fInterruptHandler)(IN INTERRUPT_FRAME* _frame);
 
+	/**
+	* @brief Type for work deferred by interrupt handlers. It runs with interrupts enabled, just before
+	* going back to user mode.
+	* @param [in] _frame The frame of the interrupt that is returning to user mode.
+	* @param [in] _data The value given when queued.
+	*/
+	typedef void (INTERRUPT *fDeferredWork)(IN INTERRUPT_FRAME* _frame, IN dword _data);
+
+	/**
+	* @brief Interrupt latency counters, in time stamp cycles.
+	*/
+	struct INTERRUPT_STATISTICS
+	{
+		dword interrupts;			/*< Interrupts serviced*/
+		dword deferred;				/*< Deferred work items run*/
+		dword dropped;				/*< Work items lost because the queue was full*/
+		dword max_vector;			/*< Vector of the longest handler*/
+		qword max_cycles;			/*< Longest handler, interrupts are disabled all along*/
+		qword max_deferred_cycles;	/*< Longest deferred work item*/
+		qword max_delay_cycles;		/*< Longest wait from queued to run*/
+	};
+
 	/**
 	* @brief Sources of interrupts.
 	*/
@@ -72,5 +94,9 @@
 	bool	INT_InterruptFromKernelMode	(IN INTERRUPT_FRAME* _frame);
 	void	INT_DisableHardwareInterrupts	();
 	void	INT_EnableHardwareInterrupts	();
+	bool	INT_QueueWork			(IN fDeferredWork _work, IN dword _data);
+	bool	INT_IsDeferring			();
+	void	INT_ResetDeferredWork	();
+	void	INT_GetStatistics		(OUT INTERRUPT_STATISTICS* _statistics);
 
 #endif //__INTERRUPTS_H__
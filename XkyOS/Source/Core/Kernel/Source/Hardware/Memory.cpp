@@ -84,77 +84,108 @@ PRIVATE PE* MR_Find(IN MEMORY_RANGE* _range, IN dword _number_of_pages)
 	return 0;
 }
 
-#define MEMORY_TYPE_UNAVAILABLE		0x00000000 /**< Indicates the memory range is inexistent */
+#define MEMORY_LIMIT	0x100000000	/**< End of the 32 bits physical address space */
+
 /**
-* @brief Verifies that a given physical address does exists currently.
-* @param _address [in] Physical address.
+* @brief Maps identity a range of physical memory in the kernel page tables.
+* @param _start [in] First byte of the range.
+* @param _end [in] Byte after the range, may be beyond 4GB.
+* @param _available [in] True if the allocator can hand out its pages.
+*/
+PRIVATE void MEM_MapRange(IN qword _start, IN qword _end, IN bool _available)
+{
+	if(_end > MEMORY_LIMIT)
+		_end = MEMORY_LIMIT;
+
+	//Only whole pages are usable, any page touched is reserved
+	if(_available)
+	{
+		_start = (_start + PAGE_SIZE - 1) & ~(qword)(PAGE_SIZE - 1);
+		_end &= ~(qword)(PAGE_SIZE - 1);
+	}
+
+	for(qword address = _start & ~(qword)(PAGE_SIZE - 1); address < _end; address += PAGE_SIZE)
+	{
+		PE* pe = (PE*)(PAGE_TABLES_START) + (dword)(address >> 12);
+
+		pe->pte.present			= 1;
+		pe->pte.read_write		= ReadWrite;
+		pe->pte.user_supervisor	= KernelMode;
+		pe->pte.write_through	= 0;
+		pe->pte.cache_disabled	= 1;
+		pe->pte.accesed			= 0;
+		pe->pte.dirty			= 0;
+		pe->pte.pat				= 0;
+		pe->pte.global			= 0;
+		pe->pte.available		= _available?1:0;
+		pe->pte.address			= (dword)(address >> 12);
+	}
+}
+
+/**
+* @brief Maps the ranges of the firmware memory map of a given kind.
 * @param _loader_data [in] Loader data regarding physical memory.
-* @return Returns memory type.
+* @param _available [in] True for the usable ranges, false for all the others (ACPI, reserved...).
+* @return Byte after the last range mapped.
 */
-PRIVATE dword PHYSICAL_IsValid(IN PHYSICAL _address, IN MEMORY_LOADER_DATA* _loader_data, IN SVGA_LOADER_DATA* _svga_loader_data)
+PRIVATE qword MEM_MapDescriptors(IN MEMORY_LOADER_DATA* _loader_data, IN bool _available)
 {
-	//Check physical memory ranges
+	qword top = 0;
 	for(dword i = 0; i < _loader_data->descriptors_number; i++)
 	{
-		//Check address is in a range that is valid as physical memory
-		if(
-		(_address >= _loader_data->descriptors[i].base_address_low)
-		&&
-		(_address <= (_loader_data->descriptors[i].base_address_low + _loader_data->descriptors[i].base_length_low))
-		)
-			return _loader_data->descriptors[i].type;
-	}
+		MEMORY_DESCRIPTOR* descriptor = &_loader_data->descriptors[i];
+		if((descriptor->type == MEMORY_TYPE_AVAILABLE) != _available)
+			continue;
 
-	//Check svga mapped/io ranges
-	if(
-		(_address >= _svga_loader_data->framebuffer)
-		&&
-		(_address < _svga_loader_data->framebuffer + (_svga_loader_data->x_resolution*_svga_loader_data->y_resolution)*4)
-	)
-		return MEMORY_TYPE_SYSTEM_RESERVED;
+		qword start = ((qword)descriptor->base_address_high << 32) | descriptor->base_address_low;
+		qword length = ((qword)descriptor->base_length_high << 32) | descriptor->base_length_low;
+		if(!length || start >= MEMORY_LIMIT)
+			continue;
 
-	//Not a valid physical address
-	return MEMORY_TYPE_UNAVAILABLE;
+		MEM_MapRange(start, start + length, _available);
+		if(start + length > top)
+			top = start + length;
+	}
+	return top;
 }
 
 /**
-* @brief Memory initialization.
+* @brief Memory initialization. Usable ranges of the firmware map become free pages, the rest of the
+* ranges it lists, the first MB and the framebuffer are mapped but never handed out, and holes stay
+* unmapped.
 * @param _loader_data [in] Loader data regarding memory.
 * @return Returns true if everything goes well.
 */
 PUBLIC bool MEM_Init(IN MEMORY_LOADER_DATA* _memory_loader_data, SVGA_LOADER_DATA* _svga_loader_data)
 {
-	//We walk the memory map filling PE's
-	PHYSICAL address = 0;
-	for(PE* pe = (PE*)(PAGE_TABLES_START); pe < (PE*)(PAGE_TABLES_END); pe++, address+=PAGE_SIZE)
+	for(PE* pe = (PE*)(PAGE_TABLES_START); pe < (PE*)(PAGE_TABLES_END); pe++)
 	{
-		dword memory_type = PHYSICAL_IsValid(address, _memory_loader_data, _svga_loader_data);
+		pe->pte.value = 0;
+	}
 
-		if(memory_type != MEMORY_TYPE_UNAVAILABLE || (address < 0x00100000))
-		{
-			pe->pte.present			= 1;
-			pe->pte.read_write		= ReadWrite;
-			pe->pte.user_supervisor	= KernelMode;
-			pe->pte.write_through	= 0;
-			pe->pte.cache_disabled	= 1;
-			pe->pte.accesed			= 0;
-			pe->pte.dirty			= 0;
-			pe->pte.pat				= 0;
-			pe->pte.global			= 0;
-			pe->pte.available		= 1;
-			pe->pte.address			= address>>12;
-		}
-		else
-		{
-			pe->pte.value = 0;
-		}
+	//Without a map (no E820) all that is known is the size (E801)
+	qword top = MEM_MapDescriptors(_memory_loader_data, true);
+	if(!_memory_loader_data->descriptors_number)
+	{
+		top = (qword)_memory_loader_data->size_in_megas << 20;
+		MEM_MapRange(0x00100000, top, true);
 	}
-	//Mark as not free the first MB (the three next until four are for kernel memory)
-	for(PE* pe = (PE*)PAGE_TABLES_START; pe < (PE*)(PAGE_TABLES_START+(PAGE_SIZE/4)); pe++)
+
+	//Reserved ranges may overlap usable ones, they win
+	MEM_MapDescriptors(_memory_loader_data, false);
+	MEM_MapRange(0, 0x00100000, false);
+	MEM_MapRange(_svga_loader_data->framebuffer, (qword)_svga_loader_data->framebuffer + (_svga_loader_data->x_resolution*_svga_loader_data->y_resolution)*4, false);
+
+	//User pages are searched only up to the end of the memory
+	if(top < MEMORY_LIMIT)
 	{
-		pe->pte.available = 0;
+		PE* end = (PE*)(PAGE_TABLES_START) + (dword)(top >> 12);
+		if(end < mem_user_range.end)
+			mem_user_range.end = end;
+		if(mem_user_range.end < mem_user_range.start)
+			mem_user_range.end = mem_user_range.start;
 	}
-	
+
 	//Activate pagination
 	CPU_WriteCR3(KERNEL_PAGE_DIRECTORY);
 
@@ -212,6 +243,17 @@ PUBLIC void MEM_ReleasePages(IN PHYSICAL _address, IN dword _number_of_pages)
 	}
 }
 
+/**
+* @brief Maps the registers of a device, identity mapped and not cached, so the kernel can reach them.
+* The pages are never handed out.
+* @param _address [in] Physical address of the registers.
+* @param _size [in] Bytes of the registers.
+*/
+PUBLIC void MEM_MapDevice(IN PHYSICAL _address, IN dword _size)
+{
+	MEM_MapRange(_address, (qword)_address + _size, false);
+}
+
 /**
 * @brief Obtain the page directory address for a virtual address
 * @param _pdbr [in] Page directory base register of virtual space
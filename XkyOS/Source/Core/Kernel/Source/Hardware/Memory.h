@@ -28,6 +28,7 @@
 
 	PHYSICAL	MEM_AllocPages		(IN dword _number_of_pages, IN ExecutionType _execution);
 	void		MEM_ReleasePages	(IN PHYSICAL _address, IN dword _number_of_pages);
+	void		MEM_MapDevice		(IN PHYSICAL _address, IN dword _size);
 
 	/**
 	* @brief Page directory index given a virtual address.
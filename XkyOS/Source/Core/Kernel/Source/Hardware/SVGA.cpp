@@ -12,6 +12,7 @@
 #include "Types.h"
 #include "Graphics.h"
 #include "SVGA.h"
+#include "CPU.h"
 
 //==================================DATA======================================//
 #pragma data_seg(".data")
@@ -286,9 +287,492 @@ PRIVATE ARGB* svga_framebuffer = 0;
 ALIGN(4)
 PRIVATE SIZE svga_screen_size = {0, 0};
 
+/**
+* @brief The framebuffer seen as a surface (rows go down in memory).
+*/
+ALIGN(4)
+PRIVATE SURFACE svga_screen = {0, 0, 0, 0};
+
+/**
+* @brief One implementation of the row primitives.
+*/
+struct PIXELS_IMPLEMENTATION
+{
+	dword features;	/*< CPU_FEATURE_* needed*/
+	void (*fill)	(OUT ARGB* _destination, IN ARGB _color, IN dword _count);
+	void (*copy)	(OUT ARGB* _destination, IN ARGB* _source, IN dword _count);
+	void (*blend)	(IN OUT ARGB* _destination, IN ARGB _color, IN dword _count);
+};
+
+#define PIXELS_SIMD_MINIMUM	64	/**< Shorter runs do not pay saving the FPU state*/
+#define PIXELS_PREFETCH		256	/**< Bytes ahead to prefetch when copying*/
+
+/**
+* @brief CPU features, read once.
+*/
+PRIVATE dword svga_cpu_features = 0;
+
+#define GLYPH_WIDTH			8	/**< Pixels per glyph row*/
+#define GLYPH_HEIGHT		8	/**< Rows per glyph*/
+#define GLYPH_PIXELS		(GLYPH_WIDTH*GLYPH_HEIGHT)
+#define GLYPH_ATLAS_PAGES	((256*GLYPH_PIXELS*sizeof(ARGB))/PAGE_SIZE)
+#define MAX_GLYPH_ATLASES	4	/**< Color pairs kept expanded*/
+
+/**
+* @brief The font expanded to pixels for a foreground and background pair, so each glyph row is
+* copied as it is.
+*/
+struct GLYPH_ATLAS
+{
+	ARGB	foreground;
+	ARGB	background;
+	ARGB*	glyphs;	/*< 256 glyphs of GLYPH_HEIGHT rows, top row first*/
+};
+
+/**
+* @brief Expanded color pairs, replaced in turns.
+*/
+PRIVATE GLYPH_ATLAS glyph_atlases[MAX_GLYPH_ATLASES];
+PRIVATE dword glyph_atlases_next = 0;
+
 //==================================CODE======================================//
 #pragma code_seg(".code")
 //============================================================================//
+/**
+* @brief Fills pixels with rep stosd.
+* @param _destination [out] First pixel.
+* @param _color [in] The color.
+* @param _count [in] Number of pixels.
+*/
+PRIVATE void PIXELS_FillString(OUT ARGB* _destination, IN ARGB _color, IN dword _count)
+{
+	__asm
+	{
+		cld
+		mov edi, _destination
+		mov eax, _color
+		mov ecx, _count
+		rep stosd
+	}
+}
+
+/**
+* @brief Copies pixels with rep movsd.
+* @param _destination [out] First pixel to write.
+* @param _source [in] First pixel to read.
+* @param _count [in] Number of pixels.
+*/
+PRIVATE void PIXELS_CopyString(OUT ARGB* _destination, IN ARGB* _source, IN dword _count)
+{
+	__asm
+	{
+		cld
+		mov esi, _source
+		mov edi, _destination
+		mov ecx, _count
+		rep movsd
+	}
+}
+
+/**
+* @brief Mixes pixels with a color, a dword at a time.
+* @param _destination [in, out] First pixel.
+* @param _color [in] The color.
+* @param _count [in] Number of pixels.
+*/
+PRIVATE void PIXELS_BlendString(IN OUT ARGB* _destination, IN ARGB _color, IN dword _count)
+{
+	for(dword i = 0; i < _count; i++)
+	{
+		_destination[i] = COLOR_HalfBlend(_color, _destination[i]);
+	}
+}
+
+/**
+* @brief Fills pixels with 64 bit MMX stores.
+* @param _destination [out] First pixel.
+* @param _color [in] The color.
+* @param _count [in] Number of pixels.
+*/
+PRIVATE void PIXELS_FillMMX(OUT ARGB* _destination, IN ARGB _color, IN dword _count)
+{
+	FPU_STATE state;
+	CPU_SaveFPU(&state);
+
+	__asm
+	{
+		cld
+		mov edi, _destination
+		movd mm0, _color
+		punpckldq mm0, mm0
+
+		//Eight pixels per iteration
+		mov ecx, _count
+		shr ecx, 3
+		jz _Tail
+	_Loop:
+		movq [edi], mm0
+		movq [edi + 8], mm0
+		movq [edi + 16], mm0
+		movq [edi + 24], mm0
+		add edi, 32
+		dec ecx
+		jnz _Loop
+
+	_Tail:
+		mov ecx, _count
+		and ecx, 7
+		mov eax, _color
+		rep stosd
+		emms
+	}
+
+	CPU_RestoreFPU(&state);
+}
+
+/**
+* @brief Copies pixels with 64 bit MMX moves.
+* @param _destination [out] First pixel to write.
+* @param _source [in] First pixel to read.
+* @param _count [in] Number of pixels.
+*/
+PRIVATE void PIXELS_CopyMMX(OUT ARGB* _destination, IN ARGB* _source, IN dword _count)
+{
+	FPU_STATE state;
+	CPU_SaveFPU(&state);
+
+	__asm
+	{
+		cld
+		mov esi, _source
+		mov edi, _destination
+
+		//Eight pixels per iteration
+		mov ecx, _count
+		shr ecx, 3
+		jz _Tail
+	_Loop:
+		movq mm0, [esi]
+		movq mm1, [esi + 8]
+		movq mm2, [esi + 16]
+		movq mm3, [esi + 24]
+		movq [edi], mm0
+		movq [edi + 8], mm1
+		movq [edi + 16], mm2
+		movq [edi + 24], mm3
+		add esi, 32
+		add edi, 32
+		dec ecx
+		jnz _Loop
+
+	_Tail:
+		mov ecx, _count
+		and ecx, 7
+		rep movsd
+		emms
+	}
+
+	CPU_RestoreFPU(&state);
+}
+
+/**
+* @brief Mixes pixels with a color, two at a time in MMX registers.
+* @param _destination [in, out] First pixel.
+* @param _color [in] The color.
+* @param _count [in] Number of pixels.
+*/
+PRIVATE void PIXELS_BlendMMX(IN OUT ARGB* _destination, IN ARGB _color, IN dword _count)
+{
+	FPU_STATE state;
+	CPU_SaveFPU(&state);
+
+	__asm
+	{
+		mov edi, _destination
+		movd mm0, _color
+		punpckldq mm0, mm0
+		mov eax, 0x007F7F7F
+		movd mm1, eax
+		punpckldq mm1, mm1
+
+		//Four pixels per iteration, see COLOR_HalfBlend
+		mov ecx, _count
+		shr ecx, 2
+		jz _Tail
+	_Loop:
+		movq mm2, [edi]
+		movq mm3, [edi + 8]
+		por mm2, mm0
+		por mm3, mm0
+		psrld mm2, 1
+		psrld mm3, 1
+		pand mm2, mm1
+		pand mm3, mm1
+		movq [edi], mm2
+		movq [edi + 8], mm3
+		add edi, 16
+		dec ecx
+		jnz _Loop
+
+	_Tail:
+		emms
+	}
+
+	CPU_RestoreFPU(&state);
+
+	for(dword i = _count & ~3; i < _count; i++)
+	{
+		_destination[i] = COLOR_HalfBlend(_color, _destination[i]);
+	}
+}
+
+/**
+* @brief Fills pixels with non temporal stores, that go to memory without passing through the cache.
+* Best for the framebuffer and for buffers that are not read soon.
+* @param _destination [out] First pixel.
+* @param _color [in] The color.
+* @param _count [in] Number of pixels.
+*/
+PRIVATE void PIXELS_FillSSE(OUT ARGB* _destination, IN ARGB _color, IN dword _count)
+{
+	FPU_STATE state;
+	CPU_SaveFPU(&state);
+
+	__asm
+	{
+		cld
+		mov edi, _destination
+		movd mm0, _color
+		punpckldq mm0, mm0
+
+		//Eight pixels per iteration
+		mov ecx, _count
+		shr ecx, 3
+		jz _Tail
+	_Loop:
+		movntq [edi], mm0
+		movntq [edi + 8], mm0
+		movntq [edi + 16], mm0
+		movntq [edi + 24], mm0
+		add edi, 32
+		dec ecx
+		jnz _Loop
+		sfence
+
+	_Tail:
+		mov ecx, _count
+		and ecx, 7
+		mov eax, _color
+		rep stosd
+		emms
+	}
+
+	CPU_RestoreFPU(&state);
+}
+
+/**
+* @brief Copies pixels prefetching the source and with non temporal stores.
+* @param _destination [out] First pixel to write.
+* @param _source [in] First pixel to read.
+* @param _count [in] Number of pixels.
+*/
+PRIVATE void PIXELS_CopySSE(OUT ARGB* _destination, IN ARGB* _source, IN dword _count)
+{
+	FPU_STATE state;
+	CPU_SaveFPU(&state);
+
+	__asm
+	{
+		cld
+		mov esi, _source
+		mov edi, _destination
+
+		//Eight pixels per iteration
+		mov ecx, _count
+		shr ecx, 3
+		jz _Tail
+	_Loop:
+		prefetchnta [esi + PIXELS_PREFETCH]
+		movq mm0, [esi]
+		movq mm1, [esi + 8]
+		movq mm2, [esi + 16]
+		movq mm3, [esi + 24]
+		movntq [edi], mm0
+		movntq [edi + 8], mm1
+		movntq [edi + 16], mm2
+		movntq [edi + 24], mm3
+		add esi, 32
+		add edi, 32
+		dec ecx
+		jnz _Loop
+		sfence
+
+	_Tail:
+		mov ecx, _count
+		and ecx, 7
+		rep movsd
+		emms
+	}
+
+	CPU_RestoreFPU(&state);
+}
+
+#define PIXELS_STRING_IMPLEMENTATION	{0,										PIXELS_FillString,	PIXELS_CopyString,	PIXELS_BlendString}
+#define PIXELS_MMX_IMPLEMENTATION		{CPU_FEATURE_MMX,						PIXELS_FillMMX,		PIXELS_CopyMMX,		PIXELS_BlendMMX}
+#define PIXELS_SSE_IMPLEMENTATION		{CPU_FEATURE_MMX | CPU_FEATURE_SSE,	PIXELS_FillSSE,		PIXELS_CopySSE,		PIXELS_BlendMMX}
+
+/**
+* @brief Row primitives implementations, indexed by PIXELS_STRING, PIXELS_MMX and PIXELS_SSE. Blending
+* reads the destination anyway, so SSE uses the MMX one.
+*/
+PRIVATE PIXELS_IMPLEMENTATION pixels_implementations[MAX_PIXELS_IMPLEMENTATIONS] = {
+	PIXELS_STRING_IMPLEMENTATION,
+	PIXELS_MMX_IMPLEMENTATION,
+	PIXELS_SSE_IMPLEMENTATION};
+
+/**
+* @brief The implementation in use, the best one the CPU has.
+*/
+PRIVATE PIXELS_IMPLEMENTATION* pixels = &pixels_implementations[PIXELS_STRING];
+
+/**
+* @brief Tells if the CPU can run an implementation of the row primitives.
+* @param _implementation [in] PIXELS_STRING, PIXELS_MMX or PIXELS_SSE.
+* @return True if it can.
+*/
+PRIVATE bool PIXELS_IsSupported(IN dword _implementation)
+{
+	if(_implementation >= MAX_PIXELS_IMPLEMENTATIONS)
+		return false;
+
+	dword features = pixels_implementations[_implementation].features;
+	return (svga_cpu_features & features) == features;
+}
+
+/**
+* @brief Fills a run of pixels with a color, written as it is.
+* @param _destination [out] First pixel.
+* @param _color [in] The color.
+* @param _count [in] Number of pixels.
+*/
+PUBLIC void PIXELS_Fill(OUT ARGB* _destination, IN ARGB _color, IN dword _count)
+{
+	if(_count < PIXELS_SIMD_MINIMUM)
+		PIXELS_FillString(_destination, _color, _count);
+	else
+		pixels->fill(_destination, _color, _count);
+}
+
+/**
+* @brief Copies a run of pixels. Runs may overlap only if the destination is below the source.
+* @param _destination [out] First pixel to write.
+* @param _source [in] First pixel to read.
+* @param _count [in] Number of pixels.
+*/
+PUBLIC void PIXELS_Copy(OUT ARGB* _destination, IN ARGB* _source, IN dword _count)
+{
+	if(_count < PIXELS_SIMD_MINIMUM)
+		PIXELS_CopyString(_destination, _source, _count);
+	else
+		pixels->copy(_destination, _source, _count);
+}
+
+/**
+* @brief Mixes a run of pixels with a color, half and half (what transparent colors do).
+* @param _destination [in, out] First pixel.
+* @param _color [in] The color.
+* @param _count [in] Number of pixels.
+*/
+PUBLIC void PIXELS_Blend(IN OUT ARGB* _destination, IN ARGB _color, IN dword _count)
+{
+	if(_count < PIXELS_SIMD_MINIMUM)
+		PIXELS_BlendString(_destination, _color, _count);
+	else
+		pixels->blend(_destination, _color, _count);
+}
+
+/**
+* @brief Converts a run of 24 bit blue, green, red pixels (as stored in bitmaps).
+* @param _destination [out] First pixel to write.
+* @param _source [in] First byte of the run.
+* @param _count [in] Number of pixels.
+*/
+PUBLIC void PIXELS_FromBGR(OUT ARGB* _destination, IN byte* _source, IN dword _count)
+{
+	//Four pixels are three whole dwords
+	dword* source = (dword*)_source;
+	for(; _count >= 4; _count -= 4)
+	{
+		dword d0 = source[0];
+		dword d1 = source[1];
+		dword d2 = source[2];
+		_destination[0] = d0 & 0x00FFFFFF;
+		_destination[1] = (d0 >> 24) | ((d1 & 0x0000FFFF) << 8);
+		_destination[2] = (d1 >> 16) | ((d2 & 0x000000FF) << 16);
+		_destination[3] = d2 >> 8;
+		_destination += 4;
+		source += 3;
+	}
+
+	byte* tail = (byte*)source;
+	for(; _count; _count--)
+	{
+		*_destination++ = SRGB(tail[2], tail[1], tail[0]);
+		tail += 3;
+	}
+}
+
+/**
+* @brief Converts a run of 32 bit blue, green, red, unused pixels (as stored in bitmaps). The unused
+* byte is dropped, so the pixels are solid.
+* @param _destination [out] First pixel to write.
+* @param _source [in] First byte of the run.
+* @param _count [in] Number of pixels.
+*/
+PUBLIC void PIXELS_FromBGRX(OUT ARGB* _destination, IN byte* _source, IN dword _count)
+{
+	dword* source = (dword*)_source;
+	for(dword i = 0; i < _count; i++)
+	{
+		_destination[i] = source[i] & 0x00FFFFFF;
+	}
+}
+
+/**
+* @brief Runs once one of the row primitives with a given implementation, to measure it.
+* @param _primitive [in] PIXELS_FILL, PIXELS_COPY or PIXELS_BLEND.
+* @param _implementation [in] PIXELS_STRING, PIXELS_MMX or PIXELS_SSE.
+* @param _buffer [in, out] Memory for 2*_count pixels (copy goes from the first half to the second one).
+* @param _count [in] Number of pixels.
+* @return False if the CPU has not the implementation or the primitive is unknown.
+*/
+PUBLIC bool PIXELS_Benchmark(IN dword _primitive, IN dword _implementation, IN OUT ARGB* _buffer, IN dword _count)
+{
+	if(!PIXELS_IsSupported(_implementation))
+		return false;
+
+	PIXELS_IMPLEMENTATION* implementation = &pixels_implementations[_implementation];
+	switch(_primitive)
+	{
+		case PIXELS_FILL:
+		{
+			implementation->fill(_buffer, SRGB(0, 0, 255), _count);
+			return true;
+		}
+		case PIXELS_COPY:
+		{
+			implementation->copy(_buffer + _count, _buffer, _count);
+			return true;
+		}
+		case PIXELS_BLEND:
+		{
+			implementation->blend(_buffer, TRGB(255, 255, 255), _count);
+			return true;
+		}
+	}
+	return false;
+}
+
 /**
 * @brief SVGA Initialization.
 * @return Returns true if svga is enabled.
@@ -298,110 +782,397 @@ PUBLIC bool SVGA_Init(IN SVGA_LOADER_DATA* _loader_data)
 	svga_screen_size.width	= _loader_data->x_resolution;
 	svga_screen_size.height	= _loader_data->y_resolution;
 	svga_framebuffer		= (ARGB*)_loader_data->framebuffer;
+
+	//Row 0 is the last one in memory
+	svga_screen.origin	= svga_framebuffer + (svga_screen_size.height - 1) * svga_screen_size.width;
+	svga_screen.pitch	= -(long)svga_screen_size.width;
+	svga_screen.width	= svga_screen_size.width;
+	svga_screen.height	= svga_screen_size.height;
+
+	//Best row primitives the CPU can run
+	svga_cpu_features = CPU_GetFeatures();
+	for(dword i = 0; i < MAX_PIXELS_IMPLEMENTATIONS; i++)
+	{
+		if(PIXELS_IsSupported(i))
+			pixels = &pixels_implementations[i];
+	}
 	
 	return SVGA_IsGraphicModeEnabled();
 }
 
+/**
+* @brief Describes a memory bitmap as a surface.
+* @param _surface [out] The surface.
+* @param _pixels [in] The pixels, row 0 first.
+* @param _width [in] Pixels per row.
+* @param _height [in] Number of rows.
+*/
+PUBLIC void SURFACE_Init(OUT SURFACE* _surface, IN ARGB* _pixels, IN dword _width, IN dword _height)
+{
+	_surface->origin	= _pixels;
+	_surface->pitch		= (long)_width;
+	_surface->width		= _width;
+	_surface->height	= _height;
+}
+
 /**
 * @brief Calculates de address of a given coordinate.
+* @param _surface [in] The surface.
 * @param _x [in] X coordinate.
 * @param _y [in] Y coordinate.
 * @return Returns the address of the ARGB element for _x and _y.
 */
-PRIVATE ARGB* SVGA_GetDirection(IN dword _x, IN dword _y)
+PRIVATE ARGB* SURFACE_GetDirection(IN SURFACE* _surface, IN dword _x, IN dword _y)
 {
 	//Should do a check...
-	return &svga_framebuffer[((svga_screen_size.height - 1 - _y) * svga_screen_size.width + _x)];
+	return _surface->origin + (long)_y * _surface->pitch + _x;
 }
 
 /**
-* @brief Get the color value in the screen for a coordinate.
+* @brief Get the color value of a surface pixel.
+* @param _surface [in] The surface.
 * @param _x [in] X coordinate.
 * @param _y [in] Y coordinate.
 * @return Returns the color of the pixel.
 */
-PUBLIC ARGB SVGA_GetPixel(IN dword _x, IN dword _y)
+PUBLIC ARGB SURFACE_GetPixel(IN SURFACE* _surface, IN dword _x, IN dword _y)
 {
-	return *SVGA_GetDirection(_x, _y);
+	return *SURFACE_GetDirection(_surface, _x, _y);
 }
 
 /**
-* @brief Set the color value in the screen for a coordinate.
+* @brief Set the color value of a surface pixel.
 * If the color is a transparent one, the color is mixed to get a solid one that makes the transparency.
+* @param _surface [in] The surface.
 * @param _x [in] X coordinate.
 * @param _y [in] Y coordinate.
 * @param _color [in] Color to fill the pixel.
 */
-PUBLIC void SVGA_SetPixel(IN dword _x, IN dword _y, IN ARGB _color)
+PUBLIC void SURFACE_SetPixel(IN SURFACE* _surface, IN dword _x, IN dword _y, IN ARGB _color)
 {
-	ARGB* direction = SVGA_GetDirection(_x, _y);
-	ARGB pixel = *direction;
+	ARGB* direction = SURFACE_GetDirection(_surface, _x, _y);
 
 	if(COLOR_IsTransparent(_color))
+		*direction = COLOR_HalfBlend(_color, *direction);
+	else
+		*direction = _color;
+}
+
+/**
+* @brief Fills a rectangle of a surface with a color. Transparent colors are mixed like in SURFACE_SetPixel.
+* @param _surface [in] The surface.
+* @param _x [in] X coordinate of the low left corner.
+* @param _y [in] Y coordinate of the low left corner.
+* @param _width [in] Number of pixels per row.
+* @param _height [in] Number of rows.
+* @param _color [in] Color to fill with.
+*/
+PUBLIC void SURFACE_Fill(IN SURFACE* _surface, IN dword _x, IN dword _y, IN dword _width, IN dword _height, IN ARGB _color)
+{
+	ARGB* direction = SURFACE_GetDirection(_surface, _x, _y);
+	for(dword i = 0; i < _height; i++)
 	{
-		byte red	= (byte)((((_color&0x00FF0000)>>16)>>1) | (((pixel&0x00FF0000)>>16)>>1));
-		byte green	= (byte)((((_color&0x0000FF00)>>8)>>1)  | (((pixel&0x0000FF00)>>8)>>1));
-		byte blue	= (byte)((((_color&0x000000FF))>>1)     | (((pixel&0x000000FF))>>1));
+		if(COLOR_IsTransparent(_color))
+			PIXELS_Blend(direction, _color, _width);
+		else
+			PIXELS_Fill(direction, _color, _width);
 
-		pixel = (red<<16) | (green<<8) | blue;
+		direction += _surface->pitch;
 	}
-	else
-		pixel = _color;
+}
 
-	//Pixel = Color
-	*direction = pixel;
+/**
+* @brief Copies a run of pixels of a surface row to memory.
+* @param _surface [in] The surface.
+* @param _x [in] X coordinate of the first pixel.
+* @param _y [in] Y coordinate of the row.
+* @param _row [out] Where to leave the pixels.
+* @param _width [in] Number of pixels.
+*/
+PUBLIC void SURFACE_ReadRow(IN SURFACE* _surface, IN dword _x, IN dword _y, OUT ARGB* _row, IN dword _width)
+{
+	PIXELS_Copy(_row, SURFACE_GetDirection(_surface, _x, _y), _width);
 }
 
 /**
-* @brief Fills the screen with color given.
-* @param _color [in] Color to fill the screen with.
+* @brief Copies a run of pixels from memory to a surface row. Colors are written as they are, no
+* transparency is applied.
+* @param _surface [in] The surface.
+* @param _x [in] X coordinate of the first pixel.
+* @param _y [in] Y coordinate of the row.
+* @param _row [in] The pixels.
+* @param _width [in] Number of pixels.
 */
-PUBLIC void SVGA_ClearScreen(IN ARGB _color)
+PUBLIC void SURFACE_WriteRow(IN SURFACE* _surface, IN dword _x, IN dword _y, IN ARGB* _row, IN dword _width)
 {
-	for(dword i = 0; i < svga_screen_size.height * svga_screen_size.width; i++)
-	{
-		svga_framebuffer[i] = _color;
-	}
+	PIXELS_Copy(SURFACE_GetDirection(_surface, _x, _y), _row, _width);
 }
 
 /**
-* @brief Prints one character in the screen.
-* @param _x [in] X coordinate.
+* @brief Writes a row of a surface from bitmap pixels, converting them in place.
+* @param _surface [in] The surface.
+* @param _x [in] X coordinate of the first pixel.
 * @param _y [in] Y coordinate.
+* @param _row [in] The bitmap pixels.
+* @param _width [in] Number of pixels.
+* @param _bits [in] Bits per bitmap pixel, 24 or 32.
+*/
+PUBLIC void SURFACE_WriteRowBGR(IN SURFACE* _surface, IN dword _x, IN dword _y, IN byte* _row, IN dword _width, IN dword _bits)
+{
+	if(_bits == 32)
+		PIXELS_FromBGRX(SURFACE_GetDirection(_surface, _x, _y), _row, _width);
+	else
+		PIXELS_FromBGR(SURFACE_GetDirection(_surface, _x, _y), _row, _width);
+}
+
+/**
+* @brief Prints one character in a surface.
+* @param _surface [in] The surface.
+* @param _x [in] X coordinate.
+* @param _y [in] Y coordinate (top row of the character).
 * @param _color [in] Color to use in character.
 * @param _character [in] Character to print.
 */
-PUBLIC void SVGA_PrintCharacter(IN dword _x, IN dword _y, IN ARGB _color, IN byte _character)
+PUBLIC void SURFACE_PrintCharacter(IN SURFACE* _surface, IN dword _x, IN dword _y, IN ARGB _color, IN byte _character)
 {
-	byte* bitmap = svga_font + _character*8;
+	byte* bitmap = svga_font + _character*GLYPH_HEIGHT;
+	ARGB* direction = SURFACE_GetDirection(_surface, _x, _y);
 
-	for(byte i = 0; i < 8; i++)
+	for(byte i = 0; i < GLYPH_HEIGHT; i++)
 	{
-		for(byte j = 0; j < 8; j++)
+		for(byte j = 0; j < GLYPH_WIDTH; j++)
 		{
 			if( bitmap[i] & (1<<j) )
 			{
-				SVGA_SetPixel(_x + (8 - j) - 1, _y - i, _color);
+				ARGB* pixel = direction + (GLYPH_WIDTH - j) - 1;
+				*pixel = COLOR_IsTransparent(_color)?COLOR_HalfBlend(_color, *pixel):_color;
 			}
 		}
+		//Rows go down
+		direction -= _surface->pitch;
 	}
 }
 
 /**
-* @brief Prints one string in the screen.
+* @brief Prints one string in a surface.
+* @param _surface [in] The surface.
 * @param _x [in] X coordinate.
-* @param _y [in] Y coordinate.
+* @param _y [in] Y coordinate (top row of the text).
 * @param _color [in] Color to use in character.
 * @param _text [in] String to print.
 */
-PUBLIC void SVGA_PrintText(IN dword _x, IN dword _y, IN ARGB _color, IN string* _text)
+PUBLIC void SURFACE_PrintText(IN SURFACE* _surface, IN dword _x, IN dword _y, IN ARGB _color, IN string* _text)
 {
 	for(byte i = 0; i < _text->size; i++)
 	{
-		SVGA_PrintCharacter(_x + i * 8, _y, _color, _text->text[i]);
+		SURFACE_PrintCharacter(_surface, _x + i * 8, _y, _color, _text->text[i]);
 	}	
 }
 
+/**
+* @brief Finds the font expanded for a color pair, expanding it if needed.
+* @param _foreground [in] Color of the set bits.
+* @param _background [in] Color of the clear bits.
+* @return The atlas, zero if there is no memory for it.
+*/
+PRIVATE GLYPH_ATLAS* GLYPH_GetAtlas(IN ARGB _foreground, IN ARGB _background)
+{
+	for(dword i = 0; i < MAX_GLYPH_ATLASES; i++)
+	{
+		if(glyph_atlases[i].glyphs && glyph_atlases[i].foreground == _foreground && glyph_atlases[i].background == _background)
+			return &glyph_atlases[i];
+	}
+
+	GLYPH_ATLAS* atlas = &glyph_atlases[glyph_atlases_next];
+	if(!atlas->glyphs)
+	{
+		atlas->glyphs = (ARGB*)MEM_AllocPages(GLYPH_ATLAS_PAGES, KernelMode);
+		if(!atlas->glyphs)
+			return 0;
+	}
+	glyph_atlases_next = (glyph_atlases_next + 1) % MAX_GLYPH_ATLASES;
+
+	atlas->foreground = _foreground;
+	atlas->background = _background;
+
+	ARGB* pixel = atlas->glyphs;
+	for(dword i = 0; i < 256*GLYPH_HEIGHT; i++)
+	{
+		//Bit 7 is the leftmost pixel
+		for(dword j = 0; j < GLYPH_WIDTH; j++)
+		{
+			*pixel++ = (svga_font[i] & (0x80>>j))?_foreground:_background;
+		}
+	}
+	return atlas;
+}
+
+/**
+* @brief Prints one string in a surface with the background of each character filled. Solid color
+* pairs are drawn by copying whole glyph rows from an atlas.
+* @param _surface [in] The surface.
+* @param _x [in] X coordinate.
+* @param _y [in] Y coordinate (top row of the text).
+* @param _foreground [in] Color to use in characters.
+* @param _background [in] Color to use behind characters.
+* @param _text [in] String to print.
+*/
+PUBLIC void SURFACE_PrintTextOpaque(IN SURFACE* _surface, IN dword _x, IN dword _y, IN ARGB _foreground, IN ARGB _background, IN string* _text)
+{
+	GLYPH_ATLAS* atlas = 0;
+	if(COLOR_IsSolid(_foreground) && COLOR_IsSolid(_background))
+		atlas = GLYPH_GetAtlas(_foreground, _background);
+
+	if(!atlas)
+	{
+		//Transparent colors depend on what is below
+		SURFACE_Fill(_surface, _x, _y - (GLYPH_HEIGHT - 1), _text->size * GLYPH_WIDTH, GLYPH_HEIGHT, _background);
+		SURFACE_PrintText(_surface, _x, _y, _foreground, _text);
+		return;
+	}
+
+	for(byte i = 0; i < _text->size; i++)
+	{
+		ARGB* glyph = atlas->glyphs + _text->text[i]*GLYPH_PIXELS;
+		ARGB* direction = SURFACE_GetDirection(_surface, _x + i * GLYPH_WIDTH, _y);
+		for(dword row = 0; row < GLYPH_HEIGHT; row++)
+		{
+			PIXELS_Copy(direction, glyph, GLYPH_WIDTH);
+			glyph += GLYPH_WIDTH;
+			direction -= _surface->pitch;
+		}
+	}
+}
+
+/**
+* @brief Moves a block of rows of a surface up, to scroll it. The top _distance rows are lost and the
+* bottom _distance rows keep their old pixels.
+* @param _surface [in] The surface.
+* @param _x [in] X coordinate of the low left corner.
+* @param _y [in] Y coordinate of the low left corner.
+* @param _width [in] Number of pixels per row.
+* @param _height [in] Number of rows.
+* @param _distance [in] Rows to move.
+*/
+PUBLIC void SURFACE_ScrollUp(IN SURFACE* _surface, IN dword _x, IN dword _y, IN dword _width, IN dword _height, IN dword _distance)
+{
+	if(!_distance || _distance >= _height)
+		return;
+
+	//From the top, so no row is overwritten before being moved
+	for(dword row = _y + _height - 1; row >= _y + _distance; row--)
+	{
+		PIXELS_Copy(SURFACE_GetDirection(_surface, _x, row), SURFACE_GetDirection(_surface, _x, row - _distance), _width);
+	}
+}
+
+/**
+* @brief Get the color value in the screen for a coordinate.
+* @param _x [in] X coordinate.
+* @param _y [in] Y coordinate.
+* @return Returns the color of the pixel.
+*/
+PUBLIC ARGB SVGA_GetPixel(IN dword _x, IN dword _y)
+{
+	return SURFACE_GetPixel(&svga_screen, _x, _y);
+}
+
+/**
+* @brief Set the color value in the screen for a coordinate.
+* If the color is a transparent one, the color is mixed to get a solid one that makes the transparency.
+* @param _x [in] X coordinate.
+* @param _y [in] Y coordinate.
+* @param _color [in] Color to fill the pixel.
+*/
+PUBLIC void SVGA_SetPixel(IN dword _x, IN dword _y, IN ARGB _color)
+{
+	SURFACE_SetPixel(&svga_screen, _x, _y, _color);
+}
+
+/**
+* @brief Fills the screen with color given.
+* @param _color [in] Color to fill the screen with.
+*/
+PUBLIC void SVGA_ClearScreen(IN ARGB _color)
+{
+	SURFACE_Fill(&svga_screen, 0, 0, svga_screen_size.width, svga_screen_size.height, _color);
+}
+
+/**
+* @brief Copies a run of pixels of a screen row to memory.
+* @param _x [in] X coordinate of the first pixel.
+* @param _y [in] Y coordinate of the row.
+* @param _row [out] Where to leave the pixels.
+* @param _width [in] Number of pixels.
+*/
+PUBLIC void SVGA_ReadRow(IN dword _x, IN dword _y, OUT ARGB* _row, IN dword _width)
+{
+	SURFACE_ReadRow(&svga_screen, _x, _y, _row, _width);
+}
+
+/**
+* @brief Copies a run of pixels from memory to a screen row. Colors are written as they are, no
+* transparency is applied.
+* @param _x [in] X coordinate of the first pixel.
+* @param _y [in] Y coordinate of the row.
+* @param _row [in] The pixels.
+* @param _width [in] Number of pixels.
+*/
+PUBLIC void SVGA_WriteRow(IN dword _x, IN dword _y, IN ARGB* _row, IN dword _width)
+{
+	SURFACE_WriteRow(&svga_screen, _x, _y, _row, _width);
+}
+
+/**
+* @brief Prints one character in the screen.
+* @param _x [in] X coordinate.
+* @param _y [in] Y coordinate.
+* @param _color [in] Color to use in character.
+* @param _character [in] Character to print.
+*/
+PUBLIC void SVGA_PrintCharacter(IN dword _x, IN dword _y, IN ARGB _color, IN byte _character)
+{
+	SURFACE_PrintCharacter(&svga_screen, _x, _y, _color, _character);
+}
+
+/**
+* @brief Prints one string in the screen.
+* @param _x [in] X coordinate.
+* @param _y [in] Y coordinate.
+* @param _color [in] Color to use in character.
+* @param _text [in] String to print.
+*/
+PUBLIC void SVGA_PrintText(IN dword _x, IN dword _y, IN ARGB _color, IN string* _text)
+{
+	SURFACE_PrintText(&svga_screen, _x, _y, _color, _text);
+}
+
+/**
+* @brief Fills a rectangle of the screen with a color.
+* @param _x [in] X coordinate of the low left corner.
+* @param _y [in] Y coordinate of the low left corner.
+* @param _width [in] Number of pixels per row.
+* @param _height [in] Number of rows.
+* @param _color [in] Color to fill with.
+*/
+PUBLIC void SVGA_Fill(IN dword _x, IN dword _y, IN dword _width, IN dword _height, IN ARGB _color)
+{
+	SURFACE_Fill(&svga_screen, _x, _y, _width, _height, _color);
+}
+
+/**
+* @brief Moves a block of screen rows up, to scroll it.
+* @param _x [in] X coordinate of the low left corner.
+* @param _y [in] Y coordinate of the low left corner.
+* @param _width [in] Number of pixels per row.
+* @param _height [in] Number of rows.
+* @param _distance [in] Rows to move.
+*/
+PUBLIC void SVGA_ScrollUp(IN dword _x, IN dword _y, IN dword _width, IN dword _height, IN dword _distance)
+{
+	SURFACE_ScrollUp(&svga_screen, _x, _y, _width, _height, _distance);
+}
+
 /**
 * @brief Indicates if graphic mode has started.
 * @return True if we are in graphic mode, false otherwise.
@@ -56,6 +56,52 @@
 	* @brief Tells if a given color is transparent.
 	*/
 	#define	COLOR_IsTransparent(C)		(((C) & 0xFF000000)?true:false)	//bool COLOR_IsTransparent(IN ARGB _color);
+	/**
+	* @brief Mixes a transparent color with a pixel, half of each (the halves of each channel are or'ed).
+	*/
+	#define COLOR_HalfBlend(C, P)		((((C) | (P)) >> 1) & 0x007F7F7F)	//ARGB COLOR_HalfBlend(IN ARGB _color, IN ARGB _pixel);
+
+	/**
+	* @brief Row primitives and their implementations.
+	*/
+	#define PIXELS_FILL		0	/**< PIXELS_Fill*/
+	#define PIXELS_COPY		1	/**< PIXELS_Copy*/
+	#define PIXELS_BLEND	2	/**< PIXELS_Blend*/
+
+	#define PIXELS_STRING	0	/**< rep stosd and rep movsd*/
+	#define PIXELS_MMX		1	/**< 64 bit MMX moves*/
+	#define PIXELS_SSE		2	/**< MMX with prefetch and non temporal stores*/
+	#define MAX_PIXELS_IMPLEMENTATIONS	3
+
+	void	PIXELS_Fill		(OUT ARGB* _destination, IN ARGB _color, IN dword _count);
+	void	PIXELS_Copy		(OUT ARGB* _destination, IN ARGB* _source, IN dword _count);
+	void	PIXELS_Blend	(IN OUT ARGB* _destination, IN ARGB _color, IN dword _count);
+	void	PIXELS_FromBGR	(OUT ARGB* _destination, IN byte* _source, IN dword _count);
+	void	PIXELS_FromBGRX	(OUT ARGB* _destination, IN byte* _source, IN dword _count);
+	bool	PIXELS_Benchmark(IN dword _primitive, IN dword _implementation, IN OUT ARGB* _buffer, IN dword _count);
+
+	/**
+	* @brief A bitmap where pixels can be drawn, row 0 being the bottom one.
+	*/
+	struct SURFACE
+	{
+		ARGB*	origin;	/*< First pixel of row 0*/
+		long	pitch;	/*< Pixels from a row to the next one, negative if rows go down in memory*/
+		dword	width;
+		dword	height;
+	};
+
+	void	SURFACE_Init			(OUT SURFACE* _surface, IN ARGB* _pixels, IN dword _width, IN dword _height);
+	ARGB	SURFACE_GetPixel		(IN SURFACE* _surface, IN dword _x, IN dword _y);
+	void	SURFACE_SetPixel		(IN SURFACE* _surface, IN dword _x, IN dword _y, IN ARGB _color);
+	void	SURFACE_Fill			(IN SURFACE* _surface, IN dword _x, IN dword _y, IN dword _width, IN dword _height, IN ARGB _color);
+	void	SURFACE_ReadRow			(IN SURFACE* _surface, IN dword _x, IN dword _y, OUT ARGB* _row, IN dword _width);
+	void	SURFACE_WriteRow		(IN SURFACE* _surface, IN dword _x, IN dword _y, IN ARGB* _row, IN dword _width);
+	void	SURFACE_WriteRowBGR		(IN SURFACE* _surface, IN dword _x, IN dword _y, IN byte* _row, IN dword _width, IN dword _bits);
+	void	SURFACE_PrintCharacter	(IN SURFACE* _surface, IN dword _x, IN dword _y, IN ARGB _color, IN byte _character);
+	void	SURFACE_PrintText		(IN SURFACE* _surface, IN dword _x, IN dword _y, IN ARGB _color, IN string* _text);
+	void	SURFACE_PrintTextOpaque	(IN SURFACE* _surface, IN dword _x, IN dword _y, IN ARGB _foreground, IN ARGB _background, IN string* _text);
+	void	SURFACE_ScrollUp		(IN SURFACE* _surface, IN dword _x, IN dword _y, IN dword _width, IN dword _height, IN dword _distance);
 
 	bool	SVGA_Init(IN SVGA_LOADER_DATA* _loader_data);
 
@@ -66,7 +112,11 @@
 	ARGB	SVGA_GetPixel		(IN dword _x, IN dword _y);
 	void	SVGA_SetPixel		(IN dword _x, IN dword _y, IN ARGB _color);
 	void	SVGA_ClearScreen	(IN ARGB _color);
+	void	SVGA_ReadRow		(IN dword _x, IN dword _y, OUT ARGB* _row, IN dword _width);
+	void	SVGA_WriteRow		(IN dword _x, IN dword _y, IN ARGB* _row, IN dword _width);
 	void	SVGA_PrintCharacter	(IN dword _x, IN dword _y, IN ARGB _color, IN byte _character);
 	void	SVGA_PrintText		(IN dword _x, IN dword _y, IN ARGB _color, IN string* _text);
+	void	SVGA_Fill			(IN dword _x, IN dword _y, IN dword _width, IN dword _height, IN ARGB _color);
+	void	SVGA_ScrollUp		(IN dword _x, IN dword _y, IN dword _width, IN dword _height, IN dword _distance);
 	
 #endif //__SVGA_H__
@@ -20,6 +20,23 @@
 */
 PRIVATE SVGA_LOADER_DATA svga_mapping_info;
 
+/**
+* @brief A range of kernel memory visible from every address space.
+*/
+struct KERNEL_RANGE
+{
+	PHYSICAL	address;
+	dword		number_of_pages;
+};
+
+#define MAX_KERNEL_RANGES	8	/**< Maximum number of kernel ranges*/
+
+/**
+* @brief Kernel ranges to map in newly created address spaces.
+*/
+PRIVATE KERNEL_RANGE kernel_ranges[MAX_KERNEL_RANGES];
+PRIVATE dword kernel_ranges_number = 0;
+
 //==================================CODE======================================//
 #pragma code_seg(".code")
 //============================================================================//
@@ -77,12 +94,8 @@ PRIVATE bool ADDRESS_SPACE_MapPage(IN ADDRESS_SPACE _pdbr, IN PHYSICAL _phys_add
 		if(!page_table)
 			return false;
 
-		//Fill
-		for(dword i = 0; i < PAGE_SIZE/4; i++)
-		{
-			//Entry as a whole
-			page_table->entries[i].value = 0;
-		}
+		//Fill, all the entries not present
+		RTL_Fill((PHYSICAL)page_table, 0, PAGE_SIZE);
 
 		//Link the new page table
 		pde->value = ((dword)page_table) & 0xFFFFF000;
@@ -160,10 +173,34 @@ PUBLIC ADDRESS_SPACE ADDRESS_SPACE_Create()
 	//ADDRESS_SPACE_Map(address_space, svga_mapping_info.framebuffer, svga_mapping_info.framebuffer, (svga_mapping_info.x_resolution*svga_mapping_info.y_resolution*4)/PAGE_SIZE, KernelMode, ReadWrite, true);
 	ADDRESS_SPACE_Map(address_space, svga_mapping_info.framebuffer, svga_mapping_info.framebuffer, RTL_BytesToPages(svga_mapping_info.x_resolution*svga_mapping_info.y_resolution*4), KernelMode, ReadWrite, true);
 
+	//Map kernel ranges
+	for(dword i = 0; i < kernel_ranges_number; i++)
+	{
+		ADDRESS_SPACE_Map(address_space, kernel_ranges[i].address, kernel_ranges[i].address, kernel_ranges[i].number_of_pages, KernelMode, ReadWrite, false);
+	}
+
 	//Ok
 	return address_space;
 }
 
+/**
+* @brief Makes a range of pages visible to the kernel from every address space created afterwards,
+* at the same address (identity mapped, supervisor only). The pages are not released with the spaces.
+* @param _address [in] Physical address of the first page.
+* @param _number_of_pages [in] Number of pages.
+* @return True if the range was added.
+*/
+PUBLIC bool ADDRESS_SPACE_AddKernelRange(IN PHYSICAL _address, IN dword _number_of_pages)
+{
+	if(kernel_ranges_number >= MAX_KERNEL_RANGES)
+		return false;
+
+	kernel_ranges[kernel_ranges_number].address = _address;
+	kernel_ranges[kernel_ranges_number].number_of_pages = _number_of_pages;
+	kernel_ranges_number++;
+	return true;
+}
+
 /**
 * @brief Maps a range of pages in a virtual memory address space.
 * @param _pdbr [in] The page directory address of the address space.
@@ -246,14 +283,70 @@ PUBLIC bool ADDRESS_SPACE_IsMapped(IN ADDRESS_SPACE _pdbr, IN VIRTUAL _virt_addr
 	return true;
 }
 
+/**
+* @brief Tells if a page table entry holds a user page released with the address space. Pages not yet
+* read by the pager are not present but owned too.
+* @param _pte [in] The page table entry.
+* @return True if the page is owned.
+*/
+PRIVATE bool ADDRESS_SPACE_IsOwnedPage(IN PTE* _pte)
+{
+	return _pte && _pte->available && _pte->user_supervisor == UserMode;
+}
+
+/**
+* @brief Counts the user pages owned by an address space in a range.
+* @param _pdbr [in] The page directory address of the address space.
+* @param _virt_address [in] Virtual address of the first page.
+* @param _number_of_pages [in] Number of pages.
+* @return The number of owned pages.
+*/
+PUBLIC dword ADDRESS_SPACE_GetOwnedPages(IN ADDRESS_SPACE _pdbr, IN VIRTUAL _virt_address, IN dword _number_of_pages)
+{
+	dword owned = 0;
+	for(dword i = 0; i < _number_of_pages; i++)
+	{
+		if(ADDRESS_SPACE_IsOwnedPage(VIRTUAL_PTE_Address(_pdbr, _virt_address + PAGE_SIZE*i)))
+			owned++;
+	}
+	return owned;
+}
+
+/**
+* @brief Counts all the user pages owned by an address space.
+* @param _pdbr [in] The page directory address of the address space.
+* @return The number of owned pages.
+*/
+PUBLIC dword ADDRESS_SPACE_GetAllOwnedPages(IN ADDRESS_SPACE _pdbr)
+{
+	PageDirectory* directory = (PageDirectory*)(_pdbr);
+
+	dword owned = 0;
+	for(dword i = 2; i < 1024; i++)
+	{
+		if(directory->entries[i].present)
+		{
+			PageTable* table = (PageTable*)(directory->entries[i].address << 12);
+			for(dword j = 0; j < 1024; j++)
+			{
+				if(ADDRESS_SPACE_IsOwnedPage(&table->entries[j]))
+					owned++;
+			}
+		}
+	}
+	return owned;
+}
+
 /**
 * @brief Deletes a virtual memory address space.
 * @param _pdbr [in] The page directory address of the address space.
+* @return The number of user pages it owned, for accounting.
 */
-PUBLIC void ADDRESS_SPACE_Release(IN ADDRESS_SPACE _pdbr)
+PUBLIC dword ADDRESS_SPACE_Release(IN ADDRESS_SPACE _pdbr)
 {
 	PageDirectory* directory = (PageDirectory*)(_pdbr);
 
+	dword owned = 0;
 	for(dword i = 2; i < 1024; i++)
 	{
 		if(directory->entries[i].present)
@@ -261,6 +354,9 @@ PUBLIC void ADDRESS_SPACE_Release(IN ADDRESS_SPACE _pdbr)
 			PageTable* table = (PageTable*)(directory->entries[i].address << 12);
 			for(dword j = 0; j < 1024; j++)
 			{
+				if(ADDRESS_SPACE_IsOwnedPage(&table->entries[j]))
+					owned++;
+
 				//if marked for deletion...
 				if(/*table->entries[j].present &&*/ table->entries[j].available)
 					MEM_ReleasePages((table->entries[j].address << 12), 1);
@@ -271,6 +367,7 @@ PUBLIC void ADDRESS_SPACE_Release(IN ADDRESS_SPACE _pdbr)
 	}
 
 	MEM_ReleasePages(_pdbr, 3);
+	return owned;
 }
 
 /**
@@ -23,11 +23,16 @@
 	bool ADDRESS_SPACE_Init(IN SVGA_LOADER_DATA* _svga_loader_data);
 
 	ADDRESS_SPACE	ADDRESS_SPACE_Create	();
-	void			ADDRESS_SPACE_Release	(IN ADDRESS_SPACE _pdbr);
+	dword			ADDRESS_SPACE_Release	(IN ADDRESS_SPACE _pdbr);
 	bool			ADDRESS_SPACE_Map		(IN ADDRESS_SPACE _pdbr, IN PHYSICAL _phys_address, IN VIRTUAL _virt_address, IN dword _number_of_pages, IN ExecutionType _execution, IN AccessType _access, IN bool _release);
 	bool			ADDRESS_SPACE_Unmap		(IN ADDRESS_SPACE _pdbr, IN VIRTUAL _virt_address, IN dword _number_of_pages);
 	bool			ADDRESS_SPACE_IsMapped	(IN ADDRESS_SPACE _pdbr, IN VIRTUAL _virt_address, IN dword _number_of_pages);
 
+	dword			ADDRESS_SPACE_GetOwnedPages		(IN ADDRESS_SPACE _pdbr, IN VIRTUAL _virt_address, IN dword _number_of_pages);
+	dword			ADDRESS_SPACE_GetAllOwnedPages	(IN ADDRESS_SPACE _pdbr);
+
+	bool			ADDRESS_SPACE_AddKernelRange(IN PHYSICAL _address, IN dword _number_of_pages);
+
 	void			ADDRESS_SPACE_SwitchTo	(IN ADDRESS_SPACE _pdbr);
 	ADDRESS_SPACE	ADDRESS_SPACE_GetCurrent();
 
@@ -0,0 +1,130 @@
+/******************************************************************************/
+/**
+* @file		Bitmap.cpp
+* @brief	XkyOS Bitmap decoder
+* Implementation of the BMP decoder. Uncompressed 24 and 32 bit files, stored bottom up or top down,
+* are checked against their size and converted a row at a time.
+*
+* @date		20/03/2008
+* @author	Pablo Bravo
+*/
+/******************************************************************************/
+#include "Bitmap.h"
+
+//==================================DATA======================================//
+#pragma data_seg(".data")
+//============================================================================//
+/**
+* @brief Header describing the pixels, right after the 14 bytes of the file header.
+*/
+struct BITMAP_INFO_HEADER
+{
+	dword	size;
+	long	width;
+	long	height;
+	word	planes;
+	word	bits;
+	dword	compression;
+	dword	image_size;
+	long	x_pixels_per_meter;
+	long	y_pixels_per_meter;
+	dword	colors_used;
+	dword	colors_important;
+};
+
+#define BITMAP_SIGNATURE		0x4D42	/**< 'BM'*/
+#define BITMAP_FILE_HEADER_SIZE	14		/**< Signature, file size, reserved and pixels offset*/
+#define BITMAP_PIXELS_OFFSET	10		/**< Where the file header keeps the pixels offset*/
+#define BITMAP_RGB				0		/**< Uncompressed*/
+#define BITMAP_BITFIELDS		3		/**< Uncompressed with channel masks*/
+#define BITMAP_MAX_SIDE			0x4000	/**< Larger sides are refused, so sizes can't overflow*/
+
+//==================================CODE======================================//
+#pragma code_seg(".code")
+//============================================================================//
+/**
+* @brief Validates a BMP file in memory.
+* @param _bitmap [out] The bitmap description.
+* @param _file [in] The file contents.
+* @param _size [in] The file size.
+* @return False if the file is not a bitmap this decoder can draw, or it is truncated.
+*/
+PUBLIC bool BITMAP_Open(OUT BITMAP* _bitmap, IN byte* _file, IN dword _size)
+{
+	if(_size < BITMAP_FILE_HEADER_SIZE + sizeof(BITMAP_INFO_HEADER) || *(word*)_file != BITMAP_SIGNATURE)
+		return false;
+
+	BITMAP_INFO_HEADER* info = (BITMAP_INFO_HEADER*)(_file + BITMAP_FILE_HEADER_SIZE);
+	if(info->size < sizeof(BITMAP_INFO_HEADER) || info->planes != 1 || (info->bits != 24 && info->bits != 32))
+		return false;
+
+	//Channel masks follow the info header, only the usual layout is drawn
+	if(info->compression == BITMAP_BITFIELDS)
+	{
+		dword* masks = (dword*)(_file + BITMAP_FILE_HEADER_SIZE + sizeof(BITMAP_INFO_HEADER));
+		if(	info->bits != 32 ||
+			_size < BITMAP_FILE_HEADER_SIZE + sizeof(BITMAP_INFO_HEADER) + 3*sizeof(dword) ||
+			masks[0] != 0x00FF0000 || masks[1] != 0x0000FF00 || masks[2] != 0x000000FF)
+			return false;
+	}
+	else if(info->compression != BITMAP_RGB)
+	{
+		return false;
+	}
+
+	//Negative height means the first row is the top one
+	bool top_down = info->height < 0;
+	dword width = (dword)info->width;
+	dword height = top_down?(dword)(-info->height):(dword)info->height;
+	if(info->width <= 0 || !height || width > BITMAP_MAX_SIDE || height > BITMAP_MAX_SIDE)
+		return false;
+
+	//Rows are padded to dwords
+	dword stride = ((width*info->bits + 31)/32)*4;
+	dword offset = *(dword*)(_file + BITMAP_PIXELS_OFFSET);
+	if(offset > _size || stride*height > _size - offset)
+		return false;
+
+	_bitmap->width = width;
+	_bitmap->height = height;
+	_bitmap->bits = info->bits;
+	if(top_down)
+	{
+		_bitmap->bottom = _file + offset + (height - 1)*stride;
+		_bitmap->pitch = -(long)stride;
+	}
+	else
+	{
+		_bitmap->bottom = _file + offset;
+		_bitmap->pitch = (long)stride;
+	}
+	return true;
+}
+
+/**
+* @brief Draws a bitmap in a surface, clipped to it.
+* @param _bitmap [in] The bitmap, from BITMAP_Open.
+* @param _surface [in] The surface.
+* @param _x [in] X coordinate of the low left corner.
+* @param _y [in] Y coordinate of the low left corner.
+*/
+PUBLIC void BITMAP_Draw(IN BITMAP* _bitmap, IN SURFACE* _surface, IN dword _x, IN dword _y)
+{
+	if(_x >= _surface->width || _y >= _surface->height)
+		return;
+
+	dword width = _bitmap->width;
+	if(width > _surface->width - _x)
+		width = _surface->width - _x;
+
+	dword height = _bitmap->height;
+	if(height > _surface->height - _y)
+		height = _surface->height - _y;
+
+	byte* row = _bitmap->bottom;
+	for(dword i = 0; i < height; i++)
+	{
+		SURFACE_WriteRowBGR(_surface, _x, _y + i, row, width, _bitmap->bits);
+		row += _bitmap->pitch;
+	}
+}
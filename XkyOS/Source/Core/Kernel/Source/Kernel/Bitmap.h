@@ -0,0 +1,32 @@
+/******************************************************************************/
+/**
+* @file		Bitmap.h
+* @brief	XkyOS Bitmap decoder
+* Definitions of the BMP decoder that draws whole rows into surfaces.
+*
+* @date		20/03/2008
+* @author	Pablo Bravo
+*/
+/******************************************************************************/
+#ifndef __BITMAP_H__
+#define __BITMAP_H__
+
+	#include "Types.h"
+	#include "SVGA.h"
+
+	/**
+	* @brief A validated BMP file, its rows described like in a surface.
+	*/
+	struct BITMAP
+	{
+		dword	width;
+		dword	height;
+		dword	bits;	/*< Bits per pixel, 24 or 32*/
+		byte*	bottom;	/*< First byte of the bottom row*/
+		long	pitch;	/*< Bytes from a row to the one above, negative for top down files*/
+	};
+
+	bool BITMAP_Open(OUT BITMAP* _bitmap, IN byte* _file, IN dword _size);
+	void BITMAP_Draw(IN BITMAP* _bitmap, IN SURFACE* _surface, IN dword _x, IN dword _y);
+
+#endif //__BITMAP_H__
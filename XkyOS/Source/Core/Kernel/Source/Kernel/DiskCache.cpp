@@ -0,0 +1,337 @@
+/******************************************************************************/
+/**
+* @file		DiskCache.cpp
+* @brief	XkyOS Disk block cache
+* Implementation of the disk block cache. The kernel reads files and image pages through it; when a
+* read starts where an earlier one ended, the blocks that follow are submitted to the disk queue before
+* they are asked for, so they arrive while the reader works on what it has. The window read ahead
+* doubles on every sequential read and goes back to the smallest when the reads jump.
+* Nothing is read ahead without a bus master (a PIO disk, or the floppy RAM disk): the CPU would move
+* the sectors there and then, so the reader would only wait longer. The cache still serves what it holds.
+* Writes forget their blocks when submitted and again when they end, as a read ahead may be submitted
+* while the write is in flight and reach the disk before it.
+*
+* @date		20/03/2008
+* @author	Pablo Bravo
+*/
+/******************************************************************************/
+#include "DiskCache.h"
+#include "RTL.h"
+
+#include "Debug.h"
+
+//==================================DATA======================================//
+#pragma data_seg(".data")
+//============================================================================//
+#define DISK_CACHE_BLOCKS			64							/**< Blocks in the cache (256KB)*/
+#define DISK_CACHE_BLOCK_SECTORS	(PAGE_SIZE/SECTOR_SIZE)		/**< A block is a page, at a multiple of its sectors*/
+#define DISK_CACHE_STREAMS			4							/**< Sequential readers followed at once*/
+#define DISK_CACHE_WINDOW_MIN		16							/**< Sectors read ahead when a stream starts*/
+#define DISK_CACHE_WINDOW_MAX		128							/**< Most sectors read ahead*/
+#define DISK_CACHE_IN_FLIGHT		16							/**< Blocks being read at once, so guests keep room in the disk queue*/
+#define DISK_CACHE_NONE				DISK_CACHE_BLOCKS
+
+#define DISK_CACHE_FREE				0	/**< The block holds nothing*/
+#define DISK_CACHE_READING			1	/**< Its request is in the disk queue*/
+#define DISK_CACHE_VALID			2	/**< It holds its sectors*/
+
+/**
+* @brief A block of the cache.
+*/
+struct DISK_CACHE_BLOCK
+{
+	dword			state;		/*< DISK_CACHE_FREE, DISK_CACHE_READING or DISK_CACHE_VALID*/
+	LBA				lba;		/*< First sector*/
+	DISK_REQUEST	request;	/*< While reading*/
+	bool			stale;		/*< A write ended over it while reading, throw the read away*/
+	dword			used;		/*< Clock of the last read it served*/
+};
+
+/**
+* @brief A sequential reader.
+*/
+struct DISK_CACHE_STREAM
+{
+	LBA		next;		/*< Sector after its last read*/
+	LBA		ahead;		/*< Sector after the last one read ahead*/
+	dword	window;		/*< Sectors to keep read ahead of next*/
+	dword	used;		/*< Clock of its last read*/
+};
+
+PRIVATE DISK_CACHE_BLOCK	disk_cache_blocks[DISK_CACHE_BLOCKS];
+PRIVATE DISK_CACHE_STREAM	disk_cache_streams[DISK_CACHE_STREAMS];
+
+/**
+* @brief Pages of the blocks, zero until the cache is initialized.
+*/
+PRIVATE PHYSICAL disk_cache_memory = 0;
+
+/**
+* @brief Reads served so far.
+*/
+PRIVATE dword disk_cache_clock = 0;
+
+/**
+* @brief Sectors served from the cache, and sectors read ahead.
+*/
+PRIVATE dword disk_cache_hits = 0;
+PRIVATE dword disk_cache_prefetched = 0;
+
+//==================================CODE======================================//
+#pragma code_seg(".code")
+//============================================================================//
+/**
+* @brief Initialize the disk block cache.
+* @return True if successful.
+*/
+PUBLIC bool DISK_CACHE_Init()
+{
+	for(dword i = 0; i < DISK_CACHE_BLOCKS; i++)
+	{
+		disk_cache_blocks[i].state = DISK_CACHE_FREE;
+		disk_cache_blocks[i].used = 0;
+	}
+	for(dword i = 0; i < DISK_CACHE_STREAMS; i++)
+	{
+		disk_cache_streams[i].next = 0;
+		disk_cache_streams[i].ahead = 0;
+		disk_cache_streams[i].window = 0;
+		disk_cache_streams[i].used = 0;
+	}
+
+	disk_cache_memory = MEM_AllocPages(DISK_CACHE_BLOCKS, KernelMode);
+	return disk_cache_memory != 0;
+}
+
+/**
+* @brief Finds the block of some sectors.
+* @param _lba [in] First sector of the block.
+* @return The block, DISK_CACHE_NONE if not in the cache.
+*/
+PRIVATE dword DISK_CACHE_Find(IN LBA _lba)
+{
+	for(dword i = 0; i < DISK_CACHE_BLOCKS; i++)
+	{
+		if(disk_cache_blocks[i].state != DISK_CACHE_FREE && disk_cache_blocks[i].lba == _lba)
+			return i;
+	}
+	return DISK_CACHE_NONE;
+}
+
+/**
+* @brief Waits for a block being read. The disk is polled, so it works with interrupts disabled.
+* @param _index [in] The block.
+* @return True if the block holds its sectors, false if it could not be read and is free again.
+*/
+PRIVATE bool DISK_CACHE_Wait(IN dword _index)
+{
+	DISK_CACHE_BLOCK* block = &disk_cache_blocks[_index];
+	if(block->state == DISK_CACHE_READING)
+	{
+		dword state = DISK_QUEUE_Poll(0, block->request);
+		while(state == DISK_REQUEST_PENDING)
+		{
+			HD_Drain();
+			state = DISK_QUEUE_Poll(0, block->request);
+		}
+		block->state = (state == DISK_REQUEST_DONE && !block->stale) ? DISK_CACHE_VALID : DISK_CACHE_FREE;
+	}
+	return block->state == DISK_CACHE_VALID;
+}
+
+/**
+* @brief Chooses a block to hold other sectors: a free one, or else the one that served a read longest ago.
+* @return The block, DISK_CACHE_NONE if all are being read.
+*/
+PRIVATE dword DISK_CACHE_Evict()
+{
+	dword index = DISK_CACHE_NONE;
+	for(dword i = 0; i < DISK_CACHE_BLOCKS; i++)
+	{
+		if(disk_cache_blocks[i].state == DISK_CACHE_FREE)
+			return i;
+		if(disk_cache_blocks[i].state == DISK_CACHE_VALID && (index == DISK_CACHE_NONE || (int)(disk_cache_blocks[i].used - disk_cache_blocks[index].used) < 0))
+			index = i;
+	}
+	return index;
+}
+
+/**
+* @brief Finds the stream a read belongs to, or starts one in place of the stream read longest ago,
+* and sizes its window.
+* @param _lba [in] First sector of the read.
+* @return The stream.
+*/
+PRIVATE DISK_CACHE_STREAM* DISK_CACHE_Stream(IN LBA _lba)
+{
+	DISK_CACHE_STREAM* oldest = &disk_cache_streams[0];
+	for(dword i = 0; i < DISK_CACHE_STREAMS; i++)
+	{
+		DISK_CACHE_STREAM* stream = &disk_cache_streams[i];
+		if(stream->window && stream->next == _lba)
+		{
+			stream->window *= 2;
+			if(stream->window > DISK_CACHE_WINDOW_MAX)
+				stream->window = DISK_CACHE_WINDOW_MAX;
+			return stream;
+		}
+		if((int)(stream->used - oldest->used) < 0)
+			oldest = stream;
+	}
+
+	oldest->ahead = _lba;
+	oldest->window = DISK_CACHE_WINDOW_MIN;
+	return oldest;
+}
+
+/**
+* @brief Submits the blocks of the window of a stream that are not in the cache yet.
+* @param _stream [in] The stream.
+*/
+PRIVATE void DISK_CACHE_ReadAhead(IN DISK_CACHE_STREAM* _stream)
+{
+	//Without a bus master the queue reads when submitted, which would only make the reader wait longer.
+	//Stated in the header of the file, PIO readers get no read ahead
+	if(!HD_IsDMA())
+		return;
+
+	if(_stream->ahead < _stream->next)
+		_stream->ahead = _stream->next;
+
+	dword reading = 0;
+	for(dword i = 0; i < DISK_CACHE_BLOCKS; i++)
+	{
+		if(disk_cache_blocks[i].state == DISK_CACHE_READING)
+			reading++;
+	}
+
+	LBA end = _stream->next + _stream->window;
+	for(LBA lba = _stream->ahead - _stream->ahead%DISK_CACHE_BLOCK_SECTORS; lba < end; lba += DISK_CACHE_BLOCK_SECTORS)
+	{
+		if(DISK_CACHE_Find(lba) != DISK_CACHE_NONE)
+			continue;
+
+		dword index = DISK_CACHE_Evict();
+		if(index == DISK_CACHE_NONE || reading == DISK_CACHE_IN_FLIGHT)
+			return;
+
+		DISK_REQUEST request = DISK_QUEUE_Submit(0, KERNEL_PAGE_DIRECTORY, lba, disk_cache_memory + index*PAGE_SIZE, DISK_CACHE_BLOCK_SECTORS, false);
+		if(!request)
+			return;
+
+		disk_cache_blocks[index].state = DISK_CACHE_READING;
+		disk_cache_blocks[index].lba = lba;
+		disk_cache_blocks[index].request = request;
+		disk_cache_blocks[index].stale = false;
+		disk_cache_blocks[index].used = disk_cache_clock;
+		disk_cache_prefetched += DISK_CACHE_BLOCK_SECTORS;
+		reading++;
+		_stream->ahead = lba + DISK_CACHE_BLOCK_SECTORS;
+	}
+}
+
+/**
+* @brief Reads sectors, from the cache where they are in it and from the disk where not, and reads
+* ahead if the read follows an earlier one.
+* @param _lba [in] First sector.
+* @param _number_of_sectors [in] Number of sectors.
+* @param _buffer [out] Where to leave them, in kernel space.
+* @return Number of sectors read.
+*/
+PUBLIC dword DISK_CACHE_Read(IN LBA _lba, IN dword _number_of_sectors, OUT VIRTUAL _buffer)
+{
+	if(!disk_cache_memory)
+		return HD_ReadSectors(0, _lba, _number_of_sectors, _buffer);
+
+	disk_cache_clock++;
+	DISK_CACHE_STREAM* stream = DISK_CACHE_Stream(_lba);
+	stream->used = disk_cache_clock;
+
+	dword done = 0;
+	while(done < _number_of_sectors)
+	{
+		LBA lba = _lba + done;
+		LBA first = lba - lba%DISK_CACHE_BLOCK_SECTORS;
+
+		dword index = DISK_CACHE_Find(first);
+		if(index != DISK_CACHE_NONE && DISK_CACHE_Wait(index))
+		{
+			dword offset = lba - first;
+			dword sectors = DISK_CACHE_BLOCK_SECTORS - offset;
+			if(sectors > _number_of_sectors - done)
+				sectors = _number_of_sectors - done;
+
+			RTL_Copy(_buffer + done*SECTOR_SIZE, disk_cache_memory + index*PAGE_SIZE + offset*SECTOR_SIZE, sectors*SECTOR_SIZE);
+			disk_cache_blocks[index].used = disk_cache_clock;
+			disk_cache_hits += sectors;
+			done += sectors;
+			continue;
+		}
+
+		//Up to the next block in the cache, straight from the disk
+		dword sectors = first + DISK_CACHE_BLOCK_SECTORS - lba;
+		while(done + sectors < _number_of_sectors && DISK_CACHE_Find(lba + sectors) == DISK_CACHE_NONE)
+			sectors += DISK_CACHE_BLOCK_SECTORS;
+		if(sectors > _number_of_sectors - done)
+			sectors = _number_of_sectors - done;
+
+		dword read = HD_ReadSectors(0, lba, sectors, _buffer + done*SECTOR_SIZE);
+		done += read;
+		if(read != sectors)
+			break;
+	}
+
+	stream->next = _lba + done;
+	DISK_CACHE_ReadAhead(stream);
+	return done;
+}
+
+/**
+* @brief Forgets the blocks of some sectors that are going to be written. Blocks being read are waited
+* for first, so the read can't land after the write.
+* @param _lba [in] First sector.
+* @param _number_of_sectors [in] Number of sectors.
+*/
+PUBLIC void DISK_CACHE_Invalidate(IN LBA _lba, IN dword _number_of_sectors)
+{
+	for(dword i = 0; i < DISK_CACHE_BLOCKS; i++)
+	{
+		DISK_CACHE_BLOCK* block = &disk_cache_blocks[i];
+		if(block->state != DISK_CACHE_FREE && block->lba < _lba + _number_of_sectors && _lba < block->lba + DISK_CACHE_BLOCK_SECTORS)
+		{
+			DISK_CACHE_Wait(i);
+			block->state = DISK_CACHE_FREE;
+		}
+	}
+}
+
+/**
+* @brief Forgets the blocks of some sectors a write has just put on the disk. It runs on the disk
+* interrupt, so blocks being read are not waited for but marked, and their read is thrown away.
+* @param _lba [in] First sector.
+* @param _number_of_sectors [in] Number of sectors.
+*/
+PUBLIC void DISK_CACHE_Written(IN LBA _lba, IN dword _number_of_sectors)
+{
+	for(dword i = 0; i < DISK_CACHE_BLOCKS; i++)
+	{
+		DISK_CACHE_BLOCK* block = &disk_cache_blocks[i];
+		if(block->state != DISK_CACHE_FREE && block->lba < _lba + _number_of_sectors && _lba < block->lba + DISK_CACHE_BLOCK_SECTORS)
+		{
+			if(block->state == DISK_CACHE_READING)
+				block->stale = true;
+			else
+				block->state = DISK_CACHE_FREE;
+		}
+	}
+}
+
+/**
+* @brief Copies the disk cache counters.
+* @param _statistics [out] Where to leave them, the rest of the counters are not touched.
+*/
+PUBLIC void DISK_CACHE_GetStatistics(OUT DISK_STATISTICS* _statistics)
+{
+	_statistics->cached = disk_cache_hits;
+	_statistics->prefetched = disk_cache_prefetched;
+}
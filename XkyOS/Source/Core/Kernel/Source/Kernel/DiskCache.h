@@ -0,0 +1,25 @@
+/******************************************************************************/
+/**
+* @file		DiskCache.h
+* @brief	XkyOS Disk block cache
+* Definitions of the cache of disk blocks that sequential reads fill ahead of time.
+*
+* @date		20/03/2008
+* @author	Pablo Bravo
+*/
+/******************************************************************************/
+#ifndef __DISKCACHE_H__
+#define __DISKCACHE_H__
+
+	#include "Types.h"
+	#include "DiskQueue.h"
+
+	bool	DISK_CACHE_Init			();
+
+	dword	DISK_CACHE_Read			(IN LBA _lba, IN dword _number_of_sectors, OUT VIRTUAL _buffer);
+	void	DISK_CACHE_Invalidate	(IN LBA _lba, IN dword _number_of_sectors);
+	void	DISK_CACHE_Written		(IN LBA _lba, IN dword _number_of_sectors);
+
+	void	DISK_CACHE_GetStatistics(OUT DISK_STATISTICS* _statistics);
+
+#endif //__DISKCACHE_H__
@@ -0,0 +1,649 @@
+/******************************************************************************/
+/**
+* @file		DiskQueue.cpp
+* @brief	XkyOS Disk request queue
+* Implementation of the disk request queue. Requests are started by bus master DMA, one transfer at a
+* time or several if the disk queues commands, and the disk interrupt completes them and starts the next,
+* so whoever submitted one can block and let the scheduler run others until it is done.
+* Without a bus master (a PIO disk, or the floppy RAM disk) the queue does nothing: a request is moved by
+* the CPU inside DISK_QUEUE_Submit and has ended when it returns, so nobody blocks and nothing overlaps.
+* Which request goes next is up to a disk scheduler. Requests longer than a transfer go back to the
+* queue after each piece, and the elevator merges requests contiguous on disk into one transfer.
+*
+* @date		20/03/2008
+* @author	Pablo Bravo
+*/
+/******************************************************************************/
+#include "DiskQueue.h"
+#include "DiskCache.h"
+#include "Handles.h"
+#include "Timer.h"
+
+#include "Debug.h"
+
+//==================================DATA======================================//
+#pragma data_seg(".data")
+//============================================================================//
+#define DISK_QUEUE_REQUESTS			64	/**< Requests submitted and not yet polled, all environments*/
+#define DISK_QUEUE_PER_ENVIRONMENT	16	/**< Of them, for one environment*/
+#define DISK_QUEUE_NONE				DISK_QUEUE_REQUESTS
+
+#define DISK_QUEUE_MERGE			8	/**< Requests a transfer can serve*/
+#define DISK_QUEUE_TRANSFERS		8	/**< Transfers in flight at most, when the disk takes several*/
+#define DISK_QUEUE_DEADLINE			9	/**< Ticks a request waits at most before it goes first (half a second)*/
+#define DISK_QUEUE_BATCH			4	/**< Transfers in a row for an environment while others wait*/
+
+/**
+* @brief A disk request.
+*/
+struct DISK_QUEUE_SLOT
+{
+	bool			used;
+	dword			generation;		/*< Bumped when the slot is freed, so old handles stop matching*/
+	ENVIRONMENT*	environment;	/*< Owner, zero for the kernel*/
+	ADDRESS_SPACE	pdbr;			/*< Address space of the buffer*/
+	LBA				lba;
+	VIRTUAL			buffer;
+	dword			sectors;
+	dword			done;			/*< Sectors already transferred*/
+	dword			piece;			/*< Sectors of the transfer in flight*/
+	bool			write;
+	bool			queued;			/*< Waiting for its turn*/
+	bool			cancelled;		/*< Its pages are going away, don't go on with it*/
+	dword			state;			/*< DISK_REQUEST_PENDING, DISK_REQUEST_DONE or DISK_REQUEST_FAILED*/
+	XID				waiter;			/*< Blocked until the request ends, zero if none*/
+	dword			sequence;		/*< Order of arrival*/
+	dword			ticks;			/*< When it arrived*/
+};
+
+/**
+* @brief The requests.
+*/
+PRIVATE DISK_QUEUE_SLOT disk_queue[DISK_QUEUE_REQUESTS];
+
+/**
+* @brief A transfer, as many as tags the disk has.
+*/
+struct DISK_QUEUE_TRANSFER
+{
+	dword	size;						/*< Requests it serves, zero if not in flight*/
+	dword	requests[DISK_QUEUE_MERGE];	/*< In disk order*/
+};
+
+/**
+* @brief The transfers, indexed by tag.
+*/
+PRIVATE DISK_QUEUE_TRANSFER disk_queue_transfers[DISK_QUEUE_TRANSFERS];
+
+/**
+* @brief Arrivals so far, and the sector after the last transferred, where the disk head is.
+*/
+PRIVATE dword disk_queue_sequence = 0;
+PRIVATE LBA disk_queue_position = 0;
+
+/**
+* @brief Environment of the last transfers, and how many in a row.
+*/
+PRIVATE ENVIRONMENT* disk_queue_last_environment = 0;
+PRIVATE dword disk_queue_streak = 0;
+
+PRIVATE DISK_STATISTICS disk_queue_statistics = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+/**
+* @brief Chooses the request to transfer next.
+* @param _skip [in] True if the requests of disk_queue_last_environment can't go now.
+* @return The request, DISK_QUEUE_NONE if none.
+*/
+typedef dword (*fDiskSchedulerPick)(IN bool _skip);
+
+/**
+* @brief A disk scheduler.
+*/
+struct DISK_SCHEDULER
+{
+	fDiskSchedulerPick	pick;
+	bool				merge;	/*< Requests contiguous to the one chosen go in the same transfer*/
+};
+
+PRIVATE dword DISK_QUEUE_PickFIFO(IN bool _skip);
+PRIVATE dword DISK_QUEUE_PickCLOOK(IN bool _skip);
+
+/**
+* @brief The schedulers, indexed by DISK_SCHEDULER_FIFO and the like, and the one in use.
+*/
+PRIVATE DISK_SCHEDULER disk_schedulers[DISK_SCHEDULERS] =
+{
+	{DISK_QUEUE_PickFIFO, false},
+	{DISK_QUEUE_PickCLOOK, true}
+};
+PRIVATE dword disk_queue_scheduler = DISK_SCHEDULER_CLOOK;
+
+//==================================CODE======================================//
+#pragma code_seg(".code")
+//============================================================================//
+#define TO_INDEX(X)	HANDLE_INDEX(X)
+#define TO_HANDLE(X)HANDLE_MAKE(X, disk_queue[X].generation)
+
+/**
+* @brief Finds the request of a handle.
+* @param _environment [in] Environment that has to own it.
+* @param _request [in] The handle.
+* @return The request, zero if the handle is not valid or not owned.
+*/
+PRIVATE DISK_QUEUE_SLOT* DISK_QUEUE_Get(IN ENVIRONMENT* _environment, IN DISK_REQUEST _request)
+{
+	dword index = TO_INDEX(_request);
+	if(index >= DISK_QUEUE_REQUESTS || !disk_queue[index].used || TO_HANDLE(index) != _request || disk_queue[index].environment != _environment)
+		return 0;
+
+	return &disk_queue[index];
+}
+
+/**
+* @brief Frees the slot of a request.
+* @param _index [in] The request.
+*/
+PRIVATE void DISK_QUEUE_Free(IN dword _index)
+{
+	disk_queue[_index].used = false;
+	disk_queue[_index].generation++;
+	disk_queue[_index].environment = 0;
+	disk_queue[_index].waiter = 0;
+}
+
+/**
+* @brief Ends a request, and lets its waiter run again.
+* @param _index [in] The request.
+* @param _ok [in] True if all the sectors were transferred.
+*/
+PRIVATE void DISK_QUEUE_End(IN dword _index, IN bool _ok)
+{
+	disk_queue[_index].queued = false;
+	disk_queue[_index].state = _ok ? DISK_REQUEST_DONE : DISK_REQUEST_FAILED;
+
+	//A read ahead may have got to the disk before the write, even a failed one may have written some
+	if(disk_queue[_index].write)
+		DISK_CACHE_Written(disk_queue[_index].lba, disk_queue[_index].sectors);
+	if(disk_queue[_index].waiter)
+	{
+		PROCESSOR_Block(disk_queue[_index].waiter, false);
+		disk_queue[_index].waiter = 0;
+	}
+}
+
+/**
+* @brief Tells if a queued request can be chosen.
+* @param _index [in] The request.
+* @param _skip [in] True if the requests of disk_queue_last_environment can't.
+* @return True if it can.
+*/
+PRIVATE bool DISK_QUEUE_IsCandidate(IN dword _index, IN bool _skip)
+{
+	return disk_queue[_index].used && disk_queue[_index].queued && !(_skip && disk_queue[_index].environment == disk_queue_last_environment);
+}
+
+/**
+* @brief First sector a request still has to transfer.
+* @param _index [in] The request.
+* @return The sector.
+*/
+PRIVATE LBA DISK_QUEUE_Next(IN dword _index)
+{
+	return disk_queue[_index].lba + disk_queue[_index].done;
+}
+
+/**
+* @brief Arrival order: the request that came first.
+* @param _skip [in] True if the requests of disk_queue_last_environment can't go now.
+* @return The request, DISK_QUEUE_NONE if none.
+*/
+PRIVATE dword DISK_QUEUE_PickFIFO(IN bool _skip)
+{
+	dword pick = DISK_QUEUE_NONE;
+	for(dword i = 0; i < DISK_QUEUE_REQUESTS; i++)
+	{
+		if(DISK_QUEUE_IsCandidate(i, _skip) && (pick == DISK_QUEUE_NONE || (int)(disk_queue[i].sequence - disk_queue[pick].sequence) < 0))
+			pick = i;
+	}
+	return pick;
+}
+
+/**
+* @brief C-LOOK elevator: the nearest request ahead of the head, and once there is none ahead, the
+* lowest one, so the disk is swept in one direction.
+* @param _skip [in] True if the requests of disk_queue_last_environment can't go now.
+* @return The request, DISK_QUEUE_NONE if none.
+*/
+PRIVATE dword DISK_QUEUE_PickCLOOK(IN bool _skip)
+{
+	dword ahead = DISK_QUEUE_NONE;
+	dword lowest = DISK_QUEUE_NONE;
+	for(dword i = 0; i < DISK_QUEUE_REQUESTS; i++)
+	{
+		if(!DISK_QUEUE_IsCandidate(i, _skip))
+			continue;
+
+		LBA next = DISK_QUEUE_Next(i);
+		if(next >= disk_queue_position && (ahead == DISK_QUEUE_NONE || next < DISK_QUEUE_Next(ahead)))
+			ahead = i;
+		if(lowest == DISK_QUEUE_NONE || next < DISK_QUEUE_Next(lowest))
+			lowest = i;
+	}
+	return (ahead != DISK_QUEUE_NONE) ? ahead : lowest;
+}
+
+/**
+* @brief Chooses the request to transfer next. A request that has waited too long goes first, whatever
+* the scheduler; an environment that has had several transfers in a row waits while others have requests.
+* @return The request, DISK_QUEUE_NONE if the queue is empty.
+*/
+PRIVATE dword DISK_QUEUE_Pick()
+{
+	dword oldest = DISK_QUEUE_PickFIFO(false);
+	if(oldest == DISK_QUEUE_NONE || TMR_Ticks() - disk_queue[oldest].ticks >= DISK_QUEUE_DEADLINE)
+		return oldest;
+
+	bool skip = disk_queue_streak >= DISK_QUEUE_BATCH && DISK_QUEUE_PickFIFO(true) != DISK_QUEUE_NONE;
+	return disk_schedulers[disk_queue_scheduler].pick(skip);
+}
+
+/**
+* @brief Adds to a transfer the queued requests right before or after it on disk, while they fit.
+* @param _transfer [in] The transfer.
+* @param _sectors [in] Sectors of the transfer so far.
+* @return Sectors of the transfer.
+*/
+PRIVATE dword DISK_QUEUE_Merge(IN DISK_QUEUE_TRANSFER* _transfer, IN dword _sectors)
+{
+	bool write = disk_queue[_transfer->requests[0]].write;
+	bool found = true;
+	while(found && _transfer->size < DISK_QUEUE_MERGE)
+	{
+		found = false;
+		LBA first = DISK_QUEUE_Next(_transfer->requests[0]);
+		LBA end = first + _sectors;
+		for(dword i = 0; i < DISK_QUEUE_REQUESTS && !found; i++)
+		{
+			DISK_QUEUE_SLOT* request = &disk_queue[i];
+			if(!DISK_QUEUE_IsCandidate(i, false) || request->write != write || request->done || _sectors + request->sectors > HD_DMA_MAX_SECTORS)
+				continue;
+
+			if(request->lba == end)
+			{
+				_transfer->requests[_transfer->size] = i;
+				found = true;
+			}
+			else if(request->lba + request->sectors == first)
+			{
+				for(dword j = _transfer->size; j > 0; j--)
+					_transfer->requests[j] = _transfer->requests[j - 1];
+				_transfer->requests[0] = i;
+				found = true;
+			}
+
+			if(found)
+			{
+				request->queued = false;
+				request->piece = request->sectors;
+				_sectors += request->sectors;
+				_transfer->size++;
+				disk_queue_statistics.merged++;
+			}
+		}
+	}
+	return _sectors;
+}
+
+/**
+* @brief Starts a transfer on a tag that is not in flight. Requests that can't be started fail at once.
+* @param _tag [in] The tag.
+* @return False if there was nothing to start.
+*/
+PRIVATE bool DISK_QUEUE_StartTag(IN dword _tag)
+{
+	DISK_QUEUE_TRANSFER* transfer = &disk_queue_transfers[_tag];
+	while(!transfer->size)
+	{
+		dword index = DISK_QUEUE_Pick();
+		if(index == DISK_QUEUE_NONE)
+			return false;
+
+		DISK_QUEUE_SLOT* request = &disk_queue[index];
+		request->queued = false;
+		request->piece = request->sectors - request->done;
+		if(request->piece > HD_DMA_MAX_SECTORS)
+			request->piece = HD_DMA_MAX_SECTORS;
+
+		transfer->requests[0] = index;
+		transfer->size = 1;
+
+		dword sectors = request->piece;
+		if(disk_schedulers[disk_queue_scheduler].merge && request->done + request->piece == request->sectors)
+			sectors = DISK_QUEUE_Merge(transfer, sectors);
+
+		//Fairness counts transfers per environment
+		if(request->environment == disk_queue_last_environment)
+		{
+			disk_queue_streak++;
+		}
+		else
+		{
+			disk_queue_last_environment = request->environment;
+			disk_queue_streak = 1;
+		}
+
+		HD_SEGMENT segments[DISK_QUEUE_MERGE];
+		bool ok = !request->cancelled;
+		for(dword i = 0; i < transfer->size; i++)
+		{
+			DISK_QUEUE_SLOT* member = &disk_queue[transfer->requests[i]];
+			segments[i].pdbr = member->pdbr;
+			segments[i].buffer = member->buffer + member->done*SECTOR_SIZE;
+			segments[i].sectors = member->piece;
+			segments[i].user = member->environment != 0;
+		}
+
+		LBA lba = DISK_QUEUE_Next(transfer->requests[0]);
+		if(ok && HD_StartTransfer(_tag, lba, segments, transfer->size, request->write))
+		{
+			disk_queue_statistics.transfers++;
+			disk_queue_statistics.sectors += sectors;
+			if(lba != disk_queue_position)
+			{
+				disk_queue_statistics.seeks++;
+				disk_queue_statistics.distance += (lba > disk_queue_position) ? (lba - disk_queue_position) : (disk_queue_position - lba);
+			}
+			disk_queue_position = lba + sectors;
+			return true;
+		}
+
+		for(dword i = 0; i < transfer->size; i++)
+			DISK_QUEUE_End(transfer->requests[i], false);
+		transfer->size = 0;
+	}
+	return true;
+}
+
+/**
+* @brief Starts transfers on the tags not in flight, while there are requests queued.
+*/
+PRIVATE void DISK_QUEUE_Start()
+{
+	dword tags = HD_GetTags();
+	if(tags > DISK_QUEUE_TRANSFERS)
+		tags = DISK_QUEUE_TRANSFERS;
+
+	for(dword tag = 0; tag < tags; tag++)
+	{
+		if(!disk_queue_transfers[tag].size && !DISK_QUEUE_StartTag(tag))
+			return;
+	}
+}
+
+/**
+* @brief Told by the disk interrupt that a transfer in flight has ended.
+* @param _tag [in] Its tag.
+* @param _ok [in] True if its sectors were transferred.
+*/
+PRIVATE void DISK_QUEUE_Completion(IN dword _tag, IN bool _ok)
+{
+	DISK_QUEUE_TRANSFER* transfer = &disk_queue_transfers[_tag];
+	for(dword i = 0; i < transfer->size; i++)
+	{
+		dword index = transfer->requests[i];
+		DISK_QUEUE_SLOT* request = &disk_queue[index];
+		if(_ok)
+			request->done += request->piece;
+
+		//Requests longer than a transfer wait for their turn again
+		if(!_ok || request->done == request->sectors || request->cancelled)
+			DISK_QUEUE_End(index, _ok && request->done == request->sectors);
+		else
+			request->queued = true;
+	}
+	transfer->size = 0;
+
+	DISK_QUEUE_Start();
+}
+
+/**
+* @brief Initialize the disk request queue.
+* @return True if successful.
+*/
+PUBLIC bool DISK_QUEUE_Init()
+{
+	for(dword i = 0; i < DISK_QUEUE_REQUESTS; i++)
+	{
+		disk_queue[i].used = false;
+		disk_queue[i].generation = 0;
+		disk_queue[i].environment = 0;
+		disk_queue[i].queued = false;
+		disk_queue[i].waiter = 0;
+	}
+	for(dword i = 0; i < DISK_QUEUE_TRANSFERS; i++)
+		disk_queue_transfers[i].size = 0;
+
+	HD_SetCompletion(DISK_QUEUE_Completion);
+	return true;
+}
+
+/**
+* @brief Submits a disk request. When it is transferred is up to the disk scheduler, or it is transferred
+* right away if the disk has no bus master.
+* @param _environment [in] The owner, zero for the kernel. The buffer of an environment must be in user pages.
+* @param _pdbr [in] Address space of the buffer.
+* @param _lba [in] First sector.
+* @param _buffer [in] The buffer, which has to stay mapped until the request ends.
+* @param _sectors [in] Number of sectors.
+* @param _write [in] True to write to the disk, false to read.
+* @return The request, or zero if there is no room for it.
+*/
+PUBLIC DISK_REQUEST DISK_QUEUE_Submit(IN ENVIRONMENT* _environment, IN ADDRESS_SPACE _pdbr, IN LBA _lba, IN VIRTUAL _buffer, IN dword _sectors, IN bool _write)
+{
+	dword index = DISK_QUEUE_NONE;
+	dword owned = 0;
+	for(dword i = 0; i < DISK_QUEUE_REQUESTS; i++)
+	{
+		if(!disk_queue[i].used && index == DISK_QUEUE_NONE)
+			index = i;
+		if(disk_queue[i].used && disk_queue[i].environment == _environment)
+			owned++;
+	}
+	if(index == DISK_QUEUE_NONE || (_environment && owned >= DISK_QUEUE_PER_ENVIRONMENT))
+		return 0;
+
+	DISK_QUEUE_SLOT* request = &disk_queue[index];
+	request->used = true;
+	request->environment = _environment;
+	request->pdbr = _pdbr;
+	request->lba = _lba;
+	request->buffer = _buffer;
+	request->sectors = _sectors;
+	request->done = 0;
+	request->piece = 0;
+	request->write = _write;
+	request->queued = false;
+	request->cancelled = false;
+	request->state = DISK_REQUEST_PENDING;
+	request->waiter = 0;
+	request->sequence = disk_queue_sequence++;
+	request->ticks = TMR_Ticks();
+	disk_queue_statistics.requests++;
+
+	if(!_sectors)
+	{
+		request->state = DISK_REQUEST_DONE;
+	}
+	else if(!HD_IsDMA())
+	{
+		//The CPU moves the sectors right here, so there is nothing to wait for and nothing to schedule.
+		//PIO is not driven from the disk interrupt. The buffer is in the current address space
+		dword done = _write ? HD_WriteSectors(0, _lba, _sectors, _buffer) : HD_ReadSectors(0, _lba, _sectors, _buffer);
+		request->state = (done == _sectors) ? DISK_REQUEST_DONE : DISK_REQUEST_FAILED;
+	}
+	else
+	{
+		request->queued = true;
+		DISK_QUEUE_Start();
+	}
+
+	return TO_HANDLE(index);
+}
+
+/**
+* @brief Tells how a request is going. Once it has ended the request is forgotten.
+* @param _environment [in] The owner.
+* @param _request [in] The request.
+* @return DISK_REQUEST_PENDING, DISK_REQUEST_DONE or DISK_REQUEST_FAILED, zero if not a request of the owner.
+*/
+PUBLIC dword DISK_QUEUE_Poll(IN ENVIRONMENT* _environment, IN DISK_REQUEST _request)
+{
+	DISK_QUEUE_SLOT* request = DISK_QUEUE_Get(_environment, _request);
+	if(!request)
+		return 0;
+
+	dword state = request->state;
+	if(state != DISK_REQUEST_PENDING)
+		DISK_QUEUE_Free(TO_INDEX(_request));
+
+	return state;
+}
+
+/**
+* @brief Like DISK_QUEUE_Poll, but if the request is pending the execution is blocked until it ends.
+* The caller has to give the processor away, and poll again once it runs.
+* @param _environment [in] The owner.
+* @param _request [in] The request.
+* @param _xid [in] The xid of the execution that waits.
+* @return DISK_REQUEST_PENDING, DISK_REQUEST_DONE or DISK_REQUEST_FAILED, zero if not a request of the owner.
+*/
+PUBLIC dword DISK_QUEUE_Wait(IN ENVIRONMENT* _environment, IN DISK_REQUEST _request, IN XID _xid)
+{
+	DISK_QUEUE_SLOT* request = DISK_QUEUE_Get(_environment, _request);
+	if(!request || request->state != DISK_REQUEST_PENDING)
+		return DISK_QUEUE_Poll(_environment, _request);
+
+	request->waiter = _xid;
+	PROCESSOR_Block(_xid, true);
+	return DISK_REQUEST_PENDING;
+}
+
+/**
+* @brief Tells if the buffer of a request is within some pages.
+* @param _index [in] The request.
+* @param _pdbr [in] The address space.
+* @param _first [in] First page number.
+* @param _last [in] Page number after the last.
+* @return True if some page of the buffer is.
+*/
+PRIVATE bool DISK_QUEUE_IsWithin(IN dword _index, IN ADDRESS_SPACE _pdbr, IN dword _first, IN dword _last)
+{
+	DISK_QUEUE_SLOT* request = &disk_queue[_index];
+	dword first = request->buffer/PAGE_SIZE;
+	dword last = (request->buffer + request->sectors*SECTOR_SIZE + PAGE_SIZE - 1)/PAGE_SIZE;
+	return request->pdbr == _pdbr && first < _last && _first < last;
+}
+
+/**
+* @brief Ends the requests whose buffer is within some pages that are going to be unmapped, so the disk
+* does not transfer to pages that belong to someone else by then.
+* @param _pdbr [in] The address space.
+* @param _address [in] First page.
+* @param _number_of_pages [in] Number of pages.
+*/
+PUBLIC void DISK_QUEUE_ReleasePages(IN ADDRESS_SPACE _pdbr, IN VIRTUAL _address, IN dword _number_of_pages)
+{
+	dword first = _address/PAGE_SIZE;
+	dword last = first + _number_of_pages;
+
+	//Queued ones leave the queue failed, the ones in flight have to be waited for
+	bool active = false;
+	for(dword i = 0; i < DISK_QUEUE_REQUESTS; i++)
+	{
+		if(!disk_queue[i].used || disk_queue[i].state != DISK_REQUEST_PENDING || !DISK_QUEUE_IsWithin(i, _pdbr, first, last))
+			continue;
+
+		if(disk_queue[i].queued)
+		{
+			DISK_QUEUE_End(i, false);
+		}
+		else
+		{
+			disk_queue[i].cancelled = true;
+			active = true;
+		}
+	}
+
+	if(active)
+		HD_Drain();
+}
+
+/**
+* @brief Ends the requests of an environment on some sectors that are going to be freed, so the disk
+* does not transfer to sectors that belong to someone else by then.
+* @param _environment [in] The environment.
+* @param _range [in] The sectors.
+*/
+PUBLIC void DISK_QUEUE_ReleaseSectors(IN ENVIRONMENT* _environment, IN DISK_RANGE _range)
+{
+	bool active = false;
+	for(dword i = 0; i < DISK_QUEUE_REQUESTS; i++)
+	{
+		DISK_QUEUE_SLOT* request = &disk_queue[i];
+		if(!request->used || request->state != DISK_REQUEST_PENDING || request->environment != _environment)
+			continue;
+		if(request->lba >= _range.start_sector + _range.number_of_sectors || _range.start_sector >= request->lba + request->sectors)
+			continue;
+
+		if(request->queued)
+		{
+			DISK_QUEUE_End(i, false);
+		}
+		else
+		{
+			request->cancelled = true;
+			active = true;
+		}
+	}
+
+	if(active)
+		HD_Drain();
+}
+
+/**
+* @brief Ends the requests of an address space that is being released, and forgets the ones ended.
+* @param _pdbr [in] The address space.
+*/
+PUBLIC void DISK_QUEUE_Release(IN ADDRESS_SPACE _pdbr)
+{
+	DISK_QUEUE_ReleasePages(_pdbr, 0, 0xFFFFFFFF/PAGE_SIZE + 1);
+	for(dword i = 0; i < DISK_QUEUE_REQUESTS; i++)
+	{
+		if(disk_queue[i].used && disk_queue[i].pdbr == _pdbr && disk_queue[i].state != DISK_REQUEST_PENDING)
+			DISK_QUEUE_Free(i);
+	}
+}
+
+/**
+* @brief Chooses the disk scheduler. Requests already queued are ordered by the new one.
+* @param _scheduler [in] DISK_SCHEDULER_FIFO or DISK_SCHEDULER_CLOOK.
+* @return True if it is a scheduler.
+*/
+PUBLIC bool DISK_QUEUE_SetScheduler(IN dword _scheduler)
+{
+	if(_scheduler >= DISK_SCHEDULERS)
+		return false;
+
+	disk_queue_scheduler = _scheduler;
+	return true;
+}
+
+/**
+* @brief Copies the disk queue counters.
+* @param _statistics [out] Where to leave them.
+*/
+PUBLIC void DISK_QUEUE_GetStatistics(OUT DISK_STATISTICS* _statistics)
+{
+	*_statistics = disk_queue_statistics;
+	_statistics->scheduler = disk_queue_scheduler;
+}
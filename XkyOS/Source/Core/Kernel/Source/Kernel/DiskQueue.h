@@ -0,0 +1,62 @@
+/******************************************************************************/
+/**
+* @file		DiskQueue.h
+* @brief	XkyOS Disk request queue
+* Definitions of the queue of disk requests that complete on the disk interrupt, and its schedulers.
+*
+* @date		20/03/2008
+* @author	Pablo Bravo
+*/
+/******************************************************************************/
+#ifndef __DISKQUEUE_H__
+#define __DISKQUEUE_H__
+
+	#include "Types.h"
+	#include "HardDisk.h"
+	#include "DiskRange.h"
+	#include "AddressSpace.h"
+	#include "Processor.h"
+
+	/**
+	* @brief Handle of a disk request.
+	*/
+	typedef dword DISK_REQUEST;
+
+	#define DISK_REQUEST_PENDING	1	/**< Queued or being transferred*/
+	#define DISK_REQUEST_DONE		2	/**< All the sectors were transferred*/
+	#define DISK_REQUEST_FAILED		3	/**< Some sector could not be transferred*/
+
+	#define DISK_SCHEDULER_FIFO		0	/**< Requests go in order of arrival, one per transfer*/
+	#define DISK_SCHEDULER_CLOOK	1	/**< Requests go in one sweep across the disk, contiguous ones merged*/
+	#define DISK_SCHEDULERS			2
+
+	/**
+	* @brief Disk queue counters.
+	*/
+	struct DISK_STATISTICS
+	{
+		dword requests;		/*< Requests submitted*/
+		dword transfers;	/*< Commands given to the disk*/
+		dword merged;		/*< Requests that went in the transfer of another*/
+		dword sectors;		/*< Sectors transferred*/
+		dword seeks;		/*< Transfers that did not start where the last ended*/
+		qword distance;		/*< Sectors the head moved in those*/
+		dword scheduler;	/*< Scheduler in use*/
+		dword cached;		/*< Sectors the kernel read from the block cache*/
+		dword prefetched;	/*< Sectors read ahead into the block cache*/
+	};
+
+	bool			DISK_QUEUE_Init			();
+
+	DISK_REQUEST	DISK_QUEUE_Submit		(IN ENVIRONMENT* _environment, IN ADDRESS_SPACE _pdbr, IN LBA _lba, IN VIRTUAL _buffer, IN dword _sectors, IN bool _write);
+	dword			DISK_QUEUE_Poll			(IN ENVIRONMENT* _environment, IN DISK_REQUEST _request);
+	dword			DISK_QUEUE_Wait			(IN ENVIRONMENT* _environment, IN DISK_REQUEST _request, IN XID _xid);
+
+	void			DISK_QUEUE_ReleasePages	(IN ADDRESS_SPACE _pdbr, IN VIRTUAL _address, IN dword _number_of_pages);
+	void			DISK_QUEUE_ReleaseSectors(IN ENVIRONMENT* _environment, IN DISK_RANGE _range);
+	void			DISK_QUEUE_Release		(IN ADDRESS_SPACE _pdbr);
+
+	bool			DISK_QUEUE_SetScheduler	(IN dword _scheduler);
+	void			DISK_QUEUE_GetStatistics(OUT DISK_STATISTICS* _statistics);
+
+#endif //__DISKQUEUE_H__
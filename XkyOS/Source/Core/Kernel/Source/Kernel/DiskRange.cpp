@@ -8,6 +8,28 @@
 */
 /******************************************************************************/
 #include "DiskRange.h"
+#include "Memory.h"
+#include "RTL.h"
+
+//==================================DATA======================================//
+#pragma data_seg(".data")
+//============================================================================//
+/**
+* @brief An allocated range and who owns it.
+*/
+struct DISK_EXTENT
+{
+	DISK_RANGE		range;
+	ENVIRONMENT*	owner;
+};
+
+/**
+* @brief Allocated ranges of every environment sorted by start sector, in kernel pages. They never
+* overlap, so their ends are sorted too and a binary search finds the one holding a sector.
+*/
+PRIVATE DISK_EXTENT* disk_extents = 0;
+PRIVATE dword disk_extents_number = 0;
+PRIVATE dword disk_extents_pages = 0;
 
 //==================================CODE======================================//
 #pragma code_seg(".code")
@@ -57,3 +79,171 @@ PUBLIC bool DISK_RANGE_ClashWith(IN DISK_RANGE _range, IN DISK_RANGE _other)
 {
 	return DISK_RANGE_Contains(_range, _other.start_sector) || DISK_RANGE_Contains(_range, _other.start_sector + _other.number_of_sectors - 1) || DISK_RANGE_ContainsCompletely(_other, _range);
 }
+
+/**
+* @brief Finds the first extent that ends after a sector.
+* @param _sector [in] The sector.
+* @return Index of the extent, disk_extents_number if none.
+*/
+PRIVATE dword DISK_RANGE_Search(IN LBA _sector)
+{
+	dword low = 0;
+	dword high = disk_extents_number;
+	while(low < high)
+	{
+		dword middle = (low + high)/2;
+		DISK_RANGE* range = &disk_extents[middle].range;
+		if(range->start_sector + range->number_of_sectors <= _sector)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+/**
+* @brief Doubles the extents table.
+* @return False if there was no memory.
+*/
+PRIVATE bool DISK_RANGE_GrowTable()
+{
+	dword pages = disk_extents_pages?(2*disk_extents_pages):1;
+	PHYSICAL memory = MEM_AllocPages(pages, KernelMode);
+	if(!memory)
+		return false;
+
+	if(disk_extents)
+	{
+		RTL_Copy(memory, (PHYSICAL)disk_extents, disk_extents_number*sizeof(DISK_EXTENT));
+		MEM_ReleasePages((PHYSICAL)disk_extents, disk_extents_pages);
+	}
+	disk_extents = (DISK_EXTENT*)memory;
+	disk_extents_pages = pages;
+	return true;
+}
+
+/**
+* @brief Assigns a range to an environment if no sector of it is already assigned.
+* @param _owner [in] The environment.
+* @param _range [in] The range.
+* @return True if the range was free.
+*/
+PUBLIC bool DISK_RANGE_Alloc(IN ENVIRONMENT* _owner, IN DISK_RANGE _range)
+{
+	LBA end = _range.start_sector + _range.number_of_sectors;
+	if(!_range.number_of_sectors || end < _range.start_sector)
+		return false;
+
+	//The first extent ending after the start must begin after the end
+	dword index = DISK_RANGE_Search(_range.start_sector);
+	if(index < disk_extents_number && disk_extents[index].range.start_sector < end)
+		return false;
+
+	if((disk_extents_number + 1)*sizeof(DISK_EXTENT) > disk_extents_pages*PAGE_SIZE && !DISK_RANGE_GrowTable())
+		return false;
+
+	for(dword i = disk_extents_number; i > index; i--)
+	{
+		disk_extents[i] = disk_extents[i - 1];
+	}
+	disk_extents[index].range = _range;
+	disk_extents[index].owner = _owner;
+	disk_extents_number++;
+	return true;
+}
+
+/**
+* @brief Indicates if every sector of a range is assigned to an environment.
+* @param _owner [in] The environment.
+* @param _range [in] The range.
+* @return True if the whole range is owned, may span several consecutive allocations.
+*/
+PUBLIC bool DISK_RANGE_IsOwned(IN ENVIRONMENT* _owner, IN DISK_RANGE _range)
+{
+	LBA end = _range.start_sector + _range.number_of_sectors;
+	if(!_range.number_of_sectors || end < _range.start_sector)
+		return false;
+
+	LBA sector = _range.start_sector;
+	for(dword i = DISK_RANGE_Search(sector); sector < end; i++)
+	{
+		if(i >= disk_extents_number || disk_extents[i].owner != _owner || !DISK_RANGE_Contains(disk_extents[i].range, sector))
+			return false;
+		sector = disk_extents[i].range.start_sector + disk_extents[i].range.number_of_sectors;
+	}
+	return true;
+}
+
+/**
+* @brief Frees the sectors of a range owned by an environment, trimming or splitting the allocations
+* it only covers in part.
+* @param _owner [in] The environment.
+* @param _range [in] The range.
+* @return The number of sectors freed, zero if some sector was not owned or there was no memory to split.
+*/
+PUBLIC dword DISK_RANGE_Free(IN ENVIRONMENT* _owner, IN DISK_RANGE _range)
+{
+	if(!DISK_RANGE_IsOwned(_owner, _range))
+		return 0;
+
+	LBA end = _range.start_sector + _range.number_of_sectors;
+	dword first = DISK_RANGE_Search(_range.start_sector);
+	LBA first_start = disk_extents[first].range.start_sector;
+	LBA first_end = first_start + disk_extents[first].range.number_of_sectors;
+
+	//Freeing the middle of an allocation leaves two
+	if(first_start < _range.start_sector && first_end > end)
+	{
+		if((disk_extents_number + 1)*sizeof(DISK_EXTENT) > disk_extents_pages*PAGE_SIZE && !DISK_RANGE_GrowTable())
+			return 0;
+
+		for(dword i = disk_extents_number; i > first; i--)
+		{
+			disk_extents[i] = disk_extents[i - 1];
+		}
+		disk_extents_number++;
+		DISK_RANGE_Fill(disk_extents[first].range, first_start, _range.start_sector - first_start);
+		DISK_RANGE_Fill(disk_extents[first + 1].range, end, first_end - end);
+		return _range.number_of_sectors;
+	}
+
+	//Keeps the head of the first and the tail of the last, the ones in between go
+	if(first_start < _range.start_sector)
+	{
+		disk_extents[first].range.number_of_sectors = _range.start_sector - first_start;
+		first++;
+	}
+	dword last = first;
+	while(last < disk_extents_number && disk_extents[last].range.start_sector + disk_extents[last].range.number_of_sectors <= end)
+	{
+		last++;
+	}
+	if(last < disk_extents_number && disk_extents[last].range.start_sector < end)
+	{
+		DISK_RANGE* range = &disk_extents[last].range;
+		DISK_RANGE_Fill(*range, end, range->start_sector + range->number_of_sectors - end);
+	}
+
+	dword removed = last - first;
+	disk_extents_number -= removed;
+	for(dword i = first; i < disk_extents_number; i++)
+	{
+		disk_extents[i] = disk_extents[i + removed];
+	}
+	return _range.number_of_sectors;
+}
+
+/**
+* @brief Frees all the ranges of an environment.
+* @param _owner [in] The environment.
+*/
+PUBLIC void DISK_RANGE_Release(IN ENVIRONMENT* _owner)
+{
+	dword j = 0;
+	for(dword i = 0; i < disk_extents_number; i++)
+	{
+		if(disk_extents[i].owner != _owner)
+			disk_extents[j++] = disk_extents[i];
+	}
+	disk_extents_number = j;
+}
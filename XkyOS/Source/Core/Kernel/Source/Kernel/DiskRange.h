@@ -24,9 +24,16 @@
 		dword	number_of_sectors;
 	};
 
+	struct ENVIRONMENT; /**< Forwarded definition*/
+
 	void	DISK_RANGE_Fill	(OUT DISK_RANGE& _range, IN LBA _start_sector, IN dword _number_of_sectors);
 	
 	bool	DISK_RANGE_Contains	(IN DISK_RANGE _range, IN LBA _sector);
 	bool	DISK_RANGE_ClashWith(IN DISK_RANGE _range, IN DISK_RANGE _other);
 
+	bool	DISK_RANGE_Alloc	(IN ENVIRONMENT* _owner, IN DISK_RANGE _range);
+	bool	DISK_RANGE_IsOwned	(IN ENVIRONMENT* _owner, IN DISK_RANGE _range);
+	dword	DISK_RANGE_Free		(IN ENVIRONMENT* _owner, IN DISK_RANGE _range);
+	void	DISK_RANGE_Release	(IN ENVIRONMENT* _owner);
+
 #endif //__DISK_RANGE_H__
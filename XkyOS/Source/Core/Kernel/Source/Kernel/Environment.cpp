@@ -9,6 +9,9 @@
 */
 /******************************************************************************/
 #include "Environment.h"
+#include "Pager.h"
+#include "DiskQueue.h"
+#include "Handles.h"
 #include "RTL.h"
 
 #include "Debug.h"
@@ -49,26 +52,6 @@ struct ENVIRONMENT
 	*/
 	LIST_ENTRY listable;
 	/**
-	* @brief The memory address space of the environment.
-	*/
-	LIST_ENTRY pdbrs;
-	/**
-	* @brief The list of disk sectors for the environment.
-	*/
-	LIST_ENTRY disks;
-	/**
-	* @brief The list of cpu slices for the environment.
-	*/
-	LIST_ENTRY cpus;
-	/**
-	* @brief The list of windows for the environment.
-	*/
-	LIST_ENTRY windows;
-	/**
-	* @brief The list of pci devices for the environment.
-	*/
-	LIST_ENTRY pcis;
-	/**
 	* @brief The list of exception handlers associated with the process.
 	*/
 	EXCEPTION_HANDLER exceptions[MAX_EXCEPTIONS];
@@ -77,32 +60,24 @@ struct ENVIRONMENT
 	*/
 	TIMER_CALLBACK timer;
 	/**
+	* @brief What it holds and has consumed, and how much it may hold.
+	*/
+	ENVIRONMENT_USAGE	usage;
+	ENVIRONMENT_LIMITS	limits;
+	/**
 	* @brief Name of the process.
 	*/
 	//DEFINE_BOUNDED_STRING(name, ENVIRONMENT_NAME_SIZE);
 };
 
 /**
-* @brief The structure where environment resources gets tracked.
+* @brief Owners of the resources, a table per type. Xids and windows are slot based handles, address
+* spaces and pci devices are addresses so their tables are hashed.
 */
-struct RESOURCE
-{
-	/**
-	* @brief This makes the resource able to be in a list.
-	*/
-	LIST_ENTRY listable;
-	/**
-	* @brief Resource type.
-	*/
-	union
-	{
-		ADDRESS_SPACE	pdbr;
-		DISK_RANGE		disk_range;
-		XID				xid;
-		WINDOW			window;
-		PCI				pci;
-	};
-};
+PRIVATE HANDLE_TABLE environment_pdbrs;
+PRIVATE HANDLE_TABLE environment_cpus;
+PRIVATE HANDLE_TABLE environment_windows;
+PRIVATE HANDLE_TABLE environment_pcis;
 
 /**
 * @brief The environments list.
@@ -134,12 +109,14 @@ PRIVATE bool EnvironmentProcessorCallback(IN XID _xid, IN EXECUTION* _execution,
 	}
 	if(current_environment)
 	{
+		current_environment->usage.ticks++;
+
 		//Call GUI callbacks
-		for(LIST_ITERATOR iter = LIST_First(&current_environment->windows); iter; iter = LIST_Next(&current_environment->windows, iter))
+		for(dword i = 0; i < HANDLE_GetSlots(&environment_windows); i++)
 		{
-			RESOURCE* node = (RESOURCE*)iter;
-			WINDOW_FlushKeyboardCallbacks(node->window);
-			WINDOW_FlushMouseCallbacks(node->window);
+			WINDOW window = HANDLE_GetHandle(&environment_windows, i, current_environment);
+			if(window)
+				WINDOW_FlushEvents(window);
 		}
 
 		//Call timer callback
@@ -169,6 +146,12 @@ PUBLIC bool ENVIRONMENT_Init()
 	//Set current environment to none
 	current_environment = 0;
 
+	//Resource tables
+	HANDLE_InitTable(&environment_pdbrs, true);
+	HANDLE_InitTable(&environment_cpus, false);
+	HANDLE_InitTable(&environment_windows, false);
+	HANDLE_InitTable(&environment_pcis, true);
+
 	return true;
 }
 
@@ -200,12 +183,19 @@ PUBLIC ENVIRONMENT* ENVIRONMENT_Create(IN string* _module_name)
 		return 0;
 	}
 
-	//Initialize resource lists
-	LIST_Init(&environment->pdbrs);
-	LIST_Init(&environment->disks);
-	LIST_Init(&environment->cpus);
-	LIST_Init(&environment->windows);
-	LIST_Init(&environment->pcis);
+	//Nothing held yet
+	environment->usage.pages = 0;
+	environment->usage.sectors = 0;
+	environment->usage.executions = 0;
+	environment->usage.windows = 0;
+	environment->usage.ticks = 0;
+	environment->usage.syscalls = 0;
+
+	environment->limits.pages = ENVIRONMENT_MAX_PAGES;
+	environment->limits.sectors = ENVIRONMENT_MAX_SECTORS;
+	environment->limits.executions = ENVIRONMENT_MAX_EXECUTIONS;
+	environment->limits.windows = ENVIRONMENT_MAX_WINDOWS;
+	environment->limits.weight = ENVIRONMENT_MAX_WEIGHT;
 
 	//Add initial_pdbr to the list of environment's address spaces
 	if(!ENVIRONMENT_AllocPDBR(environment, initial_pdbr))
@@ -236,7 +226,7 @@ PUBLIC ENVIRONMENT* ENVIRONMENT_Create(IN string* _module_name)
 	}
 
 	//Map and rebase the api
-	dword api_pages_to_map = RTL_BytesToPages(FILE_Size(&api_name));
+	dword api_pages_to_map = RTL_BytesToPages(((IMG_MODULE_HEADER*)api_module)->file_header.size);
 
 	if(!ADDRESS_SPACE_Map(initial_pdbr, api_module, API_START_DIRECTION, api_pages_to_map, UserMode, ReadOnly, true))
 	{
@@ -246,41 +236,58 @@ PUBLIC ENVIRONMENT* ENVIRONMENT_Create(IN string* _module_name)
 
 	LDR_ReubicateImage((IMG_MODULE_HEADER*)api_module, API_START_DIRECTION);
 
-	//Load module image
-	PHYSICAL exec_module = LDR_LoadImage(_module_name, UserMode);
-
-	if(!exec_module)
-	{
-		DEBUG_DATA("No LDR_LoadImage EXE = ", exec_module, 0x0000FF00)
-		//Free all (note that api module is mapped, so this wil release physical pages allocated in Map)
-		goto _Error;
-	}
-
 	/*
 	IMPORTANT:
 		Module api must be rebased before resolving imports so the function addresses are the
 		final virtual ones.
 	*/
 
-	//Resolve imports
-	dword exec_pages_to_map = RTL_BytesToPages(FILE_Size(_module_name));
-
-	if(!LDR_ResolveImports((IMG_MODULE_HEADER*)exec_module, (IMG_MODULE_HEADER*)api_module))
+	//Reserve module image, its pages are read and rebased on first touch
+	PHYSICAL exec_module = PAGER_MapImage(_module_name, initial_pdbr, MODULE_START_DIRECTION, UserMode, ReadWrite);
+	if(exec_module)
 	{
-		DEBUG("No LDR_ResolveImports")
-		//Free all
-		MEM_ReleasePages(exec_module, exec_pages_to_map);
-		goto _Error;
+		//Header and imports are already in
+		if(	!LDR_IsBound((IMG_MODULE_HEADER*)exec_module, (IMG_MODULE_HEADER*)api_module, API_START_DIRECTION) &&
+			!LDR_ResolveImports((IMG_MODULE_HEADER*)exec_module, (IMG_MODULE_HEADER*)api_module))
+		{
+			DEBUG("No LDR_ResolveImports")
+			//Free all (pages are owned by the address space)
+			goto _Error;
+		}
 	}
-
-	//Map and rebase
-	if(!ADDRESS_SPACE_Map(initial_pdbr, exec_module, MODULE_START_DIRECTION, exec_pages_to_map, UserMode, ReadWrite, true))
+	else
 	{
-		MEM_ReleasePages(exec_module, exec_pages_to_map);
-		goto _Error;
-	}
+		//Image without page index, load module image
+		exec_module = LDR_LoadImage(_module_name, UserMode);
+
+		if(!exec_module)
+		{
+			DEBUG_DATA("No LDR_LoadImage EXE = ", exec_module, 0x0000FF00)
+			//Free all (note that api module is mapped, so this wil release physical pages allocated in Map)
+			goto _Error;
+		}
+
+		//Resolve imports
+		dword exec_pages_to_map = RTL_BytesToPages(((IMG_MODULE_HEADER*)exec_module)->file_header.size);
+
+		if(	!LDR_IsBound((IMG_MODULE_HEADER*)exec_module, (IMG_MODULE_HEADER*)api_module, API_START_DIRECTION) &&
+			!LDR_ResolveImports((IMG_MODULE_HEADER*)exec_module, (IMG_MODULE_HEADER*)api_module))
+		{
+			DEBUG("No LDR_ResolveImports")
+			//Free all
+			MEM_ReleasePages(exec_module, exec_pages_to_map);
+			goto _Error;
+		}
 
-	LDR_ReubicateImage((IMG_MODULE_HEADER*)exec_module, MODULE_START_DIRECTION);
+		//Map and rebase
+		if(!ADDRESS_SPACE_Map(initial_pdbr, exec_module, MODULE_START_DIRECTION, exec_pages_to_map, UserMode, ReadWrite, true))
+		{
+			MEM_ReleasePages(exec_module, exec_pages_to_map);
+			goto _Error;
+		}
+
+		LDR_ReubicateImage((IMG_MODULE_HEADER*)exec_module, MODULE_START_DIRECTION);
+	}
 
 	//Allocate and map stack
 	PHYSICAL stack = MEM_AllocPages(NUMBER_OF_STACK_PAGES, UserMode);
@@ -316,6 +323,9 @@ PUBLIC ENVIRONMENT* ENVIRONMENT_Create(IN string* _module_name)
 		goto _Error;
 	}
 
+	//Charge the image, api and stack, plus the address space tables
+	environment->usage.pages = 3 + ADDRESS_SPACE_GetAllOwnedPages(initial_pdbr);
+
 	//Insert in environment list
 	LIST_InsertTail(&environments, (LIST_ENTRY*)environment);
 
@@ -323,25 +333,14 @@ PUBLIC ENVIRONMENT* ENVIRONMENT_Create(IN string* _module_name)
 	return environment;
 
 _Error:
+	HANDLE_Release(&environment_pdbrs, environment);
+	DISK_QUEUE_Release(initial_pdbr);
+	PAGER_Release(initial_pdbr);
 	ADDRESS_SPACE_Release(initial_pdbr);
 	HEAP_Free((PHYSICAL&)environment);
 	return 0;
 }
 
-/**
-* @brief Frees a reource environment list.
-* @param _head [in] The head of the reosurce list.
-*/
-PRIVATE void ENVIRONMENT_DeleteList(IN LIST_ENTRY* _head)
-{
-	while(!LIST_IsEmpty(_head))
-	{
-		LIST_ITERATOR iter = LIST_First(_head);
-		LIST_Remove(iter);
-		HEAP_Free((PHYSICAL&)iter); //RESOURCE*
-	}
-}
-
 /**
 * @brief Deletes an environment.
 * @param _environment [in] The environment to release.
@@ -352,40 +351,39 @@ PUBLIC void ENVIRONMENT_Release(IN ENVIRONMENT* _environment)
 
 	//Free resources
 	//Windows
-	LIST_ITERATOR iter;
-	for(iter = LIST_First(&_environment->windows); iter; iter = LIST_Next(&_environment->windows, iter))
+	dword i;
+	for(i = 0; i < HANDLE_GetSlots(&environment_windows); i++)
 	{
-		RESOURCE* node = (RESOURCE*)iter;
-		WINDOW_ReleaseWindow(node->window);
+		WINDOW window = HANDLE_GetHandle(&environment_windows, i, _environment);
+		if(window)
+			WINDOW_ReleaseWindow(window);
 	}
 	//Xid's
-	for(iter = LIST_First(&_environment->cpus); iter; iter = LIST_Next(&_environment->cpus, iter))
+	for(i = 0; i < HANDLE_GetSlots(&environment_cpus); i++)
 	{
-		RESOURCE* node = (RESOURCE*)iter;
-		PROCESSOR_DeleteExecution(node->xid);
+		XID xid = HANDLE_GetHandle(&environment_cpus, i, _environment);
+		if(xid)
+			PROCESSOR_DeleteExecution(xid);
 	}
 	//PDBR's
-	for(iter = LIST_First(&_environment->pdbrs); iter; iter = LIST_Next(&_environment->pdbrs, iter))
+	for(i = 0; i < HANDLE_GetSlots(&environment_pdbrs); i++)
 	{
-		RESOURCE* node = (RESOURCE*)iter;
-		ADDRESS_SPACE_Release(node->pdbr);
+		ADDRESS_SPACE pdbr = HANDLE_GetHandle(&environment_pdbrs, i, _environment);
+		if(pdbr)
+		{
+			DISK_QUEUE_Release(pdbr);
+			PAGER_Release(pdbr);
+			ADDRESS_SPACE_Release(pdbr);
+		}
 	}
 	//DISK
-	/*
-	for(iter = LIST_First(&_environment->disks); iter; iter = LIST_Next(&_environment->disks, iter))
-	{
-		RESOURCE* node = (RESOURCE*)iter;
-		DISK_RANGE_Release(node->disk_range);
-		//Actualize persistent disk owning list if applicable
-	}
-	*/
+	DISK_RANGE_Release(_environment);
 
-	//Delete the lists
-	ENVIRONMENT_DeleteList(&_environment->pdbrs);
-	ENVIRONMENT_DeleteList(&_environment->disks);
-	ENVIRONMENT_DeleteList(&_environment->cpus);
-	ENVIRONMENT_DeleteList(&_environment->windows);
-	ENVIRONMENT_DeleteList(&_environment->pcis);
+	//Forget the owner
+	HANDLE_Release(&environment_pdbrs, _environment);
+	HANDLE_Release(&environment_cpus, _environment);
+	HANDLE_Release(&environment_windows, _environment);
+	HANDLE_Release(&environment_pcis, _environment);
 
 	//Remove environment from list
 	LIST_Remove((LIST_ENTRY*)_environment);
@@ -394,25 +392,27 @@ PUBLIC void ENVIRONMENT_Release(IN ENVIRONMENT* _environment)
 	HEAP_Free((PHYSICAL&)_environment);
 }
 
+/**
+* @brief Checks a limit.
+* @param _used [in] What is held.
+* @param _more [in] What is asked for.
+* @param _limit [in] The limit.
+* @return True if what is held plus what is asked for does not go over the limit.
+*/
+PRIVATE bool ENVIRONMENT_Fits(IN dword _used, IN dword _more, IN dword _limit)
+{
+	return _more <= _limit && _used <= _limit - _more;
+}
+
 /**
 * @brief Assigns an address space to an environment.
 * @param _environment [in] The environment.
 * @param _address_space [in] The address space.
-* @return True if assignment can be done, false otherwise.
+* @return True if assignment can be done (no environment owns it), false otherwise.
 */
 PUBLIC bool ENVIRONMENT_AllocPDBR(IN ENVIRONMENT* _environment, IN ADDRESS_SPACE _address_space)
 {
-	if(ENVIRONMENT_OwnsPDBR(_environment, _address_space))
-		return false;
-
-	RESOURCE* node = (RESOURCE*)HEAP_Alloc(sizeof(RESOURCE));
-	if(!node) return false;
-
-	node->pdbr = _address_space;
-	LIST_Init((LIST_ENTRY*)node);
-	LIST_InsertTail(&_environment->pdbrs, (LIST_ENTRY*)node);
-
-	return true;
+	return HANDLE_Insert(&environment_pdbrs, _address_space, _environment);
 }
 
 /**
@@ -423,13 +423,7 @@ PUBLIC bool ENVIRONMENT_AllocPDBR(IN ENVIRONMENT* _environment, IN ADDRESS_SPACE
 */
 PUBLIC bool ENVIRONMENT_OwnsPDBR(IN ENVIRONMENT* _environment, IN ADDRESS_SPACE _address_space)
 {
-	for(LIST_ITERATOR iter = LIST_First(&_environment->pdbrs); iter; iter = LIST_Next(&_environment->pdbrs, iter))
-	{
-		RESOURCE* node = (RESOURCE*)iter;
-		if(node->pdbr == _address_space)
-			return true;
-	}
-	return false;
+	return _environment && HANDLE_GetOwner(&environment_pdbrs, _address_space) == _environment;
 }
 
 /**
@@ -440,36 +434,24 @@ PUBLIC bool ENVIRONMENT_OwnsPDBR(IN ENVIRONMENT* _environment, IN ADDRESS_SPACE
 */
 PUBLIC bool ENVIRONMENT_FreePDBR(IN ENVIRONMENT* _environment, IN ADDRESS_SPACE _address_space)
 {
-	for(LIST_ITERATOR iter = LIST_First(&_environment->pdbrs); iter; iter = LIST_Next(&_environment->pdbrs, iter))
-	{
-		RESOURCE* node = (RESOURCE*)iter;
-		if(node->pdbr == _address_space)
-		{
-			LIST_Remove(iter);
-			HEAP_Free((PHYSICAL&)node);
-			return true;
-		}
-	}
-	return false;
+	return HANDLE_Remove(&environment_pdbrs, _address_space, _environment);
 }
 
 /**
 * @brief Assigns a disk range to an environment.
 * @param _environment [in] The environment.
 * @param _disk_range [in] The disk range of sectors.
-* @return True if assignment can be done, false otherwise.
+* @return True if assignment can be done (no sector is assigned to any environment), false otherwise.
 */
 PUBLIC bool ENVIRONMENT_AllocDISK(IN ENVIRONMENT* _environment, IN DISK_RANGE _disk_range)
 {
-	if(ENVIRONMENT_OwnsDISK(_environment, _disk_range))
+	if(!_environment || !ENVIRONMENT_Fits(_environment->usage.sectors, _disk_range.number_of_sectors, _environment->limits.sectors))
 		return false;
 
-	RESOURCE* node = (RESOURCE*)HEAP_Alloc(sizeof(RESOURCE));
-	if(!node) return false;
+	if(!DISK_RANGE_Alloc(_environment, _disk_range))
+		return false;
 
-	node->disk_range = _disk_range;
-	LIST_Init((LIST_ENTRY*)node);
-	LIST_InsertTail(&_environment->disks, (LIST_ENTRY*)node);
+	_environment->usage.sectors += _disk_range.number_of_sectors;
 	return true;
 }
 
@@ -477,59 +459,47 @@ PUBLIC bool ENVIRONMENT_AllocDISK(IN ENVIRONMENT* _environment, IN DISK_RANGE _d
 * @brief Indicates if a given range of disk addresses is owned by an environment.
 * @param _environment [in] The environment.
 * @param _disk_range [in] The range of sector addresses to test.
-* @return True if the any of the sectors is owned.
+* @return True if all the sectors are owned.
 */
 PUBLIC bool ENVIRONMENT_OwnsDISK(IN ENVIRONMENT* _environment, IN DISK_RANGE _disk_range)
 {
-	for(LIST_ITERATOR iter = LIST_First(&_environment->disks); iter; iter = LIST_Next(&_environment->disks, iter))
-	{
-		RESOURCE* node = (RESOURCE*)iter;
-		if(DISK_RANGE_ClashWith(node->disk_range, _disk_range))
-			return true;
-	}
-	return false;
+	return DISK_RANGE_IsOwned(_environment, _disk_range);
 }
 
 /**
 * @brief Liberates a range of sectors.
 * @param _environment [in] The environment.
-* @param _start_lba [in] The starting lba of the disk range to release.
-* @return True if the lba was owned.
+* @param _disk_range [in] The disk range to release.
+* @return True if the whole range was owned.
 */
-PUBLIC bool ENVIRONMENT_FreeDISK(IN ENVIRONMENT* _environment, IN LBA _start_lba)
+PUBLIC bool ENVIRONMENT_FreeDISK(IN ENVIRONMENT* _environment, IN DISK_RANGE _disk_range)
 {
-	for(LIST_ITERATOR iter = LIST_First(&_environment->disks); iter; iter = LIST_Next(&_environment->disks, iter))
-	{
-		RESOURCE* node = (RESOURCE*)iter;
-		if(DISK_RANGE_Contains(node->disk_range, _start_lba))
-		{
-			LIST_Remove(iter);
-			HEAP_Free((PHYSICAL&)node);
-			return true;
-		}
-	}
-	return false;
+	dword sectors = DISK_RANGE_Free(_environment, _disk_range);
+	if(!sectors)
+		return false;
+
+	_environment->usage.sectors -= sectors;
+	return true;
 }
 
 /**
 * @brief Assigns a xid to an environment.
 * @param _environment [in] The environment.
 * @param _xid [in] The xid.
-* @return True if assignment can be done, false otherwise.
+* @return True if assignment can be done (no environment owns it), false otherwise.
 */
 PUBLIC bool ENVIRONMENT_AllocCPU(IN ENVIRONMENT* _environment, IN XID _xid)
 {
-	if(ENVIRONMENT_OwnsCPU(_environment, _xid))
+	if(!_environment || !ENVIRONMENT_Fits(_environment->usage.executions, 1, _environment->limits.executions))
 		return false;
 
-	RESOURCE* node = (RESOURCE*)HEAP_Alloc(sizeof(RESOURCE));
-	if(!node) return false;
+	if(!HANDLE_Insert(&environment_cpus, _xid, _environment))
+		return false;
 
-	node->xid = _xid;
-	LIST_Init((LIST_ENTRY*)node);
-	LIST_InsertTail(&_environment->cpus, (LIST_ENTRY*)node);
+	_environment->usage.executions++;
 
 	PROCESSOR_RegisterCallback(_xid, EnvironmentProcessorCallback);
+	PROCESSOR_SetWeight(_environment, _environment->limits.weight);
 
 	return true;
 }
@@ -542,13 +512,7 @@ PUBLIC bool ENVIRONMENT_AllocCPU(IN ENVIRONMENT* _environment, IN XID _xid)
 */
 PUBLIC bool ENVIRONMENT_OwnsCPU(IN ENVIRONMENT* _environment, IN XID _xid)
 {
-	for(LIST_ITERATOR iter = LIST_First(&_environment->cpus); iter; iter = LIST_Next(&_environment->cpus, iter))
-	{
-		RESOURCE* node = (RESOURCE*)iter;
-		if(node->xid == _xid)
-			return true;
-	}
-	return false;
+	return _environment && HANDLE_GetOwner(&environment_cpus, _xid) == _environment;
 }
 
 /**
@@ -559,36 +523,28 @@ PUBLIC bool ENVIRONMENT_OwnsCPU(IN ENVIRONMENT* _environment, IN XID _xid)
 */
 PUBLIC bool ENVIRONMENT_FreeCPU(IN ENVIRONMENT* _environment, IN XID _xid)
 {
-	for(LIST_ITERATOR iter = LIST_First(&_environment->cpus); iter; iter = LIST_Next(&_environment->cpus, iter))
-	{
-		RESOURCE* node = (RESOURCE*)iter;
-		if(node->xid == _xid)
-		{
-			LIST_Remove(iter);
-			HEAP_Free((PHYSICAL&)node);
-			return true;
-		}
-	}
-	return false;
+	if(!HANDLE_Remove(&environment_cpus, _xid, _environment))
+		return false;
+
+	_environment->usage.executions--;
+	return true;
 }
 
 /**
 * @brief Assigns a window to an environment.
 * @param _environment [in] The environment.
 * @param _window [in] The window.
-* @return True if assignment can be done, false otherwise.
+* @return True if assignment can be done (no environment owns it), false otherwise.
 */
 PUBLIC bool ENVIRONMENT_AllocWINDOW(IN ENVIRONMENT* _environment, IN WINDOW _window)
 {
-	if(ENVIRONMENT_OwnsWINDOW(_environment, _window))
+	if(!_environment || !ENVIRONMENT_Fits(_environment->usage.windows, 1, _environment->limits.windows))
 		return false;
 
-	RESOURCE* node = (RESOURCE*)HEAP_Alloc(sizeof(RESOURCE));
-	if(!node) return false;
+	if(!HANDLE_Insert(&environment_windows, _window, _environment))
+		return false;
 
-	node->window = _window;
-	LIST_Init((LIST_ENTRY*)node);
-	LIST_InsertTail(&_environment->windows, (LIST_ENTRY*)node);
+	_environment->usage.windows++;
 	return true;
 }
 
@@ -600,13 +556,7 @@ PUBLIC bool ENVIRONMENT_AllocWINDOW(IN ENVIRONMENT* _environment, IN WINDOW _win
 */
 PUBLIC bool ENVIRONMENT_OwnsWINDOW(IN ENVIRONMENT* _environment, IN WINDOW _window)
 {
-	for(LIST_ITERATOR iter = LIST_First(&_environment->windows); iter; iter = LIST_Next(&_environment->windows, iter))
-	{
-		RESOURCE* node = (RESOURCE*)iter;
-		if(node->window == _window)
-			return true;
-	}
-	return false;
+	return _environment && HANDLE_GetOwner(&environment_windows, _window) == _environment;
 }
 
 /**
@@ -617,37 +567,22 @@ PUBLIC bool ENVIRONMENT_OwnsWINDOW(IN ENVIRONMENT* _environment, IN WINDOW _wind
 */
 PUBLIC bool ENVIRONMENT_FreeWINDOW(IN ENVIRONMENT* _environment, IN WINDOW _window)
 {
-	for(LIST_ITERATOR iter = LIST_First(&_environment->windows); iter; iter = LIST_Next(&_environment->windows, iter))
-	{
-		RESOURCE* node = (RESOURCE*)iter;
-		if(node->window == _window)
-		{
-			LIST_Remove(iter);
-			HEAP_Free((PHYSICAL&)node);
-			return true;
-		}
-	}
-	return false;
+	if(!HANDLE_Remove(&environment_windows, _window, _environment))
+		return false;
+
+	_environment->usage.windows--;
+	return true;
 }
 
 /**
 * @brief Assigns a pci device to an environment.
 * @param _environment [in] The environment.
 * @param _pci [in] The pci address device.
-* @return True if assignment can be done, false otherwise.
+* @return True if assignment can be done (no environment owns it), false otherwise.
 */
 PUBLIC bool ENVIRONMENT_AllocPCI(IN ENVIRONMENT* _environment, IN PCI _pci)
 {
-	if(ENVIRONMENT_OwnsPCI(_environment, _pci))
-		return false;
-
-	RESOURCE* node = (RESOURCE*)HEAP_Alloc(sizeof(RESOURCE));
-	if(!node) return false;
-
-	node->pci = _pci;
-	LIST_Init((LIST_ENTRY*)node);
-	LIST_InsertTail(&_environment->pcis, (LIST_ENTRY*)node);
-	return true;
+	return HANDLE_Insert(&environment_pcis, _pci, _environment);
 }
 
 /**
@@ -658,13 +593,7 @@ PUBLIC bool ENVIRONMENT_AllocPCI(IN ENVIRONMENT* _environment, IN PCI _pci)
 */
 PUBLIC bool ENVIRONMENT_OwnsPCI(IN ENVIRONMENT* _environment, IN PCI _pci)
 {
-	for(LIST_ITERATOR iter = LIST_First(&_environment->pcis); iter; iter = LIST_Next(&_environment->pcis, iter))
-	{
-		RESOURCE* node = (RESOURCE*)iter;
-		if(node->pci == _pci)
-			return true;
-	}
-	return false;
+	return _environment && HANDLE_GetOwner(&environment_pcis, _pci) == _environment;
 }
 
 /**
@@ -675,17 +604,125 @@ PUBLIC bool ENVIRONMENT_OwnsPCI(IN ENVIRONMENT* _environment, IN PCI _pci)
 */
 PUBLIC bool ENVIRONMENT_FreePCI(IN ENVIRONMENT* _environment, IN PCI _pci)
 {
-	for(LIST_ITERATOR iter = LIST_First(&_environment->pcis); iter; iter = LIST_Next(&_environment->pcis, iter))
+	return HANDLE_Remove(&environment_pcis, _pci, _environment);
+}
+
+/**
+* @brief Charges physical pages to an environment, before they are allocated.
+* @param _environment [in] The environment, zero for the kernel.
+* @param _number_of_pages [in] The number of pages.
+* @return False if the environment would go over its limit.
+*/
+PUBLIC bool ENVIRONMENT_ChargePages(IN ENVIRONMENT* _environment, IN dword _number_of_pages)
+{
+	if(!_environment)
+		return true;
+
+	if(!ENVIRONMENT_Fits(_environment->usage.pages, _number_of_pages, _environment->limits.pages))
+		return false;
+
+	_environment->usage.pages += _number_of_pages;
+	return true;
+}
+
+/**
+* @brief Gives back physical pages to an environment.
+* @param _environment [in] The environment, zero for the kernel.
+* @param _number_of_pages [in] The number of pages released.
+*/
+PUBLIC void ENVIRONMENT_CreditPages(IN ENVIRONMENT* _environment, IN dword _number_of_pages)
+{
+	if(!_environment)
+		return;
+
+	//Pages mapped by the kernel in its spaces were not charged
+	if(_number_of_pages > _environment->usage.pages)
+		_number_of_pages = _environment->usage.pages;
+
+	_environment->usage.pages -= _number_of_pages;
+}
+
+/**
+* @brief Counts a service request.
+* @param _environment [in] The environment asking, zero for the kernel.
+*/
+PUBLIC void ENVIRONMENT_CountSyscall(IN ENVIRONMENT* _environment)
+{
+	if(_environment)
+		_environment->usage.syscalls++;
+}
+
+/**
+* @brief Consults what an environment holds and its limits.
+* @param _environment [in] The environment.
+* @param _usage [out] What it holds and has consumed.
+* @param _limits [out] Its limits.
+*/
+PUBLIC void ENVIRONMENT_GetAccount(IN ENVIRONMENT* _environment, OUT ENVIRONMENT_USAGE* _usage, OUT ENVIRONMENT_LIMITS* _limits)
+{
+	*_usage = _environment->usage;
+	*_limits = _environment->limits;
+}
+
+/**
+* @brief Lowers the limits of an environment. Limits can't be raised, so a guest can contain itself
+* but not escape the defaults.
+* @param _environment [in] The environment.
+* @param _limits [in] The new limits.
+*/
+PUBLIC void ENVIRONMENT_SetLimits(IN ENVIRONMENT* _environment, IN ENVIRONMENT_LIMITS* _limits)
+{
+	if(_limits->pages < _environment->limits.pages)
+		_environment->limits.pages = _limits->pages;
+	if(_limits->sectors < _environment->limits.sectors)
+		_environment->limits.sectors = _limits->sectors;
+	if(_limits->executions < _environment->limits.executions)
+		_environment->limits.executions = _limits->executions;
+	if(_limits->windows < _environment->limits.windows)
+		_environment->limits.windows = _limits->windows;
+	if(_limits->weight < _environment->limits.weight)
 	{
-		RESOURCE* node = (RESOURCE*)iter;
-		if(node->pci == _pci)
-		{
-			LIST_Remove(iter);
-			HEAP_Free((PHYSICAL&)node);
-			return true;
-		}
+		_environment->limits.weight = _limits->weight;
+		PROCESSOR_SetWeight(_environment, _limits->weight);
+	}
+}
+
+/**
+* @brief Writes a counter to the debug output, in red once it reaches its limit.
+* @param _text [in] The counter name.
+* @param _used [in] The counter.
+* @param _limit [in] The limit, 0xFFFFFFFF if none.
+*/
+PRIVATE void ENVIRONMENT_DumpCounter(IN string* _text, IN dword _used, IN dword _limit)
+{
+	DEBUG_Data(_text, _used, (_used >= _limit)?0x00FF0000:0x0000FF00);
+}
+
+/**
+* @brief Writes the accounting of every environment to the debug output.
+*/
+PUBLIC void ENVIRONMENT_Dump()
+{
+	string environment_text = STRING("Environment = ");
+	string pages_text = STRING("  Pages = ");
+	string sectors_text = STRING("  Sectors = ");
+	string executions_text = STRING("  Executions = ");
+	string windows_text = STRING("  Windows = ");
+	string weight_text = STRING("  Weight = ");
+	string ticks_text = STRING("  Ticks = ");
+	string syscalls_text = STRING("  Syscalls = ");
+
+	for(ENVIRONMENT* e = ENVIRONMENT_First(); e; e = ENVIRONMENT_Next(e))
+	{
+		DEBUG_Data(&environment_text, (dword)e, 0x00FFFFFF);
+		ENVIRONMENT_DumpCounter(&pages_text, e->usage.pages, e->limits.pages);
+		ENVIRONMENT_DumpCounter(&sectors_text, e->usage.sectors, e->limits.sectors);
+		ENVIRONMENT_DumpCounter(&executions_text, e->usage.executions, e->limits.executions);
+		ENVIRONMENT_DumpCounter(&windows_text, e->usage.windows, e->limits.windows);
+		ENVIRONMENT_DumpCounter(&weight_text, e->limits.weight, 0xFFFFFFFF);
+		ENVIRONMENT_DumpCounter(&ticks_text, e->usage.ticks, 0xFFFFFFFF);
+		ENVIRONMENT_DumpCounter(&syscalls_text, e->usage.syscalls, 0xFFFFFFFF);
 	}
-	return false;
 }
 
 /**
@@ -29,6 +29,37 @@
 	*/
 	typedef bool (*fCpuTimerCallback)(IN XID _xid, IN EXECUTION* _execution);
 
+	/**
+	* @brief What an environment holds and what it has consumed.
+	*/
+	struct ENVIRONMENT_USAGE
+	{
+		dword pages;		/*< Physical pages mapped for it by its services*/
+		dword sectors;		/*< Disk sectors allocated*/
+		dword executions;	/*< Xids*/
+		dword windows;
+		dword ticks;		/*< Timer ticks its executions were scheduled on*/
+		dword syscalls;
+	};
+
+	/**
+	* @brief Limits checked when an environment allocates.
+	*/
+	struct ENVIRONMENT_LIMITS
+	{
+		dword pages;
+		dword sectors;
+		dword executions;
+		dword windows;
+		dword weight;		/*< Share of the CPU against other environments, whatever its xids*/
+	};
+
+	#define ENVIRONMENT_MAX_PAGES		0x00008000	/**< Default page limit (128MB)*/
+	#define ENVIRONMENT_MAX_SECTORS		0x00200000	/**< Default disk limit (1GB)*/
+	#define ENVIRONMENT_MAX_EXECUTIONS	64			/**< Default xid limit*/
+	#define ENVIRONMENT_MAX_WINDOWS		16			/**< Default window limit*/
+	#define ENVIRONMENT_MAX_WEIGHT		PROCESSOR_DEFAULT_WEIGHT	/**< Default CPU weight*/
+
 	bool ENVIRONMENT_Init();
 	
 	#define MODULE_START_DIRECTION	0x80000000 /**< Address where module gets mapped on new execution */
@@ -45,7 +76,7 @@
 
 	bool ENVIRONMENT_AllocDISK	(IN ENVIRONMENT* _environment, IN DISK_RANGE _disk_range);
 	bool ENVIRONMENT_OwnsDISK	(IN ENVIRONMENT* _environment, IN DISK_RANGE _disk_range);
-	bool ENVIRONMENT_FreeDISK	(IN ENVIRONMENT* _environment, IN LBA _start_lba);
+	bool ENVIRONMENT_FreeDISK	(IN ENVIRONMENT* _environment, IN DISK_RANGE _disk_range);
 
 	bool ENVIRONMENT_AllocCPU	(IN ENVIRONMENT* _environment, IN XID _xid);
 	bool ENVIRONMENT_OwnsCPU	(IN ENVIRONMENT* _environment, IN XID _xid);
@@ -59,6 +90,14 @@
 	bool ENVIRONMENT_OwnsPCI	(IN ENVIRONMENT* _environment, IN PCI _pci);
 	bool ENVIRONMENT_FreePCI	(IN ENVIRONMENT* _environment, IN PCI _pci);
 
+	bool ENVIRONMENT_ChargePages	(IN ENVIRONMENT* _environment, IN dword _number_of_pages);
+	void ENVIRONMENT_CreditPages	(IN ENVIRONMENT* _environment, IN dword _number_of_pages);
+	void ENVIRONMENT_CountSyscall	(IN ENVIRONMENT* _environment);
+
+	void ENVIRONMENT_GetAccount	(IN ENVIRONMENT* _environment, OUT ENVIRONMENT_USAGE* _usage, OUT ENVIRONMENT_LIMITS* _limits);
+	void ENVIRONMENT_SetLimits	(IN ENVIRONMENT* _environment, IN ENVIRONMENT_LIMITS* _limits);
+	void ENVIRONMENT_Dump		();
+
 
 	ENVIRONMENT* ENVIRONMENT_GetCurrent	();
 	ENVIRONMENT* ENVIRONMENT_First		();
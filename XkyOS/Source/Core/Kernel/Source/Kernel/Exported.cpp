@@ -17,6 +17,10 @@ BOUNDED_STRING(dynamic_module_name, 255, 0);
 */
 PUBLIC ADDRESS_SPACE XKY_ADDRESS_SPACE_Alloc()
 {
+	//Directory and kernel tables
+	if(!ENVIRONMENT_ChargePages(ENVIRONMENT_GetCurrent(), 3))
+		return 0;
+
 	ADDRESS_SPACE current = ADDRESS_SPACE_GetCurrent();
 	ADDRESS_SPACE_ResetToKernelSpace();
 
@@ -31,6 +35,7 @@ PUBLIC ADDRESS_SPACE XKY_ADDRESS_SPACE_Alloc()
 		ADDRESS_SPACE_Release(address_space);
 	}
 	ADDRESS_SPACE_SwitchTo(current);
+	ENVIRONMENT_CreditPages(ENVIRONMENT_GetCurrent(), 3);
 	return 0;
 }
 
@@ -49,7 +54,10 @@ PUBLIC bool XKY_ADDRESS_SPACE_Free(IN ADDRESS_SPACE _address_space)
 
 	if(ENVIRONMENT_FreePDBR(ENVIRONMENT_GetCurrent(), _address_space))
 	{
-		ADDRESS_SPACE_Release(_address_space);
+		WINDOW_ReleaseSurfaces(_address_space);
+		DISK_QUEUE_Release(_address_space);
+		PAGER_Release(_address_space);
+		ENVIRONMENT_CreditPages(ENVIRONMENT_GetCurrent(), 3 + ADDRESS_SPACE_Release(_address_space));
 	}
 
 	ADDRESS_SPACE_SwitchTo(current);
@@ -87,6 +95,9 @@ PUBLIC bool XKY_ADDRESS_SPACE_SwitchTo(IN ADDRESS_SPACE _address_space)
 */
 PUBLIC VIRTUAL XKY_PAGE_Alloc(IN ADDRESS_SPACE _address_space, IN VIRTUAL _address, IN dword _number_of_pages)
 {
+	if(!ENVIRONMENT_ChargePages(ENVIRONMENT_GetCurrent(), _number_of_pages))
+		return false;
+
 	ADDRESS_SPACE current = ADDRESS_SPACE_GetCurrent();
 	ADDRESS_SPACE_ResetToKernelSpace();
 
@@ -95,6 +106,7 @@ PUBLIC VIRTUAL XKY_PAGE_Alloc(IN ADDRESS_SPACE _address_space, IN VIRTUAL _addre
 	if(!pages)
 	{
 		ADDRESS_SPACE_SwitchTo(current);
+		ENVIRONMENT_CreditPages(ENVIRONMENT_GetCurrent(), _number_of_pages);
 		return false;
 	}
 
@@ -102,6 +114,7 @@ PUBLIC VIRTUAL XKY_PAGE_Alloc(IN ADDRESS_SPACE _address_space, IN VIRTUAL _addre
 	if(!success)
 	{
 		MEM_ReleasePages(pages, _number_of_pages);
+		ENVIRONMENT_CreditPages(ENVIRONMENT_GetCurrent(), _number_of_pages);
 	}
 
 	ADDRESS_SPACE_SwitchTo(current);
@@ -119,7 +132,13 @@ PUBLIC void XKY_PAGE_Free(IN ADDRESS_SPACE _address_space, IN VIRTUAL _address,
 	ADDRESS_SPACE current = ADDRESS_SPACE_GetCurrent();
 	ADDRESS_SPACE_ResetToKernelSpace();
 
+	//The disk must be done with the pages before they can be given to someone else
+	DISK_QUEUE_ReleasePages(_address_space, _address, _number_of_pages);
+
+	//Unmapping stops at the first hole, credit what actually went away
+	dword owned = ADDRESS_SPACE_GetOwnedPages(_address_space, _address, _number_of_pages);
 	ADDRESS_SPACE_Unmap(_address_space, _address, _number_of_pages);
+	ENVIRONMENT_CreditPages(ENVIRONMENT_GetCurrent(), owned - ADDRESS_SPACE_GetOwnedPages(_address_space, _address, _number_of_pages));
 
 	ADDRESS_SPACE_SwitchTo(current);
 }
@@ -179,7 +198,7 @@ PUBLIC bool XKY_PAGE_Share(IN ADDRESS_SPACE _pdbr_origin, IN VIRTUAL _origin, IN
 */
 PUBLIC LBA XKY_DISK_Alloc(IN LBA _sector, IN dword _number_of_sectors)
 {
-	if(_sector >= HD_Size())
+	if(_sector >= HD_Size() || _number_of_sectors > HD_Size() - _sector)
 		return 0;
 
 	//First 4MB are for kernel
@@ -187,19 +206,10 @@ PUBLIC LBA XKY_DISK_Alloc(IN LBA _sector, IN dword _number_of_sectors)
 	if((HD_BootDrive() == HD_DRIVE) && (_sector < KERNEL_DISK_MEGAS*1024*1024/SECTOR_SIZE))
 		return 0;
 
-	//Check sectors are not used
+	//Add to current if no environment has any of the sectors
 	DISK_RANGE range;
 	DISK_RANGE_Fill(range, _sector, _number_of_sectors);
 
-	for(ENVIRONMENT* e = ENVIRONMENT_First(); e; e = ENVIRONMENT_Next(e))
-	{
-		if(ENVIRONMENT_OwnsDISK(e, range))
-		{
-			return 0;
-		}
-	}
-
-	//Ok, they're empty, so add to current
 	if(!ENVIRONMENT_AllocDISK(ENVIRONMENT_GetCurrent(), range))
 		return 0;
 
@@ -214,7 +224,16 @@ PUBLIC LBA XKY_DISK_Alloc(IN LBA _sector, IN dword _number_of_sectors)
 */
 PUBLIC void XKY_DISK_Free(IN LBA _sector, IN dword _number_of_sectors)
 {
-	ENVIRONMENT_FreeDISK(ENVIRONMENT_GetCurrent(), _sector);
+	DISK_RANGE range;
+	DISK_RANGE_Fill(range, _sector, _number_of_sectors);
+
+	ENVIRONMENT* environment = ENVIRONMENT_GetCurrent();
+	if(!ENVIRONMENT_OwnsDISK(environment, range))
+		return;
+
+	//No request may complete into the sectors once they can be given to someone else
+	DISK_QUEUE_ReleaseSectors(environment, range);
+	ENVIRONMENT_FreeDISK(environment, range);
 }
 
 /**
@@ -258,9 +277,85 @@ PUBLIC bool XKY_DISK_Write(IN LBA _sector, IN VIRTUAL _memory, IN dword _number_
 	}
 
 	//Do write
+	DISK_CACHE_Invalidate(_sector, _number_of_sectors);
 	return HD_WriteSectors(0, _sector, _number_of_sectors, _memory) == _number_of_sectors;
 }
 
+/**
+* @brief Submits a disk request, which is transferred while the caller goes on.
+* @param _sector [in] The first sector.
+* @param _memory [in] The buffer, in user pages of the current address space. It must stay mapped until the request ends.
+* @param _number_of_sectors [in] Number of sectors.
+* @param _write [in] True to write to the disk, false to read from it.
+* @return The request, zero if the sectors are not owned or there are too many requests.
+*/
+PUBLIC DISK_REQUEST XKY_DISK_Submit(IN LBA _sector, IN VIRTUAL _memory, IN dword _number_of_sectors, IN bool _write)
+{
+	DISK_RANGE range;
+	DISK_RANGE_Fill(range, _sector, _number_of_sectors);
+
+	//Check if lba's is owned by environment
+	if(!ENVIRONMENT_OwnsDISK(ENVIRONMENT_GetCurrent(), range))
+	{
+		return 0;
+	}
+
+	if(_write)
+		DISK_CACHE_Invalidate(_sector, _number_of_sectors);
+
+	return DISK_QUEUE_Submit(ENVIRONMENT_GetCurrent(), ADDRESS_SPACE_GetCurrent(), _sector, _memory, _number_of_sectors, _write);
+}
+
+/**
+* @brief Tells how a disk request is going. Once it has ended the request is forgotten.
+* @param _request [in] The request.
+* @return DISK_REQUEST_PENDING, DISK_REQUEST_DONE or DISK_REQUEST_FAILED, zero if not a request of the caller.
+*/
+PUBLIC dword XKY_DISK_Poll(IN DISK_REQUEST _request)
+{
+	return DISK_QUEUE_Poll(ENVIRONMENT_GetCurrent(), _request);
+}
+
+/**
+* @brief Waits for a disk request to end, and forgets it. Guests are blocked by the system call
+* instead, this polls the disk.
+* @param _request [in] The request.
+* @return True if all the sectors were transferred.
+*/
+PUBLIC bool XKY_DISK_Wait(IN DISK_REQUEST _request)
+{
+	dword state = DISK_QUEUE_Poll(ENVIRONMENT_GetCurrent(), _request);
+	while(state == DISK_REQUEST_PENDING)
+	{
+		HD_Drain();
+		state = DISK_QUEUE_Poll(ENVIRONMENT_GetCurrent(), _request);
+	}
+	return state == DISK_REQUEST_DONE;
+}
+
+/**
+* @brief Chooses the disk scheduler, for all the environments.
+* @param _scheduler [in] DISK_SCHEDULER_FIFO or DISK_SCHEDULER_CLOOK.
+* @return True if it is a scheduler.
+*/
+PUBLIC bool XKY_DISK_SetScheduler(IN dword _scheduler)
+{
+	return DISK_QUEUE_SetScheduler(_scheduler);
+}
+
+/**
+* @brief Gets the disk queue counters.
+* @param _statistics [out] Where to leave them.
+*/
+PUBLIC void XKY_DISK_GetStatistics(OUT DISK_STATISTICS* _statistics)
+{
+	if(_statistics)
+	{
+		DISK_QUEUE_GetStatistics(_statistics);
+		DISK_CACHE_GetStatistics(_statistics);
+	}
+}
+
 //Windows
 /**
 * @brief Allocates a window.
@@ -439,6 +534,152 @@ PUBLIC void XKY_WINDOW_SetPointerColor(IN WINDOW _window, IN ARGB _color)
 	}
 }
 
+/**
+* @brief Maps a private surface of a window where it can be drawn directly.
+* @param _window [in] The window.
+* @param _pdbr [in] The address space where the surface will be mapped.
+* @param _address [in] The virtual address where the surface will be mapped.
+* @return The virtual address of the surface if successful, 0 otherwise.
+*/
+PUBLIC VIRTUAL XKY_WINDOW_MapSurface(IN WINDOW _window, IN ADDRESS_SPACE _pdbr, IN VIRTUAL _address)
+{
+	if(_window && ENVIRONMENT_OwnsWINDOW(ENVIRONMENT_GetCurrent(), _window) && ENVIRONMENT_OwnsPDBR(ENVIRONMENT_GetCurrent(), _pdbr))
+	{
+		return WINDOW_MapSurface(_window, _pdbr, _address);
+	}
+	return 0;
+}
+
+/**
+* @brief Shows the contents of the window surface.
+* @param _window [in] The window.
+*/
+PUBLIC void XKY_WINDOW_Present(IN WINDOW _window)
+{
+	if(_window && ENVIRONMENT_OwnsWINDOW(ENVIRONMENT_GetCurrent(), _window))
+	{
+		WINDOW_Present(_window);
+	}
+}
+
+/**
+* @brief Consults the compositor counters.
+* @param _statistics [out] Where to leave the counters.
+*/
+PUBLIC void XKY_WINDOW_GetStatistics(OUT WINDOW_STATISTICS* _statistics)
+{
+	if(_statistics)
+	{
+		WINDOW_GetStatistics(_statistics);
+	}
+}
+
+/**
+* @brief Prints text in a window filling the background of each character.
+* @param _window [in] The window.
+* @param _x [in] The x coordinate.
+* @param _y [in] The y coordinate.
+* @param _foreground [in] The color of the text.
+* @param _background [in] The color behind the text.
+* @param _text [in] The text.
+*/
+PUBLIC void XKY_WINDOW_PrintTextOpaque(IN WINDOW _window, IN dword _x, IN dword _y, IN ARGB _foreground, IN ARGB _background, IN string* _text)
+{
+	if(_window && ENVIRONMENT_OwnsWINDOW(ENVIRONMENT_GetCurrent(), _window))
+	{
+		WINDOW_PrintTextOpaque(_window, _x, _y, _foreground, _background, _text);
+	}
+}
+
+/**
+* @brief Scrolls up the inside of a window between two rows.
+* @param _window [in] The window.
+* @param _y_low [in] Lowest row that moves.
+* @param _y_high [in] Highest row.
+* @param _distance [in] Number of rows to move.
+* @param _color [in] Color for the emptied rows.
+*/
+PUBLIC void XKY_WINDOW_Scroll(IN WINDOW _window, IN dword _y_low, IN dword _y_high, IN dword _distance, IN ARGB _color)
+{
+	if(_window && ENVIRONMENT_OwnsWINDOW(ENVIRONMENT_GetCurrent(), _window))
+	{
+		WINDOW_Scroll(_window, _y_low, _y_high, _distance, _color);
+	}
+}
+
+/**
+* @brief Draws a BMP file (24 or 32 bits, uncompressed) in a window.
+* @param _window [in] The window.
+* @param _x [in] X coordinate of the low left corner.
+* @param _y [in] Y coordinate of the low left corner.
+* @param _file [in] The file contents.
+* @param _size [in] The file size.
+* @return True if the file could be drawn.
+*/
+PUBLIC bool XKY_WINDOW_DrawBitmap(IN WINDOW _window, IN dword _x, IN dword _y, IN byte* _file, IN dword _size)
+{
+	if(_window && ENVIRONMENT_OwnsWINDOW(ENVIRONMENT_GetCurrent(), _window))
+	{
+		return WINDOW_DrawBitmap(_window, _x, _y, _file, _size);
+	}
+	return false;
+}
+
+/**
+* @brief Moves a window.
+* @param _window [in] The window.
+* @param _x [in] X coordinate of the low left corner.
+* @param _y [in] Y coordinate of the low left corner.
+*/
+PUBLIC void XKY_WINDOW_Move(IN WINDOW _window, IN dword _x, IN dword _y)
+{
+	if(_window && ENVIRONMENT_OwnsWINDOW(ENVIRONMENT_GetCurrent(), _window))
+	{
+		WINDOW_Move(_window, _x, _y);
+	}
+}
+
+/**
+* @brief Changes a window size.
+* @param _window [in] The window.
+* @param _width [in] The new width.
+* @param _height [in] The new height.
+* @return True if the window has the new size.
+*/
+PUBLIC bool XKY_WINDOW_Resize(IN WINDOW _window, IN dword _width, IN dword _height)
+{
+	if(_window && ENVIRONMENT_OwnsWINDOW(ENVIRONMENT_GetCurrent(), _window))
+	{
+		return WINDOW_Resize(_window, _width, _height);
+	}
+	return false;
+}
+
+/**
+* @brief Chooses how windows are placed, tiled or overlapped.
+* @param _layout [in] WINDOW_LAYOUT_TILED or WINDOW_LAYOUT_OVERLAPPED.
+*/
+PUBLIC void XKY_WINDOW_SetLayout(IN dword _layout)
+{
+	WINDOW_SetLayout(_layout);
+}
+
+/**
+* @brief Maps the input events ring of a window where it can be read directly.
+* @param _window [in] The window.
+* @param _pdbr [in] The address space where the ring will be mapped.
+* @param _address [in] The virtual address where the ring will be mapped.
+* @return The virtual address of the ring if successful, 0 otherwise.
+*/
+PUBLIC VIRTUAL XKY_WINDOW_MapEvents(IN WINDOW _window, IN ADDRESS_SPACE _pdbr, IN VIRTUAL _address)
+{
+	if(_window && ENVIRONMENT_OwnsWINDOW(ENVIRONMENT_GetCurrent(), _window) && ENVIRONMENT_OwnsPDBR(ENVIRONMENT_GetCurrent(), _pdbr))
+	{
+		return WINDOW_MapEvents(_window, _pdbr, _address);
+	}
+	return 0;
+}
+
 //PCI
 /**
 * @brief Allocates a PCI device.
@@ -447,14 +688,7 @@ PUBLIC void XKY_WINDOW_SetPointerColor(IN WINDOW _window, IN ARGB _color)
 */
 PUBLIC PCI XKY_PCI_Alloc(IN PCI _device)
 {
-	//Check it's not used
-	for(ENVIRONMENT* e = ENVIRONMENT_First(); e; e = ENVIRONMENT_Next(e))
-	{
-		if(ENVIRONMENT_OwnsPCI(e, _device))
-			return 0;
-	}
-
-	//Ok
+	//Fails if any environment owns it
 	if(!ENVIRONMENT_AllocPCI(ENVIRONMENT_GetCurrent(), _device))
 		return 0;
 
@@ -620,8 +854,10 @@ PUBLIC void XKY_CPU_Free(IN XID _xid)
 	//Release CPU
 	if(ENVIRONMENT_FreeCPU(ENVIRONMENT_GetCurrent(), _xid))
 	{
+		//Deleting changes the generation of the xid
+		bool current = PROCESSOR_GetCurrentXID() == _xid;
 		PROCESSOR_DeleteExecution(_xid);
-		if(PROCESSOR_GetCurrentXID() == _xid)
+		if(current)
 		{
 			//Wait until a new timer interrupt changes execution
 			__asm sti
@@ -750,15 +986,41 @@ PUBLIC bool XKY_LDR_LoadUserModule(IN string* _module, IN ADDRESS_SPACE _pdbr, I
 		//Get parameters
 		STRING_Copy(dynamic_module_name, _module);
 
+		//The image pages are the caller's
+		dword pages = RTL_BytesToPages(FILE_Size(dynamic_module_name));
+		if(!ENVIRONMENT_ChargePages(ENVIRONMENT_GetCurrent(), pages))
+			return false;
+
 		//Change to kernel memory space to be able to map in environments memory address
 		ADDRESS_SPACE current = ADDRESS_SPACE_GetCurrent();
 		ADDRESS_SPACE_ResetToKernelSpace();
 
+		//User api module, imports get resolved against it
+		PTE* pte_api = VIRTUAL_PTE_Address(_pdbr, API_START_DIRECTION);
+
+		//Reserve Module, pages get read and rebased on first touch
+		PHYSICAL module = PAGER_MapImage(dynamic_module_name, _pdbr, _base, UserMode, ReadWrite);
+		if(module)
+		{
+			if(LDR_IsBound((IMG_MODULE_HEADER*)module, (IMG_MODULE_HEADER*) (pte_api->address<<12), API_START_DIRECTION) || LDR_ResolveImports((IMG_MODULE_HEADER*)module, (IMG_MODULE_HEADER*) (pte_api->address<<12)))
+			{
+				//Restore memory space
+				ADDRESS_SPACE_SwitchTo(current);
+				return true;
+			}
+			PAGER_UnmapImage(_pdbr, _base);
+
+			//Restore memory space
+			ADDRESS_SPACE_SwitchTo(current);
+			ENVIRONMENT_CreditPages(ENVIRONMENT_GetCurrent(), pages);
+			return false;
+		}
+
 		//Map Module
-		PHYSICAL module = LDR_LoadImage(dynamic_module_name, UserMode);
+		module = LDR_LoadImage(dynamic_module_name, UserMode);
 		if(module)
 		{
-			dword file_size = FILE_Size(dynamic_module_name);
+			dword file_size = ((IMG_MODULE_HEADER*)module)->file_header.size;
 			dword pages_to_map = RTL_BytesToPages(file_size);
 
 			if(ADDRESS_SPACE_Map(_pdbr, module, _base, pages_to_map, UserMode, ReadWrite, true))
@@ -766,10 +1028,7 @@ PUBLIC bool XKY_LDR_LoadUserModule(IN string* _module, IN ADDRESS_SPACE _pdbr, I
 				//Reubicate
 				LDR_ReubicateImage((IMG_MODULE_HEADER*)module, _base);
 
-				//Resolve imports with user api module
-				PTE* pte_api = VIRTUAL_PTE_Address(_pdbr, API_START_DIRECTION);
-
-				if(LDR_ResolveImports((IMG_MODULE_HEADER*)module, (IMG_MODULE_HEADER*) (pte_api->address<<12)))
+				if(LDR_IsBound((IMG_MODULE_HEADER*)module, (IMG_MODULE_HEADER*) (pte_api->address<<12), API_START_DIRECTION) || LDR_ResolveImports((IMG_MODULE_HEADER*)module, (IMG_MODULE_HEADER*) (pte_api->address<<12)))
 				{
 					//Restore memory space
 					ADDRESS_SPACE_SwitchTo(current);
@@ -788,6 +1047,7 @@ PUBLIC bool XKY_LDR_LoadUserModule(IN string* _module, IN ADDRESS_SPACE _pdbr, I
 
 		//Restore memory space
 		ADDRESS_SPACE_SwitchTo(current);
+		ENVIRONMENT_CreditPages(ENVIRONMENT_GetCurrent(), pages);
 	}
 	return false;
 }
@@ -808,7 +1068,7 @@ PUBLIC bool XKY_LDR_LoadKernelModule(IN string* _module)
 		PHYSICAL module = LDR_LoadImage(dynamic_module_name, KernelMode);
 		if(module)
 		{
-			dword file_size = FILE_Size(dynamic_module_name);
+			dword file_size = ((IMG_MODULE_HEADER*)module)->file_header.size;
 			dword pages_to_map = RTL_BytesToPages(file_size);
 
 			//Reubicate
@@ -816,7 +1076,7 @@ PUBLIC bool XKY_LDR_LoadKernelModule(IN string* _module)
 
 			//Resolve imports with user api module
 #define KERNEL_LOAD_ADDRESS 0x00030000
-			if(LDR_ResolveImports((IMG_MODULE_HEADER*)module, (IMG_MODULE_HEADER*)KERNEL_LOAD_ADDRESS))
+			if(LDR_IsBound((IMG_MODULE_HEADER*)module, (IMG_MODULE_HEADER*)KERNEL_LOAD_ADDRESS, KERNEL_LOAD_ADDRESS) || LDR_ResolveImports((IMG_MODULE_HEADER*)module, (IMG_MODULE_HEADER*)KERNEL_LOAD_ADDRESS))
 			{
 				//Now find EntryPoint and call it
 				IMG_MODULE_HEADER* header = (IMG_MODULE_HEADER*)module;
@@ -852,6 +1112,10 @@ PUBLIC bool XKY_LDR_LoadFile(IN string* _file, IN ADDRESS_SPACE _pdbr, IN VIRTUA
 		//Get parameters
 		STRING_Copy(dynamic_module_name, _file);
 
+		dword pages = RTL_BytesToPages(FILE_Size(dynamic_module_name));
+		if(!ENVIRONMENT_ChargePages(ENVIRONMENT_GetCurrent(), pages))
+			return false;
+
 		//Change to kernel memory space to be able to map in environments memory address
 		ADDRESS_SPACE current = ADDRESS_SPACE_GetCurrent();
 		ADDRESS_SPACE_ResetToKernelSpace();
@@ -876,6 +1140,7 @@ PUBLIC bool XKY_LDR_LoadFile(IN string* _file, IN ADDRESS_SPACE _pdbr, IN VIRTUA
 
 		//Restore memory space
 		ADDRESS_SPACE_SwitchTo(current);
+		ENVIRONMENT_CreditPages(ENVIRONMENT_GetCurrent(), pages);
 	}
 	return false;
 }
@@ -918,6 +1183,25 @@ PUBLIC bool XKY_OS_Start(IN string* _module)
 	return 0;
 }
 
+/**
+* @brief Consults what the caller environment holds and its limits.
+* @param _usage [out] What it holds and has consumed.
+* @param _limits [out] Its limits.
+*/
+PUBLIC void XKY_OS_GetAccount(OUT ENVIRONMENT_USAGE* _usage, OUT ENVIRONMENT_LIMITS* _limits)
+{
+	ENVIRONMENT_GetAccount(ENVIRONMENT_GetCurrent(), _usage, _limits);
+}
+
+/**
+* @brief Lowers the limits of the caller environment.
+* @param _limits [in] The new limits, higher ones are ignored.
+*/
+PUBLIC void XKY_OS_SetLimits(IN ENVIRONMENT_LIMITS* _limits)
+{
+	ENVIRONMENT_SetLimits(ENVIRONMENT_GetCurrent(), _limits);
+}
+
 /**
 * @brief Finalizes the caller environment.
 */
@@ -977,6 +1261,18 @@ PUBLIC void XKY_INTERRUPT_UnsetHandler(IN byte _interrupt, IN fInterruptHandler
 	INT_UnsetHandler(SoftwareInterrupt, _interrupt, _handler);
 }
 
+/**
+* @brief Consults the interrupt latency counters.
+* @param _statistics [out] Where to leave the counters.
+*/
+PUBLIC void XKY_INTERRUPT_GetStatistics(OUT INTERRUPT_STATISTICS* _statistics)
+{
+	if(_statistics)
+	{
+		INT_GetStatistics(_statistics);
+	}
+}
+
 //DEBUG
 /**
 * @brief Sends a message to the debug output.
@@ -998,3 +1294,28 @@ PUBLIC void XKY_DEBUG_Data(IN string* _message, IN dword _data, IN dword _color)
 {
 	DEBUG_Data(_message, _data, _color);
 }
+
+/**
+* @brief Sends the accounting of every environment to the debug output.
+*/
+PUBLIC void XKY_DEBUG_Environments()
+{
+	ENVIRONMENT_Dump();
+}
+
+//SVGA
+/**
+* @brief Runs once a pixel row primitive over memory of the caller, to measure it.
+* @param _primitive [in] PIXELS_FILL, PIXELS_COPY or PIXELS_BLEND.
+* @param _implementation [in] PIXELS_STRING, PIXELS_MMX or PIXELS_SSE.
+* @param _buffer [in] Memory for 2*_count pixels.
+* @param _count [in] Number of pixels.
+* @return False if the implementation is not available in this CPU.
+*/
+PUBLIC bool XKY_SVGA_Benchmark(IN dword _primitive, IN dword _implementation, IN VIRTUAL _buffer, IN dword _count)
+{
+	if(!_buffer || !_count)
+		return false;
+
+	return PIXELS_Benchmark(_primitive, _implementation, (ARGB*)_buffer, _count);
+}
@@ -10,6 +10,9 @@
 	#include "RTC.h"
 	#include "Timer.h"
 	#include "Environment.h"
+	#include "Pager.h"
+	#include "DiskQueue.h"
+	#include "DiskCache.h"
 	#include "Interrupts.h"
 	#include "RTL.h"
 	#include "Debug.h"
@@ -29,6 +32,11 @@
 	void	XKY_DISK_Free	(IN LBA _sector, IN dword _number_of_sectors);
 	bool	XKY_DISK_Read	(IN LBA _sector, IN VIRTUAL _memory, IN dword _number_of_sectors);
 	bool	XKY_DISK_Write	(IN LBA _sector, IN VIRTUAL _memory, IN dword _number_of_sectors);
+	DISK_REQUEST	XKY_DISK_Submit	(IN LBA _sector, IN VIRTUAL _memory, IN dword _number_of_sectors, IN bool _write);
+	dword			XKY_DISK_Poll	(IN DISK_REQUEST _request);
+	bool			XKY_DISK_Wait	(IN DISK_REQUEST _request);
+	bool			XKY_DISK_SetScheduler	(IN dword _scheduler);
+	void			XKY_DISK_GetStatistics	(OUT DISK_STATISTICS* _statistics);
 
 	//Windows
 	WINDOW	XKY_WINDOW_Alloc	();
@@ -44,6 +52,16 @@
 	POINTER	XKY_POINTER_GetClock		();
 	void	XKY_WINDOW_SetPointer		(IN WINDOW _window, IN POINTER _pointer);
 	void	XKY_WINDOW_SetPointerColor	(IN WINDOW _window, IN ARGB _color);
+	VIRTUAL	XKY_WINDOW_MapSurface		(IN WINDOW _window, IN ADDRESS_SPACE _pdbr, IN VIRTUAL _address);
+	void	XKY_WINDOW_Present			(IN WINDOW _window);
+	void	XKY_WINDOW_GetStatistics	(OUT WINDOW_STATISTICS* _statistics);
+	void	XKY_WINDOW_PrintTextOpaque	(IN WINDOW _window, IN dword _x, IN dword _y, IN ARGB _foreground, IN ARGB _background, IN string* _text);
+	void	XKY_WINDOW_Scroll			(IN WINDOW _window, IN dword _y_low, IN dword _y_high, IN dword _distance, IN ARGB _color);
+	bool	XKY_WINDOW_DrawBitmap		(IN WINDOW _window, IN dword _x, IN dword _y, IN byte* _file, IN dword _size);
+	void	XKY_WINDOW_Move				(IN WINDOW _window, IN dword _x, IN dword _y);
+	bool	XKY_WINDOW_Resize			(IN WINDOW _window, IN dword _width, IN dword _height);
+	void	XKY_WINDOW_SetLayout		(IN dword _layout);
+	VIRTUAL	XKY_WINDOW_MapEvents		(IN WINDOW _window, IN ADDRESS_SPACE _pdbr, IN VIRTUAL _address);
 
 	//PCI
 	PCI		XKY_PCI_Alloc	(IN PCI _device);
@@ -86,15 +104,22 @@
 	//OS
 	bool	XKY_OS_Start	(IN string* _module);
 	void	XKY_OS_Finish	();
+	void	XKY_OS_GetAccount	(OUT ENVIRONMENT_USAGE* _usage, OUT ENVIRONMENT_LIMITS* _limits);
+	void	XKY_OS_SetLimits	(IN ENVIRONMENT_LIMITS* _limits);
 
 	//EXCEPTION
 	bool XKY_EXCEPTION_SetHandler	(IN byte _exception, IN ADDRESS_SPACE _pdbr, IN fInterruptHandler _handler);
 	void XKY_EXCEPTION_UnsetHandler	(IN byte _exception);
 	bool XKY_INTERRUPT_SetHandler	(IN byte _interrupt, IN fInterruptHandler _handler);
 	void XKY_INTERRUPT_UnsetHandler	(IN byte _interrupt, IN fInterruptHandler _handler);
+	void XKY_INTERRUPT_GetStatistics(OUT INTERRUPT_STATISTICS* _statistics);
 
 	//DEBUG
 	void XKY_DEBUG_Message	(IN string* _message, IN dword _color);
 	void XKY_DEBUG_Data		(IN string* _message, IN dword _data, IN dword _color);
+	void XKY_DEBUG_Environments	();
+
+	//SVGA
+	bool XKY_SVGA_Benchmark	(IN dword _primitive, IN dword _implementation, IN VIRTUAL _buffer, IN dword _count);
 
 #endif //__EXPORTED_H__
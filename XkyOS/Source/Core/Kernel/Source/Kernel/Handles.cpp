@@ -0,0 +1,290 @@
+/******************************************************************************/
+/**
+* @file		Handles.cpp
+* @brief	XkyOS Handle tables
+* Implementation of the tables recording which environment owns each resource handle, so an
+* ownership check is a load and a compare whatever the number of resources.
+*
+* @date		20/03/2008
+* @author	Pablo Bravo
+*/
+/******************************************************************************/
+#include "Handles.h"
+#include "Memory.h"
+
+//==================================DATA======================================//
+#pragma data_seg(".data")
+//============================================================================//
+#define HANDLE_ENTRIES_PER_PAGE	(PAGE_SIZE/sizeof(HANDLE_ENTRY))
+#define HANDLE_HASH_MULTIPLIER	0x9E3779B1	/**< Golden ratio, spreads page aligned addresses*/
+
+//==================================CODE======================================//
+#pragma code_seg(".code")
+//============================================================================//
+/**
+* @brief Initializes an empty table, it gets memory on first insertion.
+* @param _table [out] The table.
+* @param _hashed [in] True for handles that are addresses, false for slot based handles.
+*/
+PUBLIC void HANDLE_InitTable(OUT HANDLE_TABLE* _table, IN bool _hashed)
+{
+	_table->entries = 0;
+	_table->number = 0;
+	_table->pages = 0;
+	_table->used = 0;
+	_table->shift = 32;
+	_table->hashed = _hashed;
+}
+
+/**
+* @brief Home slot of a handle in a hashed table.
+* @param _table [in] The table.
+* @param _handle [in] The handle.
+* @return The slot where the probe starts.
+*/
+PRIVATE dword HANDLE_Hash(IN HANDLE_TABLE* _table, IN dword _handle)
+{
+	return (_handle*HANDLE_HASH_MULTIPLIER) >> _table->shift;
+}
+
+/**
+* @brief Finds the slot of a handle.
+* @param _table [in] The table.
+* @param _handle [in] The handle.
+* @return The slot, or the number of slots if the handle is not in the table.
+*/
+PRIVATE dword HANDLE_Find(IN HANDLE_TABLE* _table, IN dword _handle)
+{
+	if(!_table->number)
+		return 0;
+
+	if(!_table->hashed)
+	{
+		dword slot = HANDLE_INDEX(_handle);
+		if(slot < _table->number && _table->entries[slot].owner && _table->entries[slot].handle == _handle)
+			return slot;
+		return _table->number;
+	}
+
+	dword mask = _table->number - 1;
+	for(dword slot = HANDLE_Hash(_table, _handle); _table->entries[slot].owner; slot = (slot + 1)&mask)
+	{
+		if(_table->entries[slot].handle == _handle)
+			return slot;
+	}
+	return _table->number;
+}
+
+/**
+* @brief Places an entry in the first free slot of its probe sequence.
+* @param _table [in] The hashed table, with room.
+* @param _entry [in] The entry.
+*/
+PRIVATE void HANDLE_Place(IN HANDLE_TABLE* _table, IN HANDLE_ENTRY* _entry)
+{
+	dword mask = _table->number - 1;
+	dword slot = HANDLE_Hash(_table, _entry->handle);
+	while(_table->entries[slot].owner)
+		slot = (slot + 1)&mask;
+
+	_table->entries[slot] = *_entry;
+	_table->used++;
+}
+
+/**
+* @brief Grows a table, doubling it until it has the given number of slots.
+* @param _table [in] The table.
+* @param _number [in] Slots needed.
+* @return False if there was no memory.
+*/
+PRIVATE bool HANDLE_GrowTable(IN HANDLE_TABLE* _table, IN dword _number)
+{
+	dword pages = _table->pages?(2*_table->pages):1;
+	while(pages*HANDLE_ENTRIES_PER_PAGE < _number)
+		pages *= 2;
+
+	PHYSICAL memory = MEM_AllocPages(pages, KernelMode);
+	if(!memory)
+		return false;
+
+	HANDLE_TABLE grown = *_table;
+	grown.entries = (HANDLE_ENTRY*)memory;
+	grown.number = pages*HANDLE_ENTRIES_PER_PAGE;
+	grown.pages = pages;
+	grown.used = 0;
+	grown.shift = 32;
+	for(dword number = grown.number; number > 1; number >>= 1)
+		grown.shift--;
+
+	for(dword i = 0; i < grown.number; i++)
+	{
+		grown.entries[i].handle = 0;
+		grown.entries[i].owner = 0;
+	}
+
+	//Slot based entries keep their slot, hashed ones move as the hash depends on the size
+	for(dword i = 0; i < _table->number; i++)
+	{
+		if(!_table->entries[i].owner)
+			continue;
+
+		if(grown.hashed)
+		{
+			HANDLE_Place(&grown, &_table->entries[i]);
+		}
+		else
+		{
+			grown.entries[i] = _table->entries[i];
+			grown.used++;
+		}
+	}
+
+	if(_table->entries)
+		MEM_ReleasePages((PHYSICAL)_table->entries, _table->pages);
+
+	*_table = grown;
+	return true;
+}
+
+/**
+* @brief Records the owner of a handle.
+* @param _table [in] The table.
+* @param _handle [in] The handle.
+* @param _owner [in] The environment owning it.
+* @return False if the handle is already owned or there was no memory.
+*/
+PUBLIC bool HANDLE_Insert(IN HANDLE_TABLE* _table, IN dword _handle, IN ENVIRONMENT* _owner)
+{
+	if(!_handle || !_owner || HANDLE_Find(_table, _handle) < _table->number)
+		return false;
+
+	if(_table->hashed)
+	{
+		//Keep the probes short, at most half full
+		if(2*(_table->used + 1) > _table->number && !HANDLE_GrowTable(_table, 2*(_table->used + 1)))
+			return false;
+
+		HANDLE_ENTRY entry = {_handle, _owner};
+		HANDLE_Place(_table, &entry);
+		return true;
+	}
+
+	dword slot = HANDLE_INDEX(_handle);
+	if(slot > HANDLE_MAX_INDEX)
+		return false;
+
+	if(slot >= _table->number && !HANDLE_GrowTable(_table, slot + 1))
+		return false;
+
+	//A stale entry means the slot was reused, its handle is dead
+	if(!_table->entries[slot].owner)
+		_table->used++;
+
+	_table->entries[slot].handle = _handle;
+	_table->entries[slot].owner = _owner;
+	return true;
+}
+
+/**
+* @brief Consults the owner of a handle.
+* @param _table [in] The table.
+* @param _handle [in] The handle.
+* @return The environment owning the handle, zero if none (or the handle is stale).
+*/
+PUBLIC ENVIRONMENT* HANDLE_GetOwner(IN HANDLE_TABLE* _table, IN dword _handle)
+{
+	dword slot = HANDLE_Find(_table, _handle);
+	if(slot < _table->number)
+		return _table->entries[slot].owner;
+
+	return 0;
+}
+
+/**
+* @brief Empties a slot. Hashed tables move back the entries that follow it in the probe sequence, so
+* lookups never need tombstones.
+* @param _table [in] The table.
+* @param _slot [in] The slot.
+*/
+PRIVATE void HANDLE_RemoveSlot(IN HANDLE_TABLE* _table, IN dword _slot)
+{
+	dword hole = _slot;
+	if(_table->hashed)
+	{
+		dword mask = _table->number - 1;
+		for(dword next = (hole + 1)&mask; _table->entries[next].owner; next = (next + 1)&mask)
+		{
+			//It can fill the hole if the hole lies between its home slot and where it is
+			dword home = HANDLE_Hash(_table, _table->entries[next].handle);
+			if(((next - home)&mask) >= ((next - hole)&mask))
+			{
+				_table->entries[hole] = _table->entries[next];
+				hole = next;
+			}
+		}
+	}
+
+	_table->entries[hole].handle = 0;
+	_table->entries[hole].owner = 0;
+	_table->used--;
+}
+
+/**
+* @brief Forgets the owner of a handle.
+* @param _table [in] The table.
+* @param _handle [in] The handle.
+* @param _owner [in] The environment that should own it.
+* @return True if the handle was owned by the environment.
+*/
+PUBLIC bool HANDLE_Remove(IN HANDLE_TABLE* _table, IN dword _handle, IN ENVIRONMENT* _owner)
+{
+	dword slot = HANDLE_Find(_table, _handle);
+	if(slot >= _table->number || _table->entries[slot].owner != _owner)
+		return false;
+
+	HANDLE_RemoveSlot(_table, slot);
+	return true;
+}
+
+/**
+* @brief Forgets all the handles of an environment.
+* @param _table [in] The table.
+* @param _owner [in] The environment.
+*/
+PUBLIC void HANDLE_Release(IN HANDLE_TABLE* _table, IN ENVIRONMENT* _owner)
+{
+	dword slot = 0;
+	while(slot < _table->number)
+	{
+		//Removing may bring another entry to this slot, look at it again
+		if(_table->entries[slot].owner == _owner)
+			HANDLE_RemoveSlot(_table, slot);
+		else
+			slot++;
+	}
+}
+
+/**
+* @brief Number of slots, to sweep a table with HANDLE_GetHandle.
+* @param _table [in] The table.
+* @return The number of slots.
+*/
+PUBLIC dword HANDLE_GetSlots(IN HANDLE_TABLE* _table)
+{
+	return _table->number;
+}
+
+/**
+* @brief Consults the handle in a slot.
+* @param _table [in] The table.
+* @param _slot [in] The slot.
+* @param _owner [in] The environment we are interested in.
+* @return The handle if the slot is owned by the environment, zero otherwise.
+*/
+PUBLIC dword HANDLE_GetHandle(IN HANDLE_TABLE* _table, IN dword _slot, IN ENVIRONMENT* _owner)
+{
+	if(_slot < _table->number && _table->entries[_slot].owner == _owner)
+		return _table->entries[_slot].handle;
+
+	return 0;
+}
@@ -0,0 +1,60 @@
+/******************************************************************************/
+/**
+* @file		Handles.h
+* @brief	XkyOS Handle tables
+* Definitions of the tables recording which environment owns each resource handle.
+*
+* @date		20/03/2008
+* @author	Pablo Bravo
+*/
+/******************************************************************************/
+#ifndef __HANDLES_H__
+#define __HANDLES_H__
+
+	#include "Types.h"
+
+	/**
+	* @brief Handles of slot based resources carry the slot in the low word, plus one so zero is never
+	* a handle, and the generation of the slot in the high word so a stale handle does not match once
+	* the slot is reused.
+	*/
+	#define HANDLE_INDEX(X)		(((X)&0x0000FFFF)-1)
+	#define HANDLE_MAKE(I, G)	((((G)&0x0000FFFF)<<16)|((I)+1))
+	#define HANDLE_MAX_INDEX	0x0000FFFE	/**< Last slot a handle can address*/
+
+	struct ENVIRONMENT; /**< Forwarded definition*/
+
+	/**
+	* @brief A handle and its owner.
+	*/
+	struct HANDLE_ENTRY
+	{
+		dword			handle;
+		ENVIRONMENT*	owner;
+	};
+
+	/**
+	* @brief Owners of the handles of a resource type, in kernel pages. Direct tables are indexed by
+	* HANDLE_INDEX, hashed ones (for handles that are addresses) by the handle hash with linear probing.
+	*/
+	struct HANDLE_TABLE
+	{
+		HANDLE_ENTRY*	entries;
+		dword			number;		/*< Slots, a power of two in hashed tables*/
+		dword			pages;
+		dword			used;
+		dword			shift;		/*< 32 minus log2(number), for the hash*/
+		bool			hashed;
+	};
+
+	void			HANDLE_InitTable	(OUT HANDLE_TABLE* _table, IN bool _hashed);
+
+	bool			HANDLE_Insert		(IN HANDLE_TABLE* _table, IN dword _handle, IN ENVIRONMENT* _owner);
+	ENVIRONMENT*	HANDLE_GetOwner		(IN HANDLE_TABLE* _table, IN dword _handle);
+	bool			HANDLE_Remove		(IN HANDLE_TABLE* _table, IN dword _handle, IN ENVIRONMENT* _owner);
+	void			HANDLE_Release		(IN HANDLE_TABLE* _table, IN ENVIRONMENT* _owner);
+
+	dword			HANDLE_GetSlots		(IN HANDLE_TABLE* _table);
+	dword			HANDLE_GetHandle	(IN HANDLE_TABLE* _table, IN dword _slot, IN ENVIRONMENT* _owner);
+
+#endif //__HANDLES_H__
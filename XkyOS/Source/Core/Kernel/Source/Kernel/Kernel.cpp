@@ -17,6 +17,7 @@
 #include "RTL.h"
 #include "Exported.h"
 #include "Environment.h"
+#include "Pager.h"
 #include "Functions.h"
 
 #include "Debug.h"
@@ -30,6 +31,8 @@
 //============================================================================//
 string CLI = STRING("CLI.x");
 
+#define KERNEL_SERVICE_SIZE	2	/**< Bytes of the int instruction of a system call*/
+
 //==================================CODE======================================//
 #pragma code_seg(".code")
 //============================================================================//
@@ -99,6 +102,28 @@ PRIVATE bool INTERRUPT KERNEL_Bug(IN INTERRUPT_FRAME* _frame)
 	return true;
 }
 
+/**
+* @brief Waits for a disk request for a guest. If it is pending the caller is blocked, and the service
+* is made to run again once it is woken; meanwhile the processor goes to someone else.
+* @param _frame [in] The interrupt frame, of a system call from user mode.
+* @param _service [in] Service to run again, XKY_DISK_Wait on the request.
+* @param _request [in] The request.
+*/
+PRIVATE void KERNEL_WaitDisk(IN INTERRUPT_FRAME* _frame, IN dword _service, IN DISK_REQUEST _request)
+{
+	dword state = DISK_QUEUE_Wait(ENVIRONMENT_GetCurrent(), _request, PROCESSOR_GetCurrentXID());
+	if(state != DISK_REQUEST_PENDING)
+	{
+		_frame->eax = (state == DISK_REQUEST_DONE);
+		return;
+	}
+
+	//Back to the int instruction with the service in eax, then leave. The frame is someone else's after this
+	_frame->eax = _service;
+	_frame->eip -= KERNEL_SERVICE_SIZE;
+	PROCESSOR_Yield(_frame);
+}
+
 /**
 * @brief User mode interrupt handler for services requests.
 * @param _frame [in] The interrupt frame.
@@ -110,6 +135,8 @@ PRIVATE bool INTERRUPT KERNEL_Services(IN INTERRUPT_FRAME* _frame)
 	dword service = _frame->eax;
 	_frame->eax = 0;
 
+	ENVIRONMENT_CountSyscall(ENVIRONMENT_GetCurrent());
+
 	//Stack
 	dword* stack = 0;
 
@@ -176,13 +203,51 @@ PRIVATE bool INTERRUPT KERNEL_Services(IN INTERRUPT_FRAME* _frame)
 			return false;
 		}
 		case IDX_XKY_DISK_Read:
+		case IDX_XKY_DISK_Write:
 		{
-			_frame->eax = XKY_DISK_Read((LBA)stack[0], (VIRTUAL)stack[1], stack[2]);
+			bool write = (service == IDX_XKY_DISK_Write);
+
+			//Guests wait for the disk blocked, as XKY_DISK_Wait would. The stub pops the arguments whatever the service,
+			//see the CALLn macros of API.cpp
+			DISK_REQUEST request = 0;
+			if(HD_IsDMA() && INT_InterruptFromUserMode(_frame))
+				request = XKY_DISK_Submit((LBA)stack[0], (VIRTUAL)stack[1], stack[2], write);
+			if(request)
+			{
+				stack[0] = request;
+				KERNEL_WaitDisk(_frame, IDX_XKY_DISK_Wait, request);
+				return false;
+			}
+
+			_frame->eax = write ? XKY_DISK_Write((LBA)stack[0], (VIRTUAL)stack[1], stack[2]) : XKY_DISK_Read((LBA)stack[0], (VIRTUAL)stack[1], stack[2]);
 			return false;
 		}
-		case IDX_XKY_DISK_Write:
+		case IDX_XKY_DISK_Submit:
+		{
+			_frame->eax = XKY_DISK_Submit((LBA)stack[0], (VIRTUAL)stack[1], stack[2], (bool)stack[3]);
+			return false;
+		}
+		case IDX_XKY_DISK_Poll:
+		{
+			_frame->eax = XKY_DISK_Poll((DISK_REQUEST)stack[0]);
+			return false;
+		}
+		case IDX_XKY_DISK_Wait:
+		{
+			if(INT_InterruptFromUserMode(_frame))
+				KERNEL_WaitDisk(_frame, service, (DISK_REQUEST)stack[0]);
+			else
+				_frame->eax = XKY_DISK_Wait((DISK_REQUEST)stack[0]);
+			return false;
+		}
+		case IDX_XKY_DISK_SetScheduler:
 		{
-			_frame->eax = XKY_DISK_Write((LBA)stack[0], (VIRTUAL)stack[1], stack[2]);
+			_frame->eax = XKY_DISK_SetScheduler(stack[0]);
+			return false;
+		}
+		case IDX_XKY_DISK_GetStatistics:
+		{
+			XKY_DISK_GetStatistics((DISK_STATISTICS*)stack[0]);
 			return false;
 		}
 
@@ -253,6 +318,56 @@ PRIVATE bool INTERRUPT KERNEL_Services(IN INTERRUPT_FRAME* _frame)
 			XKY_WINDOW_SetPointerColor((WINDOW)stack[0], (ARGB)stack[1]);
 			return false;
 		}
+		case IDX_XKY_WINDOW_MapSurface:
+		{
+			_frame->eax = XKY_WINDOW_MapSurface((WINDOW)stack[0], (ADDRESS_SPACE)stack[1], (VIRTUAL)stack[2]);
+			return false;
+		}
+		case IDX_XKY_WINDOW_Present:
+		{
+			XKY_WINDOW_Present((WINDOW)stack[0]);
+			return false;
+		}
+		case IDX_XKY_WINDOW_GetStatistics:
+		{
+			XKY_WINDOW_GetStatistics((WINDOW_STATISTICS*)stack[0]);
+			return false;
+		}
+		case IDX_XKY_WINDOW_PrintTextOpaque:
+		{
+			XKY_WINDOW_PrintTextOpaque((WINDOW)stack[0], stack[1], stack[2], (ARGB)stack[3], (ARGB)stack[4], (string*)stack[5]);
+			return false;
+		}
+		case IDX_XKY_WINDOW_Scroll:
+		{
+			XKY_WINDOW_Scroll((WINDOW)stack[0], stack[1], stack[2], stack[3], (ARGB)stack[4]);
+			return false;
+		}
+		case IDX_XKY_WINDOW_DrawBitmap:
+		{
+			_frame->eax = XKY_WINDOW_DrawBitmap((WINDOW)stack[0], stack[1], stack[2], (byte*)stack[3], stack[4]);
+			return false;
+		}
+		case IDX_XKY_WINDOW_Move:
+		{
+			XKY_WINDOW_Move((WINDOW)stack[0], stack[1], stack[2]);
+			return false;
+		}
+		case IDX_XKY_WINDOW_Resize:
+		{
+			_frame->eax = XKY_WINDOW_Resize((WINDOW)stack[0], stack[1], stack[2]);
+			return false;
+		}
+		case IDX_XKY_WINDOW_SetLayout:
+		{
+			XKY_WINDOW_SetLayout(stack[0]);
+			return false;
+		}
+		case IDX_XKY_WINDOW_MapEvents:
+		{
+			_frame->eax = XKY_WINDOW_MapEvents((WINDOW)stack[0], (ADDRESS_SPACE)stack[1], (VIRTUAL)stack[2]);
+			return false;
+		}
 
 		//PCI
 		case IDX_XKY_PCI_Alloc:
@@ -415,6 +530,16 @@ PRIVATE bool INTERRUPT KERNEL_Services(IN INTERRUPT_FRAME* _frame)
 			XKY_OS_Finish();
 			return false;
 		}
+		case IDX_XKY_OS_GetAccount:
+		{
+			XKY_OS_GetAccount((ENVIRONMENT_USAGE*)stack[0], (ENVIRONMENT_LIMITS*)stack[1]);
+			return false;
+		}
+		case IDX_XKY_OS_SetLimits:
+		{
+			XKY_OS_SetLimits((ENVIRONMENT_LIMITS*)stack[0]);
+			return false;
+		}
 		
 		//EXCEPTION
 		case IDX_XKY_EXCEPTION_SetHandler:
@@ -427,6 +552,11 @@ PRIVATE bool INTERRUPT KERNEL_Services(IN INTERRUPT_FRAME* _frame)
 			XKY_EXCEPTION_UnsetHandler((byte)stack[0]);
 			return false;
 		}
+		case IDX_XKY_INTERRUPT_GetStatistics:
+		{
+			XKY_INTERRUPT_GetStatistics((INTERRUPT_STATISTICS*)stack[0]);
+			return false;
+		}
 		
 		//DEBUG
 		case IDX_XKY_DEBUG_Message:
@@ -439,6 +569,18 @@ PRIVATE bool INTERRUPT KERNEL_Services(IN INTERRUPT_FRAME* _frame)
 			XKY_DEBUG_Data((string*)stack[0], stack[1], stack[2]);
 			return false;
 		}
+		case IDX_XKY_DEBUG_Environments:
+		{
+			XKY_DEBUG_Environments();
+			return false;
+		}
+
+		//SVGA
+		case IDX_XKY_SVGA_Benchmark:
+		{
+			_frame->eax = XKY_SVGA_Benchmark(stack[0], stack[1], (VIRTUAL)stack[2], stack[3]);
+			return false;
+		}
 
 		default:
 		{
@@ -487,6 +629,9 @@ PRIVATE bool INTERRUPT KERNEL_EnvironmentExceptionRedirector(IN INTERRUPT_FRAME*
 			//Free environment
 			ENVIRONMENT_Release(environment);
 
+			//It may have failed in a callback run as deferred work, that never returns
+			INT_ResetDeferredWork();
+
 			//Wait until a new timer interrupt changes execution
 			__asm sti
 			for(;;);
@@ -512,10 +657,15 @@ PRIVATE bool INTERRUPT KERNEL_EnvironmentExceptionRedirector(IN INTERRUPT_FRAME*
 */
 PRIVATE bool HARDWARE_Init(IN LOADER_DATA* _loader_data)
 {
+	//Time stamps count from power-on
+	qword entry = CPU_ReadTimeStamp();
+
 	//Screen is first as does not depend on memory and then we can show info
 	if(!SVGA_Init(_loader_data->svga)) return false;
 	DEBUG("HARDWARE Initializing...");
 	DEBUG("  SVGA Initialized");
+	DEBUG_DATA("  Boot Mcycles = ", (dword)(entry >> 20), 0x0000FF00);
+	DEBUG_DATA("  Loader disk Mcycles = ", (dword)((_loader_data->modules_loaded - _loader_data->loader_start) >> 20), 0x0000FF00);
 
 	//Initialize memory so other elements have dynamic memory
 	if(!MEM_Init(_loader_data->memory, _loader_data->svga)) return false;
@@ -542,6 +692,14 @@ PRIVATE bool HARDWARE_Init(IN LOADER_DATA* _loader_data)
 	//Hard disk
 	if(!HD_Init(_loader_data->disk)) return false;
 	DEBUG("  HARD DISK Initialized");
+	if(HD_IsDMA()) DEBUG("  HARD DISK Bus master DMA");
+
+	//The registers of the AHCI controller have to be reachable from every address space
+	if(AHCI_GetRegisters())
+	{
+		if(!ADDRESS_SPACE_AddKernelRange(AHCI_GetRegisters(), AHCI_REGISTERS_PAGES)) return false;
+		DEBUG("  HARD DISK AHCI");
+	}
 
 	//Keyboard
 	if(!KBD_Init()) return false;
@@ -598,6 +756,18 @@ PRIVATE bool KERNEL_Init(IN LOADER_DATA* _loader_data)
 	if(!ENVIRONMENT_Init()) return false;
 	DEBUG("  ENVIRONMENT SUPPORT Initialized");
 
+	//Demand paged images support
+	if(!PAGER_Init()) return false;
+	DEBUG("  PAGER SUPPORT Initialized");
+
+	//Disk requests completed on the disk interrupt
+	if(!DISK_QUEUE_Init()) return false;
+	DEBUG("  DISK QUEUE Initialized");
+
+	//Kernel reads go through the block cache, which reads ahead sequential ones
+	if(!DISK_CACHE_Init()) return false;
+	DEBUG("  DISK CACHE Initialized");
+
 	//System services
 	if(!INT_SetHandler(SoftwareInterrupt, 0x80, KERNEL_Services)) return false;
 	DEBUG("  SYSTEM SERVICES Initialized");
@@ -608,6 +778,8 @@ PRIVATE bool KERNEL_Init(IN LOADER_DATA* _loader_data)
 		if(i != 8) //KERNEL_Bug for double fault
 		{
 			INT_UnsetHandler(ExceptionInterrupt, i, KERNEL_Bug);
+			if(i == 14) //Page faults on demand paged images never reach environments
+				INT_SetHandler(ExceptionInterrupt, i, PAGER_PageFaultHandler);
 			INT_SetHandler(ExceptionInterrupt, i, KERNEL_EnvironmentExceptionRedirector);
 		}
 	}
@@ -673,6 +845,11 @@ EXPORT(XKY_DISK_Alloc);
 EXPORT(XKY_DISK_Free);
 EXPORT(XKY_DISK_Read);
 EXPORT(XKY_DISK_Write);
+EXPORT(XKY_DISK_Submit);
+EXPORT(XKY_DISK_Poll);
+EXPORT(XKY_DISK_Wait);
+EXPORT(XKY_DISK_SetScheduler);
+EXPORT(XKY_DISK_GetStatistics);
 
 EXPORT(XKY_WINDOW_Alloc);
 EXPORT(XKY_WINDOW_Free);
@@ -687,6 +864,16 @@ EXPORT(XKY_POINTER_GetArrow);
 EXPORT(XKY_POINTER_GetClock);
 EXPORT(XKY_WINDOW_SetPointer);
 EXPORT(XKY_WINDOW_SetPointerColor);
+EXPORT(XKY_WINDOW_MapSurface);
+EXPORT(XKY_WINDOW_Present);
+EXPORT(XKY_WINDOW_GetStatistics);
+EXPORT(XKY_WINDOW_PrintTextOpaque);
+EXPORT(XKY_WINDOW_Scroll);
+EXPORT(XKY_WINDOW_DrawBitmap);
+EXPORT(XKY_WINDOW_Move);
+EXPORT(XKY_WINDOW_Resize);
+EXPORT(XKY_WINDOW_SetLayout);
+EXPORT(XKY_WINDOW_MapEvents);
 
 EXPORT(XKY_PCI_Alloc);
 EXPORT(XKY_PCI_Free);
@@ -723,14 +910,20 @@ EXPORT(XKY_LDR_FileSize);
 
 EXPORT(XKY_OS_Start);
 EXPORT(XKY_OS_Finish);
+EXPORT(XKY_OS_GetAccount);
+EXPORT(XKY_OS_SetLimits);
 
 EXPORT(XKY_EXCEPTION_SetHandler);
 EXPORT(XKY_EXCEPTION_UnsetHandler);
 EXPORT(XKY_INTERRUPT_SetHandler);
 EXPORT(XKY_INTERRUPT_UnsetHandler);
+EXPORT(XKY_INTERRUPT_GetStatistics);
 
 EXPORT(XKY_DEBUG_Message);
 EXPORT(XKY_DEBUG_Data);
+EXPORT(XKY_DEBUG_Environments);
+
+EXPORT(XKY_SVGA_Benchmark);
 
 //=================================MODULE=====================================//
 #pragma data_seg(".module")
@@ -0,0 +1,350 @@
+/******************************************************************************/
+/**
+* @file		Pager.cpp
+* @brief	XkyOS Demand paged images
+* Implementation of the lazy loader. Images built with a per-page relocation index get their pages
+* reserved but not read; the page fault handler reads and rebases each page the first time it is touched.
+*
+* @date		20/03/2008
+* @author	Pablo Bravo
+*/
+/******************************************************************************/
+#include "Pager.h"
+#include "RTL.h"
+#include "CPU.h"
+#include "DiskCache.h"
+
+#include "Debug.h"
+
+//==================================DATA======================================//
+#pragma data_seg(".data")
+//============================================================================//
+/**
+* @brief An image mapped in an address space whose pages are brought in on demand.
+*/
+struct PAGED_IMAGE
+{
+	/**
+	* @brief This makes the image able to be in a list.
+	*/
+	LIST_ENTRY listable;
+	/**
+	* @brief Address space and virtual base where the image is reserved.
+	*/
+	ADDRESS_SPACE	pdbr;
+	VIRTUAL			base;
+	/**
+	* @brief What has to be added to each relocation (zero if prelinked at base).
+	*/
+	dword			delta;
+	/**
+	* @brief Physical pages backing the image (owned by the address space once mapped).
+	*/
+	PHYSICAL		memory;
+	dword			number_of_pages;
+	/**
+	* @brief Where the file is on disk and its size in bytes.
+	*/
+	LBA				lba;
+	dword			size;
+	/**
+	* @brief Relocations and per-page index, kept resident within the image.
+	*/
+	IMG_RELOCATION*			relocs;
+	IMG_RELOCATION_PAGES*	pages;
+};
+
+/**
+* @brief The images being paged in.
+*/
+PRIVATE LIST_ENTRY pager_images;
+
+/**
+* @brief Scratch buffer to recover original values of relocations that cross a page.
+*/
+PRIVATE byte pager_sectors[2*SECTOR_SIZE];
+
+#define PAGE_FAULT_PRESENT		0x00000001	/**< Page fault error bit: the page was present (protection fault) */
+#define SECTORS_PER_PAGE		(PAGE_SIZE/SECTOR_SIZE)
+
+//==================================CODE======================================//
+#pragma code_seg(".code")
+//============================================================================//
+/**
+* @brief Initialize demand paging support.
+* @return True if successful.
+*/
+PUBLIC bool PAGER_Init()
+{
+	LIST_Init(&pager_images);
+	return true;
+}
+
+/**
+* @brief Reads a page of an image from disk into its physical backing.
+* @param _image [in] The paged image.
+* @param _page [in] Page index within the image.
+* @return True if the page was read.
+*/
+PRIVATE bool PAGER_ReadPage(IN PAGED_IMAGE* _image, IN dword _page)
+{
+	dword sectors = RTL_BytesToSectors(_image->size) - _page*SECTORS_PER_PAGE;
+	if(sectors > SECTORS_PER_PAGE)
+		sectors = SECTORS_PER_PAGE;
+
+	return DISK_CACHE_Read(_image->lba + _page*SECTORS_PER_PAGE, sectors, _image->memory + _page*PAGE_SIZE) == sectors;
+}
+
+/**
+* @brief Reads from disk the original value of a dword of the image.
+* @param _image [in] The paged image.
+* @param _offset [in] Offset of the dword within the file.
+* @return The value as stored in the file.
+*/
+PRIVATE dword PAGER_ReadOriginalDword(IN PAGED_IMAGE* _image, IN dword _offset)
+{
+	if(DISK_CACHE_Read(_image->lba + _offset/SECTOR_SIZE, 2, (VIRTUAL)pager_sectors) != 2)
+		return 0;
+
+	return *(dword*)(pager_sectors + (_offset%SECTOR_SIZE));
+}
+
+/**
+* @brief Applies the relocations falling on a freshly read page.
+* @param _image [in] The paged image.
+* @param _page [in] Page index within the image.
+*/
+PRIVATE void PAGER_RelocatePage(IN PAGED_IMAGE* _image, IN dword _page)
+{
+	if(!_image->delta || _page >= _image->pages->number_of_pages)
+		return;
+
+	dword page_start = _page*PAGE_SIZE;
+	dword page_end = page_start + PAGE_SIZE;
+
+	for(dword i = _image->pages->first_relocation[_page]; i < _image->relocs->number_of_relocations; i++)
+	{
+		dword offset = _image->relocs->relocations[i];
+		if(offset >= page_end)
+			break;
+
+		if(offset >= page_start && offset + sizeof(dword) <= page_end)
+		{
+			*(dword*)(_image->memory + offset) += _image->delta;
+		}
+		else
+		{
+			//Crosses the page limit, the other half may already be rebased so start from the file value
+			dword value = PAGER_ReadOriginalDword(_image, offset) + _image->delta;
+			for(dword j = 0; j < sizeof(dword); j++)
+			{
+				if(offset + j >= page_start && offset + j < page_end)
+					*(byte*)(_image->memory + offset + j) = (byte)(value >> (8*j));
+			}
+		}
+	}
+}
+
+/**
+* @brief Makes a page of an image visible in its address space.
+* @param _image [in] The paged image.
+* @param _page [in] Page index within the image.
+*/
+PRIVATE void PAGER_CommitPage(IN PAGED_IMAGE* _image, IN dword _page)
+{
+	PTE* pte = VIRTUAL_PTE_Address(_image->pdbr, _image->base + _page*PAGE_SIZE);
+	pte->present = 1;
+}
+
+/**
+* @brief Reserves an image in an address space. Only the header, imports and relocations are read,
+* the rest of the pages are brought in by PAGER_PageFaultHandler.
+* @param _module_name [in] The module name.
+* @param _pdbr [in] The address space.
+* @param _base [in] The virtual base of the image.
+* @param _mode [in] Indicates kernel or user memory mode.
+* @param _access [in] Access for the image pages.
+* @return The physical address of the image (header and imports are valid), or zero if the image
+* can't be demand paged (caller should use LDR_LoadImage).
+*/
+PUBLIC PHYSICAL PAGER_MapImage(IN string* _module_name, IN ADDRESS_SPACE _pdbr, IN VIRTUAL _base, IN ExecutionType _mode, IN AccessType _access)
+{
+	dword size = FILE_Size(_module_name);
+	if(!size)
+		return 0;
+
+	PAGED_IMAGE* image = (PAGED_IMAGE*)HEAP_Alloc(sizeof(PAGED_IMAGE));
+	if(!image)
+		return 0;
+
+	image->pdbr = _pdbr;
+	image->base = _base;
+	image->lba = FILE_Start(_module_name);
+	image->size = size;
+	image->number_of_pages = RTL_BytesToPages(size);
+	image->memory = MEM_AllocPages(image->number_of_pages, _mode);
+	if(!image->memory)
+	{
+		HEAP_Free((PHYSICAL&)image);
+		return 0;
+	}
+
+	//Check the header says the image carries a page index
+	IMG_MODULE_HEADER* module = (IMG_MODULE_HEADER*)image->memory;
+	if(	!PAGER_ReadPage(image, 0) ||
+		module->signature != IMAGE_SIGNATURE ||
+		module->file_header.mode > (dword)_mode ||
+		!module->relocs_section.size ||
+		!(module->relocs_section.flags & IMAGE_SECTION_PAGED) ||
+		LDR_IsCompressed(module))
+	{
+		MEM_ReleasePages(image->memory, image->number_of_pages);
+		HEAP_Free((PHYSICAL&)image);
+		return 0;
+	}
+
+	//Header and imports are at the start of the image, relocations at the end
+	dword first_lazy_page = RTL_BytesToPages(module->imports_section.offset + module->imports_section.size);
+	if(!first_lazy_page)
+		first_lazy_page = 1;
+	dword last_lazy_page = module->relocs_section.offset/PAGE_SIZE;
+
+	for(dword page = 1; page < image->number_of_pages; page++)
+	{
+		if(page < first_lazy_page || page >= last_lazy_page)
+		{
+			if(!PAGER_ReadPage(image, page))
+			{
+				MEM_ReleasePages(image->memory, image->number_of_pages);
+				HEAP_Free((PHYSICAL&)image);
+				return 0;
+			}
+		}
+	}
+
+	image->relocs = (IMG_RELOCATION*)(image->memory + module->relocs_section.offset);
+	image->pages = (IMG_RELOCATION_PAGES*)&image->relocs->relocations[image->relocs->number_of_relocations];
+	image->delta = _base - LDR_GetPrelinkedBase(module);
+
+	//Reserve all the pages, the address space owns them so releasing it frees read and unread pages alike
+	if(!ADDRESS_SPACE_Map(_pdbr, image->memory, _base, image->number_of_pages, _mode, _access, true))
+	{
+		MEM_ReleasePages(image->memory, image->number_of_pages);
+		HEAP_Free((PHYSICAL&)image);
+		return 0;
+	}
+
+	for(dword page = 0; page < image->number_of_pages; page++)
+	{
+		if(page < first_lazy_page || page >= last_lazy_page)
+		{
+			PAGER_RelocatePage(image, page);
+		}
+		else
+		{
+			VIRTUAL_PTE_Address(_pdbr, _base + page*PAGE_SIZE)->present = 0;
+		}
+	}
+
+	LIST_Init((LIST_ENTRY*)image);
+	LIST_InsertTail(&pager_images, (LIST_ENTRY*)image);
+
+	return image->memory;
+}
+
+/**
+* @brief Unmaps a demand paged image, releasing all its pages.
+* @param _pdbr [in] The address space.
+* @param _base [in] The virtual base of the image.
+*/
+PUBLIC void PAGER_UnmapImage(IN ADDRESS_SPACE _pdbr, IN VIRTUAL _base)
+{
+	for(LIST_ITERATOR iter = LIST_First(&pager_images); iter; iter = LIST_Next(&pager_images, iter))
+	{
+		PAGED_IMAGE* image = (PAGED_IMAGE*)iter;
+		if(image->pdbr == _pdbr && image->base == _base)
+		{
+			//ADDRESS_SPACE_Unmap only drops present pages
+			for(dword page = 0; page < image->number_of_pages; page++)
+			{
+				PAGER_CommitPage(image, page);
+			}
+			ADDRESS_SPACE_Unmap(_pdbr, _base, image->number_of_pages);
+
+			LIST_Remove(iter);
+			HEAP_Free((PHYSICAL&)iter);
+			return;
+		}
+	}
+}
+
+/**
+* @brief Forgets all the demand paged images of an address space that is being released.
+* @param _pdbr [in] The address space.
+*/
+PUBLIC void PAGER_Release(IN ADDRESS_SPACE _pdbr)
+{
+	LIST_ITERATOR iter = LIST_First(&pager_images);
+	while(iter)
+	{
+		LIST_ITERATOR next = LIST_Next(&pager_images, iter);
+		if(((PAGED_IMAGE*)iter)->pdbr == _pdbr)
+		{
+			LIST_Remove(iter);
+			HEAP_Free((PHYSICAL&)iter);
+		}
+		iter = next;
+	}
+}
+
+/**
+* @brief Page fault handler. Reads and rebases a reserved image page on first touch.
+* @param _frame [in] The interrupt frame.
+* @return False if the fault was served, true for further processing.
+*/
+PUBLIC bool INTERRUPT PAGER_PageFaultHandler(IN INTERRUPT_FRAME* _frame)
+{
+	//Protection faults are not ours
+	if(_frame->error & PAGE_FAULT_PRESENT)
+		return true;
+
+	ADDRESS_SPACE pdbr = CPU_ReadCR3();
+	VIRTUAL address = CPU_ReadCR2();
+
+	for(LIST_ITERATOR iter = LIST_First(&pager_images); iter; iter = LIST_Next(&pager_images, iter))
+	{
+		PAGED_IMAGE* image = (PAGED_IMAGE*)iter;
+		if(image->pdbr == pdbr && address >= image->base && address < image->base + image->number_of_pages*PAGE_SIZE)
+		{
+			//Page tables and image pages are only reachable from kernel space
+			ADDRESS_SPACE_ResetToKernelSpace();
+
+			dword page = (address - image->base)/PAGE_SIZE;
+			PTE* pte = VIRTUAL_PTE_Address(pdbr, address);
+
+			//Someone else mapped over the reservation
+			if((pte->address<<12) != image->memory + page*PAGE_SIZE)
+			{
+				ADDRESS_SPACE_SwitchTo(pdbr);
+				return true;
+			}
+
+			if(!pte->present)
+			{
+				if(!PAGER_ReadPage(image, page))
+				{
+					ADDRESS_SPACE_SwitchTo(pdbr);
+					DEBUG_DATA("PAGER_ReadPage failed = ", address, 0x00FF0000)
+					return true;
+				}
+				PAGER_RelocatePage(image, page);
+				PAGER_CommitPage(image, page);
+			}
+
+			//Retry the faulting instruction
+			ADDRESS_SPACE_SwitchTo(pdbr);
+			return false;
+		}
+	}
+	return true;
+}
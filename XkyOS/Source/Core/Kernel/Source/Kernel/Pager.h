@@ -0,0 +1,26 @@
+/******************************************************************************/
+/**
+* @file		Pager.h
+* @brief	XkyOS Demand paged images
+* Definitions of the lazy loader that brings image pages in on first touch.
+*
+* @date		20/03/2008
+* @author	Pablo Bravo
+*/
+/******************************************************************************/
+#ifndef __PAGER_H__
+#define __PAGER_H__
+
+	#include "Types.h"
+	#include "Interrupts.h"
+	#include "AddressSpace.h"
+
+	bool PAGER_Init();
+
+	PHYSICAL	PAGER_MapImage		(IN string* _module_name, IN ADDRESS_SPACE _pdbr, IN VIRTUAL _base, IN ExecutionType _mode, IN AccessType _access);
+	void		PAGER_UnmapImage	(IN ADDRESS_SPACE _pdbr, IN VIRTUAL _base);
+	void		PAGER_Release		(IN ADDRESS_SPACE _pdbr);
+
+	bool INTERRUPT PAGER_PageFaultHandler(IN INTERRUPT_FRAME* _frame);
+
+#endif //__PAGER_H__
@@ -12,6 +12,7 @@
 #include "Interrupts.h"
 #include "CPU.h"
 #include "AddressSpace.h"
+#include "Handles.h"
 
 #include "Debug.h"
 //==================================DATA======================================//
@@ -35,42 +36,222 @@ PRIVATE dword processor_current_slice = 0;
 struct PROCESSOR_SLICE
 {
 	bool				used;
+	dword				generation;	/*< Bumped when the slot is freed, so old xids stop matching*/
 	EXECUTION*			execution;
 	fProcessorCallback	callback;
 	ENVIRONMENT*		environment;
+	dword				group;		/*< Index of the environment's group*/
+	dword				vruntime;	/*< Ticks run, against the other slices of the group*/
+	bool				blocked;	/*< The execution waits for something, others run first*/
 };
 /**
 * @brief CPU resource slices.
 */
 PRIVATE PROCESSOR_SLICE processor[MAX_EXECUTIONS];
 
+/**
+* @brief The slices of an environment, scheduled as a whole. The group with the least virtual runtime
+* runs next, and the CPU it gets is shared among its slices, so the number of xids of an environment
+* does not change its share.
+*/
+struct PROCESSOR_GROUP
+{
+	ENVIRONMENT*	environment;
+	dword			executions;	/*< Slices in the group, zero if the group is free*/
+	dword			runnable;	/*< Slices in the group not blocked*/
+	dword			weight;		/*< Share of the CPU, PROCESSOR_DEFAULT_WEIGHT by default*/
+	dword			vruntime;	/*< Ticks run, scaled by the inverse of the weight*/
+};
+/**
+* @brief Groups, at most one per slice.
+*/
+PRIVATE PROCESSOR_GROUP processor_groups[MAX_EXECUTIONS];
+/**
+* @brief Virtual runtime of the last group scheduled, new groups start from it.
+*/
+PRIVATE dword processor_min_vruntime = 0;
+/**
+* @brief Slices not blocked, in all groups.
+*/
+PRIVATE dword processor_runnable = 0;
+
+/**
+* @brief Virtual runtime a tick adds to a group of default weight.
+*/
+#define PROCESSOR_TICK_VRUNTIME	1024
+
 //==================================CODE======================================//
 #pragma code_seg(".code")
 //============================================================================//
-#define TO_INDEX(X)	((X)-1)
-#define TO_HANDLE(X)((X)+1)
+#define TO_INDEX(X)	HANDLE_INDEX(X)
+#define TO_HANDLE(X)HANDLE_MAKE(X, processor[X].generation)
+
+/**
+* @brief Tells if a xid is in use and not stale.
+* @param _xid [in] The xid.
+* @return True if the xid names a used slot.
+*/
+PRIVATE bool PROCESSOR_IsXID(IN XID _xid)
+{
+	dword index = TO_INDEX(_xid);
+	return index < MAX_EXECUTIONS && processor[index].used && TO_HANDLE(index) == _xid;
+}
 
 /**
-* @brief This method finds the next runnable element.
+* @brief Compares virtual runtimes, which are allowed to wrap.
+* @param _a [in] A virtual runtime.
+* @param _b [in] Another virtual runtime.
+* @return True if _a is behind _b.
+*/
+PRIVATE bool PROCESSOR_IsBehind(IN dword _a, IN dword _b)
+{
+	return (int)(_a - _b) < 0;
+}
+
+/**
+* @brief Finds the group of an environment, or takes a free one for it.
+* @param _environment [in] The environment.
+* @return Index of the group.
+*/
+PRIVATE dword PROCESSOR_GetGroup(IN ENVIRONMENT* _environment)
+{
+	dword free = MAX_EXECUTIONS;
+	for(dword i = 0; i < MAX_EXECUTIONS; i++)
+	{
+		if(processor_groups[i].executions && processor_groups[i].environment == _environment)
+			return i;
+		if(!processor_groups[i].executions && free == MAX_EXECUTIONS)
+			free = i;
+	}
+
+	//There is a slice free for the caller, so there is a group free. It joins the others where they are,
+	//not where it left, so it neither starves them nor gets starved
+	processor_groups[free].environment = _environment;
+	processor_groups[free].weight = PROCESSOR_DEFAULT_WEIGHT;
+	processor_groups[free].vruntime = processor_min_vruntime;
+	return free;
+}
+
+/**
+* @brief Finds the virtual runtime of the least behind runnable slice of a group.
+* @param _group [in] The group.
+* @param _vruntime [in] What to return if the group has no other runnable slice.
+* @param _except [in] Slice not to count.
+* @return The virtual runtime.
+*/
+PRIVATE dword PROCESSOR_GroupVruntime(IN dword _group, IN dword _vruntime, IN dword _except)
+{
+	bool first = true;
+	for(dword i = 0; i < MAX_EXECUTIONS; i++)
+	{
+		if(i != _except && processor[i].used && !processor[i].blocked && processor[i].group == _group && (first || PROCESSOR_IsBehind(processor[i].vruntime, _vruntime)))
+		{
+			_vruntime = processor[i].vruntime;
+			first = false;
+		}
+	}
+	return _vruntime;
+}
+
+/**
+* @brief Puts a slice just allocated in the group of its environment.
+* @param _index [in] The slice.
+*/
+PRIVATE void PROCESSOR_JoinGroup(IN dword _index)
+{
+	dword group = PROCESSOR_GetGroup(processor[_index].environment);
+
+	//Start with the least behind of the group, same reason as for the groups
+	processor[_index].group = group;
+	processor[_index].vruntime = PROCESSOR_GroupVruntime(group, 0, _index);
+	processor_groups[group].executions++;
+	if(!processor[_index].blocked)
+	{
+		if(!processor_groups[group].runnable && PROCESSOR_IsBehind(processor_groups[group].vruntime, processor_min_vruntime))
+			processor_groups[group].vruntime = processor_min_vruntime;
+		processor_groups[group].runnable++;
+		processor_runnable++;
+	}
+}
+
+/**
+* @brief Blocks or unblocks a slice.
+* @param _index [in] The slice.
+* @param _blocked [in] True to block it.
+*/
+PRIVATE void PROCESSOR_SetBlocked(IN dword _index, IN bool _blocked)
+{
+	if(processor[_index].blocked == _blocked)
+		return;
+
+	PROCESSOR_GROUP* group = &processor_groups[processor[_index].group];
+	processor[_index].blocked = _blocked;
+	if(_blocked)
+	{
+		group->runnable--;
+		processor_runnable--;
+		return;
+	}
+
+	//Time spent waiting is not a credit, like a slice just allocated it goes on from where the others are
+	if(!group->runnable && PROCESSOR_IsBehind(group->vruntime, processor_min_vruntime))
+		group->vruntime = processor_min_vruntime;
+	dword vruntime = PROCESSOR_GroupVruntime(processor[_index].group, processor[_index].vruntime, _index);
+	if(PROCESSOR_IsBehind(processor[_index].vruntime, vruntime))
+		processor[_index].vruntime = vruntime;
+
+	group->runnable++;
+	processor_runnable++;
+}
+
+/**
+* @brief Charges a tick to the slice that has just run and to its group.
+*/
+PRIVATE void PROCESSOR_Charge()
+{
+	if(!processor[processor_current_slice].used)
+		return;
+
+	PROCESSOR_GROUP* group = &processor_groups[processor[processor_current_slice].group];
+	group->vruntime += (PROCESSOR_TICK_VRUNTIME*PROCESSOR_DEFAULT_WEIGHT)/group->weight;
+	processor[processor_current_slice].vruntime++;
+}
+
+/**
+* @brief This method finds the next runnable element. First the group most behind, then the slice of
+* that group most behind. Ties go to the next one after the current, so equals take turns. Blocked
+* slices are skipped while some slice is runnable; if none is, one of them runs to wait on.
 * @return Index in the CPU of the next runnable element.
 */
 PRIVATE dword PROCESSOR_FindExecutionForSchedule()
 {
-	//Search the cpu slots vector from the next to the current element until the end...
-	for(dword i = processor_current_slice + 1; i < MAX_EXECUTIONS; i++)
+	dword current_group = processor[processor_current_slice].group;
+
+	dword group = MAX_EXECUTIONS;
+	for(dword n = 1; n <= MAX_EXECUTIONS; n++)
 	{
-		if(processor[i].used)
-			return i;
+		dword i = (current_group + n) % MAX_EXECUTIONS;
+		if(processor_groups[i].executions && (processor_groups[i].runnable || !processor_runnable) &&
+			(group == MAX_EXECUTIONS || PROCESSOR_IsBehind(processor_groups[i].vruntime, processor_groups[group].vruntime)))
+			group = i;
 	}
-	//And then from the begining until the element before the current one...
-	for(dword i = 0; i < processor_current_slice; i++)
+
+	//No slices at all
+	if(group == MAX_EXECUTIONS)
+		return processor_current_slice;
+
+	processor_min_vruntime = processor_groups[group].vruntime;
+
+	dword slice = MAX_EXECUTIONS;
+	for(dword n = 1; n <= MAX_EXECUTIONS; n++)
 	{
-		if(processor[i].used)
-			return i;
+		dword i = (processor_current_slice + n) % MAX_EXECUTIONS;
+		if(processor[i].used && processor[i].group == group && (!processor[i].blocked || !processor_runnable) &&
+			(slice == MAX_EXECUTIONS || PROCESSOR_IsBehind(processor[i].vruntime, processor[slice].vruntime)))
+			slice = i;
 	}
 
-	//Ok, current element is to be returned
-	return processor_current_slice;
+	return slice;
 }
 
 /**
@@ -144,26 +325,36 @@ PRIVATE void PROCESSOR_RestoreState(IN EXECUTION* _execution, OUT INTERRUPT_FRAM
 }
 
 /**
-* @brief Processor interrupt service.
-* @param _frame [in] Interrupt frame.
+* @brief Runs the callback of the execution just scheduled, deferred by the processor interrupt so
+* guest code does not run with interrupts disabled.
+* @param _frame [in] Interrupt frame, returning to the execution.
+* @param _slice [in] The slice scheduled.
 */
-PRIVATE bool INTERRUPT ProcessorInterrupt(IN INTERRUPT_FRAME* _frame)
+PRIVATE void INTERRUPT PROCESSOR_RunCallback(IN INTERRUPT_FRAME* _frame, IN dword _slice)
 {
-	//if there are no tasks, do nothing...
-	if(!processor_slices_used)
-		return true;
+	//Still the one going to run
+	if(_slice != processor_current_slice || !processor[_slice].used || !processor[_slice].callback)
+		return;
 
-	//Gain state for first execution
-	if(processor_first_time)
+	if(processor[_slice].callback(TO_HANDLE(_slice), processor[_slice].execution, processor[_slice].environment))
 	{
-		processor_first_time = 0;
-		PROCESSOR_RestoreState(processor[processor_current_slice].execution, _frame);
+		//Change state
+		PROCESSOR_RestoreState(processor[_slice].execution, _frame);
+	}
+}
+
+/**
+* @brief Leaves the current slice for the one that has to run next.
+* @param _frame [in] Interrupt frame of the current slice, left with the state of the next.
+*/
+PRIVATE void PROCESSOR_Switch(IN INTERRUPT_FRAME* _frame)
+{
+	//Save state, unless the slice was freed while running
+	if(processor[processor_current_slice].used)
+	{
+		PROCESSOR_SaveState(processor[processor_current_slice].execution, _frame);
 	}
 
-	//Save state
-	PROCESSOR_SaveState(processor[processor_current_slice].execution, _frame);
-	
-	//Search for the next task
 	dword new_slice = PROCESSOR_FindExecutionForSchedule();
 	if(new_slice != processor_current_slice)
 	{
@@ -174,17 +365,38 @@ PRIVATE bool INTERRUPT ProcessorInterrupt(IN INTERRUPT_FRAME* _frame)
 		PROCESSOR_RestoreState(processor[processor_current_slice].execution, _frame);
 	}
 
-	//Call callback if there is any
+	//Call callback if there is any, once interrupts are enabled again
 	if(processor[processor_current_slice].callback)
 	{
-		if(processor[processor_current_slice].callback(processor_current_slice, processor[processor_current_slice].execution, processor[processor_current_slice].environment))
-		{
-			//Change state
-			PROCESSOR_RestoreState(processor[processor_current_slice].execution, _frame);
-		}
+		INT_QueueWork(PROCESSOR_RunCallback, processor_current_slice);
+	}
+}
 
+/**
+* @brief Processor interrupt service.
+* @param _frame [in] Interrupt frame.
+*/
+PRIVATE bool INTERRUPT ProcessorInterrupt(IN INTERRUPT_FRAME* _frame)
+{
+	//if there are no tasks, do nothing...
+	if(!processor_slices_used)
+		return true;
+
+	//Deferred work was interrupted, not a task. Leave the switch for next tick
+	if(INT_IsDeferring())
+		return true;
+
+	//Gain state for first execution
+	if(processor_first_time)
+	{
+		processor_first_time = 0;
+		PROCESSOR_RestoreState(processor[processor_current_slice].execution, _frame);
 	}
 
+	//Account the tick, then search for the next task
+	PROCESSOR_Charge();
+	PROCESSOR_Switch(_frame);
+
 	//Allow to continue the chain
 	return true;
 }
@@ -200,9 +412,19 @@ PUBLIC bool PROCESSOR_Init()
 	for(dword i = 0; i < MAX_EXECUTIONS; i++)
 	{
 		processor[i].used = false;
+		processor[i].generation = 0;
 		processor[i].execution = 0;
 		processor[i].callback = 0;
 		processor[i].environment = 0;
+		processor[i].group = 0;
+		processor[i].vruntime = 0;
+		processor[i].blocked = false;
+
+		processor_groups[i].environment = 0;
+		processor_groups[i].executions = 0;
+		processor_groups[i].runnable = 0;
+		processor_groups[i].weight = PROCESSOR_DEFAULT_WEIGHT;
+		processor_groups[i].vruntime = 0;
 	}
 
 	DEBUG_DATA("ProcessorInterrupt = ", (dword)ProcessorInterrupt, 0x0000FF00)
@@ -219,42 +441,32 @@ PUBLIC bool PROCESSOR_Init()
 */
 PUBLIC XID PROCESSOR_CreateNewExecution(IN XID _desired_xid, IN EXECUTION* _execution, IN ENVIRONMENT* _environment)
 {
+	//Only the slot of a desired xid counts, the generation is the slot's
+	dword index = TO_INDEX(_desired_xid);
 	if(_desired_xid == XID_ANY)
 	{
 		//Search in the vector of executions
-		for(dword i = 0; i < MAX_EXECUTIONS; i++)
-		{
-			//If it is empty...
-			if(!processor[i].used)
-			{
-				_desired_xid = i;
-				break;
-			}
-		}
-		if(_desired_xid == XID_ANY)
-		{
-			//No empty room found
-			return 0;
-		}
-		_desired_xid = TO_HANDLE(_desired_xid);
+		for(index = 0; index < MAX_EXECUTIONS && processor[index].used; index++);
 	}
 
 	//If it is empty...
-	if(!processor[TO_INDEX(_desired_xid)].used)
+	if(index < MAX_EXECUTIONS && !processor[index].used)
 	{
 		//Allocate
-		processor[TO_INDEX(_desired_xid)].used = true;
+		processor[index].used = true;
 
 		//Assign the slice
-		processor[TO_INDEX(_desired_xid)].execution = _execution;
-		processor[TO_INDEX(_desired_xid)].environment = _environment;
-		processor[TO_INDEX(_desired_xid)].callback = 0;
+		processor[index].execution = _execution;
+		processor[index].environment = _environment;
+		processor[index].callback = 0;
+		processor[index].blocked = false;
+		PROCESSOR_JoinGroup(index);
 
 		//Increase the number of executions
 		processor_slices_used++;
 
 		//Return XID
-		return _desired_xid;
+		return TO_HANDLE(index);
 	}
 
 	//Couldn't succeed
@@ -269,41 +481,33 @@ PUBLIC XID PROCESSOR_CreateNewExecution(IN XID _desired_xid, IN EXECUTION* _exec
 */
 PUBLIC XID PROCESSOR_AssignNewExecution(IN XID _desired_xid, IN XID _xid)
 {
+	if(!PROCESSOR_IsXID(_xid))
+		return 0;
+
+	dword index = TO_INDEX(_desired_xid);
 	if(_desired_xid == XID_ANY)
 	{
 		//Search the executions' vector
-		for(dword i = 0; i < MAX_EXECUTIONS; i++)
-		{
-			//If it's empty...
-			if(!processor[i].used)
-			{
-				_desired_xid = i;
-				break;
-			}
-		}
-		if(_desired_xid == XID_ANY)
-		{
-			//No empty room found
-			return 0;
-		}
-		_desired_xid = TO_HANDLE(_desired_xid);
+		for(index = 0; index < MAX_EXECUTIONS && processor[index].used; index++);
 	}
 	//If it's empty...
-	if(!processor[TO_INDEX(_desired_xid)].used)
+	if(index < MAX_EXECUTIONS && !processor[index].used)
 	{
 		//Allocate
-		processor[TO_INDEX(_desired_xid)].used = true;
+		processor[index].used = true;
 
 		//Copy
-		processor[TO_INDEX(_desired_xid)].execution = processor[TO_INDEX(_xid)].execution;
-		processor[TO_INDEX(_desired_xid)].environment = processor[TO_INDEX(_xid)].environment;
-		processor[TO_INDEX(_desired_xid)].callback = processor[TO_INDEX(_xid)].callback;
+		processor[index].execution = processor[TO_INDEX(_xid)].execution;
+		processor[index].environment = processor[TO_INDEX(_xid)].environment;
+		processor[index].callback = processor[TO_INDEX(_xid)].callback;
+		processor[index].blocked = processor[TO_INDEX(_xid)].blocked;
+		PROCESSOR_JoinGroup(index);
 
 		//Increase the number of executions
 		processor_slices_used++;
 
 		//Return the XID
-		return _desired_xid;
+		return TO_HANDLE(index);
 	}
 	return 0;
 }
@@ -314,10 +518,15 @@ PUBLIC XID PROCESSOR_AssignNewExecution(IN XID _desired_xid, IN XID _xid)
 */
 PUBLIC void PROCESSOR_DeleteExecution(IN XID _xid)
 {
-	if(TO_INDEX(_xid) < MAX_EXECUTIONS && processor[TO_INDEX(_xid)].used)
+	if(PROCESSOR_IsXID(_xid))
 	{
 		//Free the slot
 		processor[TO_INDEX(_xid)].used = false;
+		processor[TO_INDEX(_xid)].generation++;
+		processor_groups[processor[TO_INDEX(_xid)].group].executions--;
+		//No longer counted as runnable
+		PROCESSOR_SetBlocked(TO_INDEX(_xid), true);
+		processor[TO_INDEX(_xid)].blocked = false;
 		
 		//Decrease the number of executions
 		processor_slices_used--;
@@ -359,8 +568,63 @@ PUBLIC XID PROCESSOR_GetCurrentXID()
 */
 PUBLIC void PROCESSOR_RegisterCallback(IN XID _xid, IN fProcessorCallback _callback)
 {
-	if((TO_INDEX(_xid) < MAX_EXECUTIONS) && processor[TO_INDEX(_xid)].used)
+	if(PROCESSOR_IsXID(_xid))
 	{
 		processor[TO_INDEX(_xid)].callback = _callback;
 	}
 }
+
+/**
+* @brief Sets the share of the CPU of an environment. Its slices get CPU in proportion to the weight,
+* whatever their number.
+* @param _environment [in] The environment, which must hold a xid.
+* @param _weight [in] The weight, PROCESSOR_DEFAULT_WEIGHT is the share of any other environment.
+*/
+PUBLIC void PROCESSOR_SetWeight(IN ENVIRONMENT* _environment, IN dword _weight)
+{
+	if(!_weight)
+		_weight = 1;
+
+	for(dword i = 0; i < MAX_EXECUTIONS; i++)
+	{
+		if(processor_groups[i].executions && processor_groups[i].environment == _environment)
+		{
+			processor_groups[i].weight = _weight;
+			return;
+		}
+	}
+}
+
+/**
+* @brief Blocks an execution, so the scheduler runs others while it waits, or unblocks it. All the
+* slices of the execution are affected.
+* @param _xid [in] A xid of the execution.
+* @param _blocked [in] True to block it, false to let it run again.
+*/
+PUBLIC void PROCESSOR_Block(IN XID _xid, IN bool _blocked)
+{
+	if(!PROCESSOR_IsXID(_xid))
+		return;
+
+	EXECUTION* execution = processor[TO_INDEX(_xid)].execution;
+	for(dword i = 0; i < MAX_EXECUTIONS; i++)
+	{
+		if(processor[i].used && processor[i].execution == execution)
+		{
+			PROCESSOR_SetBlocked(i, _blocked);
+		}
+	}
+}
+
+/**
+* @brief Gives the rest of the tick to another slice, for a system call whose caller has just blocked.
+* Only from an interrupt taken in user mode.
+* @param _frame [in] Interrupt frame of the caller, left with the state of the slice to run.
+*/
+PUBLIC void PROCESSOR_Yield(IN INTERRUPT_FRAME* _frame)
+{
+	if(!processor_slices_used || processor_first_time || !INT_InterruptFromUserMode(_frame))
+		return;
+
+	PROCESSOR_Switch(_frame);
+}
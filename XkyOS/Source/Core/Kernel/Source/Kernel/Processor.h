@@ -13,12 +13,14 @@
 
 	#include "Types.h"
 	#include "CPU.h"
+	#include "Interrupts.h"
 
 	/**
 	* @brief CPU slots resource type.
 	*/
 	typedef dword XID;
 	#define XID_ANY 0xFFFFFFFF /**< In case we dont want an specific XID (_desired_xid)*/
+	#define PROCESSOR_DEFAULT_WEIGHT 1024 /**< CPU weight of an environment unless lowered*/
 	
 	struct ENVIRONMENT; /**< Forwarded definition*/
 	
@@ -38,6 +40,9 @@
 	void	PROCESSOR_DeleteExecution		(IN XID _xid);
 	XID		PROCESSOR_GetCurrentXID			();
 	void	PROCESSOR_RegisterCallback		(IN XID _xid, IN fProcessorCallback _callback);
+	void	PROCESSOR_SetWeight				(IN ENVIRONMENT* _environment, IN dword _weight);
+	void	PROCESSOR_Block					(IN XID _xid, IN bool _blocked);
+	void	PROCESSOR_Yield					(IN INTERRUPT_FRAME* _frame);
 
 
 #endif //__PROCESSOR_H__
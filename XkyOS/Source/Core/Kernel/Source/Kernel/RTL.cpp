@@ -9,8 +9,10 @@
 */
 /******************************************************************************/
 #include "RTL.h"
+#include "CPU.h"
 #include "XFS.h"
 #include "HardDisk.h"
+#include "DiskCache.h"
 
 #include "Debug.h"
 
@@ -66,11 +68,19 @@ PRIVATE HEAP rtl_heap = {0, 0, 0};
 #define HEAP_SIZE_IN_PAGES	(HEAP_SIZE_IN_BYTES/PAGE_SIZE)
 #define HEAP_NODES_NUMBER	(HEAP_SIZE_IN_BYTES/sizeof(HEAP_NODE))
 
+/**
+* @brief CPU features, read once.
+*/
+PRIVATE dword rtl_cpu_features = 0;
+
 //==================================CODE======================================//
 #pragma code_seg(".code")
 //============================================================================//
+#include "XMEM.h"
+
 PRIVATE bool HEAP_Init();
 PRIVATE bool FILE_Init(IN DISK_LOADER_DATA* _loader_data);
+PRIVATE void RTL_InitMemory();
 
 /**
 * @brief Initialization of runtime kernel systems, heap and file system.
@@ -79,6 +89,9 @@ PRIVATE bool FILE_Init(IN DISK_LOADER_DATA* _loader_data);
 */
 PUBLIC bool RTL_Init(IN DISK_LOADER_DATA* _loader_data)
 {
+	//Best memory primitives the CPU can run
+	RTL_InitMemory();
+
 	//Inicialize heap support.
 	if(!HEAP_Init())
 		return false;
@@ -92,30 +105,156 @@ PUBLIC bool RTL_Init(IN DISK_LOADER_DATA* _loader_data)
 }
 
 /**
-* @brief Copies _size bytes from _origin to _destiny.
+* @brief One implementation of the memory primitives.
+*/
+struct RTL_MEMORY_IMPLEMENTATION
+{
+	dword		features;	/*< CPU_FEATURE_* needed*/
+	fXMEM_Copy	copy;		/*< Copy of large blocks*/
+	fXMEM_Fill	fill;		/*< Fill of large blocks*/
+};
+
+#define RTL_STRING_IMPLEMENTATION	{0,										XMEM_CopyString,	XMEM_FillString}
+#define RTL_SSE2_IMPLEMENTATION		{CPU_FEATURE_SSE | CPU_FEATURE_SSE2,	XMEM_CopySSE2,		XMEM_FillSSE2}
+
+/**
+* @brief Memory primitives implementations, indexed by RTL_STRING and RTL_SSE2.
+*/
+PRIVATE RTL_MEMORY_IMPLEMENTATION rtl_memory_implementations[MAX_RTL_IMPLEMENTATIONS] = {
+	RTL_STRING_IMPLEMENTATION,
+	RTL_SSE2_IMPLEMENTATION};
+
+/**
+* @brief The implementation large blocks use, the best one the CPU has.
+*/
+PRIVATE RTL_MEMORY_IMPLEMENTATION* rtl_memory = &rtl_memory_implementations[RTL_STRING];
+
+/**
+* @brief Tells if the CPU can run an implementation of the memory primitives.
+* @param _implementation [in] RTL_STRING or RTL_SSE2.
+* @return True if it can.
+*/
+PRIVATE bool RTL_IsSupported(IN dword _implementation)
+{
+	if(_implementation >= MAX_RTL_IMPLEMENTATIONS)
+		return false;
+
+	dword features = rtl_memory_implementations[_implementation].features;
+	return (rtl_cpu_features & features) == features;
+}
+
+/**
+* @brief Chooses the implementation of the memory primitives for large blocks.
+*/
+PRIVATE void RTL_InitMemory()
+{
+	rtl_cpu_features = CPU_GetFeatures();
+	for(dword i = 0; i < MAX_RTL_IMPLEMENTATIONS; i++)
+	{
+		if(RTL_IsSupported(i))
+			rtl_memory = &rtl_memory_implementations[i];
+	}
+}
+
+/**
+* @brief Copies _size bytes from _origin to _destiny, front to back, so blocks may overlap only if the
+* destiny is below the origin. Small blocks go byte by byte, the rest a dword at a time, and large ones
+* skip the cache if the CPU can.
 * @param _destiny [in] Destiny address.
 * @param _origin [in] Source addres.
 * @param _size [in] Bytes to copy.
 */
-PUBLIC NAKED void RTL_Copy(IN PHYSICAL _destiny, IN PHYSICAL _origin, IN dword _size)
+PUBLIC void RTL_Copy(OUT PHYSICAL _destiny, IN PHYSICAL _origin, IN dword _size)
 {
-	__asm
+	XMEM_Copy((byte*)_destiny, (const byte*)_origin, _size, rtl_memory->copy);
+}
+
+/**
+* @brief Sets _size bytes at _destiny to a value. Small blocks go byte by byte, the rest a dword at a
+* time, and large ones skip the cache if the CPU can.
+* @param _destiny [out] Destiny address.
+* @param _value [in] The byte.
+* @param _size [in] Bytes to fill.
+*/
+PUBLIC void RTL_Fill(OUT PHYSICAL _destiny, IN byte _value, IN dword _size)
+{
+	XMEM_Fill((byte*)_destiny, _value, _size, rtl_memory->fill);
+}
+
+/**
+* @brief Reads an extended XLZ length.
+* @param _in [in out] Compressed stream pointer.
+* @param _end [in] End of the compressed stream.
+* @param _length [in out] Length to extend.
+* @return False if the stream ends before the length does.
+*/
+PRIVATE bool RTL_DecompressLength(IN OUT byte*& _in, IN byte* _end, IN OUT dword& _length)
+{
+	byte value;
+	do
 	{
-		push ebp
-		mov ebp, esp
-		push ecx
-		push esi
-		push edi
-		mov ecx, dword ptr [ebp + 16] //_size
-		mov esi, dword ptr [ebp + 12] //_origin
-		mov edi, dword ptr [ebp + 8]  //_destiny
-		rep movsb
-		pop edi
-		pop esi
-		pop ecx
-		pop ebp
-		ret 12
+		if(_in >= _end)
+			return false;
+		value = *_in++;
+		_length += value;
 	}
+	while(value == 255);
+	return true;
+}
+
+/**
+* @brief Decompresses a XLZ stream (see Tools/INC/XLZ.h for the format).
+* @param _destiny [out] Where to leave the data.
+* @param _destiny_size [in] Size of the destiny buffer.
+* @param _origin [in] The compressed stream.
+* @param _origin_size [in] Size of the compressed stream.
+* @return Number of bytes decompressed, zero if the stream is corrupt.
+*/
+PUBLIC dword RTL_Decompress(OUT PHYSICAL _destiny, IN dword _destiny_size, IN PHYSICAL _origin, IN dword _origin_size)
+{
+	byte* in = (byte*)_origin;
+	byte* in_end = in + _origin_size;
+	byte* out = (byte*)_destiny;
+	byte* out_end = out + _destiny_size;
+
+	while(in < in_end)
+	{
+		byte token = *in++;
+
+		//Literals
+		dword literals = token>>4;
+		if(literals == 15 && !RTL_DecompressLength(in, in_end, literals))
+			return 0;
+		if(literals > (dword)(in_end - in) || literals > (dword)(out_end - out))
+			return 0;
+		RTL_Copy((PHYSICAL)out, (PHYSICAL)in, literals);
+		in += literals;
+		out += literals;
+
+		//Last sequence has no match
+		if(in >= in_end)
+			break;
+
+		//Match
+		if(in_end - in < 2)
+			return 0;
+		dword offset = in[0] | (in[1]<<8);
+		in += 2;
+
+		dword length = token & 0x0F;
+		if(length == 15 && !RTL_DecompressLength(in, in_end, length))
+			return 0;
+		length += 4;
+
+		if(!offset || offset > (dword)(out - (byte*)_destiny) || length > (dword)(out_end - out))
+			return 0;
+
+		//Byte by byte, matches may overlap
+		byte* match = out - offset;
+		while(length--)
+			*out++ = *match++;
+	}
+	return (dword)(out - (byte*)_destiny);
 }
 
 /**
@@ -209,8 +348,8 @@ PUBLIC bool STRING_Compare(IN string* _s1, IN string* _s2)
 PUBLIC bool STRING_Append(IN OUT string* _s1, IN string* _s2)
 {
 	//Assumming enough space in s1
-	for(byte i = 0; i < _s2->size; i++)
-		_s1->text[_s1->size++] = _s2->text[i];
+	RTL_Copy((PHYSICAL)&_s1->text[_s1->size], (PHYSICAL)_s2->text, _s2->size);
+	_s1->size = (byte)(_s1->size + _s2->size);
 
 	return true;
 }
@@ -224,8 +363,7 @@ PUBLIC bool STRING_Append(IN OUT string* _s1, IN string* _s2)
 PUBLIC bool STRING_Copy(OUT string* _s1, IN string* _s2)
 {
 	//Assumming enough space in s1
-	for(byte i = 0; i < _s2->size; i++)
-		_s1->text[i] = _s2->text[i];
+	RTL_Copy((PHYSICAL)_s1->text, (PHYSICAL)_s2->text, _s2->size);
 
 	_s1->size = _s2->size;
 	return true;
@@ -463,6 +601,21 @@ PUBLIC dword FILE_Size(IN string* _file_path)
 	return 0;
 }
 
+/**
+* @brief Gets the disk address where a given file starts.
+* @param _file_path [in] Path of the file we want to locate.
+* @return The LBA of the first sector of the file or zero if the file does not exist.
+*/
+PUBLIC dword FILE_Start(IN string* _file_path)
+{
+	XFS_ENTRY* file = FILE_Search(_file_path);
+	if(file)
+	{
+		return RTL_ByteOffsetToLBA(file->direction);
+	}
+	return 0;
+}
+
 /**
 * @brief Reads a file in a buffer.
 * @param _file_path [in] Path of the file we want to read.
@@ -479,11 +632,26 @@ PUBLIC bool FILE_Read(IN string* _file_path, OUT byte* _memory)
 		//Get number of sectors to read
 		dword sectors = RTL_BytesToSectors(file->size);
 
-		return HD_ReadSectors(0, lba, sectors, (VIRTUAL)_memory) == sectors;
+		return DISK_CACHE_Read(lba, sectors, (VIRTUAL)_memory) == sectors;
 	}
 	return false;
 }
 
+/**
+* @brief Finds a file that can be read where it is, because its disk is held in memory.
+* @param _file_path [in] Path of the file.
+* @return Kernel address of the file, to be read and never written, or zero if it has to be read with FILE_Read.
+*/
+PUBLIC PHYSICAL FILE_Map(IN string* _file_path)
+{
+	XFS_ENTRY* file = FILE_Search(_file_path);
+	if(file)
+	{
+		return HD_MapSectors(RTL_ByteOffsetToLBA(file->direction), RTL_BytesToSectors(file->size));
+	}
+	return 0;
+}
+
 /**
 * @brief Initializes the heap.
 * @return True if initilization was successful, false otherwise.
@@ -779,6 +947,58 @@ PUBLIC LIST_ITERATOR LIST_Next(IN LIST_ENTRY* _head, IN LIST_ITERATOR _iterator)
 }
 
 
+/**
+* @brief Tells if the sections of an image are stored compressed.
+* @param _module [in] The module image as read from the file.
+* @return True if it has compressed sections.
+*/
+PUBLIC bool LDR_IsCompressed(IN IMG_MODULE_HEADER* _module)
+{
+	return ((_module->imports_section.flags | _module->data_section.flags | _module->code_section.flags | _module->exports_section.flags | _module->relocs_section.flags) & IMAGE_SECTION_COMPRESSED) != 0;
+}
+
+/**
+* @brief Expands a compressed image into newly allocated pages.
+* @param _module [in] The module image as read from the file.
+* @param _mode [in] Indicates kernel or user memory mode.
+* @return The physical address of the expanded image, or zero if there was an error.
+*/
+PRIVATE PHYSICAL LDR_DecompressImage(IN IMG_MODULE_HEADER* _module, IN ExecutionType _mode)
+{
+	//The stream starts where the first compressed section does
+	IMG_SECTION_HEADER* sections = &_module->imports_section;
+	dword start = _module->file_header.size;
+	for(dword i = 0; i < 5; i++)
+	{
+		if((sections[i].flags & IMAGE_SECTION_COMPRESSED) && sections[i].offset < start)
+			start = sections[i].offset;
+	}
+
+	dword number_of_pages = RTL_BytesToPages(_module->file_header.size);
+	PHYSICAL image = MEM_AllocPages(number_of_pages, _mode);
+	if(!image)
+		return 0;
+
+	//Header as is, sections straight from the stream
+	RTL_Copy(image, (PHYSICAL)_module, start);
+	dword compressed_size = *(dword*)(((byte*)_module) + start);
+	dword expanded_size = _module->file_header.size - start;
+	if(RTL_Decompress(image + start, expanded_size, ((PHYSICAL)_module) + start + sizeof(dword), compressed_size) != expanded_size)
+	{
+		DEBUG("LDR_DecompressImage corrupt stream")
+		MEM_ReleasePages(image, number_of_pages);
+		return 0;
+	}
+
+	//From now on it's a plain image
+	IMG_SECTION_HEADER* image_sections = &((IMG_MODULE_HEADER*)image)->imports_section;
+	for(dword i = 0; i < 5; i++)
+	{
+		image_sections[i].flags &= ~IMAGE_SECTION_COMPRESSED;
+	}
+	return image;
+}
+
 /**
 * @brief Loads an image.
 * @param _module_name [in] The module name.
@@ -787,6 +1007,14 @@ PUBLIC LIST_ITERATOR LIST_Next(IN LIST_ENTRY* _head, IN LIST_ITERATOR _iterator)
 */
 PUBLIC PHYSICAL LDR_LoadImage(IN string* _module_name, IN ExecutionType _mode)
 {
+	//A compressed image on a disk held in memory is expanded from where it is, with no copy in between.
+	//Only compressed ones: a plain image is relocated and written in place, and the RAM disk pages sit
+	//in the first megabyte the page allocator doesn't own, so they can't be handed to the module. Plain
+	//images, and any image on a hard disk, still get private pages and a FILE_Read
+	IMG_MODULE_HEADER* mapped = (IMG_MODULE_HEADER*)FILE_Map(_module_name);
+	if(mapped && mapped->signature == IMAGE_SIGNATURE && mapped->file_header.mode <= (dword)_mode && LDR_IsCompressed(mapped))
+		return LDR_DecompressImage(mapped, _mode);
+
 	dword size = FILE_Size(_module_name);
 	if(size)
 	{
@@ -811,6 +1039,12 @@ PUBLIC PHYSICAL LDR_LoadImage(IN string* _module_name, IN ExecutionType _mode)
 					MEM_ReleasePages(memory, number_of_pages);
 					return 0;
 				}
+				if(LDR_IsCompressed(module))
+				{
+					PHYSICAL image = LDR_DecompressImage(module, _mode);
+					MEM_ReleasePages(memory, number_of_pages);
+					return image;
+				}
 
 				//Ok
 				return memory;
@@ -837,6 +1071,32 @@ PRIVATE IMG_RELOCATION* LDR_GetRelocs(IN IMG_MODULE_HEADER* _module)
 	return (IMG_RELOCATION*)(((byte*)_module) + _module->relocs_section.offset);
 }
 
+/**
+* @brief Get the prelink record of a given module image.
+* @param _module [in] The module image mapped in memory.
+* @return The prelink record within the module, zero if it has none.
+*/
+PRIVATE IMG_PRELINK* LDR_GetPrelink(IN IMG_MODULE_HEADER* _module)
+{
+	IMG_RELOCATION* relocs = LDR_GetRelocs(_module);
+	if(!relocs || !(_module->relocs_section.flags & IMAGE_SECTION_PAGED) || !(_module->relocs_section.flags & IMAGE_SECTION_PRELINK))
+		return 0;
+
+	IMG_RELOCATION_PAGES* pages = (IMG_RELOCATION_PAGES*)&relocs->relocations[relocs->number_of_relocations];
+	return (IMG_PRELINK*)&pages->first_relocation[pages->number_of_pages];
+}
+
+/**
+* @brief Get the base an image has been prelinked to.
+* @param _module [in] The module image mapped in memory.
+* @return The base its relocations are already applied for, zero if not prelinked.
+*/
+PUBLIC VIRTUAL LDR_GetPrelinkedBase(IN IMG_MODULE_HEADER* _module)
+{
+	IMG_PRELINK* prelink = LDR_GetPrelink(_module);
+	return prelink?prelink->base:0;
+}
+
 /**
 * @brief Reubicates an image to a new base.
 * @param _module [in] The module image to be rebased.
@@ -844,6 +1104,11 @@ PRIVATE IMG_RELOCATION* LDR_GetRelocs(IN IMG_MODULE_HEADER* _module)
 */
 PUBLIC void LDR_ReubicateImage(IN IMG_MODULE_HEADER* _module, IN VIRTUAL _base)
 {
+	//Prelinked images are already rebased, only the difference is applied
+	dword delta = (dword)_base - LDR_GetPrelinkedBase(_module);
+	if(!delta)
+		return;
+
 	//Get relocs
 	IMG_RELOCATION* relocs = LDR_GetRelocs(_module);
 	if(relocs)
@@ -852,7 +1117,7 @@ PUBLIC void LDR_ReubicateImage(IN IMG_MODULE_HEADER* _module, IN VIRTUAL _base)
 		{
 			dword offset = relocs->relocations[i];
 
-			*(dword*)(((byte*)_module) + offset) += (dword)_base;
+			*(dword*)(((byte*)_module) + offset) += delta;
 		}
 	}
 }
@@ -951,6 +1216,25 @@ PUBLIC bool LDR_ResolveImports(IN IMG_MODULE_HEADER* _module, IN IMG_MODULE_HEAD
 	return true;
 }
 
+/**
+* @brief Tells if the imports of a module were bound by PE2X to a given export module at a given base.
+* @param _module [in] The module with imports.
+* @param _export_module [in] The export module.
+* @param _export_base [in] The base where the export module is loaded.
+* @return True if imports are valid as they are, false if they must be resolved.
+*/
+PUBLIC bool LDR_IsBound(IN IMG_MODULE_HEADER* _module, IN IMG_MODULE_HEADER* _export_module, IN VIRTUAL _export_base)
+{
+	IMG_PRELINK* prelink = LDR_GetPrelink(_module);
+	IMG_PRELINK* export_prelink = LDR_GetPrelink(_export_module);
+	if(!prelink || !export_prelink || !prelink->imports_base)
+		return false;
+
+	return	prelink->imports_base == _export_base &&
+			export_prelink->base == _export_base &&
+			prelink->imports_checksum == export_prelink->checksum;
+}
+
 /**
 * @brief Obtains the address of a function exported by a module.
 * @param _module [in] The module we want to resolve its export.
@@ -18,6 +18,10 @@
 
 	bool	RTL_Init(IN DISK_LOADER_DATA* _loader_data);
 
+	#define RTL_STRING					0	/**< Memory primitives with rep movsd and rep stosd*/
+	#define RTL_SSE2					1	/**< Non temporal stores for large blocks*/
+	#define MAX_RTL_IMPLEMENTATIONS		2
+
 	//Conversion
 	dword	RTL_BytesToUnit				(IN dword _bytes, IN dword _unit_size);
 	dword	RTL_ByteOffsetToUnitOffset	(IN dword _offset, IN dword _unit_size);
@@ -26,7 +30,9 @@
 	dword	RTL_BytesToHeapNodes		(IN dword _bytes);
 	dword	RTL_ByteOffsetToLBA			(IN dword _offset);
 
-	void RTL_Copy(OUT PHYSICAL _destiny, IN PHYSICAL _origin, IN dword _size);
+	void	RTL_Copy		(OUT PHYSICAL _destiny, IN PHYSICAL _origin, IN dword _size);
+	void	RTL_Fill		(OUT PHYSICAL _destiny, IN byte _value, IN dword _size);
+	dword	RTL_Decompress	(OUT PHYSICAL _destiny, IN dword _destiny_size, IN PHYSICAL _origin, IN dword _origin_size);
 
 	//Strings
 	bool STRING_Compare	(IN string* _s1, IN string* _s2);
@@ -36,7 +42,9 @@
 	//Files
 	bool	FILE_Exists	(IN string* _file_path);
 	dword	FILE_Size	(IN string* _file_path);
+	dword	FILE_Start	(IN string* _file_path);
 	bool	FILE_Read	(IN string* _file_path, OUT byte* _memory);
+	PHYSICAL FILE_Map	(IN string* _file_path);
 
 	//Heap
 	PHYSICAL	HEAP_Alloc	(IN dword _size);
@@ -61,8 +69,11 @@
 
 	//Loader
 	PHYSICAL	LDR_LoadImage			(IN string* _module_name, IN ExecutionType _mode);
+	bool		LDR_IsCompressed		(IN IMG_MODULE_HEADER* _module);
 	void		LDR_ReubicateImage		(IN IMG_MODULE_HEADER* _module, IN VIRTUAL _base);
+	VIRTUAL		LDR_GetPrelinkedBase	(IN IMG_MODULE_HEADER* _module);
 	bool		LDR_ResolveImports		(IN IMG_MODULE_HEADER* _module, IN IMG_MODULE_HEADER* _api);
+	bool		LDR_IsBound				(IN IMG_MODULE_HEADER* _module, IN IMG_MODULE_HEADER* _export_module, IN VIRTUAL _export_base);
 	VIRTUAL		LDR_GetProcedureAddress	(IN IMG_MODULE_HEADER* _module, IN string* _function_name);
 	PHYSICAL	LDR_LoadFile			(IN string* _name, IN ExecutionType _mode);
 
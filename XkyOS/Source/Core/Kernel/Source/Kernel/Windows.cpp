@@ -3,7 +3,12 @@
 * @file		Windows.cpp
 * @brief	XkyOS Window manager
 * Implementation of window subsystem
-* 
+* Windows are drawn in their own back buffers. Changed areas of the screen are kept in a list of
+* dirty rectangles that gets composited to the framebuffer once per timer tick, with the mouse
+* pointer drawn on top.
+* Windows are kept in a table that grows as needed, tiled over the screen or overlapped, and a grid
+* of screen cells tells which windows can be under the pointer.
+*
 * @date		20/03/2008
 * @author	Pablo Bravo
 */
@@ -13,8 +18,11 @@
 #include "Interrupts.h"
 #include "Keyboard.h"
 #include "Mouse.h"
+#include "CPU.h"
 #include "RTL.h"
 #include "Environment.h"
+#include "Bitmap.h"
+#include "Handles.h"
 
 #include "Debug.h"
 
@@ -29,7 +37,6 @@ struct POINTER_IMPL
 {
 	COORDINATE position;
 	ARGB color;
-	ARGB background[8][8];
 	dword mask;
 };
 
@@ -78,49 +85,44 @@ PRIVATE byte* masks[MAX_MASKS] = {POINTER_ARROW_MASK, POINTER_CLOCK_MASK};
 */
 PRIVATE POINTER_IMPL mouse_pointer;
 
-
-/**
-* @brief Message from the mouse.
-*/
-struct MOUSE_MESSAGE
-{
-	COORDINATE cursor;
-	bool right;
-	bool left;
-};
-
-/**
-* @brief Message from the keyboard.
-*/
-typedef dword KEYBOARD_MESSAGE;
-
 /**
 * @brief Implementation of a window.
 */
 struct WINDOW_IMPL
 {
 	bool focus;
-	
+
 	RECTANGLE area;
-	
+
 	dword	pointer_mask;
 	ARGB	pointer_color;
-	
+
     ADDRESS_SPACE			keyboard_pdbr;
 	fWindowKeyboardCallback	keyboard_callback;
-	KEYBOARD_MESSAGE		keyboard_events[32];
-	dword					keyboard_index;
 
 	ADDRESS_SPACE			mouse_pdbr;
 	fWindowMouseCallback	mouse_callback;
-	MOUSE_MESSAGE			mouse_events[32];
-	dword					mouse_index;
+
+	WINDOW_EVENT_RING*		events;		/*< A pool page, visible from every address space*/
+	ADDRESS_SPACE			events_pdbr;
+	VIRTUAL					events_address;
+
+	SURFACE			buffer;
+	PHYSICAL		buffer_memory;
+	dword			buffer_pages;
+
+	ADDRESS_SPACE	surface_pdbr;
+	VIRTUAL			surface_address;
 };
 
 #define WINDOW_DEFAULT_COLOR	SRGB(0, 0, 0)	/**< Windows default color (black)*/
 #define WINDOW_WIDTH_MARGIN		0x00000010		/**< Windows default margin in X*/
 #define WINDOW_HEIGHT_MARGIN	0x0000000C		/**< Windows default margin in Y*/
-#define MAX_WINDOWS	4	/**< Maximum number of windows*/
+#define WINDOW_CASCADE			0x00000020		/**< Offset between overlapped windows*/
+#define WINDOW_INITIAL_WINDOWS	4	/**< Windows in the table before it has to grow*/
+#define WINDOW_POOL_SCREENS		2	/**< Screens of pixels reserved for window buffers*/
+#define WINDOW_GRID_SHIFT		5	/**< Hit test cells are 32x32 pixels*/
+#define WINDOW_MINIMUM_SIZE		0x00000010		/**< Smallest side of a window, frame included*/
 
 /**
 * @brief Represents a block in the 'heap' of executions.
@@ -128,12 +130,53 @@ struct WINDOW_IMPL
 struct HEAP_WINDOW_BLOCK
 {
 	bool used;
+	dword generation;	/*< Bumped when the window is freed, so old handles stop matching*/
 	WINDOW_IMPL window;
 };
 /**
-* @brief Windows repository
+* @brief Windows repository, in kernel pages. It doubles when full, handles are indexes (and the
+* generation of the slot) so they stay valid.
+*/
+PRIVATE HEAP_WINDOW_BLOCK* windows_heap = 0;
+PRIVATE dword windows_number = 0;
+PRIVATE dword windows_heap_pages = 0;
+
+/**
+* @brief Indexes of the used windows from the bottom one to the top one.
+*/
+PRIVATE dword* windows_order = 0;
+PRIVATE dword windows_order_number = 0;
+
+/**
+* @brief How windows are placed, WINDOW_LAYOUT_TILED or WINDOW_LAYOUT_OVERLAPPED.
+*/
+PRIVATE dword windows_layout = WINDOW_LAYOUT_TILED;
+
+/**
+* @brief Pages where window buffers are taken from. They are visible to the kernel from every address
+* space, as windows come and go after the address spaces are created.
+*/
+struct WINDOW_POOL
+{
+	PHYSICAL	memory;
+	dword		number_of_pages;
+	byte*		used;	/*< A byte per page, in kernel pages*/
+};
+PRIVATE WINDOW_POOL window_pool;
+
+/**
+* @brief Screen cells, each with the windows touching it from the top one down, so the window under
+* the pointer is found testing one or two windows.
 */
-PRIVATE HEAP_WINDOW_BLOCK windows_heap[MAX_WINDOWS];
+struct WINDOW_GRID
+{
+	dword	width;		/*< Cells per row*/
+	dword	height;		/*< Rows of cells*/
+	dword*	first;		/*< For each cell, its first entry in windows (one more for the end)*/
+	dword*	windows;	/*< Windows heap indexes*/
+	dword	pages;
+};
+PRIVATE WINDOW_GRID window_grid;
 
 /**
 * @brief Background image name.
@@ -145,113 +188,355 @@ PRIVATE string background_image_name = STRING("XkyOS.bmp");
 */
 PRIVATE SIZE screen_size;
 
+/**
+* @brief The desktop background, what is seen where there are no windows.
+*/
+PRIVATE SURFACE desktop;
+
+/**
+* @brief One screen row where the compositor builds the pixels before writing them.
+*/
+PRIVATE SURFACE compositor_row;
+
+#define MAX_DIRTY_RECTANGLES	16	/**< Maximum number of dirty rectangles before collapsing them*/
+
+/**
+* @brief Screen areas to composite on next tick.
+*/
+PRIVATE RECTANGLE dirty_rectangles[MAX_DIRTY_RECTANGLES];
+PRIVATE dword dirty_rectangles_number = 0;
+
+/**
+* @brief Compositor counters.
+*/
+PRIVATE WINDOW_STATISTICS window_statistics;
+
 //==================================CODE======================================//
 #pragma code_seg(".code")
 //============================================================================//
-#define TO_INDEX(X)	((X)-1)
-#define TO_HANDLE(X)((X)+1)
+#define TO_INDEX(X)	HANDLE_INDEX(X)
+#define TO_HANDLE(X)HANDLE_MAKE(X, windows_heap[X].generation)
+
+/**
+* @brief Tells if a handle names a used window and is not stale.
+* @param _window [in] Window resource.
+* @return True if the window can be used.
+*/
+PRIVATE bool WINDOW_IsWindow(IN WINDOW _window)
+{
+	dword index = TO_INDEX(_window);
+	return index < windows_number && windows_heap[index].used && TO_HANDLE(index) == _window;
+}
+
+/**
+* @brief Allocates memory for a surface, visible to the kernel from every address space.
+* @param _surface [out] The surface.
+* @param _width [in] Pixels per row.
+* @param _height [in] Number of rows.
+* @param _execution [in] Indicates kernel or user memory.
+* @return The physical address of the pixels, zero if no memory.
+*/
+PRIVATE PHYSICAL WINDOW_AllocSurface(OUT SURFACE* _surface, IN dword _width, IN dword _height, IN ExecutionType _execution)
+{
+	dword pages = RTL_BytesToPages(_width*_height*sizeof(ARGB));
+	PHYSICAL memory = MEM_AllocPages(pages, _execution);
+	if(!memory)
+		return 0;
+
+	if(_execution == UserMode && !ADDRESS_SPACE_AddKernelRange(memory, pages))
+	{
+		MEM_ReleasePages(memory, pages);
+		return 0;
+	}
+
+	SURFACE_Init(_surface, (ARGB*)memory, _width, _height);
+	return memory;
+}
+
+/**
+* @brief Marks an area of the screen to be composited on next tick.
+* @param _x_low [in] The low x coordinate.
+* @param _y_low [in] The low y coordinate.
+* @param _x_high [in] The high x coordinate.
+* @param _y_high [in] The high y coordinate.
+*/
+PRIVATE void WINDOW_Invalidate(IN dword _x_low, IN dword _y_low, IN dword _x_high, IN dword _y_high)
+{
+	//Clip to the screen
+	if(_x_high >= screen_size.width)
+		_x_high = screen_size.width - 1;
+	if(_y_high >= screen_size.height)
+		_y_high = screen_size.height - 1;
+	if(_x_low > _x_high || _y_low > _y_high)
+		return;
+
+	//Grow a rectangle that touches or overlaps the new one
+	for(dword i = 0; i < dirty_rectangles_number; i++)
+	{
+		RECTANGLE* r = &dirty_rectangles[i];
+		if(	_x_low <= r->up_right.x + 1 && r->down_left.x <= _x_high + 1 &&
+			_y_low <= r->up_right.y + 1 && r->down_left.y <= _y_high + 1)
+		{
+			if(_x_low < r->down_left.x)		r->down_left.x = _x_low;
+			if(_y_low < r->down_left.y)		r->down_left.y = _y_low;
+			if(_x_high > r->up_right.x)		r->up_right.x = _x_high;
+			if(_y_high > r->up_right.y)		r->up_right.y = _y_high;
+			return;
+		}
+	}
+
+	//No room, collapse all into one
+	if(dirty_rectangles_number == MAX_DIRTY_RECTANGLES)
+	{
+		for(dword i = 0; i < dirty_rectangles_number; i++)
+		{
+			RECTANGLE* r = &dirty_rectangles[i];
+			if(r->down_left.x < _x_low)		_x_low = r->down_left.x;
+			if(r->down_left.y < _y_low)		_y_low = r->down_left.y;
+			if(r->up_right.x > _x_high)		_x_high = r->up_right.x;
+			if(r->up_right.y > _y_high)		_y_high = r->up_right.y;
+		}
+		dirty_rectangles_number = 0;
+	}
+
+	RECTANGLE* r = &dirty_rectangles[dirty_rectangles_number++];
+	r->down_left.x = _x_low;
+	r->down_left.y = _y_low;
+	r->up_right.x = _x_high;
+	r->up_right.y = _y_high;
+}
+
+/**
+* @brief Marks the area covered by the mouse pointer to be composited.
+*/
+PRIVATE void POINTER_Invalidate()
+{
+	WINDOW_Invalidate(mouse_pointer.position.x, mouse_pointer.position.y - (POINTER_HEIGHT - 1), mouse_pointer.position.x + (POINTER_WIDTH - 1), mouse_pointer.position.y);
+}
+
+/**
+* @brief Marks the area of a window to be composited.
+* @param _index [in] The windows heap index.
+*/
+PRIVATE void WINDOW_InvalidateWindow(IN dword _index)
+{
+	RECTANGLE* area = &windows_heap[_index].window.area;
+	WINDOW_Invalidate(area->down_left.x, area->down_left.y, area->up_right.x, area->up_right.y);
+}
 
 /**
 * @brief Loads the image background.
+* @return False if there was no memory for the desktop.
 */
-PRIVATE void WINDOW_LoadBackground()
+PRIVATE bool WINDOW_LoadBackground()
 {
+	if(!WINDOW_AllocSurface(&desktop, screen_size.width, screen_size.height, UserMode))
+		return false;
+
+	WINDOW_Invalidate(0, 0, screen_size.width - 1, screen_size.height - 1);
+
+	qword start = CPU_ReadTimeStamp();
+	bool loaded = false;
+
 	dword size = FILE_Size(&background_image_name);
 	if(size)
 	{
-		dword pages = RTL_BytesToPages(size);
-		PHYSICAL memory = MEM_AllocPages(pages, UserMode);
-		if(memory)
+		//On a disk held in memory the image is drawn from where it is
+		dword pages = 0;
+		PHYSICAL memory = FILE_Map(&background_image_name);
+		if(!memory)
 		{
-			if(FILE_Read(&background_image_name, (byte*)memory))
+			pages = RTL_BytesToPages(size);
+			memory = MEM_AllocPages(pages, UserMode);
+			if(memory && !FILE_Read(&background_image_name, (byte*)memory))
 			{
-				//Copy BMP File to Background
-				//Jump over BMP header
-				byte* bmp = ((byte*)memory + 0x36);
-				for(dword i = 0; i < 768; i++)
-				{
-					for(dword j = 0; j < 1024; j++)
-					{
-						byte B = *bmp;
-						byte G = *(bmp+1);
-						byte R = *(bmp+2);
-						SVGA_SetPixel(j, i, SRGB(R,G,B));
-						bmp+=3;
-					}
-				}
-				//Release memory
 				MEM_ReleasePages(memory, pages);
-				//Ok
-				return;
+				memory = 0;
+			}
+		}
+		if(memory)
+		{
+			BITMAP bitmap;
+			if(BITMAP_Open(&bitmap, (byte*)memory, size))
+			{
+				//Smaller images leave the blue showing
+				if(bitmap.width < screen_size.width || bitmap.height < screen_size.height)
+					SURFACE_Fill(&desktop, 0, 0, screen_size.width, screen_size.height, SRGB(0,0,255));
+				BITMAP_Draw(&bitmap, &desktop, 0, 0);
+				loaded = true;
 			}
-			//Release memory
-			MEM_ReleasePages(memory, pages);
+			//Release memory, unless it is the disk's
+			if(pages)
+				MEM_ReleasePages(memory, pages);
 		}
 	}
-	
+
 	//No image
-	SVGA_ClearScreen(SRGB(0,0,255));
+	if(!loaded)
+		SURFACE_Fill(&desktop, 0, 0, screen_size.width, screen_size.height, SRGB(0,0,255));
+
+	window_statistics.background_cycles = CPU_ReadTimeStamp() - start;
+	return true;
 }
 
 /**
-* @brief Draws an horizontal line.
-* @param _x_low [in] The low x coordinate.
-* @param _x_high [in] The high x coordinate.
-* @param _y [in] The y coordinate.
-* @param _color [in] The color of the line.
+* @brief Reserves the pages for window buffers.
+* @return False if there was no memory.
 */
-PRIVATE void WINDOW_DrawLineHorizontal(IN dword _x_low, IN dword _x_high, IN dword _y, IN ARGB _color)
+PRIVATE bool WINDOW_PoolInit()
 {
-	for(dword i = _x_low; i <= _x_high; i++)
+	window_pool.number_of_pages = WINDOW_POOL_SCREENS*RTL_BytesToPages(screen_size.width*screen_size.height*sizeof(ARGB));
+	window_pool.memory = MEM_AllocPages(window_pool.number_of_pages, UserMode);
+	if(!window_pool.memory)
+		return false;
+
+	window_pool.used = (byte*)MEM_AllocPages(RTL_BytesToPages(window_pool.number_of_pages), KernelMode);
+	if(!window_pool.used || !ADDRESS_SPACE_AddKernelRange(window_pool.memory, window_pool.number_of_pages))
+		return false;
+
+	for(dword i = 0; i < window_pool.number_of_pages; i++)
 	{
-		SVGA_SetPixel(i, _y, _color);
+		window_pool.used[i] = false;
 	}
+	return true;
 }
 
 /**
-* @brief Draws a vertical line.
-* @param _y_low [in] The low y coordinate.
-* @param _y_high [in] The high y coordinate.
-* @param _x [in] The x coordinate.
-* @param _color [in] The color of the line.
+* @brief Takes consecutive pages from the window pool.
+* @param _number_of_pages [in] Number of pages.
+* @return The physical address of the first page, zero if there is no room.
+*/
+PRIVATE PHYSICAL WINDOW_PoolAlloc(IN dword _number_of_pages)
+{
+	dword run = 0;
+	for(dword i = 0; i < window_pool.number_of_pages; i++)
+	{
+		run = window_pool.used[i]?0:(run + 1);
+		if(run == _number_of_pages)
+		{
+			dword first = i + 1 - run;
+			for(dword j = first; j <= i; j++)
+			{
+				window_pool.used[j] = true;
+			}
+			return window_pool.memory + first*PAGE_SIZE;
+		}
+	}
+	return 0;
+}
+
+/**
+* @brief Gives back pages to the window pool.
+* @param _address [in] Physical address of the first page.
+* @param _number_of_pages [in] Number of pages.
 */
-PRIVATE void WINDOW_DrawLineVertical(IN dword _y_low, IN dword _y_high, IN dword _x, IN ARGB _color)
+PRIVATE void WINDOW_PoolRelease(IN PHYSICAL _address, IN dword _number_of_pages)
 {
-	for(dword i = _y_low; i <= _y_high; i++)
+	dword first = (_address - window_pool.memory)/PAGE_SIZE;
+	for(dword i = first; i < first + _number_of_pages; i++)
 	{
-		SVGA_SetPixel(_x, i, _color);
+		window_pool.used[i] = false;
 	}
 }
 
 /**
-* @brief Initializes a window.
+* @brief Doubles the windows repository.
+* @return False if there was no memory.
+*/
+PRIVATE bool WINDOW_GrowTable()
+{
+	dword number = windows_number?(2*windows_number):WINDOW_INITIAL_WINDOWS;
+	dword pages = RTL_BytesToPages(number*(sizeof(HEAP_WINDOW_BLOCK) + sizeof(dword)));
+
+	PHYSICAL memory = MEM_AllocPages(pages, KernelMode);
+	if(!memory)
+		return false;
+
+	HEAP_WINDOW_BLOCK* heap = (HEAP_WINDOW_BLOCK*)memory;
+	dword* order = (dword*)(heap + number);
+	if(windows_number)
+	{
+		RTL_Copy((PHYSICAL)heap, (PHYSICAL)windows_heap, windows_number*sizeof(HEAP_WINDOW_BLOCK));
+		RTL_Copy((PHYSICAL)order, (PHYSICAL)windows_order, windows_order_number*sizeof(dword));
+	}
+	for(dword i = windows_number; i < number; i++)
+	{
+		heap[i].used = false;
+		heap[i].generation = 0;
+	}
+
+	//The interrupt handlers look at the repository
+	dword state = INT_DisableInterrupts();
+	PHYSICAL old = (PHYSICAL)windows_heap;
+	dword old_pages = windows_heap_pages;
+	windows_heap = heap;
+	windows_order = order;
+	windows_number = number;
+	windows_heap_pages = pages;
+	INT_EnableInterrupts(state);
+
+	if(old)
+		MEM_ReleasePages(old, old_pages);
+	return true;
+}
+
+/**
+* @brief Initializes a window, still without area nor buffer.
 * @param _index [in] The windows heap index.
-* @param _x_low [in] The low x coordinate.
-* @param _x_high [in] The high x coordinate.
-* @param _y_low [in] The low y coordinate.
-* @param _y_high [in] The high y coordinate.
 */
-PRIVATE void WINDOW_Init(IN dword _index, IN dword _x_low, IN dword _x_high, IN dword _y_low, IN dword _y_high)
+PRIVATE void WINDOW_Init(IN dword _index)
 {
-	windows_heap[_index].used = false;
+	WINDOW_IMPL* w = &windows_heap[_index].window;
+
+	w->focus = false;
+
+	w->area.down_left.x = 0;
+	w->area.down_left.y = 0;
+	w->area.up_right.x = 0;
+	w->area.up_right.y = 0;
+
+	w->pointer_color = POINTER_DEFAULT_COLOR;
+	w->pointer_mask = POINTER_ARROW;
+
+	w->keyboard_pdbr = 0;
+	w->keyboard_callback = 0;
+
+	w->mouse_pdbr = 0;
+	w->mouse_callback = 0;
+
+	w->events = 0;
+	w->events_pdbr = 0;
+	w->events_address = 0;
 
-	windows_heap[_index].window.focus = false;
+	w->buffer_memory = 0;
+	w->buffer_pages = 0;
 
-	windows_heap[_index].window.area.down_left.x = _x_low + WINDOW_WIDTH_MARGIN;
-	windows_heap[_index].window.area.down_left.y = _y_low + WINDOW_HEIGHT_MARGIN;
-	windows_heap[_index].window.area.up_right.x = _x_high - WINDOW_WIDTH_MARGIN;
-	windows_heap[_index].window.area.up_right.y = _y_high - WINDOW_HEIGHT_MARGIN;
+	w->surface_pdbr = 0;
+	w->surface_address = 0;
+}
 
-	windows_heap[_index].window.pointer_color = POINTER_DEFAULT_COLOR;
-	windows_heap[_index].window.pointer_mask = POINTER_ARROW;
+/**
+* @brief Fills a rectangle of a window buffer with the desktop mixed with a color.
+* @param _index [in] The windows heap index.
+* @param _x [in] X relative coordinate of the low left corner.
+* @param _y [in] Y relative coordinate of the low left corner.
+* @param _width [in] Number of pixels per row.
+* @param _height [in] Number of rows.
+* @param _color [in] The color, made transparent.
+*/
+PRIVATE void WINDOW_FillBackground(IN dword _index, IN dword _x, IN dword _y, IN dword _width, IN dword _height, IN ARGB _color)
+{
+	SURFACE* buffer = &windows_heap[_index].window.buffer;
+	dword x_low = windows_heap[_index].window.area.down_left.x;
+	dword y_low = windows_heap[_index].window.area.down_left.y;
 
-	windows_heap[_index].window.keyboard_pdbr = 0;
-	windows_heap[_index].window.keyboard_callback = 0;
-	windows_heap[_index].window.keyboard_index = 0;
+	for(dword y = _y; y < _y + _height; y++)
+	{
+		SURFACE_ReadRow(&desktop, x_low + _x, y_low + y, buffer->origin + y*buffer->pitch + _x, _width);
+	}
 
-	windows_heap[_index].window.mouse_pdbr = 0;
-	windows_heap[_index].window.mouse_callback = 0;
-	windows_heap[_index].window.mouse_index = 0;
+	//Make color transparent... should be solid?
+	SURFACE_Fill(buffer, _x, _y, _width, _height, COLOR_MakeTransparent(_color));
 }
 
 /**
@@ -261,76 +546,308 @@ PRIVATE void WINDOW_Init(IN dword _index, IN dword _x_low, IN dword _x_high, IN
 */
 PRIVATE void WINDOW_Clear(IN dword _index, IN ARGB _color)
 {
-	//Make color transparent... should be solid?
-	_color = COLOR_MakeTransparent(_color);
+	SURFACE* buffer = &windows_heap[_index].window.buffer;
 
-	//Rectangle
-	dword x_low = windows_heap[_index].window.area.down_left.x;
-	dword x_high = windows_heap[_index].window.area.up_right.x;
-	dword y_low = windows_heap[_index].window.area.down_left.y;
-	dword y_high = windows_heap[_index].window.area.up_right.y;
-	
-	//Fill the window rectangle
-	for(dword x = x_low; x <= x_high; x++)
+	//Fill the window rectangle over the desktop
+	WINDOW_FillBackground(_index, 0, 0, buffer->width, buffer->height, _color);
+
+	//Draw lines
+	_color = COLOR_MakeSolid(_color);
+
+	SURFACE_Fill(buffer, 0, 0, buffer->width, 1, _color);
+	SURFACE_Fill(buffer, 0, buffer->height - 1, buffer->width, 1, _color);
+	SURFACE_Fill(buffer, 0, 0, 1, buffer->height, _color);
+	SURFACE_Fill(buffer, buffer->width - 1, 0, 1, buffer->height, _color);
+
+	WINDOW_InvalidateWindow(_index);
+}
+
+/**
+* @brief Places a window, with a new buffer if the size changes. The old top rows are kept inside
+* the frame, text being written from the top.
+* @param _index [in] The windows heap index.
+* @param _x [in] X coordinate of the low left corner.
+* @param _y [in] Y coordinate of the low left corner.
+* @param _width [in] Pixels per row, both edges included.
+* @param _height [in] Number of rows, both edges included.
+* @return False if the window could not take the new size (its buffer is mapped, or the pool is full).
+*/
+PRIVATE bool WINDOW_SetArea(IN dword _index, IN dword _x, IN dword _y, IN dword _width, IN dword _height)
+{
+	WINDOW_IMPL* w = &windows_heap[_index].window;
+	bool resized = true;
+
+	if(_width < WINDOW_MINIMUM_SIZE)
+		_width = WINDOW_MINIMUM_SIZE;
+	if(_height < WINDOW_MINIMUM_SIZE)
+		_height = WINDOW_MINIMUM_SIZE;
+
+	SURFACE old_buffer = w->buffer;
+	PHYSICAL old_memory = w->buffer_memory;
+	dword old_pages = w->buffer_pages;
+
+	//Where it was
+	if(old_memory)
+		WINDOW_InvalidateWindow(_index);
+
+	if(!old_memory || old_buffer.width != _width || old_buffer.height != _height)
 	{
-		for(dword y = y_low; y <= y_high; y++)
+		//A mapped buffer can't move under its owner
+		dword pages = RTL_BytesToPages(_width*_height*sizeof(ARGB));
+		PHYSICAL memory = w->surface_pdbr?0:WINDOW_PoolAlloc(pages);
+		if(memory)
+		{
+			SURFACE_Init(&w->buffer, (ARGB*)memory, _width, _height);
+			w->buffer_memory = memory;
+			w->buffer_pages = pages;
+		}
+		else if(old_memory)
+		{
+			_width = old_buffer.width;
+			_height = old_buffer.height;
+			resized = false;
+		}
+		else
 		{
-			SVGA_SetPixel(x, y, _color);
+			return false;
 		}
 	}
 
-	//Draw lines
-	_color = COLOR_MakeSolid(_color);
+	w->area.down_left.x = _x;
+	w->area.down_left.y = _y;
+	w->area.up_right.x = _x + _width - 1;
+	w->area.up_right.y = _y + _height - 1;
+
+	if(w->buffer_memory == old_memory)
+	{
+		//Where it is
+		WINDOW_InvalidateWindow(_index);
+		return resized;
+	}
 
-	WINDOW_DrawLineHorizontal(x_low, x_high, y_low, _color);
-	WINDOW_DrawLineHorizontal(x_low, x_high, y_high, _color);
-	WINDOW_DrawLineVertical(y_low, y_high, x_low, _color);
-	WINDOW_DrawLineVertical(y_low, y_high, x_high, _color);
+	//Desktop and frame, then what was inside the old frame
+	WINDOW_Clear(_index, WINDOW_DEFAULT_COLOR);
+	if(old_memory)
+	{
+		dword width = ((old_buffer.width < _width)?old_buffer.width:_width) - 2;
+		dword height = ((old_buffer.height < _height)?old_buffer.height:_height) - 2;
+		for(dword i = 1; i <= height; i++)
+		{
+			SURFACE_WriteRow(&w->buffer, 1, _height - 1 - i, old_buffer.origin + (long)(old_buffer.height - 1 - i)*old_buffer.pitch + 1, width);
+		}
+		WINDOW_PoolRelease(old_memory, old_pages);
+	}
+	return true;
+}
+
+/**
+* @brief Calculates the cells of the hit test grid an area touches.
+* @param _area [in] The area.
+* @param _low [out] Low left cell.
+* @param _high [out] Up right cell.
+*/
+PRIVATE void WINDOW_GetCells(IN RECTANGLE* _area, OUT COORDINATE* _low, OUT COORDINATE* _high)
+{
+	_low->x = _area->down_left.x >> WINDOW_GRID_SHIFT;
+	_low->y = _area->down_left.y >> WINDOW_GRID_SHIFT;
+	_high->x = _area->up_right.x >> WINDOW_GRID_SHIFT;
+	_high->y = _area->up_right.y >> WINDOW_GRID_SHIFT;
+	if(_high->x >= window_grid.width)
+		_high->x = window_grid.width - 1;
+	if(_high->y >= window_grid.height)
+		_high->y = window_grid.height - 1;
 }
 
 /**
-* @brief Redraws the background where to mouse pointer was.
+* @brief Builds again the hit test grid, after windows come, go, move or change size.
+* @return False if there was no memory (the old grid is kept).
 */
-PRIVATE void POINTER_RestoreBackground()
+PRIVATE bool WINDOW_BuildGrid()
 {
-	for(byte y = 0; y < 8; y++)
+	dword cells = window_grid.width*window_grid.height;
+	COORDINATE low, high;
+
+	dword entries = 0;
+	for(dword i = 0; i < windows_order_number; i++)
+	{
+		WINDOW_GetCells(&windows_heap[windows_order[i]].window.area, &low, &high);
+		entries += (high.x - low.x + 1)*(high.y - low.y + 1);
+	}
+
+	dword pages = RTL_BytesToPages((cells + 1 + entries)*sizeof(dword));
+	dword* first = (dword*)MEM_AllocPages(pages, KernelMode);
+	if(!first)
+		return false;
+	dword* windows = first + cells + 1;
+
+	//Count the windows per cell, then turn the counts into where each cell ends
+	for(dword cell = 0; cell <= cells; cell++)
+	{
+		first[cell] = 0;
+	}
+	for(dword i = 0; i < windows_order_number; i++)
 	{
-		for(byte x = 0; x < 8; x++)
+		WINDOW_GetCells(&windows_heap[windows_order[i]].window.area, &low, &high);
+		for(dword y = low.y; y <= high.y; y++)
 		{
-			SVGA_SetPixel(mouse_pointer.position.x + x, mouse_pointer.position.y - y, mouse_pointer.background[x][y]);
+			for(dword x = low.x; x <= high.x; x++)
+			{
+				first[y*window_grid.width + x]++;
+			}
+		}
+	}
+	for(dword cell = 1; cell <= cells; cell++)
+	{
+		first[cell] += first[cell - 1];
+	}
+
+	//Fill each cell backwards from its end, bottom window first so the top one ends first
+	for(dword i = 0; i < windows_order_number; i++)
+	{
+		WINDOW_GetCells(&windows_heap[windows_order[i]].window.area, &low, &high);
+		for(dword y = low.y; y <= high.y; y++)
+		{
+			for(dword x = low.x; x <= high.x; x++)
+			{
+				windows[--first[y*window_grid.width + x]] = windows_order[i];
+			}
 		}
 	}
+
+	//The mouse and keyboard handlers look at the grid
+	dword state = INT_DisableInterrupts();
+	PHYSICAL old = (PHYSICAL)window_grid.first;
+	dword old_pages = window_grid.pages;
+	window_grid.first = first;
+	window_grid.windows = windows;
+	window_grid.pages = pages;
+	INT_EnableInterrupts(state);
+
+	if(old)
+		MEM_ReleasePages(old, old_pages);
+	return true;
 }
 
 /**
-* @brief Gets the background where the pointer is going to be.
+* @brief Places the windows following the layout, and builds the hit test grid.
+* Tiles are filled by columns, up and down in turns, so four windows are the four quarters.
 */
-PRIVATE void POINTER_SaveBackground()
+PRIVATE void WINDOW_Layout()
 {
-	for(byte y = 0; y < 8; y++)
+	dword number = windows_order_number;
+	if(windows_layout == WINDOW_LAYOUT_TILED && number)
 	{
-		for(byte x = 0; x < 8; x++)
+		dword columns = 1;
+		while(columns*columns < number)
+			columns++;
+		dword rows = (number + columns - 1)/columns;
+		columns = (number + rows - 1)/rows;
+
+		dword tile_width = screen_size.width/columns;
+		for(dword i = 0; i < number; i++)
 		{
-			mouse_pointer.background[x][y] = SVGA_GetPixel(mouse_pointer.position.x + x, mouse_pointer.position.y - y);
+			dword column = i/rows;
+			dword in_column = (column == columns - 1)?(number - column*rows):rows;
+			dword row = (column & 1)?(in_column - 1 - i%rows):(i%rows);
+			dword tile_height = screen_size.height/in_column;
+
+			WINDOW_SetArea(	windows_order[i],
+							column*tile_width + WINDOW_WIDTH_MARGIN,
+							row*tile_height + WINDOW_HEIGHT_MARGIN,
+							tile_width - 2*WINDOW_WIDTH_MARGIN + 1,
+							tile_height - 2*WINDOW_HEIGHT_MARGIN + 1);
 		}
 	}
+	WINDOW_BuildGrid();
 }
 
 /**
-* @brief Draws the mouse pointer.
+* @brief Builds a screen row from the desktop, the windows and the pointer, and writes it.
+* @param _y [in] The row.
+* @param _x_low [in] The low x coordinate.
+* @param _x_high [in] The high x coordinate.
+* @return Number of pixels written to the framebuffer.
 */
-PRIVATE void POINTER_Draw()
+PRIVATE dword WINDOW_ComposeRow(IN dword _y, IN dword _x_low, IN dword _x_high)
 {
-	dword width = screen_size.width;
-	byte* mask = masks[mouse_pointer.mask];
-	for(byte y = 0; y < 8; y++)
+	dword width = _x_high - _x_low + 1;
+	ARGB* row = compositor_row.origin;
+
+	//Desktop below everything
+	SURFACE_ReadRow(&desktop, _x_low, _y, row, width);
+
+	//Windows, from the bottom one
+	for(dword i = 0; i < windows_order_number; i++)
+	{
+		WINDOW_IMPL* w = &windows_heap[windows_order[i]].window;
+		if(!w->buffer_memory || _y < w->area.down_left.y || _y > w->area.up_right.y)
+			continue;
+
+		dword x_low = (_x_low > w->area.down_left.x)?_x_low:w->area.down_left.x;
+		dword x_high = (_x_high < w->area.up_right.x)?_x_high:w->area.up_right.x;
+		if(x_low > x_high)
+			continue;
+
+		SURFACE_ReadRow(&w->buffer, x_low - w->area.down_left.x, _y - w->area.down_left.y, row + (x_low - _x_low), x_high - x_low + 1);
+	}
+
+	//Pointer on top
+	if(_y <= mouse_pointer.position.y && mouse_pointer.position.y - _y < POINTER_HEIGHT)
 	{
-		for(byte x = 0; x < 8; x++)
+		byte* mask = masks[mouse_pointer.mask] + (mouse_pointer.position.y - _y)*POINTER_WIDTH;
+		for(dword x = 0; x < POINTER_WIDTH; x++)
 		{
-			if(mask[y*8+x] && (mouse_pointer.position.x + x < width) && (mouse_pointer.position.y - y > 0))
-				SVGA_SetPixel(mouse_pointer.position.x + x, mouse_pointer.position.y - y, mouse_pointer.color);
+			dword screen_x = mouse_pointer.position.x + x;
+			if(mask[x] && screen_x >= _x_low && screen_x <= _x_high)
+				SURFACE_SetPixel(&compositor_row, screen_x - _x_low, 0, mouse_pointer.color);
 		}
 	}
+
+	SVGA_WriteRow(_x_low, _y, row, width);
+	return width;
+}
+
+/**
+* @brief Composites the dirty rectangles to the framebuffer.
+*/
+PRIVATE void WINDOW_Compose()
+{
+	if(!dirty_rectangles_number)
+		return;
+
+	qword start = CPU_ReadTimeStamp();
+	dword pixels = 0;
+
+	//The mouse may invalidate while compositing, what it marks is left for next frame
+	RECTANGLE rectangles[MAX_DIRTY_RECTANGLES];
+	dword state = INT_DisableInterrupts();
+	dword number = dirty_rectangles_number;
+	for(dword i = 0; i < number; i++)
+	{
+		rectangles[i] = dirty_rectangles[i];
+	}
+	dirty_rectangles_number = 0;
+	INT_EnableInterrupts(state);
+
+	for(dword i = 0; i < number; i++)
+	{
+		RECTANGLE* r = &rectangles[i];
+		for(dword y = r->down_left.y; y <= r->up_right.y; y++)
+		{
+			pixels += WINDOW_ComposeRow(y, r->down_left.x, r->up_right.x);
+		}
+	}
+	window_statistics.last_rectangles = number;
+
+	qword cycles = CPU_ReadTimeStamp() - start;
+
+	window_statistics.frames++;
+	window_statistics.last_pixels = pixels;
+	window_statistics.last_cycles = cycles;
+	if(cycles > window_statistics.max_cycles)
+		window_statistics.max_cycles = cycles;
+	window_statistics.pixels += pixels;
+	window_statistics.cycles += cycles;
 }
 
 /**
@@ -342,16 +859,15 @@ PRIVATE void POINTER_Init(IN dword _mask, IN ARGB _color)
 {
 	//Set Color
 	mouse_pointer.color = _color;
-	
+
 	//Set position
 	mouse_pointer.position.x = MOUSE_GetX();
 	mouse_pointer.position.y = MOUSE_GetY();
 
 	//Set mask
 	mouse_pointer.mask = _mask;
-	
-	POINTER_SaveBackground();
-	POINTER_Draw();
+
+	POINTER_Invalidate();
 }
 
 /**
@@ -360,8 +876,11 @@ PRIVATE void POINTER_Init(IN dword _mask, IN ARGB _color)
 */
 PRIVATE void POINTER_SetNewMask(IN dword _mask)
 {
-	if(_mask < MAX_MASKS)
+	if(_mask < MAX_MASKS && _mask != mouse_pointer.mask)
+	{
 		mouse_pointer.mask = _mask;
+		POINTER_Invalidate();
+	}
 }
 
 /**
@@ -370,7 +889,11 @@ PRIVATE void POINTER_SetNewMask(IN dword _mask)
 */
 PRIVATE void POINTER_SetNewColor(IN ARGB _color)
 {
-	mouse_pointer.color = _color;
+	if(_color != mouse_pointer.color)
+	{
+		mouse_pointer.color = _color;
+		POINTER_Invalidate();
+	}
 }
 
 /**
@@ -378,8 +901,8 @@ PRIVATE void POINTER_SetNewColor(IN ARGB _color)
 */
 PRIVATE void POINTER_OnMove()
 {
-	//Restore background
-	POINTER_RestoreBackground();
+	//Where it was
+	POINTER_Invalidate();
 
 	//Get new position
 	mouse_pointer.position.x = MOUSE_GetX();
@@ -389,12 +912,9 @@ PRIVATE void POINTER_OnMove()
 	mouse_pointer.position.y = MOUSE_GetY();
 	if(mouse_pointer.position.y <= POINTER_HEIGHT)
 		mouse_pointer.position.y = POINTER_HEIGHT;
-	
-	//Save
-	POINTER_SaveBackground();
-	
-	//Draw
-	POINTER_Draw();
+
+	//Where it is
+	POINTER_Invalidate();
 }
 
 /**
@@ -406,7 +926,7 @@ PRIVATE void POINTER_OnMove()
 */
 PRIVATE bool WINDOW_TestCoordinatesInWindow(IN dword _index, IN dword _x, IN dword _y)
 {
-	return 
+	return
 		(
 			(_x <= windows_heap[_index].window.area.up_right.x)
 			&&
@@ -428,15 +948,73 @@ PRIVATE bool WINDOW_TestCoordinatesInWindow(IN dword _index, IN dword _x, IN dwo
 */
 PRIVATE WINDOW WINDOW_GetFromPointer(IN dword _x, IN dword _y)
 {
-	for(dword i = 0; i < MAX_WINDOWS; i++)
+	dword cell_x = _x >> WINDOW_GRID_SHIFT;
+	dword cell_y = _y >> WINDOW_GRID_SHIFT;
+	if(!window_grid.first || cell_x >= window_grid.width || cell_y >= window_grid.height)
+		return 0;
+
+	//Only the windows touching the cell, the top one first
+	dword cell = cell_y*window_grid.width + cell_x;
+	for(dword i = window_grid.first[cell]; i < window_grid.first[cell + 1]; i++)
 	{
-		if(windows_heap[i].used)
+		dword index = window_grid.windows[i];
+		if(WINDOW_TestCoordinatesInWindow(index, _x, _y))
+			return TO_HANDLE(index);
+	}
+	return 0;
+}
+
+/**
+* @brief Queues an input event in a window ring. Only called from interrupt handlers, so the reader
+* never runs in the middle.
+* @param _index [in] The windows heap index.
+* @param _type [in] WINDOW_EVENT_KEY or WINDOW_EVENT_MOUSE.
+* @param _value [in] The scan code or the buttons mask.
+*/
+PRIVATE void WINDOW_PushEvent(IN dword _index, IN dword _type, IN dword _value)
+{
+	WINDOW_IMPL* w = &windows_heap[_index].window;
+	WINDOW_EVENT_RING* ring = w->events;
+
+	//Nobody would read it
+	if(!ring || (!w->events_pdbr && !w->keyboard_callback && !w->mouse_callback))
+		return;
+
+	dword x = mouse_pointer.position.x - w->area.down_left.x;
+	dword y = mouse_pointer.position.y - w->area.down_left.y;
+	dword head = ring->head;
+
+	//A move with the same buttons just updates the last one if it is not read yet, and the reader is not
+	//in the middle of taking it
+	if(_type == WINDOW_EVENT_MOUSE && head != ring->tail && !ring->reading)
+	{
+		WINDOW_EVENT* last = &ring->events[(head - 1) & (WINDOW_EVENTS - 1)];
+		if(last->type == WINDOW_EVENT_MOUSE && last->value == _value)
 		{
-			if(WINDOW_TestCoordinatesInWindow(i, _x, _y))
-				return TO_HANDLE(i);
+			last->x = x;
+			last->y = y;
+			ring->coalesced++;
+			window_statistics.coalesced++;
+			return;
 		}
 	}
-	return 0;
+
+	if(head - ring->tail >= WINDOW_EVENTS)
+	{
+		ring->dropped++;
+		window_statistics.dropped++;
+		return;
+	}
+
+	WINDOW_EVENT* event = &ring->events[head & (WINDOW_EVENTS - 1)];
+	event->type = _type;
+	event->value = _value;
+	event->x = x;
+	event->y = y;
+
+	//The event is complete before the reader can see it
+	ring->head = head + 1;
+	window_statistics.events++;
 }
 
 /**
@@ -450,26 +1028,7 @@ PRIVATE bool INTERRUPT WindowKeyboardHandler(IN INTERRUPT_FRAME* _frame)
 	WINDOW window = WINDOW_GetFromPointer(mouse_pointer.position.x, mouse_pointer.position.y);
 	if(window)
 	{
-		WINDOW_IMPL* w = &windows_heap[TO_INDEX(window)].window;
-
-		if(w->keyboard_callback && w->keyboard_pdbr)
-		{
-			 if(ENVIRONMENT_GetCurrent() && ENVIRONMENT_OwnsWINDOW(ENVIRONMENT_GetCurrent(), window))
-			 {
-				 ADDRESS_SPACE current = ADDRESS_SPACE_GetCurrent();
-				 ADDRESS_SPACE_SwitchTo(w->keyboard_pdbr);
-
-				//Call callback if any
-				dword scan_code = KBD_ScanCode();
-				w->keyboard_callback(scan_code);
-
-				ADDRESS_SPACE_SwitchTo(current);
-			}
-			else
-			{
-				w->keyboard_events[w->keyboard_index++] = KBD_ScanCode();
-			}
-		}
+		WINDOW_PushEvent(TO_INDEX(window), WINDOW_EVENT_KEY, KBD_ScanCode());
 	}
 	return true;
 }
@@ -490,75 +1049,85 @@ PRIVATE bool INTERRUPT WindowMouseHandler(IN INTERRUPT_FRAME* _frame)
 		POINTER_SetNewColor(w->pointer_color);
 		POINTER_SetNewMask(w->pointer_mask);
 
-		if(w->mouse_callback && w->mouse_pdbr)
-		{
-			dword x = mouse_pointer.position.x - w->area.down_left.x;
-			dword y = mouse_pointer.position.y - w->area.down_left.y;
-			bool left = MOUSE_IsLeftButtonDown();
-			bool right = MOUSE_IsRightButtonDown();
-
-			if(ENVIRONMENT_GetCurrent() && ENVIRONMENT_OwnsWINDOW(ENVIRONMENT_GetCurrent(), window))
-			{
-				ADDRESS_SPACE current = ADDRESS_SPACE_GetCurrent();
-				ADDRESS_SPACE_SwitchTo(w->mouse_pdbr);
-
-				//Call callback if any
-				w->mouse_callback(x, y, left, right);
+		dword buttons = 0;
+		if(MOUSE_IsLeftButtonDown())
+			buttons |= WINDOW_BUTTON_LEFT;
+		if(MOUSE_IsRightButtonDown())
+			buttons |= WINDOW_BUTTON_RIGHT;
 
-				ADDRESS_SPACE_SwitchTo(current);
-			}
-			else
-			{
-				dword index = w->mouse_index;
-				w->mouse_events[index].left = left;
-				w->mouse_events[index].right = right;
-				w->mouse_events[index].cursor.x = x;
-				w->mouse_events[index].cursor.y = y;
-				w->mouse_index++;
-			}
-		}
+		WINDOW_PushEvent(TO_INDEX(window), WINDOW_EVENT_MOUSE, buttons);
 	}
 
 	POINTER_OnMove();
 	return true;
 }
 
+/**
+* @brief Composites what changed since last tick, deferred by the timer interrupt.
+* @param _frame [in] Interrupt frame.
+* @param _data [in] Unused.
+*/
+PRIVATE void INTERRUPT WindowComposeWork(IN INTERRUPT_FRAME* _frame, IN dword _data)
+{
+	WINDOW_Compose();
+}
+
+/**
+* @brief Window timer interrupt service. Leaves the composition for when interrupts are enabled.
+* @param _frame [in] Interrupt frame.
+* @return True if call chain can be continued, false otherwise.
+*/
+PRIVATE bool INTERRUPT WindowTimerHandler(IN INTERRUPT_FRAME* _frame)
+{
+	if(dirty_rectangles_number)
+		INT_QueueWork(WindowComposeWork, 0);
+	return true;
+}
+
 /**
 * @brief Window initialization.
 * @return Returns true if everything goes well.
 */
 PUBLIC bool WINDOW_Init()
 {
-	WINDOW_LoadBackground();
-	
 	dword height = SVGA_GetHeight();
-	dword half_height = height/2;
 	dword width = SVGA_GetWidth();
-	dword half_width = width/2;
-	
+
 	screen_size.height = height;
 	screen_size.width = width;
 
-	WINDOW_Init(0, 0, half_width, 0, half_height);
-	WINDOW_Init(1, 0, half_width, half_height, height);
-	WINDOW_Init(2, half_width, width, half_height, height);
-	WINDOW_Init(3, half_width, width, 0, half_height);
+	if(!WINDOW_AllocSurface(&compositor_row, width, 1, KernelMode))
+		return false;
+
+	if(!WINDOW_LoadBackground())
+		return false;
+
+	//Windows are placed as they are allocated
+	if(!WINDOW_PoolInit() || !WINDOW_GrowTable())
+		return false;
 
-	WINDOW_Clear(0, WINDOW_DEFAULT_COLOR);
-	WINDOW_Clear(1, WINDOW_DEFAULT_COLOR);
-	WINDOW_Clear(2, WINDOW_DEFAULT_COLOR);
-	WINDOW_Clear(3, WINDOW_DEFAULT_COLOR);
+	window_grid.width = (width + (1<<WINDOW_GRID_SHIFT) - 1) >> WINDOW_GRID_SHIFT;
+	window_grid.height = (height + (1<<WINDOW_GRID_SHIFT) - 1) >> WINDOW_GRID_SHIFT;
+	if(!WINDOW_BuildGrid())
+		return false;
 
 	//Start Mouse Pointer
 	POINTER_Init(POINTER_ARROW, POINTER_DEFAULT_COLOR);
-	
-	//Register keyboard and mouse handlers
+
+	//First frame, the time stamp counts from reset so it tells how long booting took
+	WINDOW_Compose();
+	window_statistics.desktop_cycles = CPU_ReadTimeStamp();
+
+	//Register keyboard, mouse and timer handlers
 	if(!INT_SetHandler(HardwareInterrupt, 1, WindowKeyboardHandler))
 		return false;
 
 	if(!INT_SetHandler(HardwareInterrupt, 12, WindowMouseHandler))
 		return false;
 
+	if(!INT_SetHandler(HardwareInterrupt, 0, WindowTimerHandler))
+		return false;
+
 	return true;
 }
 
@@ -568,15 +1137,46 @@ PUBLIC bool WINDOW_Init()
 */
 PUBLIC WINDOW WINDOW_GetWindow()
 {
-	for(dword i = 0; i < MAX_WINDOWS; i++)
+	dword index = 0;
+	while(index < windows_number && windows_heap[index].used)
+		index++;
+
+	if(index == windows_number && !WINDOW_GrowTable())
+		return 0;
+
+	WINDOW_Init(index);
+
+	//The events ring must be there before the window is under the pointer
+	WINDOW_EVENT_RING* ring = (WINDOW_EVENT_RING*)WINDOW_PoolAlloc(1);
+	if(!ring)
+		return 0;
+	ring->head = 0;
+	ring->tail = 0;
+	ring->dropped = 0;
+	ring->coalesced = 0;
+	ring->reading = 0;
+	windows_heap[index].window.events = ring;
+	windows_heap[index].used = true;
+
+	//New windows go on top
+	windows_order[windows_order_number++] = index;
+
+	if(windows_layout == WINDOW_LAYOUT_OVERLAPPED)
 	{
-		if(!windows_heap[i].used)
-		{
-			windows_heap[i].used = true;
-			return TO_HANDLE(i);
-		}
+		dword width = screen_size.width/2 - 2*WINDOW_WIDTH_MARGIN + 1;
+		dword height = screen_size.height/2 - 2*WINDOW_HEIGHT_MARGIN + 1;
+		dword offset = ((windows_order_number - 1)*WINDOW_CASCADE) % (screen_size.height/2);
+		WINDOW_SetArea(index, WINDOW_WIDTH_MARGIN + offset, screen_size.height - WINDOW_HEIGHT_MARGIN - height - offset, width, height);
 	}
-	return 0;
+	WINDOW_Layout();
+
+	//No room in the pool
+	if(!windows_heap[index].window.buffer_memory)
+	{
+		WINDOW_ReleaseWindow(TO_HANDLE(index));
+		return 0;
+	}
+	return TO_HANDLE(index);
 }
 
 /**
@@ -585,23 +1185,40 @@ PUBLIC WINDOW WINDOW_GetWindow()
 */
 PUBLIC void WINDOW_ReleaseWindow(IN WINDOW _window)
 {
-	if(_window && TO_INDEX(_window)<MAX_WINDOWS && windows_heap[TO_INDEX(_window)].used)
+	if(WINDOW_IsWindow(_window))
 	{
-		windows_heap[TO_INDEX(_window)].used = false;
+		WINDOW_UnmapSurface(_window);
+		WINDOW_UnmapEvents(_window);
 
-		WINDOW_IMPL* w = &windows_heap[TO_INDEX(_window)].window;
-		w->focus = false;
+		dword index = TO_INDEX(_window);
+		WINDOW_IMPL* w = &windows_heap[index].window;
 
-		w->pointer_color = POINTER_DEFAULT_COLOR;
-		w->pointer_mask = POINTER_ARROW;
+		//Out of the stack
+		dword j = 0;
+		for(dword i = 0; i < windows_order_number; i++)
+		{
+			if(windows_order[i] != index)
+				windows_order[j++] = windows_order[i];
+		}
+		windows_order_number = j;
+
+		//The desktop shows again where it was
+		if(w->buffer_memory)
+		{
+			WINDOW_InvalidateWindow(index);
+			WINDOW_PoolRelease(w->buffer_memory, w->buffer_pages);
+		}
 
-		w->keyboard_pdbr = 0;
-		w->keyboard_callback = 0;
-		w->keyboard_index = 0;
+		//No interrupt may queue on the ring once it is back in the pool
+		dword state = INT_DisableInterrupts();
+		windows_heap[index].used = false;
+		windows_heap[index].generation++;
+		WINDOW_PoolRelease((PHYSICAL)w->events, 1);
+		WINDOW_Init(index);
+		INT_EnableInterrupts(state);
 
-		w->mouse_pdbr = 0;
-		w->mouse_callback = 0;
-		w->mouse_index = 0;
+		//The others take the room
+		WINDOW_Layout();
 	}
 }
 
@@ -612,7 +1229,7 @@ PUBLIC void WINDOW_ReleaseWindow(IN WINDOW _window)
 */
 PUBLIC dword WINDOW_GetHeight(IN WINDOW _window)
 {
-	if(_window && TO_INDEX(_window)<MAX_WINDOWS && windows_heap[TO_INDEX(_window)].used)
+	if(WINDOW_IsWindow(_window))
 	{
 		WINDOW_IMPL* w = &windows_heap[TO_INDEX(_window)].window;
 
@@ -628,7 +1245,7 @@ PUBLIC dword WINDOW_GetHeight(IN WINDOW _window)
 */
 PUBLIC dword WINDOW_GetWidth(IN WINDOW _window)
 {
-	if(_window && TO_INDEX(_window)<MAX_WINDOWS && windows_heap[TO_INDEX(_window)].used)
+	if(WINDOW_IsWindow(_window))
 	{
 		WINDOW_IMPL* w = &windows_heap[TO_INDEX(_window)].window;
 
@@ -637,6 +1254,71 @@ PUBLIC dword WINDOW_GetWidth(IN WINDOW _window)
 	return 0;
 }
 
+/**
+* @brief Moves a window, keeping it on the screen. A later tiling may place it again.
+* @param _window [in] Window resource.
+* @param _x [in] X coordinate of the low left corner.
+* @param _y [in] Y coordinate of the low left corner.
+*/
+PUBLIC void WINDOW_Move(IN WINDOW _window, IN dword _x, IN dword _y)
+{
+	if(WINDOW_IsWindow(_window))
+	{
+		SURFACE* buffer = &windows_heap[TO_INDEX(_window)].window.buffer;
+
+		if(_x > screen_size.width - buffer->width)
+			_x = screen_size.width - buffer->width;
+		if(_y > screen_size.height - buffer->height)
+			_y = screen_size.height - buffer->height;
+
+		WINDOW_SetArea(TO_INDEX(_window), _x, _y, buffer->width, buffer->height);
+		WINDOW_BuildGrid();
+	}
+}
+
+/**
+* @brief Changes a window size, as returned by WINDOW_GetWidth and WINDOW_GetHeight, keeping its low
+* left corner. The window is cleared but for the top rows. A later tiling may size it again.
+* @param _window [in] Window resource.
+* @param _width [in] The new width.
+* @param _height [in] The new height.
+* @return False if the size could not change (the buffer is mapped or there is no memory).
+*/
+PUBLIC bool WINDOW_Resize(IN WINDOW _window, IN dword _width, IN dword _height)
+{
+	if(WINDOW_IsWindow(_window))
+	{
+		COORDINATE* low = &windows_heap[TO_INDEX(_window)].window.area.down_left;
+
+		//The area includes both edges
+		dword width = _width + 1;
+		dword height = _height + 1;
+		if(width > screen_size.width - low->x)
+			width = screen_size.width - low->x;
+		if(height > screen_size.height - low->y)
+			height = screen_size.height - low->y;
+
+		bool resized = WINDOW_SetArea(TO_INDEX(_window), low->x, low->y, width, height);
+		WINDOW_BuildGrid();
+		return resized;
+	}
+	return false;
+}
+
+/**
+* @brief Chooses how windows are placed.
+* @param _layout [in] WINDOW_LAYOUT_TILED to share the screen among all the windows now and whenever
+* one comes or goes, WINDOW_LAYOUT_OVERLAPPED to leave them where they are and cascade new ones.
+*/
+PUBLIC void WINDOW_SetLayout(IN dword _layout)
+{
+	if(_layout == WINDOW_LAYOUT_TILED || _layout == WINDOW_LAYOUT_OVERLAPPED)
+	{
+		windows_layout = _layout;
+		WINDOW_Layout();
+	}
+}
+
 /**
 * @brief Consults a window pixel.
 * @param _window [in] Window resource.
@@ -646,7 +1328,7 @@ PUBLIC dword WINDOW_GetWidth(IN WINDOW _window)
 */
 PUBLIC ARGB WINDOW_GetPixel(IN WINDOW _window, IN dword _x, IN dword _y)
 {
-	if(_window && TO_INDEX(_window)<MAX_WINDOWS && windows_heap[TO_INDEX(_window)].used)
+	if(WINDOW_IsWindow(_window))
 	{
 		WINDOW_IMPL* w = &windows_heap[TO_INDEX(_window)].window;
 
@@ -654,7 +1336,7 @@ PUBLIC ARGB WINDOW_GetPixel(IN WINDOW _window, IN dword _x, IN dword _y)
 		dword y_size = w->area.up_right.y - w->area.down_left.y;
 		if(_x < x_size && _y < y_size)
 		{
-			return SVGA_GetPixel(w->area.down_left.x + _x, w->area.down_left.y + _y);
+			return SURFACE_GetPixel(&w->buffer, _x, _y);
 		}
 	}
 	return 0;
@@ -669,7 +1351,7 @@ PUBLIC ARGB WINDOW_GetPixel(IN WINDOW _window, IN dword _x, IN dword _y)
 */
 PUBLIC void WINDOW_SetPixel(IN WINDOW _window, IN dword _x, IN dword _y, IN ARGB _color)
 {
-	if(_window && TO_INDEX(_window)<MAX_WINDOWS && windows_heap[TO_INDEX(_window)].used)
+	if(WINDOW_IsWindow(_window))
 	{
 		WINDOW_IMPL* w = &windows_heap[TO_INDEX(_window)].window;
 
@@ -677,7 +1359,8 @@ PUBLIC void WINDOW_SetPixel(IN WINDOW _window, IN dword _x, IN dword _y, IN ARGB
 		dword y_size = w->area.up_right.y - w->area.down_left.y;
 		if(_x <= x_size && _y <= y_size)
 		{
-			SVGA_SetPixel(w->area.down_left.x + _x, w->area.down_left.y + _y, _color);
+			SURFACE_SetPixel(&w->buffer, _x, _y, _color);
+			WINDOW_Invalidate(w->area.down_left.x + _x, w->area.down_left.y + _y, w->area.down_left.x + _x, w->area.down_left.y + _y);
 			return;
 		}
 	}
@@ -693,7 +1376,7 @@ PUBLIC void WINDOW_SetPixel(IN WINDOW _window, IN dword _x, IN dword _y, IN ARGB
 */
 PUBLIC void WINDOW_PrintText(IN WINDOW _window, IN dword _x, IN dword _y, IN ARGB _color, IN string* _text)
 {
-	if(_window && TO_INDEX(_window)<MAX_WINDOWS && windows_heap[TO_INDEX(_window)].used)
+	if(WINDOW_IsWindow(_window))
 	{
 		WINDOW_IMPL* w = &windows_heap[TO_INDEX(_window)].window;
 
@@ -704,12 +1387,258 @@ PUBLIC void WINDOW_PrintText(IN WINDOW _window, IN dword _x, IN dword _y, IN ARG
 			//Test we can put the text
 			if((_y >= 8) && ((_x + _text->size * 8) < x_size))
 			{
-				SVGA_PrintText(w->area.down_left.x + _x, w->area.down_left.y + _y, _color, _text);
+				SURFACE_PrintText(&w->buffer, _x, _y, _color, _text);
+				WINDOW_Invalidate(w->area.down_left.x + _x, w->area.down_left.y + _y - 7, w->area.down_left.x + _x + _text->size * 8 - 1, w->area.down_left.y + _y);
 			}
 		}
 	}
 }
 
+/**
+* @brief Draws a BMP file in the window, clipped to it.
+* @param _window [in] Window resource.
+* @param _x [in] X relative coordinate of the low left corner.
+* @param _y [in] Y relative coordinate of the low left corner.
+* @param _file [in] The file contents.
+* @param _size [in] The file size.
+* @return False if the file is not a 24 or 32 bit uncompressed bitmap.
+*/
+PUBLIC bool WINDOW_DrawBitmap(IN WINDOW _window, IN dword _x, IN dword _y, IN byte* _file, IN dword _size)
+{
+	if(WINDOW_IsWindow(_window))
+	{
+		WINDOW_IMPL* w = &windows_heap[TO_INDEX(_window)].window;
+
+		BITMAP bitmap;
+		if(!BITMAP_Open(&bitmap, _file, _size))
+			return false;
+
+		BITMAP_Draw(&bitmap, &w->buffer, _x, _y);
+
+		//Only what was drawn, within the window
+		if(_x < w->buffer.width && _y < w->buffer.height)
+		{
+			dword width = bitmap.width;
+			if(width > w->buffer.width - _x)
+				width = w->buffer.width - _x;
+			dword height = bitmap.height;
+			if(height > w->buffer.height - _y)
+				height = w->buffer.height - _y;
+			if(width && height)
+				WINDOW_Invalidate(w->area.down_left.x + _x, w->area.down_left.y + _y, w->area.down_left.x + _x + width - 1, w->area.down_left.y + _y + height - 1);
+		}
+		return true;
+	}
+	return false;
+}
+
+/**
+* @brief Prints text in the window, filling the background of each character.
+* @param _window [in] Window resource.
+* @param _x [in] X relative coordinate.
+* @param _y [in] Y relative coordinate.
+* @param _foreground [in] Color for the text.
+* @param _background [in] Color behind the text.
+* @param _text [in] String text.
+*/
+PUBLIC void WINDOW_PrintTextOpaque(IN WINDOW _window, IN dword _x, IN dword _y, IN ARGB _foreground, IN ARGB _background, IN string* _text)
+{
+	if(WINDOW_IsWindow(_window))
+	{
+		WINDOW_IMPL* w = &windows_heap[TO_INDEX(_window)].window;
+
+		dword x_size = w->area.up_right.x - w->area.down_left.x;
+		dword y_size = w->area.up_right.y - w->area.down_left.y;
+		if(_x <= x_size && _y <= y_size)
+		{
+			//Test we can put the text
+			if((_y >= 8) && ((_x + _text->size * 8) < x_size))
+			{
+				SURFACE_PrintTextOpaque(&w->buffer, _x, _y, _foreground, _background, _text);
+				WINDOW_Invalidate(w->area.down_left.x + _x, w->area.down_left.y + _y - 7, w->area.down_left.x + _x + _text->size * 8 - 1, w->area.down_left.y + _y);
+			}
+		}
+	}
+}
+
+/**
+* @brief Scrolls up the inside of a window (borders excluded) between two rows, moving its rows.
+* The rows left at the bottom are emptied.
+* @param _window [in] Window resource.
+* @param _y_low [in] Lowest row that moves.
+* @param _y_high [in] Highest row, lost when scrolling.
+* @param _distance [in] Number of rows to move.
+* @param _color [in] Color for the emptied rows, mixed over the window like in a new window.
+*/
+PUBLIC void WINDOW_Scroll(IN WINDOW _window, IN dword _y_low, IN dword _y_high, IN dword _distance, IN ARGB _color)
+{
+	if(WINDOW_IsWindow(_window))
+	{
+		WINDOW_IMPL* w = &windows_heap[TO_INDEX(_window)].window;
+		SURFACE* buffer = &w->buffer;
+
+		if(!_y_low || _y_high >= buffer->height - 1 || _y_low > _y_high || !_distance)
+			return;
+
+		dword height = _y_high - _y_low + 1;
+		if(_distance > height)
+			_distance = height;
+
+		SURFACE_ScrollUp(buffer, 1, _y_low, buffer->width - 2, height, _distance);
+
+		WINDOW_FillBackground(TO_INDEX(_window), 1, _y_low, buffer->width - 2, _distance, WINDOW_DEFAULT_COLOR);
+		SURFACE_Fill(buffer, 1, _y_low, buffer->width - 2, _distance, _color);
+
+		WINDOW_Invalidate(w->area.down_left.x + 1, w->area.down_left.y + _y_low, w->area.up_right.x - 1, w->area.down_left.y + _y_high);
+	}
+}
+
+/**
+* @brief Maps the window back buffer in an address space, to be drawn directly. Rows are
+* WINDOW_GetWidth + 1 pixels (the window includes both edges), row 0 being the bottom one like
+* in WINDOW_SetPixel. What is drawn reaches the screen on WINDOW_Present.
+* @param _window [in] Window resource.
+* @param _pdbr [in] The address space where the surface will be mapped.
+* @param _address [in] The virtual address where the surface will be mapped.
+* @return The virtual address of the surface, zero if it could not be mapped.
+*/
+PUBLIC VIRTUAL WINDOW_MapSurface(IN WINDOW _window, IN ADDRESS_SPACE _pdbr, IN VIRTUAL _address)
+{
+	if(WINDOW_IsWindow(_window))
+	{
+		WINDOW_IMPL* w = &windows_heap[TO_INDEX(_window)].window;
+
+		//One mapping per window
+		if(w->surface_pdbr)
+			return 0;
+
+		//Page tables are only reachable from kernel space
+		ADDRESS_SPACE current = ADDRESS_SPACE_GetCurrent();
+		ADDRESS_SPACE_ResetToKernelSpace();
+
+		//The window owns the pages, not the address space
+		bool success = ADDRESS_SPACE_Map(_pdbr, w->buffer_memory, _address, w->buffer_pages, UserMode, ReadWrite, false);
+
+		ADDRESS_SPACE_SwitchTo(current);
+
+		if(success)
+		{
+			w->surface_pdbr = _pdbr;
+			w->surface_address = _address;
+			return _address;
+		}
+	}
+	return 0;
+}
+
+/**
+* @brief Unmaps the window back buffer from the address space it was mapped in, if any.
+* @param _window [in] Window resource.
+*/
+PUBLIC void WINDOW_UnmapSurface(IN WINDOW _window)
+{
+	if(WINDOW_IsWindow(_window))
+	{
+		WINDOW_IMPL* w = &windows_heap[TO_INDEX(_window)].window;
+
+		if(w->surface_pdbr)
+		{
+			ADDRESS_SPACE current = ADDRESS_SPACE_GetCurrent();
+			ADDRESS_SPACE_ResetToKernelSpace();
+
+			ADDRESS_SPACE_Unmap(w->surface_pdbr, w->surface_address, w->buffer_pages);
+
+			ADDRESS_SPACE_SwitchTo(current);
+
+			w->surface_pdbr = 0;
+			w->surface_address = 0;
+		}
+	}
+}
+
+/**
+* @brief Maps the window events ring in an address space, to be read directly. The guest reads the
+* events from tail to head and then advances tail; while mapped the callbacks are not called.
+* @param _window [in] Window resource.
+* @param _pdbr [in] The address space where the ring will be mapped.
+* @param _address [in] The virtual address where the ring will be mapped.
+* @return The virtual address of the ring, zero if it could not be mapped.
+*/
+PUBLIC VIRTUAL WINDOW_MapEvents(IN WINDOW _window, IN ADDRESS_SPACE _pdbr, IN VIRTUAL _address)
+{
+	if(WINDOW_IsWindow(_window))
+	{
+		WINDOW_IMPL* w = &windows_heap[TO_INDEX(_window)].window;
+
+		//One reader per ring
+		if(w->events_pdbr)
+			return 0;
+
+		//Page tables are only reachable from kernel space
+		ADDRESS_SPACE current = ADDRESS_SPACE_GetCurrent();
+		ADDRESS_SPACE_ResetToKernelSpace();
+
+		//The window owns the page, not the address space
+		bool success = ADDRESS_SPACE_Map(_pdbr, (PHYSICAL)w->events, _address, 1, UserMode, ReadWrite, false);
+
+		ADDRESS_SPACE_SwitchTo(current);
+
+		if(success)
+		{
+			w->events_pdbr = _pdbr;
+			w->events_address = _address;
+			return _address;
+		}
+	}
+	return 0;
+}
+
+/**
+* @brief Unmaps the window events ring from the address space it was mapped in, if any.
+* @param _window [in] Window resource.
+*/
+PUBLIC void WINDOW_UnmapEvents(IN WINDOW _window)
+{
+	if(WINDOW_IsWindow(_window))
+	{
+		WINDOW_IMPL* w = &windows_heap[TO_INDEX(_window)].window;
+
+		if(w->events_pdbr)
+		{
+			ADDRESS_SPACE current = ADDRESS_SPACE_GetCurrent();
+			ADDRESS_SPACE_ResetToKernelSpace();
+
+			ADDRESS_SPACE_Unmap(w->events_pdbr, w->events_address, 1);
+
+			ADDRESS_SPACE_SwitchTo(current);
+
+			w->events_pdbr = 0;
+			w->events_address = 0;
+		}
+	}
+}
+
+/**
+* @brief Shows the window back buffer on next composition.
+* @param _window [in] Window resource.
+*/
+PUBLIC void WINDOW_Present(IN WINDOW _window)
+{
+	if(WINDOW_IsWindow(_window))
+	{
+		WINDOW_InvalidateWindow(TO_INDEX(_window));
+	}
+}
+
+/**
+* @brief Consults the compositor counters.
+* @param _statistics [out] Where to leave the counters.
+*/
+PUBLIC void WINDOW_GetStatistics(OUT WINDOW_STATISTICS* _statistics)
+{
+	*_statistics = window_statistics;
+}
+
 /**
 * @brief Registers a keyboard callback for a window.
 * @param _window [in] Window resource.
@@ -717,7 +1646,7 @@ PUBLIC void WINDOW_PrintText(IN WINDOW _window, IN dword _x, IN dword _y, IN ARG
 */
 PUBLIC void WINDOW_RegisterKeyboard(IN WINDOW _window, IN ADDRESS_SPACE _pdbr, IN fWindowKeyboardCallback _callback)
 {
-	if(_window && TO_INDEX(_window)<MAX_WINDOWS && windows_heap[TO_INDEX(_window)].used)
+	if(WINDOW_IsWindow(_window))
 	{
 		WINDOW_IMPL* w = &windows_heap[TO_INDEX(_window)].window;
 
@@ -733,7 +1662,7 @@ PUBLIC void WINDOW_RegisterKeyboard(IN WINDOW _window, IN ADDRESS_SPACE _pdbr, I
 */
 PUBLIC void WINDOW_RegisterMouse(IN WINDOW _window, IN ADDRESS_SPACE _pdbr, IN fWindowMouseCallback _callback)
 {
-	if(_window && TO_INDEX(_window)<MAX_WINDOWS && windows_heap[TO_INDEX(_window)].used)
+	if(WINDOW_IsWindow(_window))
 	{
 		WINDOW_IMPL* w = &windows_heap[TO_INDEX(_window)].window;
 
@@ -767,7 +1696,7 @@ PUBLIC POINTER POINTER_GetClock()
 */
 PUBLIC void WINDOW_SetPointer(IN WINDOW _window, IN POINTER _pointer)
 {
-	if(_window && TO_INDEX(_window)<MAX_WINDOWS && windows_heap[TO_INDEX(_window)].used)
+	if(WINDOW_IsWindow(_window))
 	{
 		WINDOW_IMPL* w = &windows_heap[TO_INDEX(_window)].window;
 
@@ -782,7 +1711,7 @@ PUBLIC void WINDOW_SetPointer(IN WINDOW _window, IN POINTER _pointer)
 */
 PUBLIC void WINDOW_SetPointerColor(IN WINDOW _window, IN ARGB _color)
 {
-	if(_window && TO_INDEX(_window)<MAX_WINDOWS && windows_heap[TO_INDEX(_window)].used)
+	if(WINDOW_IsWindow(_window))
 	{
 		WINDOW_IMPL* w = &windows_heap[TO_INDEX(_window)].window;
 
@@ -791,53 +1720,67 @@ PUBLIC void WINDOW_SetPointerColor(IN WINDOW _window, IN ARGB _color)
 }
 
 /**
-* @brief Flush keyboard events to the window handler when environment owning the window gains execution.
-* @param _window [in] Window resource.
+* @brief Unmaps all the surfaces mapped in an address space that is going to be released.
+* @param _pdbr [in] The address space.
 */
-PUBLIC void WINDOW_FlushKeyboardCallbacks(IN WINDOW _window)
+PUBLIC void WINDOW_ReleaseSurfaces(IN ADDRESS_SPACE _pdbr)
 {
-	if(_window && TO_INDEX(_window)<MAX_WINDOWS && windows_heap[TO_INDEX(_window)].used)
+	for(dword i = 0; i < windows_number; i++)
 	{
-		WINDOW_IMPL* w = &windows_heap[TO_INDEX(_window)].window;
-
-		if(w->keyboard_callback && w->keyboard_pdbr)
-		{
-			ADDRESS_SPACE current = ADDRESS_SPACE_GetCurrent();
-			ADDRESS_SPACE_SwitchTo(w->keyboard_pdbr);
-
-			for(dword i = 0; i < w->keyboard_index; i++)
-			{
-				w->keyboard_callback(w->keyboard_events[i]);
-			}
-			w->keyboard_index = 0;
-
-			ADDRESS_SPACE_SwitchTo(current);
-		}
+		if(windows_heap[i].used && windows_heap[i].window.surface_pdbr == _pdbr)
+			WINDOW_UnmapSurface(TO_HANDLE(i));
+		if(windows_heap[i].used && windows_heap[i].window.events_pdbr == _pdbr)
+			WINDOW_UnmapEvents(TO_HANDLE(i));
 	}
 }
 
 /**
-* @brief Flush mouse events to the window handler when environment owning the window gains execution.
+* @brief Delivers the queued events to the window callbacks when the environment owning the window
+* gains execution. Windows whose ring is mapped are read by the guest instead.
 * @param _window [in] Window resource.
 */
-PUBLIC void WINDOW_FlushMouseCallbacks(IN WINDOW  _window)
+PUBLIC void WINDOW_FlushEvents(IN WINDOW _window)
 {
-	if(_window && TO_INDEX(_window)<MAX_WINDOWS && windows_heap[TO_INDEX(_window)].used)
+	if(WINDOW_IsWindow(_window))
 	{
 		WINDOW_IMPL* w = &windows_heap[TO_INDEX(_window)].window;
+		WINDOW_EVENT_RING* ring = w->events;
+
+		if(w->events_pdbr || ring->tail == ring->head)
+			return;
+
+		ADDRESS_SPACE current = ADDRESS_SPACE_GetCurrent();
+		ADDRESS_SPACE switched = current;
 
-		if(w->mouse_callback && w->mouse_pdbr)
+		while(ring->tail != ring->head)
 		{
-			ADDRESS_SPACE current = ADDRESS_SPACE_GetCurrent();
-			ADDRESS_SPACE_SwitchTo(w->mouse_pdbr);
+			//Deferred work runs with interrupts enabled, the event must not change until tail is past it
+			ring->reading = 1;
+			WINDOW_EVENT event = ring->events[ring->tail & (WINDOW_EVENTS - 1)];
+			ring->tail++;
+			ring->reading = 0;
 
-			for(dword i = 0; i < w->mouse_index; i++)
+			if(event.type == WINDOW_EVENT_KEY && w->keyboard_callback && w->keyboard_pdbr)
 			{
-				w->mouse_callback(w->mouse_events[i].cursor.x, w->mouse_events[i].cursor.y, w->mouse_events[i].left, w->mouse_events[i].right);
+				if(switched != w->keyboard_pdbr)
+				{
+					switched = w->keyboard_pdbr;
+					ADDRESS_SPACE_SwitchTo(switched);
+				}
+				w->keyboard_callback(event.value);
 			}
-			w->mouse_index = 0;
+			else if(event.type == WINDOW_EVENT_MOUSE && w->mouse_callback && w->mouse_pdbr)
+			{
+				if(switched != w->mouse_pdbr)
+				{
+					switched = w->mouse_pdbr;
+					ADDRESS_SPACE_SwitchTo(switched);
+				}
+				w->mouse_callback(event.x, event.y, (event.value & WINDOW_BUTTON_LEFT)?true:false, (event.value & WINDOW_BUTTON_RIGHT)?true:false);
+			}
+		}
 
+		if(switched != current)
 			ADDRESS_SPACE_SwitchTo(current);
-		}
 	}
 }
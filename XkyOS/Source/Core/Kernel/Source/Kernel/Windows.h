@@ -27,6 +27,59 @@
 	* @brief The keyboard callback type.
 	*/
 	typedef void (*fWindowKeyboardCallback)(IN dword _scan_code);
+	/**
+	* @brief An input event of a window.
+	*/
+	struct WINDOW_EVENT
+	{
+		dword type;		/*< WINDOW_EVENT_KEY or WINDOW_EVENT_MOUSE*/
+		dword value;	/*< The scan code, or the WINDOW_BUTTON_ mask*/
+		dword x;		/*< Pointer relative to the window low left corner*/
+		dword y;
+	};
+
+	#define WINDOW_EVENT_KEY	1	/**< A key was pressed or released*/
+	#define WINDOW_EVENT_MOUSE	2	/**< The pointer moved or a button changed*/
+	#define WINDOW_BUTTON_LEFT	1	/**< Left button down*/
+	#define WINDOW_BUTTON_RIGHT	2	/**< Right button down*/
+	#define WINDOW_EVENTS		128	/**< Events in a ring, a power of two*/
+
+	/**
+	* @brief The events of a window, in a page of its own. The interrupt handlers only write events and
+	* head, the reader only tail, so no lock is needed. Indexes run free and are masked with WINDOW_EVENTS - 1.
+	* A pointer move may update the last event after it is published, but not while the reader says it is
+	* reading: it may be copying that event or about to move tail past it.
+	*/
+	struct WINDOW_EVENT_RING
+	{
+		volatile dword	head;		/*< Next event to be written*/
+		volatile dword	tail;		/*< Next event to be read*/
+		dword			dropped;	/*< Events lost because the ring was full*/
+		dword			coalesced;	/*< Pointer moves folded into the previous one*/
+		volatile dword	reading;	/*< Set by the reader while it takes events*/
+		WINDOW_EVENT	events[WINDOW_EVENTS];
+	};
+	/**
+	* @brief Compositor counters.
+	*/
+	struct WINDOW_STATISTICS
+	{
+		dword frames;			/*< Compositions done*/
+		dword last_rectangles;	/*< Dirty rectangles in last composition*/
+		dword last_pixels;		/*< Pixels written to the framebuffer in last composition*/
+		qword last_cycles;		/*< Time stamp cycles spent in last composition*/
+		qword max_cycles;		/*< Worst composition*/
+		qword pixels;			/*< Pixels written to the framebuffer since boot*/
+		qword cycles;			/*< Time stamp cycles spent compositing since boot*/
+		qword background_cycles;/*< Time stamp cycles spent loading and decoding the desktop image*/
+		qword desktop_cycles;	/*< Time stamp when the first frame was on screen*/
+		dword events;			/*< Input events queued to windows*/
+		dword dropped;			/*< Input events lost in full rings*/
+		dword coalesced;		/*< Pointer moves folded into a queued one*/
+	};
+
+	#define WINDOW_LAYOUT_TILED			0	/**< The windows share the screen*/
+	#define WINDOW_LAYOUT_OVERLAPPED	1	/**< The windows stay where they are put*/
 
 	bool WINDOW_Init();
 
@@ -35,12 +88,26 @@
 	
 	dword	WINDOW_GetHeight(IN WINDOW _window);
 	dword	WINDOW_GetWidth	(IN WINDOW _window);
+	void	WINDOW_Move		(IN WINDOW _window, IN dword _x, IN dword _y);
+	bool	WINDOW_Resize	(IN WINDOW _window, IN dword _width, IN dword _height);
+	void	WINDOW_SetLayout(IN dword _layout);
 	ARGB	WINDOW_GetPixel	(IN WINDOW _window, IN dword _x, IN dword _y);
 	void	WINDOW_SetPixel	(IN WINDOW _window, IN dword _x, IN dword _y, IN ARGB _color);
 	void	WINDOW_PrintText(IN WINDOW _window, IN dword _x, IN dword _y, IN ARGB _color, IN string* _text);
+	void	WINDOW_PrintTextOpaque(IN WINDOW _window, IN dword _x, IN dword _y, IN ARGB _foreground, IN ARGB _background, IN string* _text);
+	void	WINDOW_Scroll	(IN WINDOW _window, IN dword _y_low, IN dword _y_high, IN dword _distance, IN ARGB _color);
+	bool	WINDOW_DrawBitmap(IN WINDOW _window, IN dword _x, IN dword _y, IN byte* _file, IN dword _size);
+
+	VIRTUAL	WINDOW_MapSurface	(IN WINDOW _window, IN ADDRESS_SPACE _pdbr, IN VIRTUAL _address);
+	void	WINDOW_UnmapSurface	(IN WINDOW _window);
+	void	WINDOW_Present		(IN WINDOW _window);
+
+	void	WINDOW_GetStatistics(OUT WINDOW_STATISTICS* _statistics);
 
 	void	WINDOW_RegisterKeyboard	(IN WINDOW _window, IN ADDRESS_SPACE _pdbr, IN fWindowKeyboardCallback _keyboard_callback);
 	void	WINDOW_RegisterMouse	(IN WINDOW _window, IN ADDRESS_SPACE _pdbr, IN fWindowMouseCallback _mouse_callback);
+	VIRTUAL	WINDOW_MapEvents		(IN WINDOW _window, IN ADDRESS_SPACE _pdbr, IN VIRTUAL _address);
+	void	WINDOW_UnmapEvents		(IN WINDOW _window);
 
 	/**
 	* @brief Pointer handle type.
@@ -53,7 +120,7 @@
 	void	WINDOW_SetPointerColor	(IN WINDOW _window, IN ARGB _color);
 
 	//Private kernel use
-	void WINDOW_FlushKeyboardCallbacks	(IN WINDOW _window);
-	void WINDOW_FlushMouseCallbacks		(IN WINDOW _window);
+	void WINDOW_FlushEvents				(IN WINDOW _window);
+	void WINDOW_ReleaseSurfaces			(IN ADDRESS_SPACE _pdbr);
 
 #endif
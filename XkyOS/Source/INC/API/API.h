@@ -46,6 +46,39 @@ IMPORT(XKY_DISK_Free);
 IMPORT(XKY_DISK_Read);
 IMPORT(XKY_DISK_Write);
 
+typedef dword DISK_REQUEST;
+#define DISK_REQUEST_PENDING	1	/**< Queued or being transferred*/
+#define DISK_REQUEST_DONE		2	/**< All the sectors were transferred*/
+#define DISK_REQUEST_FAILED		3	/**< Some sector could not be transferred*/
+
+typedef DISK_REQUEST	(*fXKY_DISK_Submit)	(IN LBA _sector, IN VIRTUAL _memory, IN dword _number_of_sectors, IN bool _write);
+typedef dword			(*fXKY_DISK_Poll)	(IN DISK_REQUEST _request);
+typedef bool			(*fXKY_DISK_Wait)	(IN DISK_REQUEST _request);
+IMPORT(XKY_DISK_Submit);
+IMPORT(XKY_DISK_Poll);
+IMPORT(XKY_DISK_Wait);
+
+#define DISK_SCHEDULER_FIFO		0	/**< Requests go in order of arrival, one per transfer*/
+#define DISK_SCHEDULER_CLOOK	1	/**< Requests go in one sweep across the disk, contiguous ones merged*/
+
+struct DISK_STATISTICS
+{
+	dword requests;
+	dword transfers;
+	dword merged;
+	dword sectors;
+	dword seeks;
+	qword distance;
+	dword scheduler;
+	dword cached;
+	dword prefetched;
+};
+
+typedef bool	(*fXKY_DISK_SetScheduler)	(IN dword _scheduler);
+typedef void	(*fXKY_DISK_GetStatistics)	(OUT DISK_STATISTICS* _statistics);
+IMPORT(XKY_DISK_SetScheduler);
+IMPORT(XKY_DISK_GetStatistics);
+
 //Windows
 typedef dword WINDOW;
 typedef dword ARGB;
@@ -53,8 +86,52 @@ typedef dword POINTER;
 typedef void (*fWindowMouseCallback)	(IN dword _x, IN dword _y, IN bool _left_clicked, IN bool _right_clicked);
 typedef void (*fWindowKeyboardCallback)	(IN dword _scan_code);
 
+struct WINDOW_EVENT
+{
+	dword type;
+	dword value;
+	dword x;
+	dword y;
+};
+
+#define WINDOW_EVENT_KEY	1	/**< A key was pressed or released, value is the scan code*/
+#define WINDOW_EVENT_MOUSE	2	/**< The pointer moved or a button changed, value is the buttons mask*/
+#define WINDOW_BUTTON_LEFT	1
+#define WINDOW_BUTTON_RIGHT	2
+#define WINDOW_EVENTS		128
+
+struct WINDOW_EVENT_RING
+{
+	volatile dword	head;
+	volatile dword	tail;
+	dword			dropped;
+	dword			coalesced;
+	volatile dword	reading;
+	WINDOW_EVENT	events[WINDOW_EVENTS];
+};
+
 #define SRGB(R,G,B) ((ARGB)((0x00<<24)|((R)<<16)|((G)<<8)|((B)))) //ARGB SolidRGB(byte R, byte G, byte B);
 #define TRGB(R,G,B) ((ARGB)((0xFF<<24)|((R)<<16)|((G)<<8)|((B)))) //ARGB TransparentRGB(byte R, byte G, byte B);
+#define COLOR_IsSolid(C) (((C) & 0xFF000000)?false:true) //bool COLOR_IsSolid(ARGB _color);
+
+#define WINDOW_LAYOUT_TILED			0	/**< The windows share the screen*/
+#define WINDOW_LAYOUT_OVERLAPPED	1	/**< The windows stay where they are put*/
+
+struct WINDOW_STATISTICS
+{
+	dword frames;
+	dword last_rectangles;
+	dword last_pixels;
+	qword last_cycles;
+	qword max_cycles;
+	qword pixels;
+	qword cycles;
+	qword background_cycles;
+	qword desktop_cycles;
+	dword events;
+	dword dropped;
+	dword coalesced;
+};
 
 typedef WINDOW	(*fXKY_WINDOW_Alloc)	();
 typedef void	(*fXKY_WINDOW_Free)		(IN WINDOW _window);
@@ -70,6 +147,16 @@ typedef POINTER	(*fXKY_POINTER_GetArrow)		();
 typedef POINTER	(*fXKY_POINTER_GetClock)		();
 typedef void	(*fXKY_WINDOW_SetPointer)		(IN WINDOW _window, IN POINTER _pointer);
 typedef void	(*fXKY_WINDOW_SetPointerColor)	(IN WINDOW _window, IN ARGB _color);
+typedef VIRTUAL	(*fXKY_WINDOW_MapSurface)		(IN WINDOW _window, IN ADDRESS_SPACE _pdbr, IN VIRTUAL _address);
+typedef void	(*fXKY_WINDOW_Present)			(IN WINDOW _window);
+typedef void	(*fXKY_WINDOW_GetStatistics)	(OUT WINDOW_STATISTICS* _statistics);
+typedef void	(*fXKY_WINDOW_PrintTextOpaque)	(IN WINDOW _window, IN dword _x, IN dword _y, IN ARGB _foreground, IN ARGB _background, IN string* _text);
+typedef void	(*fXKY_WINDOW_Scroll)			(IN WINDOW _window, IN dword _y_low, IN dword _y_high, IN dword _distance, IN ARGB _color);
+typedef bool	(*fXKY_WINDOW_DrawBitmap)		(IN WINDOW _window, IN dword _x, IN dword _y, IN byte* _file, IN dword _size);
+typedef void	(*fXKY_WINDOW_Move)				(IN WINDOW _window, IN dword _x, IN dword _y);
+typedef bool	(*fXKY_WINDOW_Resize)			(IN WINDOW _window, IN dword _width, IN dword _height);
+typedef void	(*fXKY_WINDOW_SetLayout)		(IN dword _layout);
+typedef VIRTUAL	(*fXKY_WINDOW_MapEvents)		(IN WINDOW _window, IN ADDRESS_SPACE _pdbr, IN VIRTUAL _address);
 IMPORT(XKY_WINDOW_Alloc);
 IMPORT(XKY_WINDOW_Free);
 IMPORT(XKY_WINDOW_GetHeight);
@@ -83,6 +170,16 @@ IMPORT(XKY_POINTER_GetArrow);
 IMPORT(XKY_POINTER_GetClock);
 IMPORT(XKY_WINDOW_SetPointer);
 IMPORT(XKY_WINDOW_SetPointerColor);
+IMPORT(XKY_WINDOW_MapSurface);
+IMPORT(XKY_WINDOW_Present);
+IMPORT(XKY_WINDOW_GetStatistics);
+IMPORT(XKY_WINDOW_PrintTextOpaque);
+IMPORT(XKY_WINDOW_Scroll);
+IMPORT(XKY_WINDOW_DrawBitmap);
+IMPORT(XKY_WINDOW_Move);
+IMPORT(XKY_WINDOW_Resize);
+IMPORT(XKY_WINDOW_SetLayout);
+IMPORT(XKY_WINDOW_MapEvents);
 
 //PCI
 typedef dword PCI;
@@ -194,10 +291,32 @@ IMPORT(XKY_LDR_LoadFile);
 IMPORT(XKY_LDR_FileSize);
 
 //OS
+struct ENVIRONMENT_USAGE
+{
+	dword pages;
+	dword sectors;
+	dword executions;
+	dword windows;
+	dword ticks;
+	dword syscalls;
+};
+struct ENVIRONMENT_LIMITS
+{
+	dword pages;
+	dword sectors;
+	dword executions;
+	dword windows;
+	dword weight;		/*< Share of the CPU against other environments, whatever its xids*/
+};
+
 typedef bool	(*fXKY_OS_Start)	(IN string* _module);
 typedef void	(*fXKY_OS_Finish)	();
+typedef void	(*fXKY_OS_GetAccount)	(OUT ENVIRONMENT_USAGE* _usage, OUT ENVIRONMENT_LIMITS* _limits);
+typedef void	(*fXKY_OS_SetLimits)	(IN ENVIRONMENT_LIMITS* _limits);
 IMPORT(XKY_OS_Start);
 IMPORT(XKY_OS_Finish);
+IMPORT(XKY_OS_GetAccount);
+IMPORT(XKY_OS_SetLimits);
 
 //EXCEPTION
 struct INTERRUPT_FRAME
@@ -234,14 +353,43 @@ typedef bool (*fInterruptHandler)(IN INTERRUPT_FRAME* _frame);
 typedef bool (*fXKY_EXCEPTION_SetHandler)	(IN byte _exception, IN ADDRESS_SPACE _pdbr, IN fInterruptHandler _handler);
 typedef void (*fXKY_EXCEPTION_UnsetHandler)	(IN byte _exception);
 
+struct INTERRUPT_STATISTICS
+{
+	dword interrupts;
+	dword deferred;
+	dword dropped;
+	dword max_vector;
+	qword max_cycles;
+	qword max_deferred_cycles;
+	qword max_delay_cycles;
+};
+typedef void (*fXKY_INTERRUPT_GetStatistics)	(OUT INTERRUPT_STATISTICS* _statistics);
+
 IMPORT(XKY_EXCEPTION_SetHandler);
 IMPORT(XKY_EXCEPTION_UnsetHandler);
+IMPORT(XKY_INTERRUPT_GetStatistics);
 
 //DEBUG
 typedef void (*fXKY_DEBUG_Message)	(IN string* _message, IN dword _color);
 typedef void (*fXKY_DEBUG_Data)		(IN string* _message, IN dword _data, IN dword _color);
+typedef void (*fXKY_DEBUG_Environments)	();
 
 IMPORT(XKY_DEBUG_Message);
 IMPORT(XKY_DEBUG_Data);
+IMPORT(XKY_DEBUG_Environments);
+
+//SVGA
+#define PIXELS_FILL		0
+#define PIXELS_COPY		1
+#define PIXELS_BLEND	2
+
+#define PIXELS_STRING	0
+#define PIXELS_MMX		1
+#define PIXELS_SSE		2
+#define MAX_PIXELS_IMPLEMENTATIONS	3
+
+typedef bool (*fXKY_SVGA_Benchmark)	(IN dword _primitive, IN dword _implementation, IN VIRTUAL _buffer, IN dword _count);
+
+IMPORT(XKY_SVGA_Benchmark);
 
 #endif //__API_H__
@@ -32,6 +32,11 @@
 #define IDX_XKY_DISK_Free	(IDX_XKY_DISK_START + 2) /**< XKY_DISK_Free Index*/
 #define IDX_XKY_DISK_Read	(IDX_XKY_DISK_START + 3) /**< XKY_DISK_Read Index*/
 #define IDX_XKY_DISK_Write	(IDX_XKY_DISK_START + 4) /**< XKY_DISK_Write Index*/
+#define IDX_XKY_DISK_Submit	(IDX_XKY_DISK_START + 5) /**< XKY_DISK_Submit Index*/
+#define IDX_XKY_DISK_Poll	(IDX_XKY_DISK_START + 6) /**< XKY_DISK_Poll Index*/
+#define IDX_XKY_DISK_Wait	(IDX_XKY_DISK_START + 7) /**< XKY_DISK_Wait Index*/
+#define IDX_XKY_DISK_SetScheduler	(IDX_XKY_DISK_START + 8) /**< XKY_DISK_SetScheduler Index*/
+#define IDX_XKY_DISK_GetStatistics	(IDX_XKY_DISK_START + 9) /**< XKY_DISK_GetStatistics Index*/
 
 //Windows
 #define IDX_XKY_WINDOW_START	0x30
@@ -48,6 +53,9 @@
 #define IDX_XKY_POINTER_GetClock		(IDX_XKY_WINDOW_START + 11) /**< XKY_POINTER_GetClock Index*/
 #define IDX_XKY_WINDOW_SetPointer		(IDX_XKY_WINDOW_START + 12) /**< XKY_WINDOW_SetPointer Index*/
 #define IDX_XKY_WINDOW_SetPointerColor	(IDX_XKY_WINDOW_START + 13) /**< XKY_WINDOW_SetPointerColor Index*/
+#define IDX_XKY_WINDOW_MapSurface		(IDX_XKY_WINDOW_START + 14) /**< XKY_WINDOW_MapSurface Index*/
+#define IDX_XKY_WINDOW_Present			(IDX_XKY_WINDOW_START + 15) /**< XKY_WINDOW_Present Index*/
+#define IDX_XKY_WINDOW_GetStatistics	(IDX_XKY_WINDOW_START + 16) /**< XKY_WINDOW_GetStatistics Index*/
 
 //PCI
 #define IDX_XKY_PCI_START	0x40
@@ -96,6 +104,8 @@
 #define IDX_XKY_OS_START	0x90
 #define IDX_XKY_OS_Start		(IDX_XKY_OS_START + 1) /**< XKY_OS_Start Index*/
 #define IDX_XKY_OS_Finish		(IDX_XKY_OS_START + 2) /**< XKY_OS_Finish Index*/
+#define IDX_XKY_OS_GetAccount	(IDX_XKY_OS_START + 3) /**< XKY_OS_GetAccount Index*/
+#define IDX_XKY_OS_SetLimits	(IDX_XKY_OS_START + 4) /**< XKY_OS_SetLimits Index*/
 
 //EXCEPTION
 #define IDX_XKY_EXCEPTION_START	0xA0
@@ -103,10 +113,26 @@
 #define IDX_XKY_EXCEPTION_UnsetHandler		(IDX_XKY_EXCEPTION_START + 2) /**< XKY_EXCEPTION_UnsetHandler Index*/
 #define IDX_XKY_INTERRUPT_SetHandler		(IDX_XKY_EXCEPTION_START + 3) /**< XKY_INTERRUPT_SetHandler Index*/
 #define IDX_XKY_INTERRUPT_UnsetHandler		(IDX_XKY_EXCEPTION_START + 4) /**< XKY_INTERRUPT_UnsetHandler Index*/
+#define IDX_XKY_INTERRUPT_GetStatistics		(IDX_XKY_EXCEPTION_START + 5) /**< XKY_INTERRUPT_GetStatistics Index*/
 
 //DEBUG
 #define IDX_XKY_DEBUG_START	0xB0
 #define IDX_XKY_DEBUG_Message	(IDX_XKY_DEBUG_START + 1) /**< XKY_DEBUG_Message Index*/
 #define IDX_XKY_DEBUG_Data		(IDX_XKY_DEBUG_START + 2) /**< XKY_DEBUG_Data Index*/
+#define IDX_XKY_DEBUG_Environments	(IDX_XKY_DEBUG_START + 3) /**< XKY_DEBUG_Environments Index*/
+
+//SVGA
+#define IDX_XKY_SVGA_START	0xC0
+#define IDX_XKY_SVGA_Benchmark	(IDX_XKY_SVGA_START + 1) /**< XKY_SVGA_Benchmark Index*/
+
+//Windows (continued)
+#define IDX_XKY_WINDOW_EX_START	0xD0
+#define IDX_XKY_WINDOW_PrintTextOpaque	(IDX_XKY_WINDOW_EX_START + 1) /**< XKY_WINDOW_PrintTextOpaque Index*/
+#define IDX_XKY_WINDOW_Scroll			(IDX_XKY_WINDOW_EX_START + 2) /**< XKY_WINDOW_Scroll Index*/
+#define IDX_XKY_WINDOW_DrawBitmap		(IDX_XKY_WINDOW_EX_START + 3) /**< XKY_WINDOW_DrawBitmap Index*/
+#define IDX_XKY_WINDOW_Move				(IDX_XKY_WINDOW_EX_START + 4) /**< XKY_WINDOW_Move Index*/
+#define IDX_XKY_WINDOW_Resize			(IDX_XKY_WINDOW_EX_START + 5) /**< XKY_WINDOW_Resize Index*/
+#define IDX_XKY_WINDOW_SetLayout		(IDX_XKY_WINDOW_EX_START + 6) /**< XKY_WINDOW_SetLayout Index*/
+#define IDX_XKY_WINDOW_MapEvents		(IDX_XKY_WINDOW_EX_START + 7) /**< XKY_WINDOW_MapEvents Index*/
 
 #endif //__FUNCTIONS_H__